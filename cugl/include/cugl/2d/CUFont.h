@@ -301,7 +301,8 @@ public:
      *
      * The font size is fixed on initialization.  It cannot be changed without
      * disposing of the entire font.  However, all other attributes may be
-     * changed.
+     * changed.  Files in the asset directory are read through the
+     * {@link AssetPack}, if there is one.
      *
      * @param file  The file with the font asset
      * @param size  The font size in points
@@ -961,6 +962,36 @@ public:
      */
     bool hasAtlas() const { return _hasAtlas; }
     
+    /**
+     * Appends the current atlas to the given buffer, returning true on success.
+     *
+     * The encoding contains the glyph layout, the glyph metrics, the kerning
+     * and the atlas pixels.  It may be restored with {@link decodeAtlas} to
+     * skip rasterizing the glyphs when the same font is loaded again (e.g.
+     * by the {@link AssetCache}).  This method fails if the atlas has no
+     * pixels, which is the case once {@link getAtlas()} has been called.
+     *
+     * @param data  The buffer to append the atlas to
+     *
+     * @return true if the atlas was encoded
+     */
+    bool encodeAtlas(std::vector<Uint8>& data) const;
+    
+    /**
+     * Restores an atlas encoded by {@link encodeAtlas}, returning true on success.
+     *
+     * The encoding must come from a font with the same source, size and
+     * settings.  As with {@link buildAtlasAsync()}, this method does not
+     * generate the OpenGL texture, so it is thread safe.  If the encoding
+     * is invalid, this font is left with no atlas.
+     *
+     * @param data  The encoded atlas
+     * @param size  The size of the encoding in bytes
+     *
+     * @return true if the atlas was restored
+     */
+    bool decodeAtlas(const Uint8* data, size_t size);
+    
 #pragma mark -
 #pragma mark Rendering
     /**
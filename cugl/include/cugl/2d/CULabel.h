@@ -813,7 +813,9 @@ public:
      * @param srcFactor Specifies how the source blending factors are computed
      * @param dstFactor Specifies how the destination blending factors are computed.
      */
-    void setBlendFunc(GLenum srcFactor, GLenum dstFactor) { _srcFactor = srcFactor; _dstFactor = dstFactor; }
+    void setBlendFunc(GLenum srcFactor, GLenum dstFactor) {
+        _srcFactor = srcFactor; _dstFactor = dstFactor; setContentDirty();
+    }
     
     /**
      * Returns the source blending factor
@@ -858,7 +860,7 @@ public:
      *
      * @param equation  Specifies how source and destination colors are combined
      */
-    void setBlendEquation(GLenum equation) { _blendEquation = equation; }
+    void setBlendEquation(GLenum equation) { _blendEquation = equation; setContentDirty(); }
     
     /**
      * Returns the blending equation for this textured node
@@ -899,6 +901,18 @@ public:
      */
     virtual void draw(const std::shared_ptr<SpriteBatch>& batch, const Mat4& transform, Color4 tint) override;
     
+    /**
+     * Returns the sprite batch state used by draw(), as a sortable key.
+     *
+     * A label with a background also draws a solid quad, but the glyph
+     * texture dominates its state.
+     *
+     * @return the sprite batch state used by draw(), as a sortable key.
+     */
+    virtual Uint64 getRenderKey() const override {
+        return makeRenderKey(_texture, _blendEquation, _srcFactor, _dstFactor);
+    }
+    
 private:
 #pragma mark -
 #pragma mark Internal Helpers
@@ -48,6 +48,10 @@
 #include <cugl/assets/CUJsonValue.h>
 #include <vector>
 #include <string>
+#include <list>
+
+/** The render key of a node that draws nothing of its own */
+#define RENDER_KEY_NONE 0
 
 namespace cugl {
     
@@ -157,6 +161,66 @@ protected:
      * alternate transform.
      */
     Mat4  _combined;
+    /** Whether the local transform only uses the 2d affine entries */
+    bool _affine;
+    
+    /**
+     * The cached node to world transform.
+     *
+     * This is only valid when _worldDirty is false.  If a node is dirty, so
+     * are all of its descendants, so a clean node has clean ancestors.
+     */
+    mutable Mat4 _world;
+    /** The cached world to node transform (valid unless _inverseDirty) */
+    mutable Mat4 _worldInverse;
+    /** Whether the world transform only uses the 2d affine entries */
+    mutable bool _worldAffine;
+    /** Whether the world transform must be recomputed */
+    mutable bool _worldDirty;
+    /** Whether the world inverse must be recomputed */
+    mutable bool _inverseDirty;
+    
+    /** Whether a scene may skip this node when its bounds are off screen */
+    bool _cullable;
+    /**
+     * The cached world bounds of this node and all of its descendants.
+     *
+     * This is only valid when _boundsDirty is false.  If a node is dirty, so
+     * are all of its ancestors.
+     */
+    mutable Rect _subtreeBounds;
+    /** The number of nodes in this subtree (valid unless _boundsDirty) */
+    mutable unsigned int _subtreeCount;
+    /** Whether the subtree has a node that may not be culled */
+    mutable bool _subtreeUnbounded;
+    /** Whether the subtree bounds must be recomputed */
+    mutable bool _boundsDirty;
+    
+    /** Whether this subtree is drawn from a retained mesh */
+    bool _static;
+    /** The retained mesh of a static subtree (nullptr if never baked) */
+    std::shared_ptr<SpriteMesh> _staticMesh;
+    /** The node to world transform that the retained mesh was baked with */
+    Mat4 _staticTransform;
+    /** The tint that the retained mesh was baked with */
+    Color4 _staticTint;
+    /** Whether this subtree is drawn from an offscreen texture */
+    bool _cacheAsBitmap;
+    /** The offscreen texture of a cached subtree (nullptr if released) */
+    std::shared_ptr<Texture> _cacheTexture;
+    /** The region of node space captured by the offscreen texture */
+    Rect _cacheBounds;
+    /** The drawing scale (ignoring the viewport) the texture was sized for */
+    float _cacheScale;
+    /** The position of this node in the least-recently-used cache list */
+    std::list<Node*>::iterator _cacheEntry;
+    /**
+     * Whether anything drawn by this subtree has changed.
+     *
+     * A static node re-bakes its mesh, and a cached node redraws its texture,
+     * when this is true.  If a node is dirty, so are all of its ancestors.
+     */
+    bool _contentDirty;
     
     /** The array of children nodes */
     std::vector<std::shared_ptr<Node>> _children;
@@ -199,6 +263,10 @@ protected:
     int  _zOrder;
     /** Indicates whether or not the z-order is currently violated */
     bool _zDirty;
+    /** Whether this node is in the list of moved children of its parent */
+    bool _zQueued;
+    /** The children that have moved out of z-order since the last sort */
+    std::vector<Node*> _zMoved;
     
 #pragma mark -
 #pragma mark Constructors
@@ -956,7 +1024,7 @@ public:
      *
      * @param color the color tinting this node.
      */
-    virtual void setColor(Color4 color) { _tintColor = color; }
+    virtual void setColor(Color4 color) { _tintColor = color; setContentDirty(); }
 
     /**
      * Returns the absolute color tinting this node.
@@ -989,7 +1057,33 @@ public:
      *
      * @param visible   true if the node is visible.
      */
-    void setVisible(bool visible) { _isVisible = visible; }
+    void setVisible(bool visible) {
+        if (_isVisible != visible) { _isVisible = visible; setContentDirty(); }
+    }
+    
+    /**
+     * Returns true if a scene may skip this node when it is off screen.
+     *
+     * A scene culls any subtree whose world bounds lie outside of the camera
+     * viewport.  Nodes that draw outside of their content bounds (such as
+     * particle or glow effects) should disable this.  Doing so also keeps
+     * every ancestor from being culled.  The default value is true.
+     *
+     * @return true if a scene may skip this node when it is off screen.
+     */
+    bool isCullable() const { return _cullable; }
+    
+    /**
+     * Sets whether a scene may skip this node when it is off screen.
+     *
+     * A scene culls any subtree whose world bounds lie outside of the camera
+     * viewport.  Nodes that draw outside of their content bounds (such as
+     * particle or glow effects) should disable this.  Doing so also keeps
+     * every ancestor from being culled.  The default value is true.
+     *
+     * @param value Whether a scene may skip this node when it is off screen.
+     */
+    void setCullable(bool value) { _cullable = value; setBoundsDirty(); }
     
     /**
      * Returns true if this node is tinted by its parent.
@@ -1011,7 +1105,7 @@ public:
      *
      * @param flag  Whether this node is tinted by its parent.
      */
-    void setRelativeColor(bool flag) { _hasParentColor = flag; }
+    void setRelativeColor(bool flag) { _hasParentColor = flag; setContentDirty(); }
     
     
 #pragma mark -
@@ -1221,9 +1315,12 @@ public:
      * It is the recursive (left-multiplied) node-to-parent transforms of all 
      * of its ancestors.
      *
+     * The matrix is cached, and is only recomputed when this node or one
+     * of its ancestors is transformed or reparented.
+     *
      * @return the matrix transforming node space to world space.
      */
-    Mat4 getNodeToWorldTransform() const;
+    Mat4 getNodeToWorldTransform() const { return worldTransform(); }
     
     /**
      * Returns the matrix transforming node space to world space.
@@ -1233,11 +1330,24 @@ public:
      * or mouse clicks. It is the recursive (right-multiplied) parent-to-node
      * transforms of all of its ancestors.
      *
+     * The matrix is cached, and is only recomputed when this node or one
+     * of its ancestors is transformed or reparented.
+     *
      * @return the matrix transforming node space to world space.
      */
-    Mat4 getWorldToNodeTransform() const {
-        return getNodeToWorldTransform().getInverse();
-    }
+    Mat4 getWorldToNodeTransform() const { return worldInverse(); }
+    
+    /**
+     * Returns the world space bounding box of this node and its descendants.
+     *
+     * This is the union of the transformed content bounds of every node in
+     * this subtree, including invisible ones.  The value is cached, and is
+     * only recomputed when a node in the subtree moves, resizes or is added
+     * or removed.
+     *
+     * @return the world space bounding box of this node and its descendants.
+     */
+    const Rect& getSubtreeBounds() const;
     
     /**
      * Converts a screen position to node (local) space coordinates.
@@ -1271,7 +1381,7 @@ public:
      * @return A point in node (local) space coordinates.
      */
     Vec2 worldToNodeCoords(const Vec2& worldPoint) const {
-        return getWorldToNodeTransform().transform(worldPoint);
+        return worldInverse().transform(worldPoint);
     }
 
     /**
@@ -1305,7 +1415,7 @@ public:
      * @return A point in OpenGL coordinates.
      */
     Vec2 nodeToWorldCoords(const Vec2& nodePoint) const {
-        return getNodeToWorldTransform().transform(nodePoint);
+        return worldTransform().transform(nodePoint);
     }
     
     /**
@@ -1410,6 +1520,11 @@ public:
      * and needs resorting, then so are all of its ancestors (including any
      * associated {@link Scene}).
      *
+     * Resorting is incremental.  Only the children that were moved out of
+     * place (by {@link setZOrder}, {@link addChild} or {@link swapChild})
+     * are removed and merged back in.  Hence repeated calls after a few
+     * changes are cheap, even when there are many children.
+     *
      * Sorting does not happen automatically (except within a {@link Scene}).
      * It is the responsibility of a user to call this method before rendering. 
      * Otherwise, render order will be in the unsorted order.
@@ -1781,6 +1896,10 @@ public:
      * method draw(shared_ptr<SpriteBatch>,const Mat4&,Color4) if you need to
      * define custom drawing code.
      *
+     * The transform is composed with that of each node in the subtree.  A
+     * {@link Scene} draws its nodes with their cached world transforms
+     * instead, skipping any subtree whose bounds lie outside of the viewport.
+     *
      * @param batch     The SpriteBatch to draw with.
      * @param transform The global transformation matrix.
      * @param tint      The tint to blend with the Node color.
@@ -1825,6 +1944,145 @@ public:
      */
     virtual void draw(const std::shared_ptr<SpriteBatch>& batch, const Mat4& transform, Color4 tint) {}
     
+    /**
+     * Returns the sprite batch state used by draw(), as a sortable key.
+     *
+     * A deferred {@link Scene} groups nodes with equal keys so that they can
+     * be drawn without a flush.  The key should identify the texture and
+     * blend state set by draw().  The value {@link RENDER_KEY_NONE} means
+     * that the node draws nothing, and deferred rendering will skip it.
+     *
+     * Any subclass that overrides draw() must also override this method,
+     * or it will be skipped by a deferred scene.
+     *
+     * @return the sprite batch state used by draw(), as a sortable key.
+     */
+    virtual Uint64 getRenderKey() const { return RENDER_KEY_NONE; }
+    
+    /**
+     * Returns a render key for the given texture and blend state.
+     *
+     * The result is never {@link RENDER_KEY_NONE}.
+     *
+     * @param texture   The texture (nullptr for a solid color)
+     * @param equation  The blend equation
+     * @param srcFactor The source blend factor
+     * @param dstFactor The destination blend factor
+     *
+     * @return a render key for the given texture and blend state.
+     */
+    static Uint64 makeRenderKey(const std::shared_ptr<Texture>& texture, GLenum equation,
+                                GLenum srcFactor, GLenum dstFactor);
+    
+    /**
+     * Returns true if this subtree is drawn from a retained mesh.
+     *
+     * A static subtree bakes everything it draws (fully transformed and
+     * tinted) into a {@link SpriteMesh} on the GPU.  Later frames draw that
+     * mesh with one call per texture, skipping the subtree entirely.  The
+     * mesh is baked again whenever a node in the subtree changes, or when
+     * this node is drawn with a different transform or tint.
+     *
+     * This is intended for layers that rarely change, such as backgrounds
+     * and decorations.  The default value is false.
+     *
+     * @return true if this subtree is drawn from a retained mesh.
+     */
+    bool isStatic() const { return _static; }
+    
+    /**
+     * Sets whether this subtree is drawn from a retained mesh.
+     *
+     * A static subtree bakes everything it draws (fully transformed and
+     * tinted) into a {@link SpriteMesh} on the GPU.  Later frames draw that
+     * mesh with one call per texture, skipping the subtree entirely.  The
+     * mesh is baked again whenever a node in the subtree changes, or when
+     * this node is drawn with a different transform or tint.
+     *
+     * This is intended for layers that rarely change, such as backgrounds
+     * and decorations.  The default value is false.
+     *
+     * @param value Whether this subtree is drawn from a retained mesh.
+     */
+    void setStatic(bool value);
+    
+    /**
+     * Returns true if this subtree is drawn from an offscreen texture.
+     *
+     * A cached subtree is drawn once into a texture sized to its bounds,
+     * and is then drawn as a single textured quad.  The texture is redrawn
+     * whenever a node in the subtree changes, or when this node is scaled
+     * up (or far down) from the size the texture was made for.  Moving or
+     * rotating the node, or tinting an ancestor, only changes the quad.
+     *
+     * This is intended for subtrees that are expensive to draw but rarely
+     * change, such as labels and user interface panels.  Textures are
+     * released in least-recently-drawn order when the total exceeds the
+     * budget set by {@link setBitmapCacheBudget}.  A subtree that is not
+     * cullable, or is too large for the budget, is drawn normally.  The
+     * default value is false.
+     *
+     * @return true if this subtree is drawn from an offscreen texture.
+     */
+    bool isCachedAsBitmap() const { return _cacheAsBitmap; }
+    
+    /**
+     * Sets whether this subtree is drawn from an offscreen texture.
+     *
+     * A cached subtree is drawn once into a texture sized to its bounds,
+     * and is then drawn as a single textured quad.  The texture is redrawn
+     * whenever a node in the subtree changes, or when this node is scaled
+     * up (or far down) from the size the texture was made for.  Moving or
+     * rotating the node, or tinting an ancestor, only changes the quad.
+     *
+     * This is intended for subtrees that are expensive to draw but rarely
+     * change, such as labels and user interface panels.  Textures are
+     * released in least-recently-drawn order when the total exceeds the
+     * budget set by {@link setBitmapCacheBudget}.  A subtree that is not
+     * cullable, or is too large for the budget, is drawn normally.  The
+     * default value is false.
+     *
+     * @param value Whether this subtree is drawn from an offscreen texture.
+     */
+    void setCacheAsBitmap(bool value);
+    
+    /**
+     * Returns the maximum memory (in bytes) for all bitmap caches.
+     *
+     * This budget is shared by every node with {@link isCachedAsBitmap}.
+     * The default is 32 MB.
+     *
+     * @return the maximum memory (in bytes) for all bitmap caches.
+     */
+    static size_t getBitmapCacheBudget();
+    
+    /**
+     * Sets the maximum memory (in bytes) for all bitmap caches.
+     *
+     * This budget is shared by every node with {@link isCachedAsBitmap}.
+     * If the current usage exceeds the new budget, the least recently
+     * drawn textures are released immediately.  The default is 32 MB.
+     *
+     * @param bytes The maximum memory (in bytes) for all bitmap caches.
+     */
+    static void setBitmapCacheBudget(size_t bytes);
+    
+    /**
+     * Returns the memory (in bytes) currently held by bitmap caches.
+     *
+     * @return the memory (in bytes) currently held by bitmap caches.
+     */
+    static size_t getBitmapCacheUsage();
+    
+    /**
+     * Marks the drawing of this node as changed.
+     *
+     * This forces any static or cached ancestor to draw again.  The built-in
+     * setters call this automatically.  A subclass with custom drawing code
+     * must call it whenever the output of draw() changes.
+     */
+    void setContentDirty();
+    
     
 #pragma mark -
 #pragma mark Layout Automation
@@ -1894,9 +2152,16 @@ private:
      * The purpose of this pointer is to climb back up the scene graph tree.
      * No child asserts ownership of its parent.
      *
+     * The new parent is marked dirty explicitly, as the child may already
+     * be dirty and so would stop marking before it reaches the parent.
+     *
      * @param parent    A pointer to the parent node.
      */
-    void setParent(Node* parent) { _parent = parent; }
+    void setParent(Node* parent) {
+        if (_parent) { _parent->setBoundsDirty(); _parent->setContentDirty(); }
+        _parent = parent; setWorldDirty();
+        if (_parent) { _parent->setBoundsDirty(); _parent->setContentDirty(); }
+    }
 
     /**
      * Sets the scene graph.
@@ -1930,6 +2195,39 @@ private:
      */
     static bool compareNodeSibs(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b);
     
+    /**
+     * Adds this node to the given list of children moved out of z-order.
+     *
+     * The node is only added if it is not already in the list.  The list
+     * must belong to the parent (or scene) of this node.
+     *
+     * @param moved The list of moved children of the parent
+     */
+    void queueZMove(std::vector<Node*>& moved);
+    
+    /**
+     * Removes this node from the given list of children moved out of z-order.
+     *
+     * This method is called when the node is removed from its parent.
+     *
+     * @param moved The list of moved children of the parent
+     */
+    void dequeueZMove(std::vector<Node*>& moved);
+    
+    /**
+     * Restores the z-order of the given children.
+     *
+     * This method assumes that every child not in the moved list is in
+     * sorted order.  The moved children are removed, sorted, and merged back
+     * in, so the cost is proportional to the number of moved children (plus
+     * a linear merge).  If too many children have moved, it falls back to a
+     * full sort.  Either way, the moved list is empty afterwards.
+     *
+     * @param children  The children to resort
+     * @param moved     The children moved out of z-order
+     */
+    static void resortChildren(std::vector<std::shared_ptr<Node>>& children, std::vector<Node*>& moved);
+    
     /**
      * Updates the node to parent transform.
      *
@@ -1937,6 +2235,120 @@ private:
      * transform, and positional translation, in that order.
      */
     virtual void updateTransform();
+    
+    /**
+     * Marks the world transform of this node and its descendants as dirty.
+     *
+     * Descendants of a dirty node are always dirty, so this stops at any
+     * node that is already dirty.  It also marks the subtree bounds of
+     * this node and its ancestors as dirty.
+     */
+    void setWorldDirty();
+    
+    /**
+     * Returns the cached matrix transforming node space to world space.
+     *
+     * The matrix is recomputed first if this node or an ancestor changed.
+     *
+     * @return the cached matrix transforming node space to world space.
+     */
+    const Mat4& worldTransform() const;
+    
+    /**
+     * Returns the cached matrix transforming world space to node space.
+     *
+     * The matrix is recomputed first if this node or an ancestor changed.
+     *
+     * @return the cached matrix transforming world space to node space.
+     */
+    const Mat4& worldInverse() const;
+    
+    /**
+     * Marks the subtree bounds of this node and its ancestors as dirty.
+     *
+     * Ancestors of a dirty node are always dirty, so this stops at any
+     * node that is already dirty.
+     */
+    void setBoundsDirty();
+    
+    /**
+     * Marks this node and all of its descendants as unchanged.
+     *
+     * This is called once a static node has baked its mesh, or a cached
+     * node has drawn its texture.
+     */
+    void cleanContent();
+    
+    /**
+     * Draws this static subtree from its retained mesh.
+     *
+     * The mesh is baked first if it is missing or out of date.  The
+     * arguments are those that render() would receive.
+     *
+     * @param batch     The SpriteBatch to draw with.
+     * @param transform The global transformation matrix.
+     * @param tint      The tint to blend with the Node color.
+     */
+    void renderStatic(const std::shared_ptr<SpriteBatch>& batch, const Mat4& transform, Color4 tint);
+    
+    /**
+     * Draws this Node and all of its children with their cached world transforms.
+     *
+     * This is how a {@link Scene} draws its nodes.  If the scene culls, any
+     * subtree whose bounds lie outside of the viewport is skipped.
+     *
+     * @param batch     The SpriteBatch to draw with.
+     * @param tint      The tint to blend with the Node color.
+     */
+    void renderWorld(const std::shared_ptr<SpriteBatch>& batch, Color4 tint);
+    
+    /**
+     * Draws this visible Node and all of its children.
+     *
+     * This is the part of render() and renderWorld() after the transform is
+     * known.  The children are drawn with renderWorld() if world is true,
+     * and with render() otherwise.
+     *
+     * @param batch     The SpriteBatch to draw with.
+     * @param transform The global transformation matrix of the parent.
+     * @param matrix    The global transformation matrix of this node.
+     * @param tint      The tint to blend with the Node color.
+     * @param world     Whether the matrices are the cached world transforms
+     */
+    void renderSubtree(const std::shared_ptr<SpriteBatch>& batch, const Mat4& transform,
+                       const Mat4& matrix, Color4 tint, bool world);
+    
+    /**
+     * Draws this cached subtree from its offscreen texture.
+     *
+     * The texture is drawn first if it is missing or out of date. This
+     * method returns false, drawing nothing, if the subtree cannot be
+     * cached.  The caller should then draw it normally.
+     *
+     * @param batch     The SpriteBatch to draw with.
+     * @param matrix    The global transformation matrix of this node.
+     * @param tint      The tint to blend with the Node color.
+     *
+     * @return true if the subtree was drawn from its texture.
+     */
+    bool renderCached(const std::shared_ptr<SpriteBatch>& batch, const Mat4& matrix, Color4 tint);
+    
+    /**
+     * Releases the offscreen texture of this node, if any.
+     *
+     * The memory is returned to the shared bitmap cache budget.
+     */
+    void releaseCache();
+    
+    /**
+     * Releases bitmap cache textures until the given amount fits the budget.
+     *
+     * Textures are released in least-recently-drawn order.  The nodes keep
+     * caching, and draw their textures again when next rendered.
+     *
+     * @param bytes     The memory (in bytes) about to be allocated
+     */
+    static void evictCaches(size_t bytes);
 
     // Copying is only allowed via shared pointer.
     CU_DISALLOW_COPY_AND_ASSIGN(Node);
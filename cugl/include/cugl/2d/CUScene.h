@@ -47,6 +47,11 @@
 #include <cugl/2d/CUNode.h>
 #include <cugl/renderer/CUOrthographicCamera.h>
 
+/** How many queued packets a deferred scene searches back for a state match */
+#define RENDER_QUEUE_WINDOW 64
+/** The end of the member list of a packet group */
+#define RENDER_GROUP_END    ((unsigned int)-1)
+
 namespace cugl {
     
 /**
@@ -77,6 +82,8 @@ protected:
     bool _zDirty;
     /** Indicates whether auto-sorting is active */
     bool _zSort;
+    /** The children that have moved out of z-order since the last sort */
+    std::vector<Node*> _zMoved;
   
     /** The blending equation for this scene */
     GLenum _blendEquation;
@@ -87,6 +94,48 @@ protected:
 
     /** Whether or note this scene is still active */
     bool _active;
+    
+    /** A node to draw, captured during a deferred render */
+    struct RenderPacket {
+        /** The node to draw */
+        Node* node;
+        /** The global transform for the node */
+        Mat4 transform;
+        /** The absolute tint for the node */
+        Color4 tint;
+        /**
+         * The sprite batch state of the node.
+         *
+         * This is RENDER_KEY_NONE for a static or cached subtree, which is
+         * drawn from its retained mesh or texture.  In that case, the node
+         * uses its cached world transform, and only the tint is set.
+         */
+        Uint64 key;
+        /** The scene-space bounding box of the node */
+        Rect bounds;
+        /** The group of the packet (groups are submitted in order of creation) */
+        unsigned int group;
+        /** The previous packet of the same group (or RENDER_GROUP_END) */
+        unsigned int next;
+    };
+    
+    /** Whether this scene sorts its draws by state before submitting them */
+    bool _deferred;
+    /** The packets collected for the current deferred render */
+    std::vector<RenderPacket> _packets;
+    /** The submission order for the collected packets */
+    std::vector<unsigned int> _queue;
+    /** The newest packet of each group for the current deferred render */
+    std::vector<unsigned int> _groups;
+    
+    /** Whether this scene skips subtrees that lie outside of the viewport */
+    bool _culling;
+    /** The world space bounds of the camera viewport for the current render */
+    Rect _viewBounds;
+    /** The number of nodes drawn in the last render */
+    unsigned int _drawnTotal;
+    /** The number of nodes culled in the last render */
+    unsigned int _culledTotal;
 
 #pragma mark -
 #pragma mark Constructors
@@ -888,6 +937,79 @@ public:
      */
     virtual void reset() {}
     
+    /**
+     * Returns true if this scene sorts its draws by batch state.
+     *
+     * A deferred scene first collects every visible node that draws, and
+     * then reorders them so that nodes with the same texture and blend
+     * state are drawn together.  Nodes only move past other nodes that they
+     * do not overlap, so the result looks the same as a pre-order traversal.
+     *
+     * Nodes that override render() are drawn as ordinary nodes, without
+     * their custom render logic.  This value is false by default.
+     *
+     * @return true if this scene sorts its draws by batch state.
+     */
+    bool isDeferred() const { return _deferred; }
+    
+    /**
+     * Sets whether this scene sorts its draws by batch state.
+     *
+     * A deferred scene first collects every visible node that draws, and
+     * then reorders them so that nodes with the same texture and blend
+     * state are drawn together.  Nodes only move past other nodes that they
+     * do not overlap, so the result looks the same as a pre-order traversal.
+     *
+     * Nodes that override render() are drawn as ordinary nodes, without
+     * their custom render logic.  This value is false by default.
+     *
+     * @param value Whether this scene sorts its draws by batch state.
+     */
+    void setDeferred(bool value) { _deferred = value; }
+    
+    /**
+     * Returns true if this scene skips subtrees outside of the viewport.
+     *
+     * When culling, a subtree is not drawn if its cached world bounds (see
+     * {@link Node#getSubtreeBounds()}) do not meet the camera viewport.
+     * Subtrees with a node that is not cullable are always drawn.  This
+     * value is true by default.
+     *
+     * @return true if this scene skips subtrees outside of the viewport.
+     */
+    bool isCulling() const { return _culling; }
+    
+    /**
+     * Sets whether this scene skips subtrees outside of the viewport.
+     *
+     * When culling, a subtree is not drawn if its cached world bounds (see
+     * {@link Node#getSubtreeBounds()}) do not meet the camera viewport.
+     * Subtrees with a node that is not cullable are always drawn.  This
+     * value is true by default.
+     *
+     * @param value Whether this scene skips subtrees outside of the viewport.
+     */
+    void setCulling(bool value) { _culling = value; }
+    
+    /**
+     * Returns the number of visible nodes drawn in the last render.
+     *
+     * This counts every visible node that was visited, whether or not it
+     * draws anything of its own.
+     *
+     * @return the number of visible nodes drawn in the last render.
+     */
+    unsigned int getNodesDrawn() const { return _drawnTotal; }
+    
+    /**
+     * Returns the number of nodes culled in the last render.
+     *
+     * This counts every node in a culled subtree, visible or not.
+     *
+     * @return the number of nodes culled in the last render.
+     */
+    unsigned int getNodesCulled() const { return _culledTotal; }
+    
     /**
      * Draws all of the children in this scene with the given SpriteBatch.
      *
@@ -899,6 +1021,10 @@ public:
      * That means that parents are always draw before (and behind children). The
      * children of each sub tree are ordered by z-value (or by the order added).
      *
+     * If the scene is deferred, nodes that do not overlap may be drawn out
+     * of this order to reduce the number of sprite batch flushes.  If the
+     * scene is culling, subtrees outside of the viewport are skipped.
+     *
      * @param batch     The SpriteBatch to draw with.
      */
     void render(const std::shared_ptr<SpriteBatch>& batch);
@@ -906,6 +1032,28 @@ public:
 private:
 #pragma mark -
 #pragma mark Internal Helpers
+    /**
+     * Collects draw packets for the given node and its descendants.
+     *
+     * Packets are appended in pre-order.  Invisible subtrees, culled subtrees
+     * and nodes that draw nothing of their own are skipped.  A static or
+     * cached subtree becomes a single packet for its mesh or texture.
+     *
+     * @param node      The node to collect
+     * @param tint      The absolute tint of the parent
+     */
+    void collect(Node* node, Color4 tint);
+    
+    /**
+     * Orders the collected packets so that equal states are adjacent.
+     *
+     * Each packet joins the latest group with the same state, provided no
+     * packet of a later group overlaps it.  Otherwise it starts a new group.
+     * The queue is then sorted once by group, so that it submits the groups
+     * in order of creation.  Packets that overlap never change their relative
+     * order.  Static and cached subtrees are never grouped.
+     */
+    void sortPackets();
     /**
      * Sets whether the children of this Scene needs resorting.
      *
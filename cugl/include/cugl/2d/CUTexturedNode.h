@@ -449,7 +449,9 @@ public:
      * @param srcFactor Specifies how the source blending factors are computed
      * @param dstFactor Specifies how the destination blending factors are computed.
      */
-    void setBlendFunc(GLenum srcFactor, GLenum dstFactor) { _srcFactor = srcFactor; _dstFactor = dstFactor; }
+    void setBlendFunc(GLenum srcFactor, GLenum dstFactor) {
+        _srcFactor = srcFactor; _dstFactor = dstFactor; setContentDirty();
+    }
     
     /**
      * Returns the source blending factor
@@ -494,7 +496,7 @@ public:
      *
      * @param equation  Specifies how source and destination colors are combined
      */
-    void setBlendEquation(GLenum equation) { _blendEquation = equation; }
+    void setBlendEquation(GLenum equation) { _blendEquation = equation; setContentDirty(); }
     
     /**
      * Returns the blending equation for this textured node
@@ -591,11 +593,16 @@ public:
      * the anchor to the bottom left).  That is because anchors do not
      * make sense when we are using absolute positioning.
      *
+     * An absolute polygon may lie outside of the content bounds, so this
+     * also disables culling (see {@link Node#setCullable()}).
+     *
      * @param flag  Whether if this node is using absolute positioning.
      */
     void setAbsolute(bool flag) {
         _absolute = flag;
         _anchor = Vec2::ANCHOR_BOTTOM_LEFT;
+        setCullable(!flag);
+        setContentDirty();
     }
     
     /**
@@ -685,6 +692,15 @@ public:
     virtual void draw(const std::shared_ptr<SpriteBatch>& batch,
                       const Mat4& transform, Color4 tint) override = 0;
     
+    /**
+     * Returns the sprite batch state used by draw(), as a sortable key.
+     *
+     * @return the sprite batch state used by draw(), as a sortable key.
+     */
+    virtual Uint64 getRenderKey() const override {
+        return makeRenderKey(_texture, _blendEquation, _srcFactor, _dstFactor);
+    }
+    
     /**
      * Refreshes this node to restore the render data.
      */
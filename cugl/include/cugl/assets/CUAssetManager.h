@@ -51,7 +51,8 @@
 #include <cugl/util/CUDebug.h>
 #include <cugl/assets/CULoader.h>
 #include <typeinfo>
-#include <atomic>
+#include <map>
+#include <vector>
 
 
 namespace cugl {
@@ -77,6 +78,10 @@ namespace cugl {
  * still be used after an asset manager is destroyed, provided that they still
  * have a smart pointer referencing them.
  *
+ * Each asset type may have a memory budget.  An asset that is not referenced
+ * outside of the manager may be evicted when its type is over budget, least
+ * recently used first.  Evicted assets are reloaded when next accessed.
+ *
  * IMPORTANT: This class is not even remotely thread-safe.  Do not call any of
  * these methods outside of the main CUGL thread.
  */
@@ -87,16 +92,42 @@ private:
     
 #pragma mark Internal Helpers
 protected:
+    /** An asset identifier: the asset type hash and the asset key */
+    typedef std::pair<size_t,std::string> AssetId;
+    
+    /** An asset of an asynchronous directory load (a node in the dependency graph) */
+    class Request {
+    public:
+        /** The directory entry for the asset */
+        std::shared_ptr<JsonValue> json;
+        /** The callback for the asset */
+        LoaderCallback callback;
+        /** The number of dependencies that have not finished loading */
+        size_t blockers;
+        /** Whether the asset has been handed to its loader */
+        bool issued;
+        /** The size of the asset source in bytes (its weight for progress) */
+        size_t bytes;
+        /** The requests that depend on this one */
+        std::vector<AssetId> dependents;
+    };
+    
     /** The individual loaders for each type */
     std::unordered_map<size_t,std::shared_ptr<BaseLoader>> _handlers;
-    /** The central thread for managing all of the loaders */
+    /** The worker threads shared by all of the loaders */
     std::shared_ptr<ThreadPool> _workers;
+    /** The cache of preprocessed assets shared by all of the loaders */
+    std::shared_ptr<AssetCache> _cache;
 
     /** State variable to manage reading JSON directories */
     bool _preload;
     
-    /** Wait variable to create a load barrier for directories. */
-    std::atomic<bool> _wait;
+    /** The unfinished assets of asynchronous directory loads */
+    std::map<AssetId,Request> _requests;
+    /** The bytes of the directory requests finished since the graph was last empty */
+    size_t _loadedBytes;
+    /** The bytes of the directory requests not yet finished */
+    size_t _pendingBytes;
 
     /**
      * Synchronously reads an asset category from a JSON file
@@ -123,40 +154,23 @@ protected:
     bool readCategory(size_t hash, const std::shared_ptr<JsonValue>& json);
     
     /**
-     * Asynchronously reads an asset category from a JSON file
-     *
-     * JSON directories provide a robust way for us to load a collection of
-     * assets. Instead of having to define parameters like asset key, font
-     * size, or texture wrap in the code, we can specify them in a JSON file.
-     * This JSON file (called the asset directory) is read by the asset manager,
-     * and directs the various loaders to load in assets.
+     * Adds an asset category to the dependency graph for asynchronous loading.
      *
-     * Currently JSON loading supports five types of assets, with the following
-     * names: "textures", "fonts", "music", "soundfx", and "jsons".  See the
-     * method {@link BaseLoader#read} in each of the individual loaders for a
-     * description of the suported JSON format. A loader must still be attached
-     * for the asset manager to read that type of asset.  If the asset directory
-     * contains an asset for which there is no attached asset manager, those
-     * specific assets will not be loaded.
+     * Each asset in the category becomes a {@link Request}.  Assets that are
+     * already loaded, or already requested, are skipped.  Nothing is handed
+     * to the loaders yet, as dependencies may refer to assets in categories
+     * that have not been added.
      *
-     * As an asynchronous read, all asset loading will take place outside of
-     * the main thread.  However, assets such as fonts and textures will need
-     * the OpenGL context to complete, so part of their asset loading may take
-     * place in the main thread via the {@link Application#schedule} interface.
-     * You may either poll this interface to determine when the assets are 
-     * loaded or use optional callbacks.
-     *
-     * The optional callback function will be called each time an individual
-     * asset loads or fails to load.  However, if the entire category fails
-     * to load, the callback function will be given the asset category name 
-     * (e.g. "soundfx") as the asset key.
+     * If there is no loader for this category, the callback function will
+     * be given the asset category name (e.g. "soundfx") as the asset key.
      *
      * @param hash      The hash of the asset type
      * @param json      The child of asset directory with these assets
      * @param callback  An optional callback after each asset is loaded
+     * @param added     The list to append the new requests to
      */
     void readCategory(size_t hash, const std::shared_ptr<JsonValue>& json,
-                      LoaderCallback callback);
+                      LoaderCallback callback, std::vector<AssetId>& added);
     
     /**
      * Immediately removes an asset category previously loaded from the JSON file
@@ -173,32 +187,55 @@ protected:
     bool purgeCategory(size_t hash, const std::shared_ptr<JsonValue>& json);
 
     /**
-     * Synchronizes the asset manager to wait until all assets have finished.
+     * Links the given requests to the requests they depend on.
+     *
+     * Dependencies are reported by {@link BaseLoader#getDependencies}.  A
+     * dependency that is already loaded is ignored.  A dependency on a key
+     * that is neither loaded nor requested (such as a region of a texture
+     * atlas) waits on every pending request of that asset type.
      *
-     * This method is necessary for assets whose construction depends on
-     * previously loaded assets (e.g. scene graphs).  In the current architecture,
-     * this method is only correct if the asset manager loads assets in a
-     * single thread.
+     * @param added     The newly added requests
      */
-    void sync();
+    void linkRequests(const std::vector<AssetId>& added);
     
     /**
-     * Blocks the asset manager until the next animation frame.
+     * Hands the given request to its loader.
      *
-     * Any assets queued after a block will not be added to thread pool
-     * until at least one animation frame has passed.  This method is used
-     * to implement the {@link sync()} method.
+     * The request must have no unfinished dependencies.  Its callback is
+     * wrapped so that {@link completeRequest} is called when it finishes.
+     *
+     * @param id    The request identifier
      */
-    void block();
-
+    void issueRequest(const AssetId& id);
+    
     /**
-     * Resumes a previously blocked the asset manager.
+     * Records that the given request has finished loading.
      *
-     * Any assets queued after a block will not be added to thread pool
-     * until at least one animation frame has passed.  This method is used
-     * to implement the {@link sync()} method.
+     * Any dependents with no other unfinished dependencies are handed to
+     * their loaders.  This method is called in the main thread, whether
+     * or not the asset loaded successfully.
+     *
+     * @param id    The request identifier
      */
-    void resume();
+    void completeRequest(const AssetId& id);
+    
+    /**
+     * Returns the loader for the given asset type, or nullptr if there is none.
+     *
+     * The loader is not copied into a new smart pointer, as this is used on
+     * every asset access.
+     *
+     * @return the loader for the given asset type
+     */
+    template<typename T>
+    Loader<T>* getLoader() const {
+        auto it = _handlers.find(typeid(T).hash_code());
+        if (it == _handlers.end()) {
+            CUAssertLog(false, "No loader assigned for given type");
+            return nullptr;
+        }
+        return static_cast<Loader<T>*>(it->second.get());
+    }
     
     
 #pragma mark -
@@ -210,7 +247,7 @@ public:
      * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an asset 
      * manager on the heap, use one of the static constructors instead.
      */
-    AssetManager() : _preload(false), _wait(false) {}
+    AssetManager() : _preload(false), _loadedBytes(0), _pendingBytes(0) {}
     
     /**
      * Deletes this asset manager, disposing of all resources.
@@ -227,11 +264,12 @@ public:
     void dispose();
 
     /**
-     * Initializes a new asset manager with two auxiliary threads.
+     * Initializes a new asset manager with one auxiliary thread per spare core.
      *
-     * The asset manager will have a thread pool of size 2, giving it two 
-     * threads to load assets asynchronously.  These threads have no effect on 
-     * synchronous loading and will sleep when no assets are being loaded.
+     * The asset manager will have a thread pool with one thread for each CPU
+     * core other than the main one (and at least one thread).  These threads
+     * load assets asynchronously.  They have no effect on synchronous loading
+     * and will sleep when no assets are being loaded.
      *
      * This initializer does not attach any loaders.  It simply creates an 
      * object that is ready to accept loader objects.
@@ -240,63 +278,62 @@ public:
      */
     bool init();
 
-    //
-    // Initializes a new asset manager with the given number of auxiliary threads.
-    //
-    // The asset manager will have a thread pool of the given size, allowing it
-    // load assets asynchronously.  These threads have no effect on synchronous
-    // loading and will sleep when no assets are being loaded.  If threads is
-    // 0, all assets must be loaded synchronously.
-    //
-    // This initializer does not attach any loaders.  It simply creates an
-    // object that is ready to accept loader objects.
-    //
-    // @param threads   The number of threads for asynchronous loading
-    //
-    // @return true if the asset manager was initialized successfully
-    //
-    // TODO: This class must be refactored for this to be safe to use.
-    // bool init(unsigned int threads);
+    /**
+     * Initializes a new asset manager with the given number of auxiliary threads.
+     *
+     * The asset manager will have a thread pool of the given size, allowing it
+     * load assets asynchronously.  These threads have no effect on synchronous
+     * loading and will sleep when no assets are being loaded.  If threads is
+     * 0, all assets are loaded in the main thread, even asynchronous ones.
+     *
+     * This initializer does not attach any loaders.  It simply creates an
+     * object that is ready to accept loader objects.
+     *
+     * @param threads   The number of threads for asynchronous loading
+     *
+     * @return true if the asset manager was initialized successfully
+     */
+    bool init(unsigned int threads);
     
 #pragma mark -
 #pragma mark Static Constructors
     /**
-     * Returns a newly allocated asset manager with two auxiliary threads.
+     * Returns a newly allocated asset manager with one auxiliary thread per spare core.
      *
-     * The asset manager will have a thread pool of size 2, giving it two
-     * threads to load assets asynchronously.  These threads have no effect on
-     * synchronous loading and will sleep when no assets are being loaded.
+     * The asset manager will have a thread pool with one thread for each CPU
+     * core other than the main one (and at least one thread).  These threads
+     * load assets asynchronously.  They have no effect on synchronous loading
+     * and will sleep when no assets are being loaded.
      *
      * This constructor does not attach any loaders.  It simply creates an
      * object that is ready to accept loader objects.
      *
-     * @return a newly allocated asset manager with two auxiliary threads.
+     * @return a newly allocated asset manager with one auxiliary thread per spare core.
      */
     static std::shared_ptr<AssetManager> alloc() {
         std::shared_ptr<AssetManager> result = std::make_shared<AssetManager>();
         return (result->init() ? result : nullptr);
     }
     
-    //
-    // Returns a newly allocated asset manager with the given number of auxiliary threads.
-    //
-    // The asset manager will have a thread pool of the given size, allowing it
-    // load assets asynchronously.  These threads have no effect on synchronous
-    // loading and will sleep when no assets are being loaded.  If threads is
-    // 0, all assets must be loaded synchronously.
-    //
-    // This constructor does not attach any loaders.  It simply creates an
-    // object that is ready to accept loader objects.
-    //
-    // @param threads   The number of threads for asynchronous loading
-    //
-    // @return a newly allocated asset manager with the given number of auxiliary threads.
-    //
-    // TODO: This class must be refactored for this to be safe to use.
-    // static std::shared_ptr<AssetManager> alloc(unsigned int threads) {
-    //     std::shared_ptr<AssetManager> result = std::make_shared<AssetManager>();
-    //     return (result->init(threads) ? result : nullptr);
-    // }
+    /**
+     * Returns a newly allocated asset manager with the given number of auxiliary threads.
+     *
+     * The asset manager will have a thread pool of the given size, allowing it
+     * load assets asynchronously.  These threads have no effect on synchronous
+     * loading and will sleep when no assets are being loaded.  If threads is
+     * 0, all assets are loaded in the main thread, even asynchronous ones.
+     *
+     * This constructor does not attach any loaders.  It simply creates an
+     * object that is ready to accept loader objects.
+     *
+     * @param threads   The number of threads for asynchronous loading
+     *
+     * @return a newly allocated asset manager with the given number of auxiliary threads.
+     */
+    static std::shared_ptr<AssetManager> alloc(unsigned int threads) {
+        std::shared_ptr<AssetManager> result = std::make_shared<AssetManager>();
+        return (result->init(threads) ? result : nullptr);
+    }
 
 #pragma mark -
 #pragma mark Loader Management
@@ -321,6 +358,7 @@ public:
         }
         
         loader->setThreadPool(_workers);
+        loader->setCache(_cache);
         _handlers[hash] = loader;
         loader->setManager(this);
         return true;
@@ -356,6 +394,7 @@ public:
             return false;
         }
         it->second->setThreadPool(nullptr);
+        it->second->setCache(nullptr);
         it->second = nullptr;
         _handlers.erase(hash);
         return true;
@@ -393,6 +432,34 @@ public:
         return std::dynamic_pointer_cast<Loader<T>>(it->second);
     }
     
+    /**
+     * Returns the cache of preprocessed assets.
+     *
+     * The cache is shared by all attached loaders, which consult it before
+     * decoding images, rasterizing font atlases or parsing JSON.  By default
+     * it is the directory "cache" in {@link Application#getSaveDirectory}.
+     *
+     * @return the cache of preprocessed assets.
+     */
+    const std::shared_ptr<AssetCache>& getCache() const { return _cache; }
+    
+    /**
+     * Sets the cache of preprocessed assets.
+     *
+     * The cache is shared by all attached loaders, which consult it before
+     * decoding images, rasterizing font atlases or parsing JSON.  Setting
+     * it to nullptr disables caching.  It is unsafe to call this method if
+     * the manager is actively loading assets.
+     *
+     * @param cache The cache of preprocessed assets
+     */
+    void setCache(const std::shared_ptr<AssetCache>& cache) {
+        _cache = cache;
+        for(auto it = _handlers.begin(); it != _handlers.end(); ++it) {
+            it->second->setCache(cache);
+        }
+    }
+    
 #pragma mark -
 #pragma mark Progress Monitoring
     /**
@@ -444,11 +511,97 @@ public:
      * loaded asynchronously and have not completed loading. It is not safe to 
      * use asynchronously loaded assets until all loading is complete.
      *
+     * Assets from an asynchronous directory load are weighted by the size of
+     * their source files, so one large texture counts for more than many
+     * small sounds.  Other asynchronous loads count each asset equally.
+     *
      * @return the loader progress as a percentage.
      */
-    float progress() const  {
-        size_t size = loadCount()+waitCount();
-        return (size == 0 ? 0.0f : ((float)loadCount())/size);
+    float progress() const;
+    
+    /**
+     * Changes the priority of an asset that is waiting on the main thread.
+     *
+     * Assets that finish loading in the worker threads wait their turn for
+     * the main thread (e.g. to upload to the GPU).  Raising the priority of
+     * an asset that is needed on screen now lets it jump that queue.  See
+     * {@link BaseLoader#prioritize}.
+     *
+     * @param key       The key to identify the given asset
+     * @param priority  The new priority (larger runs first)
+     *
+     * @return true if the asset was waiting on the main thread
+     */
+    template<typename T>
+    bool prioritize(const std::string& key, int priority) {
+        auto it = _handlers.find(typeid(T).hash_code());
+        return it != _handlers.end() && it->second->prioritize(key,priority);
+    }
+    
+#pragma mark -
+#pragma mark Memory Management
+    /**
+     * Returns the memory used by all loaded assets in bytes.
+     *
+     * The value returned is the sum of the memory for all attached loaders.
+     * See {@link BaseLoader#getMemory}.
+     *
+     * @return the memory used by all loaded assets in bytes.
+     */
+    size_t getMemory() const;
+    
+    /**
+     * Returns the memory used by the loaded assets of the given type in bytes.
+     *
+     * The type of the asset is specified by the template parameter T.  The
+     * memory is that of the asset data, such as texture bytes for textures
+     * and PCM bytes for sounds.
+     *
+     * @return the memory used by the loaded assets of the given type in bytes.
+     */
+    template<typename T>
+    size_t getMemory() const {
+        auto it = _handlers.find(typeid(T).hash_code());
+        return (it == _handlers.end() ? 0 : it->second->getMemory());
+    }
+    
+    /**
+     * Returns the memory budget for assets of the given type in bytes.
+     *
+     * The type of the asset is specified by the template parameter T.  A
+     * budget of 0 means there is no limit.  See {@link setBudget}.
+     *
+     * @return the memory budget for assets of the given type in bytes.
+     */
+    template<typename T>
+    size_t getBudget() const {
+        auto it = _handlers.find(typeid(T).hash_code());
+        return (it == _handlers.end() ? 0 : it->second->getBudget());
+    }
+    
+    /**
+     * Sets the memory budget for assets of the given type in bytes.
+     *
+     * The type of the asset is specified by the template parameter T.  When
+     * the assets of that type use more memory than this, the least recently
+     * used assets that are not referenced outside of this manager are
+     * evicted.  An evicted asset is reloaded synchronously the next time
+     * it is accessed with {@link get}, so the budget should be large enough
+     * that this is rare.  A budget of 0 means there is no limit.
+     *
+     * Lowering the budget evicts assets immediately.
+     *
+     * @param bytes The memory budget for assets of the given type in bytes.
+     */
+    template<typename T>
+    void setBudget(size_t bytes) {
+        auto it = _handlers.find(typeid(T).hash_code());
+        if (it != _handlers.end()) {
+            it->second->setBudget(bytes);
+            return;
+        }
+        
+        CUAssertLog(false, "No loader assigned for given type");
     }
 
     
@@ -461,21 +614,17 @@ public:
      * the method is parameterized by the type, it is safe to reuse keys for
      * different types.  However, this is not recommended.
      *
+     * If the asset was evicted to stay within the budget for its type, it
+     * is reloaded synchronously before it is returned.
+     *
      * @param  key  The key to identify the given asset
      *
      * @return the asset for the given key.
      */
     template<typename T>
     std::shared_ptr<T> get(const std::string& key) const {
-        size_t hash = typeid(T).hash_code();
-        auto it = _handlers.find(hash);
-        if (it == _handlers.end()) {
-            CUAssertLog(false, "No loader assigned for given type");
-            return nullptr;
-        }
-        
-        std::shared_ptr<Loader<T>> loader = std::dynamic_pointer_cast<Loader<T>>(it->second);
-        return loader->get(key);
+        Loader<T>* loader = getLoader<T>();
+        return (loader == nullptr ? nullptr : loader->get(key));
     }
     
     /**
@@ -494,6 +643,55 @@ public:
         return get<T>(std::string(key));
     }
     
+    /**
+     * Returns the asset for the given handle.
+     *
+     * This is the same as {@link AssetHandle#get}, and is much faster than
+     * looking up the asset by key.  It returns nullptr if the asset is not
+     * loaded.
+     *
+     * @param  handle   The handle of the asset
+     *
+     * @return the asset for the given handle.
+     */
+    template<typename T>
+    std::shared_ptr<T> get(const AssetHandle<T>& handle) const {
+        return handle.get();
+    }
+    
+    /**
+     * Returns a handle for the asset with the given key.
+     *
+     * The type of the asset is specified by the template parameter T.  The
+     * key does not need to be loaded yet.  Code that accesses an asset often
+     * should resolve it once and keep the handle, which stays valid even if
+     * the asset is unloaded and loaded again.
+     *
+     * @param  key  The key to identify the given asset
+     *
+     * @return a handle for the asset with the given key.
+     */
+    template<typename T>
+    AssetHandle<T> resolve(const std::string& key) const {
+        Loader<T>* loader = getLoader<T>();
+        return (loader == nullptr ? AssetHandle<T>() : loader->resolve(key));
+    }
+    
+    /**
+     * Returns a handle for the asset with the given key.
+     *
+     * The type of the asset is specified by the template parameter T.  The
+     * key does not need to be loaded yet.
+     *
+     * @param  key  The key to identify the given asset
+     *
+     * @return a handle for the asset with the given key.
+     */
+    template<typename T>
+    AssetHandle<T> resolve(const char* key) const {
+        return resolve<T>(std::string(key));
+    }
+    
     /**
      * Loads an asset and assigns it to the given key.
      *
@@ -1006,6 +1204,20 @@ public:
     bool unloadDirectory(const char* directory) {
         return unloadDirectory(std::string(directory));
     }
+    
+    /**
+     * Returns the JSON in the given asset file.
+     *
+     * If there is a cache, the JSON is read from it when the file has not
+     * changed since it was cached (see {@link AssetCache#readJson}).  Otherwise
+     * it is parsed with {@link JsonReader}.  This method is safe to call from
+     * any thread.
+     *
+     * @param source    The JSON file, relative to the asset directory
+     *
+     * @return the JSON in the given asset file (nullptr on failure)
+     */
+    std::shared_ptr<JsonValue> readJson(const std::string& source) const;
 
 };
 
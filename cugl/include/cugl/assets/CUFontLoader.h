@@ -63,7 +63,7 @@ namespace cugl {
  * loads as much of the asset as possible without using OpenGL.  This allows
  * us to load the texture in a separate thread.  It then finishes off the
  * remainder of asset loading (particularly the OpenGL atlas generation) using
- * {@link Application#schedule}.  This is a good template for asset loaders in
+ * {@link Application#defer}.  This is a good template for asset loaders in
  * general.
  *
  * As with all of our loaders, this loader is designed to be attached to an
@@ -104,7 +104,7 @@ protected:
      * This method finishes the asset loading started in {@link preload}.  As
      * atlas generation requires OpenGL, this step is not safe to be done in a 
      * separate thread.  Instead, it takes place in the main CUGL thread via 
-     ( {@link Application#schedule}.
+     * {@link Application#defer}.
      *
      * The font atlas will use the character set specified in the asset.
      *
@@ -179,6 +179,7 @@ protected:
      *      "file":         The path to the asset
      *      "size":         This font size (int)
      *      "charset":      The set of characters for the font atlas (string)
+     *      "priority":     The main-thread priority of an asynchronous load (int)
      *
      * @param json      The directory entry for the asset
      * @param callback  An optional callback for asynchronous loading
@@ -188,6 +189,17 @@ protected:
      */
     bool read(const std::shared_ptr<JsonValue>& json, LoaderCallback callback, bool async) override;
     
+    /**
+     * Returns the GPU memory used by the atlas of the given font in bytes.
+     *
+     * @param asset The font to measure
+     *
+     * @return the GPU memory used by the atlas of the given font in bytes.
+     */
+    size_t footprint(const std::shared_ptr<Font>& asset) const override {
+        return (asset->hasAtlas() ? asset->getAtlas()->getByteSize() : 0);
+    }
+    
     
 public:
 #pragma mark -
@@ -212,7 +224,7 @@ public:
      * fail.  You must reinitialize the loader to begin loading assets again.
      */
     void dispose() override {
-        _assets.clear();
+        unloadAll();
         _loader = nullptr;
     }
 
@@ -226,7 +226,7 @@ public:
      * fail.  You must reinitialize the loader to begin loading assets again.
      */
     void dispose() override {
-        _assets.clear();
+        this->unloadAll();
         _loader = nullptr;
     }
     
@@ -66,6 +66,19 @@ private:
     CU_DISALLOW_COPY_AND_ASSIGN(JsonLoader);
     
 protected:
+    /**
+     * Returns the JSON in the given asset file (nullptr on failure)
+     *
+     * If the loader has an {@link AssetCache}, the parsed value is read from
+     * it when the file is unchanged.  This method is safe to call outside
+     * of the main thread.
+     *
+     * @param source    The pathname to the asset
+     *
+     * @return the JSON in the given asset file (nullptr on failure)
+     */
+    std::shared_ptr<JsonValue> preload(const std::string& source);
+    
     /**
      * Finishes loading the Json file, cleaning up the wait queues.
      *
@@ -147,7 +160,7 @@ public:
      * fail.  You must reinitialize the loader to begin loading assets again.
      */
     void dispose() override {
-        _assets.clear();
+        unloadAll();
         _loader = nullptr;
     }
     
@@ -51,8 +51,13 @@
 #include <functional>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <atomic>
 #include <cugl/assets/CUJsonValue.h>
 #include <cugl/util/CUThreadPool.h>
+#include <cugl/base/CUApplication.h>
 
 namespace cugl {
 
@@ -83,6 +88,196 @@ class AssetManager;
  */
 typedef std::function<void(const std::string& key, bool success)> LoaderCallback;
 
+#pragma mark -
+#pragma mark Asset Cache
+/**
+ * This class is an on-disk cache of preprocessed assets.
+ *
+ * Decoding an image, rasterizing a font atlas, or parsing a JSON file gives
+ * the same result on every launch.  This cache keeps those results in a
+ * directory (typically under {@link Application#getSaveDirectory}) so that
+ * a warm start can read them back instead of recomputing them.
+ *
+ * Each entry is named by a key, which should identify both the asset and
+ * any loader settings that affect the result.  An entry is also stamped
+ * with the size and modification time of its source files.  If the
+ * platform cannot report a modification time (as with Android APK assets),
+ * the stamp is a hash of the file contents instead.  An entry whose stamp
+ * no longer matches is a miss, and is replaced by the next write.
+ *
+ * Payloads are stored with LZ4 block compression when it makes them
+ * smaller, as raw pixels compress well and decompress much faster than
+ * they could be decoded from PNG.
+ *
+ * Every entry is written to a temporary file and then renamed, so the
+ * cache is safe to use from the loader threads.
+ */
+class AssetCache {
+private:
+    /** The directory of the cache files (with a trailing separator) */
+    std::string _directory;
+    /** The number of successful reads */
+    std::atomic<Uint32> _hits;
+    /** The number of failed reads */
+    std::atomic<Uint32> _misses;
+    
+    /**
+     * Returns the stamp for the current contents of the given source files
+     *
+     * The sources are relative to the asset directory.  This method returns
+     * 0 if any of the sources cannot be read.
+     *
+     * @param sources   The source files of an entry
+     *
+     * @return the stamp for the current contents of the given source files
+     */
+    Uint64 stamp(const std::vector<std::string>& sources) const;
+    
+    /**
+     * Returns the path of the cache file for the given key
+     *
+     * @param key   The entry key
+     *
+     * @return the path of the cache file for the given key
+     */
+    std::string entryPath(const std::string& key) const;
+    
+public:
+#pragma mark Constructors
+    /**
+     * Creates an uninitialized cache.
+     *
+     * You must initialize the cache to use it.
+     */
+    AssetCache() : _hits(0), _misses(0) {}
+    
+    /**
+     * Deletes this cache, leaving its files on disk.
+     */
+    ~AssetCache() { dispose(); }
+    
+    /**
+     * Releases the cache, leaving its files on disk.
+     *
+     * You must reinitialize the cache to use it.
+     */
+    void dispose() { _directory.clear(); }
+    
+    /**
+     * Initializes a cache in the given directory.
+     *
+     * The directory is created if it does not exist.
+     *
+     * @param directory The cache directory
+     *
+     * @return true if the cache was initialized successfully
+     */
+    bool init(const std::string& directory);
+    
+    /**
+     * Returns a newly allocated cache in the given directory.
+     *
+     * The directory is created if it does not exist.
+     *
+     * @param directory The cache directory
+     *
+     * @return a newly allocated cache in the given directory.
+     */
+    static std::shared_ptr<AssetCache> alloc(const std::string& directory) {
+        std::shared_ptr<AssetCache> result = std::make_shared<AssetCache>();
+        return (result->init(directory) ? result : nullptr);
+    }
+    
+#pragma mark Entries
+    /**
+     * Reads the payload of the given entry, returning true on a hit.
+     *
+     * The entry is a hit if it exists and its stamp matches the current
+     * source files.  The sources are relative to the asset directory.
+     *
+     * @param key       The entry key
+     * @param sources   The source files of the entry
+     * @param data      The vector to store the payload
+     *
+     * @return true if the entry is present and up to date
+     */
+    bool read(const std::string& key, const std::vector<std::string>& sources, std::vector<Uint8>& data);
+    
+    /**
+     * Writes the payload of the given entry, stamped with its source files.
+     *
+     * The sources are relative to the asset directory.  This method fails
+     * if any of them cannot be read.
+     *
+     * @param key       The entry key
+     * @param sources   The source files of the entry
+     * @param data      The payload
+     *
+     * @return true if the entry was written
+     */
+    bool write(const std::string& key, const std::vector<std::string>& sources, const std::vector<Uint8>& data);
+    
+    /**
+     * Returns the JSON in the given asset file, using the cache if possible.
+     *
+     * On a miss, the file is parsed with {@link JsonReader} and the result
+     * is written to the cache in the binary form of {@link JsonValue#toBinary}.
+     *
+     * @param source    The JSON file, relative to the asset directory
+     *
+     * @return the JSON in the given asset file (nullptr on failure)
+     */
+    std::shared_ptr<JsonValue> readJson(const std::string& source);
+    
+    /**
+     * Deletes every entry in this cache.
+     */
+    void clear();
+    
+    /**
+     * Returns the number of successful reads since initialization.
+     *
+     * @return the number of successful reads since initialization.
+     */
+    Uint32 getHits() const { return _hits.load(); }
+    
+    /**
+     * Returns the number of failed reads since initialization.
+     *
+     * @return the number of failed reads since initialization.
+     */
+    Uint32 getMisses() const { return _misses.load(); }
+    
+#pragma mark Compression
+    /**
+     * Appends the LZ4 block compression of the given data to the buffer.
+     *
+     * This is the block format of LZ4 (without the frame header), so it
+     * may be decompressed by any LZ4 implementation given the original
+     * size.  The compressor is greedy and favors speed over ratio.
+     *
+     * @param data      The data to compress
+     * @param size      The size of the data in bytes
+     * @param output    The buffer to append the compressed data to
+     */
+    static void compress(const Uint8* data, size_t size, std::vector<Uint8>& output);
+    
+    /**
+     * Decompresses an LZ4 block, returning true if it is valid.
+     *
+     * The block must decompress to exactly the given output size.  Every
+     * read and write is bounds checked, so a corrupt block fails safely.
+     *
+     * @param data      The compressed data
+     * @param size      The size of the compressed data in bytes
+     * @param output    The buffer for the decompressed data
+     * @param capacity  The expected size of the decompressed data
+     *
+     * @return true if the block is valid
+     */
+    static bool decompress(const Uint8* data, size_t size, Uint8* output, size_t capacity);
+};
+
 #pragma mark -
 #pragma mark Polymorphic Base
 /**
@@ -111,6 +306,70 @@ protected:
      */
     AssetManager* _manager;
     
+    /** The cache of preprocessed assets (may be null) */
+    std::shared_ptr<AssetCache> _cache;
+    
+    /** The origin and memory of a loaded asset (or of the assets of one entry) */
+    class Residency {
+    public:
+        /** The directory entry for the asset (nullptr if loaded from a source) */
+        std::shared_ptr<JsonValue> json;
+        /** The source of the asset, if it has no directory entry */
+        std::string source;
+        /** The keys loaded for the asset (e.g. the regions of an atlas) */
+        std::vector<std::string> members;
+        /** The memory used by the asset in bytes */
+        size_t bytes;
+        /** The access counter when the asset was last used */
+        Uint64 used;
+        /** Whether the asset is in memory (false if it was evicted) */
+        bool resident;
+    };
+    
+    /** The residency of each loaded asset, by the key it was loaded with */
+    std::unordered_map<std::string,Residency> _residency;
+    /** The key each asset was loaded with (which differs for atlas regions) */
+    std::unordered_map<std::string,std::string> _owners;
+    /** The memory budget in bytes (0 for no limit) */
+    size_t _budget;
+    /** The memory used by the resident assets in bytes */
+    size_t _memory;
+    /** The access counter for least-recently-used eviction */
+    Uint64 _clock;
+    /** The number of changes to the loaded assets (bump on every erase, as handles cache map nodes) */
+    Uint64 _revision;
+    
+    /** The deferred main-thread work for each asset still materializing */
+    std::unordered_map<std::string,Uint32> _uploads;
+    /** A mutex for the deferred work (it is posted from the worker threads) */
+    std::mutex _uploadMutex;
+    
+    /**
+     * Defers the main-thread part of loading the given asset.
+     *
+     * The work runs under the per-frame budget of {@link Application#defer},
+     * so that many assets finishing together do not cause a hitch.  The
+     * work returns true if it has more to do.  Until it returns false, the
+     * asset may be moved up the queue with {@link prioritize}.
+     *
+     * This method is safe to call from the worker threads.
+     *
+     * @param key       The key of the asset
+     * @param priority  The work priority (larger runs first)
+     * @param work      The work function
+     */
+    void defer(const std::string& key, int priority, std::function<bool()> work) {
+        std::lock_guard<std::mutex> lock(_uploadMutex);
+        _uploads[key] = Application::get()->defer([=](void) {
+            bool more = work();
+            if (!more) {
+                std::lock_guard<std::mutex> lock(this->_uploadMutex);
+                this->_uploads.erase(key);
+            }
+            return more;
+        }, priority);
+    }
+    
     /**
      * Internal method to support asset loading.
      *
@@ -210,6 +469,188 @@ protected:
      */
     virtual bool verify(const std::string& key) const { return false; }
    
+#pragma mark Residency
+    /**
+     * Returns the memory used by the asset for the given key in bytes.
+     *
+     * This method is abstract and should be overridden in child classes.
+     * Assets that report no memory are never evicted.
+     *
+     * @param key   The key associated with the asset
+     *
+     * @return the memory used by the asset for the given key in bytes.
+     */
+    virtual size_t measure(const std::string& key) const { return 0; }
+    
+    /**
+     * Returns true if any of the given assets is referenced outside this loader.
+     *
+     * An asset in use may not be evicted, as that would not free its memory.
+     * This method is abstract and should be overridden in child classes.
+     *
+     * @param keys  The keys of the assets
+     *
+     * @return true if any of the given assets is referenced outside this loader.
+     */
+    virtual bool inUse(const std::vector<std::string>& keys) const { return false; }
+    
+    /**
+     * Records a newly loaded asset, evicting others if over budget.
+     *
+     * Either the directory entry or the source is used to reload the asset
+     * if it is evicted.  This method is called when the asset has finished
+     * loading, so that all of its members are present.
+     *
+     * @param key       The key the asset was loaded with
+     * @param json      The directory entry for the asset (may be nullptr)
+     * @param source    The source of the asset, if it has no directory entry
+     */
+    void admit(const std::string& key, const std::shared_ptr<JsonValue>& json, const std::string& source) {
+        forget(key);
+        std::vector<std::string> keys;
+        if (json != nullptr) {
+            getMembers(json,keys);
+        } else {
+            keys.push_back(key);
+        }
+        
+        Residency& entry = _residency[key];
+        entry.json = json;
+        entry.source = source;
+        entry.bytes = 0;
+        for(auto it = keys.begin(); it != keys.end(); ++it) {
+            if (verify(*it)) {
+                entry.members.push_back(*it);
+                entry.bytes += measure(*it);
+                _owners[*it] = key;
+            }
+        }
+        entry.used = ++_clock;
+        entry.resident = true;
+        _memory += entry.bytes;
+        _revision++;
+        trim(key);
+    }
+    
+    /**
+     * Removes the residency record for the given key.
+     *
+     * The asset itself is not unloaded.  Once forgotten, an evicted asset
+     * is no longer reloaded on access.
+     *
+     * @param key   The key the asset was loaded with
+     */
+    void forget(const std::string& key) {
+        auto it = _residency.find(key);
+        if (it == _residency.end()) {
+            return;
+        }
+        if (it->second.resident) {
+            _memory -= it->second.bytes;
+        }
+        for(auto jt = it->second.members.begin(); jt != it->second.members.end(); ++jt) {
+            _owners.erase(*jt);
+        }
+        _residency.erase(it);
+        _revision++;
+    }
+    
+    /**
+     * Marks the asset containing the given key as used.
+     *
+     * @param key   The key associated with the asset
+     */
+    void touch(const std::string& key) {
+        auto it = _owners.find(key);
+        if (it != _owners.end()) {
+            _residency[it->second].used = ++_clock;
+        }
+    }
+    
+    /**
+     * Synchronously reloads the evicted asset containing the given key.
+     *
+     * The asset is loaded exactly as it was the first time.  If it fails to
+     * load, it is forgotten, so that it is not reloaded on every access.
+     *
+     * @param key   The key associated with the asset
+     *
+     * @return true if the asset was evicted and has been reloaded
+     */
+    bool restore(const std::string& key) {
+        auto it = _owners.find(key);
+        if (it == _owners.end() || _residency[it->second].resident) {
+            return false;
+        }
+        
+        std::string owner = it->second;
+        std::shared_ptr<JsonValue> json = _residency[owner].json;
+        std::string source = _residency[owner].source;
+        forget(owner);
+        bool success = (json != nullptr ? read(json,nullptr,false) : read(owner,source,nullptr,false));
+        if (success) {
+            admit(owner,json,source);
+        }
+        return success;
+    }
+    
+    /**
+     * Evicts the least recently used assets until the memory is within budget.
+     *
+     * Only assets that are not in use are evicted.  An evicted asset is
+     * reloaded the next time it is accessed.
+     *
+     * @param keep  The key of an asset to keep (e.g. one just loaded)
+     */
+    void trim(const std::string& keep) {
+        while (_budget > 0 && _memory > _budget) {
+            auto victim = _residency.end();
+            for(auto it = _residency.begin(); it != _residency.end(); ++it) {
+                const Residency& entry = it->second;
+                if (entry.resident && entry.bytes > 0 && it->first != keep &&
+                    (victim == _residency.end() || entry.used < victim->second.used) &&
+                    !inUse(entry.members)) {
+                    victim = it;
+                }
+            }
+            if (victim == _residency.end()) {
+                return;
+            }
+            
+            Residency& entry = victim->second;
+            if (entry.json != nullptr) {
+                purge(entry.json);
+            } else {
+                purge(victim->first);
+            }
+            entry.resident = false;
+            _memory -= entry.bytes;
+            _revision++;
+        }
+    }
+    
+    /**
+     * Returns a callback that records the asset when it finishes loading.
+     *
+     * @param key       The key the asset is loaded with
+     * @param json      The directory entry for the asset (may be nullptr)
+     * @param source    The source of the asset, if it has no directory entry
+     * @param callback  The original callback (may be nullptr)
+     *
+     * @return a callback that records the asset when it finishes loading.
+     */
+    LoaderCallback track(const std::string& key, const std::shared_ptr<JsonValue>& json,
+                         const std::string& source, LoaderCallback callback) {
+        return [=](const std::string& asset, bool success) {
+            if (success) {
+                this->admit(key,json,source);
+            }
+            if (callback != nullptr) {
+                callback(asset,success);
+            }
+        };
+    }
+    
     
 public:
 #pragma mark Constructors
@@ -219,7 +660,7 @@ public:
      * NEVER CALL THIS CONSTRUCTOR. As this is an abstract class, you should 
      * call one of the static constructors of the appropriate child class.
      */
-    BaseLoader()    {}
+    BaseLoader() : _budget(0), _memory(0), _clock(0), _revision(1) {}
     
     /**
      * Deletes this asset loader, disposing of all resources.
@@ -337,6 +778,26 @@ public:
         _manager = manager;
     }
     
+    /**
+     * Returns the cache of preprocessed assets for this loader.
+     *
+     * Loaders consult the cache before doing any expensive work, such as
+     * decoding an image.  If this value is nullptr, nothing is cached.
+     *
+     * @return the cache of preprocessed assets for this loader.
+     */
+    const std::shared_ptr<AssetCache>& getCache() const { return _cache; }
+    
+    /**
+     * Sets the cache of preprocessed assets for this loader.
+     *
+     * Loaders consult the cache before doing any expensive work, such as
+     * decoding an image.  If this value is nullptr, nothing is cached.
+     *
+     * @param cache The cache of preprocessed assets
+     */
+    void setCache(const std::shared_ptr<AssetCache>& cache) { _cache = cache; }
+    
     /**
      * Returns the asset manager for this loader.
      *
@@ -368,7 +829,11 @@ public:
      * @return true if the asset was successfully loaded
      */
     bool load(const std::string& key, const std::string& source) {
-        return read(key,source,nullptr,false);
+        bool success = read(key,source,nullptr,false);
+        if (success) {
+            admit(key,nullptr,source);
+        }
+        return success;
     }
 
     /**
@@ -388,7 +853,7 @@ public:
      * @return true if the asset was successfully loaded
      */
     bool load(const char* key, const std::string& source) {
-        return read(std::string(key),source,nullptr,false);
+        return load(std::string(key),source);
     }
 
     /**
@@ -408,7 +873,7 @@ public:
      * @return true if the asset was successfully loaded
      */
     bool load(const std::string& key, const char* source) {
-        return read(key,std::string(source),nullptr,false);
+        return load(key,std::string(source));
     }
     
     /**
@@ -428,7 +893,7 @@ public:
      * @return true if the asset was successfully loaded
      */
     bool load(const char* key, const char* source) {
-        return read(std::string(key),std::string(source),nullptr,false);
+        return load(std::string(key),std::string(source));
     }
 
     /**
@@ -453,7 +918,11 @@ public:
      * @return true if the asset was successfully loaded
      */
     bool load(const std::shared_ptr<JsonValue>& json) {
-        return read(json,nullptr,false);
+        bool success = read(json,nullptr,false);
+        if (success) {
+            admit(json->key(),json,"");
+        }
+        return success;
     }
     
     /**
@@ -476,7 +945,10 @@ public:
      * @param callback  An optional callback for asynchronous loading
      */
     void loadAsync(const std::string& key, const std::string& source, LoaderCallback callback) {
-        read(key, source, callback,true);
+        // A loader without threads finishes immediately, and may skip the callback
+        if (read(key, source, track(key,nullptr,source,callback),true)) {
+            admit(key,nullptr,source);
+        }
     }
 
     /**
@@ -499,7 +971,7 @@ public:
      * @param callback  An optional callback for asynchronous loading
      */
     void loadAsync(const char* key, const std::string& source, LoaderCallback callback) {
-        read(std::string(key), source, callback,true);
+        loadAsync(std::string(key), source, callback);
     }
 
     /**
@@ -522,7 +994,7 @@ public:
      * @param callback  An optional callback for asynchronous loading
      */
     void loadAsync(const std::string& key, const char* source, LoaderCallback callback) {
-        read(key, std::string(source), callback,true);
+        loadAsync(key, std::string(source), callback);
     }
 
     /**
@@ -545,7 +1017,7 @@ public:
      * @param callback  An optional callback for asynchronous loading
      */
     void loadAsync(const char* key, const char* source, LoaderCallback callback) {
-        read(std::string(key), std::string(source), callback,true);
+        loadAsync(std::string(key), std::string(source), callback);
     }
 
     /**
@@ -564,7 +1036,10 @@ public:
      * in that case.
      *
      * The optional callback function will be called with the asset status when
-     * it either finishes loading or fails to load.
+     * it either finishes loading or fails to load.  However, a load that is
+     * not handed to a worker (because there is no thread pool, or because the
+     * asset is already loaded or loading) may finish without the callback.
+     * The return value distinguishes the two cases.
      *
      * This method is abstract and should be overridden in child classes to
      * support the appropriate asset type.
@@ -572,9 +1047,16 @@ public:
      * @param key       The key to access the asset after loading
      * @param source    The pathname to the asset
      * @param callback  An optional callback for asynchronous loading
+     *
+     * @return true if the load was handed to a worker, and will reach the callback
      */
-    void loadAsync(const std::shared_ptr<JsonValue>& json, LoaderCallback callback) {
-        read(json, callback,true);
+    bool loadAsync(const std::shared_ptr<JsonValue>& json, LoaderCallback callback) {
+        // A worker load stays queued until it calls back; nothing else does
+        size_t waiting = waitCount();
+        if (read(json, track(json->key(),json,"",callback),true)) {
+            admit(json->key(),json,"");
+        }
+        return waitCount() > waiting;
     }
 
     /**
@@ -586,10 +1068,15 @@ public:
      *
      * This method is abstract and should be overridden in child classes. 
      *
+     * An evicted asset counts as unloaded, and is no longer reloaded.
+     *
      * @return true if the asset was successfully unloaded
      */
     bool unload(const std::string& key) {
-        return purge(key);
+        auto it = _residency.find(key);
+        bool evicted = (it != _residency.end() && !it->second.resident);
+        forget(key);
+        return purge(key) || evicted;
     }
 
     /**
@@ -604,11 +1091,27 @@ public:
      * @return true if the asset was successfully unloaded
      */
     bool unload(const char* key) {
-        return purge(key);
+        return unload(std::string(key));
     }
     
+    /**
+     * Unloads the asset for the given directory entry
+     *
+     * An asset may still be available if it is referenced by a smart pointer.
+     * See the description of the specific implementation for how assets
+     * are released.
+     *
+     * An evicted asset counts as unloaded, and is no longer reloaded.
+     *
+     * @param json      The directory entry for the asset
+     *
+     * @return true if the asset was successfully unloaded
+     */
     bool unload(const std::shared_ptr<JsonValue>& json) {
-        return purge(json);
+        auto it = _residency.find(json->key());
+        bool evicted = (it != _residency.end() && !it->second.resident);
+        forget(json->key());
+        return purge(json) || evicted;
     }
     
     /**
@@ -622,6 +1125,46 @@ public:
      */
     virtual void unloadAll() {}
     
+#pragma mark Memory Management
+    /**
+     * Returns the memory used by the assets in this loader in bytes.
+     *
+     * This is the memory of the asset data (e.g. texture or PCM bytes), as
+     * reported by the specific loader.  It does not include evicted assets.
+     *
+     * @return the memory used by the assets in this loader in bytes.
+     */
+    size_t getMemory() const { return _memory; }
+    
+    /**
+     * Returns the memory budget of this loader in bytes.
+     *
+     * If the assets use more memory than this, the least recently used
+     * assets that are not referenced elsewhere are evicted.  An evicted asset
+     * is reloaded (synchronously) the next time it is accessed by key.  A
+     * budget of 0 means there is no limit.
+     *
+     * @return the memory budget of this loader in bytes.
+     */
+    size_t getBudget() const { return _budget; }
+    
+    /**
+     * Sets the memory budget of this loader in bytes.
+     *
+     * If the assets use more memory than this, the least recently used
+     * assets that are not referenced elsewhere are evicted.  An evicted asset
+     * is reloaded (synchronously) the next time it is accessed by key.  A
+     * budget of 0 means there is no limit.
+     *
+     * Lowering the budget evicts assets immediately.
+     *
+     * @param bytes The memory budget of this loader in bytes.
+     */
+    void setBudget(size_t bytes) {
+        _budget = bytes;
+        trim("");
+    }
+    
 
 #pragma mark Progress Monitoring
     /**
@@ -709,12 +1252,71 @@ public:
         return (size == 0 ? 0.0f : ((float)loadCount())/size);
     }
     
+    /**
+     * Changes the priority of an asset that is waiting on the main thread.
+     *
+     * Assets that finish loading in the worker threads wait their turn for
+     * the main thread (e.g. to upload to the GPU).  Raising the priority of
+     * an asset that is needed on screen now lets it jump that queue.  The
+     * initial priority comes from the "priority" value of the directory
+     * entry, which is 0 by default.
+     *
+     * @param key       The key of the asset
+     * @param priority  The new priority (larger runs first)
+     *
+     * @return true if the asset was waiting on the main thread
+     */
+    bool prioritize(const std::string& key, int priority) {
+        std::lock_guard<std::mutex> lock(_uploadMutex);
+        auto it = _uploads.find(key);
+        return it != _uploads.end() && Application::get()->prioritize(it->second,priority);
+    }
+    
+#pragma mark Dependencies
+    /**
+     * Adds the assets required by the given directory entry to deps.
+     *
+     * When the {@link AssetManager} loads a JSON directory asynchronously,
+     * it will not start loading this asset until every asset it depends on
+     * has finished loading.  Each dependency is a pair of the asset type
+     * hash (typeid(T).hash_code()) and the asset key.  Dependencies must not
+     * form a cycle.
+     *
+     * By default, an asset has no dependencies.  A loader that accesses
+     * other assets while loading must override this method.
+     *
+     * @param json  The directory entry for the asset
+     * @param deps  The list to append the dependencies to
+     */
+    virtual void getDependencies(const std::shared_ptr<JsonValue>& json,
+                                 std::vector<std::pair<size_t,std::string>>& deps) const {}
+    
+    /**
+     * Adds the keys of the assets loaded for the given directory entry to keys.
+     *
+     * Most entries load a single asset with the key of the entry.  However,
+     * an entry may load more than one (e.g. the regions of an atlas).  These
+     * assets are evicted and reloaded together.  Keys that are not loaded
+     * are ignored, so this method may list keys that might not exist.
+     *
+     * @param json  The directory entry for the asset
+     * @param keys  The list to append the keys to
+     */
+    virtual void getMembers(const std::shared_ptr<JsonValue>& json,
+                            std::vector<std::string>& keys) const {
+        keys.push_back(json->key());
+    }
+    
 };
 
 
 #pragma mark -
 #pragma mark Templated Middle Layer
 
+/** Forward reference to the asset handles */
+template <class T>
+class AssetHandle;
+
 /**
  * This class is a specific template for each loader.
  *
@@ -724,7 +1326,9 @@ public:
  * loader implementations.
  *
  * All assets are assigned a key and retrieved via that key.  This provides a 
- * quick way to reference assets.
+ * quick way to reference assets.  Code that accesses an asset often should
+ * resolve the key to an {@link AssetHandle} once, as a handle reaches its
+ * asset without hashing the key.
  *
  * IMPORTANT: This class is not even remotely thread-safe.  Do not call any of
  * these methods outside of the main CUGL thread.
@@ -737,6 +1341,32 @@ protected:
     
     /** The assets we are expecting that are not yet loaded */
     std::unordered_set<std::string> _queue;
+    
+    /**
+     * A slot in the handle table
+     *
+     * A slot caches the location of its asset in the hash map, which is
+     * looked up again whenever the loaded assets have changed.
+     */
+    class Slot {
+    public:
+        /** The key of the asset */
+        std::string key;
+        /** The asset in the hash map (nullptr if it is not loaded) */
+        std::shared_ptr<T>* asset;
+        /** The access counter of the asset residency (nullptr if untracked) */
+        Uint64* used;
+        /** The loader revision when the slot was last looked up */
+        Uint64 revision;
+    };
+    
+    /** The handle table; slots are never removed, so handles stay valid */
+    std::vector<Slot> _slots;
+    /** The slot for each key that has been resolved */
+    std::unordered_map<std::string, Uint32> _handles;
+    
+    /** Allow handles to access their slots */
+    friend class AssetHandle<T>;
 
     /**
      * Unloads the asset for the given key
@@ -756,6 +1386,7 @@ protected:
         auto it = _assets.find(key);
         if (it != _assets.end()) {
             _assets.erase(it);
+            _revision++;
             return true;
         }
         return false;
@@ -776,6 +1407,112 @@ protected:
         return _assets.find(key) != _assets.end();
     }
     
+    /**
+     * Returns the memory used by the given asset in bytes.
+     *
+     * This method is abstract and should be overridden in child classes.
+     * Assets that report no memory are never evicted.
+     *
+     * @param asset The asset to measure
+     *
+     * @return the memory used by the given asset in bytes.
+     */
+    virtual size_t footprint(const std::shared_ptr<T>& asset) const { return 0; }
+    
+    /**
+     * Returns the memory used by the asset for the given key in bytes.
+     *
+     * @param key   The key associated with the asset
+     *
+     * @return the memory used by the asset for the given key in bytes.
+     */
+    size_t measure(const std::string& key) const override {
+        auto it = _assets.find(key);
+        return (it == _assets.end() ? 0 : footprint(it->second));
+    }
+    
+    /**
+     * Returns true if any of the given assets is referenced outside this loader.
+     *
+     * By default, an asset is in use if there is any smart pointer to it
+     * other than the one in this loader.  Loaders whose assets refer to
+     * each other (e.g. atlas regions) must override this method.
+     *
+     * @param keys  The keys of the assets
+     *
+     * @return true if any of the given assets is referenced outside this loader.
+     */
+    bool inUse(const std::vector<std::string>& keys) const override {
+        for(auto it = keys.begin(); it != keys.end(); ++it) {
+            auto jt = _assets.find(*it);
+            if (jt != _assets.end() && jt->second.use_count() > 1) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    /**
+     * Returns the slot for the given key, allocating one if necessary.
+     *
+     * @param key   The key associated with the asset
+     *
+     * @return the slot for the given key
+     */
+    Uint32 slot(const std::string& key) {
+        auto it = _handles.find(key);
+        if (it != _handles.end()) {
+            return it->second;
+        }
+        
+        Slot entry;
+        entry.key = key;
+        entry.asset = nullptr;
+        entry.used = nullptr;
+        entry.revision = 0;
+        _slots.push_back(entry);
+        Uint32 result = (Uint32)(_slots.size()-1);
+        _handles[key] = result;
+        return result;
+    }
+    
+    /**
+     * Returns the asset in the given slot.
+     *
+     * The slot is only looked up again if the loaded assets have changed
+     * since its last access.  If the asset was evicted to stay within the
+     * memory budget, it is reloaded synchronously before it is returned.
+     *
+     * @param slot  The slot of the asset
+     *
+     * @return the asset in the given slot
+     */
+    std::shared_ptr<T> fetch(Uint32 slot) {
+        Slot& entry = _slots[slot];
+        if (entry.revision != _revision) {
+            auto it = _assets.find(entry.key);
+            entry.asset = (it == _assets.end() ? nullptr : &(it->second));
+            entry.used = nullptr;
+            auto jt = _owners.find(entry.key);
+            if (jt != _owners.end()) {
+                auto kt = _residency.find(jt->second);
+                entry.used = (kt == _residency.end() ? nullptr : &(kt->second.used));
+            }
+            entry.revision = _revision;
+        }
+        
+        if (entry.asset != nullptr) {
+            if (entry.used != nullptr) {
+                *(entry.used) = ++_clock;
+            }
+            return *(entry.asset);
+        } else if (restore(std::string(entry.key))) {
+            // Copy the key, as a reload may resolve (and move) other slots
+            return fetch(slot);
+        }
+        return nullptr;
+    }
+    
 public:
 #pragma mark Constructors
     /**
@@ -788,19 +1525,46 @@ public:
 
     
 #pragma mark Asset Access
+    /**
+     * Returns a handle for the asset with the given key.
+     *
+     * The key does not need to be loaded yet.  The handle stays valid for
+     * the life of this loader, even if the asset is unloaded and loaded
+     * again.  It is much faster than looking up the key on each access.
+     *
+     * @param key   The key associated with the asset
+     *
+     * @return a handle for the asset with the given key
+     */
+    AssetHandle<T> resolve(const std::string& key) {
+        return AssetHandle<T>(std::static_pointer_cast<Loader<T>>(shared_from_this()),slot(key));
+    }
+    
     /**
      * Returns the asset for the given key.
      *
      * If the key is valid, the asset is guaranteed not to be null.  Otherwise,
      * this method returns nullptr
      *
+     * If the asset was evicted to stay within the memory budget, it is
+     * reloaded synchronously before it is returned.
+     *
+     * This method uses the same slot as {@link resolve}, so repeated lookups
+     * of a key only hash it once.  A slot is only allocated for keys that
+     * are loaded (or evicted), so misses do not grow the handle table.
+     *
      * @param key   The key associated with the asset
      *
      * @return the asset pointer for the given key
      */
-    std::shared_ptr<T> get(const std::string& key) const {
-        auto it = _assets.find(key);
-        return (it == _assets.end() ? nullptr : it->second);
+    std::shared_ptr<T> get(const std::string& key) {
+        auto it = _handles.find(key);
+        if (it != _handles.end()) {
+            return fetch(it->second);
+        } else if (_assets.find(key) != _assets.end() || _owners.find(key) != _owners.end()) {
+            return fetch(slot(key));
+        }
+        return nullptr;
     }
 
     /**
@@ -813,9 +1577,8 @@ public:
      *
      * @return the asset pointer for the given key
      */
-    std::shared_ptr<T> get(const char* key) const {
-        auto it = _assets.find(std::string(key));
-        return (it == _assets.end() ? nullptr : it->second);
+    std::shared_ptr<T> get(const char* key) {
+        return get(std::string(key));
     }
     
     /**
@@ -828,7 +1591,7 @@ public:
      *
      * @return the asset pointer for the given key
      */
-    std::shared_ptr<T> operator[](const std::string& key) const { return get(key); }
+    std::shared_ptr<T> operator[](const std::string& key) { return get(key); }
 
     /**
      * Returns the asset for the given key.
@@ -840,7 +1603,7 @@ public:
      *
      * @return the asset pointer for the given key
      */
-    std::shared_ptr<T> operator[](const char* key) const { return get(key); }
+    std::shared_ptr<T> operator[](const char* key) { return get(key); }
     
 
 #pragma mark Asset Loading
@@ -876,6 +1639,108 @@ public:
      */
     void unloadAll() override {
         _assets.clear();
+        _residency.clear();
+        _owners.clear();
+        _memory = 0;
+        _revision++;
+    }
+};
+
+#pragma mark -
+#pragma mark Asset Handles
+
+/**
+ * This class is a reference to an asset of a loader.
+ *
+ * A handle is created by {@link Loader#resolve} (or the asset manager), which
+ * looks up the key once.  After that, a handle reaches its asset through a
+ * slot in the loader, without hashing the key or the asset type.  Handles are
+ * cheap to copy, and stay valid when their asset is unloaded, evicted or
+ * loaded again.  Accessing a handle whose asset is not loaded returns nullptr.
+ *
+ * A handle does not keep its loader alive, so handles may be cached for as
+ * long as is convenient.  Once the loader is deleted, the handle returns
+ * nullptr.  Like the loaders, handles may only be used on the main CUGL thread.
+ */
+template <class T>
+class AssetHandle {
+private:
+    /** The loader of the asset */
+    std::weak_ptr<Loader<T>> _loader;
+    /** The slot of the asset in the loader */
+    Uint32 _slot;
+    
+public:
+    /**
+     * Creates an empty handle that refers to no asset.
+     */
+    AssetHandle() : _slot(0) {}
+    
+    /**
+     * Creates a handle for the given slot of a loader.
+     *
+     * You should use {@link Loader#resolve} instead of this constructor.
+     *
+     * @param loader    The loader of the asset
+     * @param slot      The slot of the asset in the loader
+     */
+    AssetHandle(const std::shared_ptr<Loader<T>>& loader, Uint32 slot) :
+    _loader(loader), _slot(slot) {}
+    
+    /**
+     * Returns true if this handle refers to an asset of a live loader.
+     *
+     * The asset itself may not be loaded.
+     *
+     * @return true if this handle refers to an asset of a live loader.
+     */
+    bool isValid() const { return !_loader.expired(); }
+    
+    /**
+     * Returns the key of the asset, or the empty string for an empty handle.
+     *
+     * @return the key of the asset
+     */
+    std::string key() const {
+        std::shared_ptr<Loader<T>> loader = _loader.lock();
+        return loader == nullptr ? "" : loader->_slots[_slot].key;
+    }
+    
+    /**
+     * Returns the asset for this handle.
+     *
+     * This method returns nullptr if the handle is empty, if its loader was
+     * deleted, or if the asset is not loaded.  If the asset was evicted to stay within the memory budget,
+     * it is reloaded synchronously before it is returned.
+     *
+     * @return the asset for this handle.
+     */
+    std::shared_ptr<T> get() const {
+        std::shared_ptr<Loader<T>> loader = _loader.lock();
+        return loader == nullptr ? nullptr : loader->fetch(_slot);
+    }
+    
+    /**
+     * Returns true if this handle refers to the same asset as the other.
+     *
+     * @param other The handle to compare
+     *
+     * @return true if this handle refers to the same asset as the other.
+     */
+    bool operator==(const AssetHandle<T>& other) const {
+        return (_slot == other._slot && !_loader.owner_before(other._loader) &&
+                !other._loader.owner_before(_loader));
+    }
+    
+    /**
+     * Returns true if this handle does not refer to the same asset as the other.
+     *
+     * @param other The handle to compare
+     *
+     * @return true if this handle does not refer to the same asset as the other.
+     */
+    bool operator!=(const AssetHandle<T>& other) const {
+        return !(*this == other);
     }
 };
 
@@ -164,7 +164,7 @@ public:
      * fail.  You must reinitialize the loader to begin loading assets again.
      */
     void dispose() override {
-        _assets.clear();
+        unloadAll();
         _loader = nullptr;
     }
     
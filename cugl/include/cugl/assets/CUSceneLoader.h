@@ -144,7 +144,7 @@ protected:
      * This method finishes the asset loading started in {@link preload}. This
      * step is not safe to be done in a separate thread, as it accesses the
      * main asset table.  Therefore, it takes place in the main CUGL thread
-     * via {@link Application#schedule}.  The scene is stored using the name
+     * via {@link Application#defer}.  The scene is stored using the name
      * of the root Node as a key.
      *
      * This method supports an optional callback function which reports whether
@@ -301,7 +301,7 @@ public:
      */
     void dispose() override {
         _manager = nullptr;
-        _assets.clear();
+        unloadAll();
         _loader = nullptr;
         _types.clear();
         _forms.clear();
@@ -371,6 +371,21 @@ public:
      */
     std::shared_ptr<Node> build(const std::string& key, const std::shared_ptr<JsonValue>& json) const;
     
+    /**
+     * Adds the textures and fonts used by the given scene to deps.
+     *
+     * The scene is scanned for the widget attributes that name other
+     * assets: "texture", "background", "foreground", "left_cap" and
+     * "right_cap" for textures, and "font" for fonts.  This includes the
+     * nested widgets of buttons and sliders.  An asynchronous directory
+     * load builds the scene once these assets have finished loading.
+     *
+     * @param json  The directory entry for the scene
+     * @param deps  The list to append the dependencies to
+     */
+    void getDependencies(const std::shared_ptr<JsonValue>& json,
+                         std::vector<std::pair<size_t,std::string>>& deps) const override;
+    
 };
     
 }
@@ -142,6 +142,19 @@ protected:
     virtual bool read(const std::shared_ptr<JsonValue>& json,
                       LoaderCallback callback, bool async) override;
 
+    /**
+     * Returns the memory used by the given sound in bytes.
+     *
+     * Sounds are fully decoded at load time, so this is the size of the
+     * PCM data (as 16-bit samples, which is the format of the mixer).
+     *
+     * @param asset The sound to measure
+     *
+     * @return the memory used by the given sound in bytes.
+     */
+    size_t footprint(const std::shared_ptr<Sound>& asset) const override {
+        return (size_t)(asset->getLength()*asset->getChannels()*sizeof(Sint16));
+    }
     
 public:
 #pragma mark -
@@ -166,7 +179,7 @@ public:
      * fail.  You must reinitialize the loader to begin loading assets again.
      */
     void dispose() override {
-        _assets.clear();
+        unloadAll();
         _loader = nullptr;
     }
     
@@ -45,6 +45,7 @@
 //
 #ifndef __CU_TEXTURE_LOADER_H__
 #define __CU_TEXTURE_LOADER_H__
+#include <vector>
 #include <cugl/assets/CULoader.h>
 #include <cugl/renderer/CUTexture.h>
 
@@ -63,8 +64,9 @@ namespace cugl {
  * Note that this implementation uses a two phase loading system.  First, it
  * loads as much of the asset as possible without using OpenGL.  This allows 
  * us to load the texture in a separate thread.  It then finishes off the 
- * remainder of asset loading using {@link Application#schedule}.  This is a
- * good template for asset loaders in general.
+ * remainder of asset loading using {@link Application#defer}, which spreads
+ * the GPU uploads over several frames.  This is a good template for asset
+ * loaders in general.
  *
  * As with all of our loaders, this loader is designed to be attached to an
  * asset manager. Use the method {@link getHook()} to get the appropriate
@@ -86,6 +88,64 @@ protected:
     GLuint _wrapt;
     /** The default support for mipmaps */
     bool _mipmaps;
+
+public:
+    /**
+     * An image placed in a packed atlas page
+     *
+     * The position is measured in pixels from the top left corner of the page,
+     * and does not include any padding around the image.
+     */
+    typedef struct {
+        /** The asset key for this image */
+        std::string key;
+        /** The page containing this image */
+        int page;
+        /** The left edge of the image in the page */
+        int x;
+        /** The top edge of the image in the page */
+        int y;
+        /** The image width in pixels */
+        int width;
+        /** The image height in pixels */
+        int height;
+    } PackedImage;
+    
+protected:
+    /**
+     * A texture that is uploaded to the GPU a strip at a time
+     *
+     * Uploading a large image in one call can take several milliseconds.
+     * Instead, the image is uploaded a few rows per call, and the calls
+     * are spread over frames by {@link Application#defer}.  The surface
+     * is freed once every row has been uploaded.
+     *
+     * A compressed container is uploaded in a single call instead, as it
+     * is a fraction of the size of the decoded image.
+     */
+    class Upload {
+    public:
+        /** The decoded image (nullptr once uploaded) */
+        SDL_Surface* surface;
+        /** The compressed image, used in place of the surface if not nullptr */
+        std::shared_ptr<TextureContainer> container;
+        /** The texture being uploaded to */
+        std::shared_ptr<Texture> texture;
+        /** The first row not yet uploaded */
+        int row;
+        
+        /**
+         * Creates an upload for the given surface
+         *
+         * @param surface   The decoded image (may be nullptr)
+         */
+        Upload(SDL_Surface* surface) : surface(surface), row(0) {}
+        
+        /**
+         * Deletes this upload, freeing the surface if it was not finished
+         */
+        ~Upload() { if (surface != nullptr) { SDL_FreeSurface(surface); } }
+    };
     
 #pragma mark Asset Loading
     /**
@@ -109,18 +169,73 @@ protected:
      * we need to create an OpenGL texture.  Hence this method does the maximum
      * amount of work that can be done in asynchronous texture loading.
      *
-     * @param source    The pathname to the asset
+     * The image is decoded straight into the upload layout by {@link Texture#decode},
+     * which also premultiplies the colors by alpha if requested.
+     *
+     * @param source        The pathname to the asset
+     * @param premultiply   Whether to premultiply the colors by alpha
      *
      * @return the SDL_Surface with the texture information
      */
-    SDL_Surface* preload(const std::string& source);
+    SDL_Surface* preload(const std::string& source, bool premultiply=false);
+    
+    /**
+     * Loads the first usable compressed container of a directory entry.
+     *
+     * The "compressed" value of the entry is either a path or an array of
+     * paths to KTX files, in order of preference.  This method returns the
+     * first container that exists, parses, and has one of the given formats.
+     * It returns nullptr if there is none, in which case the entry should
+     * fall back to its "file".
+     *
+     * This method does not use OpenGL, and so it is safe to call outside of
+     * the main thread.  The formats should come from {@link Texture#getCompressedFormats},
+     * queried in the main thread.
+     *
+     * @param json      The asset directory entry
+     * @param formats   The compressed formats supported by this device
+     *
+     * @return the first usable compressed container of a directory entry.
+     */
+    std::shared_ptr<TextureContainer> preloadCompressed(const std::shared_ptr<JsonValue>& json,
+                                                        const std::vector<GLenum>& formats);
+    
+    /**
+     * Returns a texture for the given image, loaded in the main thread.
+     *
+     * This is the synchronous counterpart of {@link preload} and {@link upload},
+     * so it also benefits from the asset cache.
+     *
+     * @param source        The pathname to the asset
+     * @param premultiply   Whether to premultiply the colors by alpha
+     *
+     * @return a texture for the given image (nullptr on failure)
+     */
+    std::shared_ptr<Texture> build(const std::string& source, bool premultiply);
+    
+    /**
+     * Uploads the next strip of the surface to the texture.
+     *
+     * The texture is created on the first call.  Each call uploads at most
+     * a fixed number of bytes, so that one large image cannot blow the frame
+     * budget.  This step is not safe to be done in a separate thread.  Instead,
+     * it takes place in the main CUGL thread via {@link Application#defer}.
+     *
+     * If the surface is nullptr (because it failed to load), the texture
+     * stays nullptr.
+     *
+     * @param state     The upload state
+     *
+     * @return true if there are more rows to upload
+     */
+    bool upload(Upload& state);
     
     /**
-     * Creates an OpenGL texture from the SDL_Surface, and assigns it the given key.
+     * Finishes an uploaded texture, and assigns it the given key.
      *
-     * This method finishes the asset loading started in {@link preload}.  This
-     * step is not safe to be done in a separate thread.  Instead, it takes
-     * place in the main CUGL thread via {@link Application#schedule}.
+     * This method finishes the asset loading started in {@link preload} and
+     * {@link upload}.  This step is not safe to be done in a separate thread.
+     * Instead, it takes place in the main CUGL thread via {@link Application#defer}.
      *
      * The loaded texture will have default parameters for scaling and wrap.
      * It will only have a mipmap if that is the default.
@@ -129,17 +244,17 @@ protected:
      * the asset was successfully materialized.
      *
      * @param key       The key to access the asset after loading
-     * @param surface   The SDL_Surface to convert
+     * @param texture   The uploaded texture (nullptr on failure)
      * @param callback  An optional callback for asynchronous loading
      */
-    void materialize(const std::string& key, SDL_Surface* surface, LoaderCallback callback);
+    void materialize(const std::string& key, const std::shared_ptr<Texture>& texture, LoaderCallback callback);
     
     /**
-     * Creates an OpenGL texture from the SDL_Surface accoring to the directory entry.
+     * Finishes an uploaded texture accoring to the directory entry.
      *
-     * This method finishes the asset loading started in {@link preload}.  This
-     * step is not safe to be done in a separate thread.  Instead, it takes
-     * place in the main CUGL thread via {@link Application#schedule}.
+     * This method finishes the asset loading started in {@link preload} and
+     * {@link upload}.  This step is not safe to be done in a separate thread.
+     * Instead, it takes place in the main CUGL thread via {@link Application#defer}.
      *
      * This version of read provides support for JSON directories. A texture
      * directory entry has the following values
@@ -159,11 +274,78 @@ protected:
      * the asset was successfully materialized.
      *
      * @param json      The asset directory entry
-     * @param surface   The SDL_Surface to convert
+     * @param texture   The uploaded texture (nullptr on failure)
      * @param callback  An optional callback for asynchronous loading
      */
-    void materialize(const std::shared_ptr<JsonValue>& json, SDL_Surface* surface, LoaderCallback callback);
+    void materialize(const std::shared_ptr<JsonValue>& json, const std::shared_ptr<Texture>& texture, LoaderCallback callback);
     
+#pragma mark Atlas Packing
+    /**
+     * Loads and packs the images of an atlas entry outside the main thread.
+     *
+     * A packed directory entry has a "pack" object in place of a "file". Each
+     * child of this object maps an asset key to the path of an image. All of
+     * the images are decoded and arranged into one or more pages of at most
+     * "maxsize" pixels per side (default 2048), separated by "padding" pixels
+     * (default 0). The padding is filled by extruding the image edges so that
+     * linear filtering does not bleed in neighboring images.
+     *
+     * The images vector is cleared and filled with the placement of each
+     * image.  If any image fails to load or does not fit in a page, this
+     * method returns an empty vector.
+     *
+     * @param json      The asset directory entry
+     * @param images    The vector to store the image placements
+     *
+     * @return the SDL_Surface for each atlas page
+     */
+    std::vector<SDL_Surface*> preloadPack(const std::shared_ptr<JsonValue>& json,
+                                          std::vector<PackedImage>& images);
+    
+    /**
+     * Uploads the next strip of the pages of a packed atlas.
+     *
+     * The pages are uploaded in order, one strip per call, with {@link upload}.
+     * Hence a large atlas is spread over several frames, exactly like a large
+     * image.  This step is not safe to be done in a separate thread.  Instead,
+     * it takes place in the main CUGL thread via {@link Application#defer}.
+     *
+     * If a page is larger than the OpenGL texture limit, or its texture cannot
+     * be created, this method stops and leaves that texture nullptr.
+     *
+     * @param key       The key of the atlas
+     * @param pages     The upload state for each atlas page
+     *
+     * @return true if there are more strips to upload
+     */
+    bool uploadPack(const std::string& key, const std::vector<std::shared_ptr<Upload>>& pages);
+    
+    /**
+     * Assigns the keys of a packed atlas once its pages are uploaded.
+     *
+     * This method finishes the asset loading started in {@link preloadPack}
+     * and {@link uploadPack}.  It is not safe to be done in a separate thread.
+     * Instead, it takes place in the main CUGL thread via {@link Application#defer}.
+     *
+     * The first page is assigned the key of the directory entry, and any
+     * later page n has the suffix _n.  Each packed image is then assigned its
+     * own key as a subtexture of its page.  Hence a packed image is accessed
+     * exactly as if it had been loaded on its own, but all images on the same
+     * page can be drawn by a {@link SpriteBatch} without a flush.
+     *
+     * This method supports an optional callback function which reports
+     * whether the asset was successfully materialized.
+     *
+     * @param json      The asset directory entry
+     * @param pages     The upload state for each atlas page
+     * @param images    The placement of each image in the pages
+     * @param callback  An optional callback for asynchronous loading
+     *
+     * @return true if the atlas was successfully materialized
+     */
+    bool materializePack(const std::shared_ptr<JsonValue>& json, const std::vector<std::shared_ptr<Upload>>& pages,
+                         const std::vector<PackedImage>& images, LoaderCallback callback);
+
 
     /**
      * Internal method to support asset loading.
@@ -208,6 +390,19 @@ protected:
      *      "magfilter":    The name of the min filter ("nearest" or "linear")
      *      "wrapS":        The s-coord wrap rule ("clamp", "repeat", or "mirrored")
      *      "wrapT":        The t-coord wrap rule ("clamp", "repeat", or "mirrored")
+     *      "premultiply":  Whether to premultiply the colors by alpha (bool)
+     *      "priority":     The main-thread priority of an asynchronous load (int)
+     *      "compressed":   A KTX path, or array of paths, to use before "file"
+     *
+     * A compressed container is only used if this device supports its format
+     * (see {@link preloadCompressed}).  Otherwise the entry falls back to the
+     * "file" image.  Containers carry their own mipmaps, and are not
+     * premultiplied at load time.
+     *
+     * Alternatively, the entry may specify a "pack" object (mapping asset keys
+     * to image paths) instead of a "file".  In that case the images are packed
+     * into a texture atlas at load time, with optional "maxsize" and "padding"
+     * values.  See {@link preloadPack} for details.
      *
      * @param json      The directory entry for the asset
      * @param callback  An optional callback for asynchronous loading
@@ -236,6 +431,32 @@ protected:
      */
     virtual bool purge(const std::shared_ptr<JsonValue>& json) override;
     
+    /**
+     * Returns the GPU memory used by the given texture in bytes.
+     *
+     * The regions of an atlas share the memory of their page, and so use
+     * no memory of their own.
+     *
+     * @param asset The texture to measure
+     *
+     * @return the GPU memory used by the given texture in bytes.
+     */
+    size_t footprint(const std::shared_ptr<Texture>& asset) const override {
+        return asset->getByteSize();
+    }
+    
+    /**
+     * Returns true if any of the given textures is referenced outside this loader.
+     *
+     * The regions of an atlas refer to their page.  Those references do not
+     * count if the regions are among the given textures.
+     *
+     * @param keys  The keys of the textures
+     *
+     * @return true if any of the given textures is referenced outside this loader.
+     */
+    bool inUse(const std::vector<std::string>& keys) const override;
+    
 public:
 #pragma mark -
 #pragma mark Constructors
@@ -259,7 +480,7 @@ public:
      * fail.  You must reinitialize the loader to begin loading assets again.
      */
     void dispose() override {
-        _assets.clear();
+        unloadAll();
         _loader = nullptr;
     }
     
@@ -405,6 +626,18 @@ public:
      */
     void setMipMaps(bool flag) { _mipmaps = flag; }
 
+    /**
+     * Adds the keys of the textures loaded for the given directory entry to keys.
+     *
+     * A packed atlas loads its pages and the regions of each packed image,
+     * while an atlas file loads its texture and each named region.  These
+     * textures are evicted and reloaded together.
+     *
+     * @param json  The directory entry for the texture
+     * @param keys  The list to append the keys to
+     */
+    void getMembers(const std::shared_ptr<JsonValue>& json, std::vector<std::string>& keys) const override;
+
 };
 
 }
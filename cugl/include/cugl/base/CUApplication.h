@@ -40,31 +40,28 @@
 #include <functional>
 #include <deque>
 #include <mutex>
+#include <atomic>
+#include <set>
 
 namespace cugl {
 
 /**
- * The storage type for all user-defined callbacks.
+ * The storage type for budgeted main-thread work.
  *
- * The application API provides a way for the user to attach one-time or 
- * reoccuring callback functions.  This to allow the user to schedule 
- * activity in a future animation frame without having to create a separate
- * thread.  This is particularly important for functionality that accesses
- * the OpenGL context (or any of the low-level SDL subsystems), as that must 
- * be done in the main thread.
+ * Deferred work is like a scheduled callback, except that the application
+ * only runs as much of it per frame as fits in the work budget.  This is
+ * used for expensive main-thread tasks, like uploading assets to the GPU,
+ * which would cause a hitch if they all landed in the same frame.
  *
- * To keep things simple, callbacks should never require arguments or
- * return a value.  If you wish to keep state, it should be done through
- * the appropriate closure.
+ * The work returns true if it has more to do, in which case it is called
+ * again (possibly in the same frame).  It returns false when it is done.
  */
 typedef struct {
-    /** The callback function */
-    std::function<bool()> callback;
-    /** The reoccurrence period (0 if called every frame) */
-    Uint32 period;
-    /** The countdown until the next reoccurrence */
-    Uint32 timer;
-} scheduable;
+    /** The work function */
+    std::function<bool()> work;
+    /** The priority of this work (larger runs first) */
+    int priority;
+} deferrable;
     
 /**
  * This class represents a basic CUGL application
@@ -181,24 +178,92 @@ private:
     /** The SDL timestamp for the end of an animation frame */
     Uint32 _finish;
     
+    /** The number of bits of time resolved by each level of the timer wheel */
+    static const int WHEEL_BITS = 6;
+    /** The number of buckets in each level of the timer wheel */
+    static const int WHEEL_SLOTS = 1 << WHEEL_BITS;
+    /** The number of levels of the timer wheel (about 4.6 hours in total) */
+    static const int WHEEL_LEVELS = 4;
+    /** A scheduled callback, or a request to cancel one (defined in the cpp) */
+    struct Timer;
+    
     /** Counter to assign unique keys to callbacks */
-    Uint32 _funcid;
+    std::atomic<Uint32> _funcid;
+    /** New callbacks and cancellations from any thread (a lock-free stack) */
+    std::atomic<Timer*> _inbox;
     
     /** Callback functions (processed at the start of every loop) */
-    std::unordered_map<Uint32, scheduable> _callbacks;
-	/** A mutex lock for the schedule queue */
+    std::unordered_map<Uint32, Timer*> _callbacks;
+    /** The buckets of the timer wheel, each a list of callbacks */
+    Timer* _wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+    /** The non-empty buckets of each level of the timer wheel */
+    Uint64 _occupied[WHEEL_LEVELS];
+    /** Callbacks too far in the future for the timer wheel */
+    Timer* _overflow;
+    /** The time of the timer wheel, in milliseconds since the first frame */
+    Uint64 _clock;
+	/** A mutex lock for the deferred work queue */
 	std::mutex _queueMutex;
+    
+    /** Counter to assign unique keys to deferred work */
+    Uint32 _deferid;
+    /** The time budget (in microseconds) for deferred work each frame */
+    Uint32 _deferBudget;
+    /** Deferred work (processed after the callbacks, under the budget) */
+    std::unordered_map<Uint32, deferrable> _deferred;
+    /** The deferred work in run order: negated priority, then identifier */
+    std::set<std::pair<int,Uint32>> _deferOrder;
     /**
      * Processes all of the scheduled callback functions.
      *
      * This method wakes up any sleeping callbacks that should be executed.
-     * If they are a one time callback, they are deleted.  If they are
-     * a reoccuring callback, the timer is reset.
+     * If they return false, they are deleted.  Otherwise the timer is reset.
+     * The callbacks are kept in a hierarchical timer wheel, so the cost of
+     * a frame depends on the number of callbacks that are due, not on the
+     * number that are scheduled.
      *
      * @param millis    The number of milliseconds since last called
      */
     void processCallbacks(Uint32 millis);
     
+    /**
+     * Adds a new callback or cancellation to the inbox.
+     *
+     * This method is lock-free and safe to call from any thread.  The
+     * inbox is emptied into the timer wheel at the start of each frame.
+     *
+     * @param timer The callback or cancellation
+     */
+    void post(Timer* timer);
+    
+    /**
+     * Adds a callback to the timer wheel, according to its deadline.
+     *
+     * @param timer The callback to add
+     */
+    void insert(Timer* timer);
+    
+    /**
+     * Removes a callback from its bucket of the timer wheel.
+     *
+     * @param timer The callback to remove
+     */
+    void remove(Timer* timer);
+    
+    /**
+     * Deletes all scheduled callbacks, including those still in the inbox.
+     */
+    void clearCallbacks();
+    
+    /**
+     * Processes deferred work until the frame budget is spent.
+     *
+     * Work runs in priority order, and work of equal priority runs in the
+     * order it was deferred.  At least one piece of work runs each frame,
+     * so that an undersized budget cannot stall the queue.
+     */
+    void processDeferred();
+    
 #pragma mark -
 #pragma mark Constructors
 public:
@@ -443,10 +508,72 @@ public:
      * appropriate schedule function.  Hence this value should be saved if
      * you ever wish to unschedule a callback.
      *
+     * This method is safe to call from any thread.  The callback is removed
+     * at the start of the next animation frame, before any callbacks run.
+     *
      * @param id    The callback identifier
      */
     void unschedule(Uint32 id);
 
+    /**
+     * Defers main-thread work to run under the per-frame work budget.
+     *
+     * Deferred work is executed after the scheduled callbacks, but only
+     * until the budget set by {@link setDeferBudget} is spent for that
+     * frame.  Whatever is left waits for the next frame.  Work with a
+     * larger priority runs first.
+     *
+     * The work function returns true if it has more to do, and false when
+     * it is done.  Long tasks (such as texture uploads) should be broken
+     * into pieces this way, so that the budget can stop them part way.
+     *
+     * This method is safe to call from any thread.  The work is guaranteed
+     * to be executed in the main thread.
+     *
+     * @param work      The work function
+     * @param priority  The work priority (larger runs first)
+     *
+     * @return a unique identifier for the deferred work
+     */
+    Uint32 defer(std::function<bool()> work, int priority=0);
+    
+    /**
+     * Changes the priority of deferred work that has not finished.
+     *
+     * This allows work that has become urgent (such as an asset that is
+     * needed on screen now) to jump the queue.
+     *
+     * @param id        The deferred work identifier
+     * @param priority  The new work priority (larger runs first)
+     *
+     * @return true if the work was still pending
+     */
+    bool prioritize(Uint32 id, int priority);
+    
+    /**
+     * Returns the number of pieces of deferred work that have not finished.
+     *
+     * @return the number of pieces of deferred work that have not finished.
+     */
+    size_t getDeferredCount();
+    
+    /**
+     * Returns the time budget for deferred work each frame, in microseconds.
+     *
+     * @return the time budget for deferred work each frame, in microseconds.
+     */
+    Uint32 getDeferBudget() const { return _deferBudget; }
+    
+    /**
+     * Sets the time budget for deferred work each frame, in microseconds.
+     *
+     * A piece of work is only started if the budget has not been spent,
+     * so a frame may exceed the budget by the length of one piece.
+     *
+     * @param micros    The time budget for deferred work each frame
+     */
+    void setDeferBudget(Uint32 micros) { _deferBudget = micros; }
+
     
 #pragma mark -
 #pragma mark Initialization Attributes
@@ -0,0 +1,321 @@
+//
+//  CUAssetPack.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides support for an asset pack.  A pack is a single file
+//  that holds every file of the asset directory, so that loading an asset
+//  does not have to open a file of its own.  This is much faster on Android,
+//  where each asset is a separate lookup in the APK.
+//
+//  The pack is mapped into memory when the platform allows it, and each entry
+//  is read through an SDL_RWops that points straight into the mapping.  The
+//  I/O classes and the asset loaders resolve asset paths through the pack,
+//  falling back to the asset directory if an asset is not in it.  Packs are
+//  built from the asset directory with the packassets.py tool.
+//
+//  This class uses our standard shared-pointer architecture.
+//
+//  1. The constructor does not perform any initialization; it just sets all
+//     attributes to their defaults.
+//
+//  2. All initialization takes place via init methods, which can fail if an
+//     object is initialized more than once.
+//
+//  3. All allocation takes place via static constructors which return a shared
+//     pointer.
+//
+//  CUGL zlib License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+#ifndef __CU_ASSET_PACK_H__
+#define __CU_ASSET_PACK_H__
+#include <cugl/base/CUBase.h>
+#include <SDL/SDL.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** The name of the pack in the asset directory */
+#define CU_ASSET_PACK   "assets.pack"
+
+namespace cugl {
+
+/**
+ * This class is a read-only archive of the files in the asset directory.
+ *
+ * A pack file has the following layout, with all values little-endian.
+ *
+ *      Header:     The magic "CUPK", the version, the number of entries and
+ *                  the size of the name table (4 bytes each)
+ *      Index:      40 bytes per entry, sorted by name
+ *      Names:      The entry names (UTF8, with '/' separators, no terminators)
+ *      Data:       The entry contents, each starting at a multiple of 16
+ *
+ * An index entry is the offset and length of its name in the name table
+ * (4 bytes each), followed by the offset of its data in the file, the stored
+ * size, the original size and a 64-bit BLAKE2b hash of the original contents
+ * (8 bytes each).  If the stored size is less than the original size, the
+ * entry is an LZ4 block (see {@link AssetCache#compress}).
+ *
+ * Where the platform supports it, the pack is mapped into memory and
+ * uncompressed entries are read in place.  This includes a pack inside an
+ * Android APK, provided the APK stores it uncompressed (the 'pack' entry of
+ * noCompress in build.gradle).  Otherwise, the pack is kept open and
+ * uncompressed entries are streamed from the file, so that large entries
+ * such as music are never copied into memory.  Either way, loading an asset
+ * only requires a search of the index, not a new file.
+ *
+ * Most code does not use a pack directly.  Instead, {@link openAsset} and
+ * {@link openFile} resolve asset paths through the pack in the asset
+ * directory, if there is one.  This class is thread safe.
+ */
+class AssetPack : public std::enable_shared_from_this<AssetPack> {
+public:
+    /**
+     * The location of an entry in the pack
+     */
+    typedef struct {
+        /** The offset of the entry data in the pack */
+        Uint64 offset;
+        /** The size of the entry in the pack */
+        Uint64 stored;
+        /** The size of the original file */
+        Uint64 size;
+        /** A hash of the original file (to detect changes) */
+        Uint64 hash;
+    } Entry;
+
+private:
+    /** The path to the pack file */
+    std::string _path;
+    /** The mapped pack file (nullptr if the pack is not mapped) */
+    Uint8* _mapping;
+    /** The size of the mapped pack file */
+    size_t _mapsize;
+    /** The bytes mapped before the pack (to align a pack inside an APK) */
+    size_t _mapskip;
+    /** The open pack file if it is not mapped */
+    SDL_RWops* _file;
+    /** A mutex for reading the pack file if it is not mapped */
+    mutable std::mutex _fileMutex;
+    /** The header, index and name table (a copy if the pack is not mapped) */
+    std::vector<Uint8> _header;
+    /** The start of the index (in the mapping or the header copy) */
+    const Uint8* _index;
+    /** The start of the name table (in the mapping or the header copy) */
+    const Uint8* _names;
+    /** The number of entries */
+    Uint32 _count;
+
+    /**
+     * Maps the given file into memory, returning true on success
+     *
+     * @param path  The file to map
+     *
+     * @return true if the file was mapped
+     */
+    bool map(const std::string& path);
+
+    /**
+     * Unmaps the pack file, if it is mapped
+     */
+    void unmap();
+
+    /**
+     * Returns true if the header, index and name table are valid
+     *
+     * This method also checks that every entry lies within the pack, so
+     * that later reads need no checks of their own.  On success, it sets
+     * the index and name table.
+     *
+     * @param header    The start of the pack (or a copy of its tables)
+     * @param size      The size of the pack file
+     *
+     * @return true if the header, index and name table are valid
+     */
+    bool validate(const Uint8* header, Uint64 size);
+
+    /**
+     * Returns the position of the given entry in the index, or -1 if missing
+     *
+     * @param name  The entry name
+     *
+     * @return the position of the given entry in the index, or -1 if missing
+     */
+    Sint64 search(const std::string& name) const;
+
+public:
+#pragma mark Constructors
+    /**
+     * Creates an unopened asset pack.
+     *
+     * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+     * the heap, use one of the static constructors instead.
+     */
+    AssetPack();
+
+    /**
+     * Deletes this asset pack, closing the file.
+     *
+     * Any stream opened by this pack keeps it alive until the stream closes.
+     */
+    ~AssetPack() { dispose(); }
+
+    /**
+     * Closes this asset pack, releasing all resources.
+     *
+     * You must reinitialize the pack to use it.
+     */
+    void dispose();
+
+    /**
+     * Initializes the asset pack in the given file.
+     *
+     * This method fails quietly (returning false) if the file does not
+     * exist, but logs an error if it is not a valid pack.
+     *
+     * @param path  The path to the pack file
+     *
+     * @return true if the pack was opened successfully
+     */
+    bool init(const std::string& path);
+
+    /**
+     * Returns a newly allocated asset pack for the given file.
+     *
+     * This method returns nullptr if the file does not exist or is not
+     * a valid pack.
+     *
+     * @param path  The path to the pack file
+     *
+     * @return a newly allocated asset pack for the given file.
+     */
+    static std::shared_ptr<AssetPack> alloc(const std::string& path) {
+        std::shared_ptr<AssetPack> result = std::make_shared<AssetPack>();
+        return (result->init(path) ? result : nullptr);
+    }
+
+#pragma mark Entries
+    /**
+     * Returns the number of entries in this pack.
+     *
+     * @return the number of entries in this pack.
+     */
+    size_t size() const { return _count; }
+
+    /**
+     * Returns true if this pack has an entry of the given name.
+     *
+     * @param name  The entry name, relative to the asset directory
+     *
+     * @return true if this pack has an entry of the given name.
+     */
+    bool contains(const std::string& name) const { return search(name) >= 0; }
+
+    /**
+     * Returns true if this pack has an entry of the given name, storing its location.
+     *
+     * @param name  The entry name, relative to the asset directory
+     * @param entry The entry to store the location
+     *
+     * @return true if this pack has an entry of the given name.
+     */
+    bool find(const std::string& name, Entry& entry) const;
+
+    /**
+     * Returns the name of the entry at the given position.
+     *
+     * The entries are sorted by name.
+     *
+     * @param pos   The entry position
+     *
+     * @return the name of the entry at the given position.
+     */
+    std::string getName(size_t pos) const;
+
+    /**
+     * Returns true if this pack is mapped into memory.
+     *
+     * If this is true, uncompressed entries are read without a copy.
+     *
+     * @return true if this pack is mapped into memory.
+     */
+    bool isMapped() const { return _mapping != nullptr; }
+
+    /**
+     * Returns a read-only stream for the given entry.
+     *
+     * The stream must be closed with SDL_RWclose.  If the entry is
+     * uncompressed, the stream reads the mapping in place, or the pack file
+     * if the pack is not mapped.  Otherwise, the entry is decompressed into
+     * a buffer owned by the stream.  This method returns nullptr if the entry
+     * does not exist.
+     *
+     * @param name  The entry name, relative to the asset directory
+     *
+     * @return a read-only stream for the given entry.
+     */
+    SDL_RWops* open(const std::string& name) const;
+
+#pragma mark Asset Resolution
+    /**
+     * Returns the pack in the asset directory, or nullptr if there is none.
+     *
+     * The pack is the file {@link CU_ASSET_PACK} in the asset directory.  It
+     * is opened on the first call, and stays open until the program exits.
+     *
+     * @return the pack in the asset directory, or nullptr if there is none.
+     */
+    static std::shared_ptr<AssetPack> get();
+
+    /**
+     * Returns a read-only stream for the given asset.
+     *
+     * The asset is taken from the pack in the asset directory if it is there,
+     * and otherwise from the asset directory itself.  This method returns
+     * nullptr if the asset does not exist.
+     *
+     * @param source    The asset path, relative to the asset directory
+     *
+     * @return a read-only stream for the given asset.
+     */
+    static SDL_RWops* openAsset(const std::string& source);
+
+    /**
+     * Returns a stream for the given file, resolving assets through the pack.
+     *
+     * This is a replacement for SDL_RWFromFile.  If the file is opened for
+     * reading and is in the asset directory, it is taken from the pack when
+     * the pack has it.  Otherwise, this is the same as SDL_RWFromFile.
+     *
+     * Pack entries are always binary, so "r" reads carriage returns on
+     * every platform.
+     *
+     * @param path  The full path to the file
+     * @param mode  The SDL_RWFromFile mode
+     *
+     * @return a stream for the given file (nullptr on failure)
+     */
+    static SDL_RWops* openFile(const std::string& path, const char* mode);
+};
+
+}
+
+#endif /* __CU_ASSET_PACK_H__ */
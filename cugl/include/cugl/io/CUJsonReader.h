@@ -66,6 +66,9 @@ namespace  cugl {
  * for the file name.  Keep in mind that absolute paths are very dangerous on
  * mobile devices, because they do not have proper file systems.  You should
  * confine all files to either the asset or the save directory.
+ *
+ * Files in the asset directory are read from the {@link AssetPack} there,
+ * if there is one and it has the file.
  */
 class JsonReader : public TextReader {
     
@@ -526,6 +526,18 @@ public:
      */
     bool deleteFile();
 
+    /**
+     * Flushes the file denoted by this pathname to storage.
+     *
+     * Closing a file only hands its contents to the operating system.  This
+     * method blocks until they are on the storage device, so that a file
+     * written and then renamed over another cannot turn up empty after a
+     * crash.
+     *
+     * @return true if the file was successfully flushed.
+     */
+    bool syncFile();
+
     /**
      * Creates the directory named by this pathname.
      *
@@ -565,7 +577,8 @@ public:
      * for this pathname will no longer exist. The file will now be referred
      * to via the provided pathname.
      *
-     * This method will fail if there is no file for this pathname.
+     * This method will fail if there is no file for this pathname.  If there
+     * is already a file at the new pathname, it is replaced (on every platform).
      *
      * @param path  The new pathname for this file.
      *
@@ -582,7 +595,8 @@ public:
      * for this pathname will no longer exist. The file will now be referred
      * to via the provided pathname.
      *
-     * This method will fail if there is no file for this pathname.
+     * This method will fail if there is no file for this pathname.  If there
+     * is already a file at the new pathname, it is replaced (on every platform).
      *
      * @param path  The new pathname for this file.
      *
@@ -599,7 +613,8 @@ public:
      * for this pathname will no longer exist. The file will now be referred
      * to via the provided pathname.
      *
-     * This method will fail if there is no file for this pathname.
+     * This method will fail if there is no file for this pathname.  If there
+     * is already a file at the new pathname, it is replaced (on every platform).
      *
      * @param dest  The new pathname for this file.
      *
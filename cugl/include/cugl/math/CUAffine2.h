@@ -823,6 +823,24 @@ public:
      */
     static Rect* transform(const Affine2& aff, const Rect& rect, Rect* dst);
     
+    /**
+     * Transforms an array of points in place by the given affine transform.
+     *
+     * Consecutive points start stride bytes apart, which allows this method
+     * to transform the positions inside of an array of vertices.  The default
+     * stride is a packed array of Vec2.
+     *
+     * This method is vectorized on platforms that support it, and is much
+     * faster than transforming each point individually.
+     *
+     * @param aff       The affine transform.
+     * @param points    The first point to transform.
+     * @param count     The number of points to transform.
+     * @param stride    The distance in bytes between consecutive points.
+     */
+    static void transformPoints(const Affine2& aff, Vec2* points, size_t count,
+                                size_t stride = sizeof(Vec2));
+    
     /**
      * Returns a copy of the given point transformed.
      *
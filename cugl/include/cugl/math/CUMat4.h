@@ -97,11 +97,6 @@ public:
         vFloat col[4];
         float  m[16];
     };
-#elif defined CU_MATH_VECTOR_SSE
-	__declspec(align(16)) union {
-        __m128 col[4];
-        float m[16];
-    };
 #else
     float m[16];
 #endif
@@ -1422,6 +1417,25 @@ public:
      */
     static Rect* transform(const Mat4& mat, const Rect& rect, Rect* dst);
     
+    /**
+     * Transforms an array of points in place by the given matrix.
+     *
+     * The points are treated as 2d points (z = 0, w = 1), so translation is
+     * applied.  Consecutive points start stride bytes apart, which allows
+     * this method to transform the positions inside of an array of vertices.
+     * The default stride is a packed array of Vec2.
+     *
+     * This method is vectorized on platforms that support it, and is much
+     * faster than transforming each point individually.
+     *
+     * @param mat       The transform matrix.
+     * @param points    The first point to transform.
+     * @param count     The number of points to transform.
+     * @param stride    The distance in bytes between consecutive points.
+     */
+    static void transformPoints(const Mat4& mat, Vec2* points, size_t count,
+                                size_t stride = sizeof(Vec2));
+    
     /**
      * Transforms the vector by the given matrix, and stores the result in dst.
      *
@@ -41,10 +41,20 @@
     #define CU_MATH_VECTOR_APPLE
 #elif defined (__IPHONE__)
     #define CU_MATH_VECTOR_IOS
-#elif defined (__SSE__)
-	// TODO: There is apparently an alignment error here
-	// I do not know enough SSE to debug this right now
-    // #define CU_MATH_VECTOR_SSE
+#elif defined (__SSE__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 1)
+    // Mat4 keeps a plain float layout and uses unaligned loads, as heap
+    // allocations on 32-bit Windows are only 8-byte aligned
+    #define CU_MATH_VECTOR_SSE
+#endif
+
+// Define the bulk kernel support (independent of the Mat4 layout above)
+#if defined (__AVX2__)
+    #define CU_MATH_KERNEL_AVX2
+#endif
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define CU_MATH_KERNEL_SSE2
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__)
+    #define CU_MATH_KERNEL_NEON
 #endif
 
 /**
@@ -86,4 +96,23 @@ inline GLubyte clampb(GLuint value, GLubyte min, GLubyte max) {
  */
 int nextPOT(int x);
 
+/**
+ * Applies a 2d affine transform to an array of points in place.
+ *
+ * The transform is the six values (a, b, c, d, tx, ty), so that each point
+ * (x,y) becomes (a*x+c*y+tx, b*x+d*y+ty).  A point is a pair of floats, and
+ * consecutive points start stride bytes apart.  Hence this can transform
+ * the positions of an array of vertices, as well as a plain Vec2 array.  A
+ * stride of 2*sizeof(float) is the fastest case.
+ *
+ * This function uses AVX2, SSE2 or NEON when the compiler supports them,
+ * and falls back to scalar code otherwise.
+ *
+ * @param affine    The six transform values
+ * @param points    The first point to transform
+ * @param count     The number of points
+ * @param stride    The distance in bytes between consecutive points
+ */
+void transformPoints2(const float* affine, void* points, size_t count, size_t stride);
+
 #endif /* CU_MATH_BASE_H */
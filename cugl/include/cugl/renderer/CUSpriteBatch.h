@@ -47,9 +47,12 @@
 #include <cugl/math/CUMathBase.h>
 #include <cugl/math/CUMat4.h>
 #include <cugl/renderer/CUVertex.h>
+#include <cugl/renderer/CUSpriteShader.h>
 #include <vector>
 
 #define DEFAULT_CAPACITY 8192
+/** The number of full meshes the streaming ring buffers hold before wrapping */
+#define STREAM_RING_FACTOR 4
 
 namespace cugl {
 
@@ -59,7 +62,154 @@ class Affine2;
 class Texture;
 class Rect;
 class Poly2;
+class SpriteBatch;
+
+/**
+ * This class is a mesh recorded by a sprite batch and retained on the GPU.
+ *
+ * A sprite mesh stores fully transformed and tinted geometry in static
+ * buffers, so that it can be drawn again without any per-vertex work on the
+ * CPU.  It is recorded with {@link SpriteBatch#beginRecording} and drawn with
+ * {@link SpriteBatch#draw(const std::shared_ptr<SpriteMesh>&)}.
+ *
+ * The geometry is grouped into runs that share a texture and blend state.
+ * While recording, a mesh joins the latest run with the same state unless a
+ * later run overlaps it.  This preserves the painter's order while drawing
+ * each texture with as few calls as possible.
+ */
+class SpriteMesh {
+#pragma mark Values
+private:
+    /** A range of indices drawn with the same texture and blend state */
+    class Run {
+    public:
+        /** The texture for this run */
+        std::shared_ptr<Texture> texture;
+        /** The drawing command (GL_TRIANGLES or GL_LINES) */
+        GLenum command;
+        /** The blend equation */
+        GLenum equation;
+        /** The source blend factor */
+        GLenum srcFactor;
+        /** The destination blend factor */
+        GLenum dstFactor;
+        /** The bounding box of the run geometry */
+        Rect bounds;
+        /** The run indices (only present while recording) */
+        std::vector<GLuint> indices;
+        /** The offset of the run in the index buffer */
+        GLsizei offset;
+        /** The number of indices in the run */
+        GLsizei count;
+    };
+    
+    /** The OpenGL vertex array object */
+    GLuint _vertArray;
+    /** The OpenGL vertex buffer object */
+    GLuint _vertBuffer;
+    /** The OpenGL index buffer object */
+    GLuint _indxBuffer;
+    
+    /** The recorded vertices (only present while recording) */
+    std::vector<Vertex2> _vertices;
+    /** The number of vertices in the vertex buffer */
+    unsigned int _vertSize;
+    /** The number of indices in the index buffer */
+    unsigned int _indxSize;
+    /** The runs of this mesh, in drawing order */
+    std::vector<Run> _runs;
+
+public:
+#pragma mark Constructors
+    /**
+     * Creates an empty mesh with no buffers.
+     *
+     * The buffers are only allocated when a mesh is first recorded.
+     */
+    SpriteMesh();
+    
+    /**
+     * Deletes this mesh, disposing all resources
+     */
+    ~SpriteMesh() { dispose(); }
+    
+    /**
+     * Deletes the buffers and empties this mesh.
+     */
+    void dispose();
+    
+    /**
+     * Returns a newly allocated empty mesh.
+     *
+     * @return a newly allocated empty mesh.
+     */
+    static std::shared_ptr<SpriteMesh> alloc() {
+        return std::make_shared<SpriteMesh>();
+    }
+    
+#pragma mark Attributes
+    /**
+     * Returns true if this mesh has nothing to draw.
+     *
+     * @return true if this mesh has nothing to draw.
+     */
+    bool isEmpty() const { return _runs.empty(); }
+    
+    /**
+     * Returns the number of vertices in this mesh.
+     *
+     * @return the number of vertices in this mesh.
+     */
+    unsigned int getVertexCount() const { return _vertSize; }
+    
+    /**
+     * Returns the number of draw calls needed for this mesh.
+     *
+     * @return the number of draw calls needed for this mesh.
+     */
+    size_t getRunCount() const { return _runs.size(); }
+    
+private:
+#pragma mark Internal Helpers
+    /**
+     * Removes all geometry so that the mesh may be recorded again.
+     *
+     * The buffers are kept so they can be reused.
+     */
+    void clear();
     
+    /**
+     * Appends the given geometry to this mesh.
+     *
+     * The geometry is added to a run with the given state.  The indices are
+     * relative to the given vertices.
+     *
+     * @param vertices  The vertices to add
+     * @param vsize     The number of vertices to add
+     * @param indices   The indices to add
+     * @param isize     The number of indices to add
+     * @param texture   The texture of the geometry
+     * @param command   The drawing command
+     * @param equation  The blend equation
+     * @param srcFactor The source blend factor
+     * @param dstFactor The destination blend factor
+     */
+    void append(const Vertex2* vertices, unsigned int vsize, const GLuint* indices, unsigned int isize,
+                const std::shared_ptr<Texture>& texture, GLenum command,
+                GLenum equation, GLenum srcFactor, GLenum dstFactor);
+    
+    /**
+     * Uploads the recorded geometry to the GPU.
+     *
+     * The CPU copy of the geometry is discarded afterwards.
+     *
+     * @return true if the upload was successful.
+     */
+    bool upload();
+    
+    friend class SpriteBatch;
+};
+
 /**
  * This class is a sprite batch for drawing 2d graphics.
  *
@@ -78,6 +228,19 @@ class Poly2;
 class SpriteBatch {
 #pragma mark Values
 private:
+    /** A render target redirecting drawing, with the state it replaced */
+    class Target {
+    public:
+        /** The texture drawn into */
+        std::shared_ptr<Texture> texture;
+        /** The perspective before the target was pushed */
+        Mat4 perspective;
+        /** The framebuffer before the target was pushed */
+        GLint framebuffer;
+        /** The viewport before the target was pushed */
+        GLint viewport[4];
+    };
+    
     /** The shader for this sprite batch */
     std::shared_ptr<SpriteShader> _shader;
     /** The vertex capacity of the mesh */
@@ -89,6 +252,10 @@ private:
     GLuint _vertBuffer;
     /** The OpenGL index buffer object */
     GLuint _indxBuffer;
+    /** The OpenGL vertex array object for sprite instances */
+    GLuint _instArray;
+    /** The OpenGL buffer object for sprite instances */
+    GLuint _instBuffer;
     
     /** The sprite batch vertex mesh */
     Vertex2* _vertData;
@@ -105,6 +272,64 @@ private:
     /** The number of indices in the current mesh */
     unsigned int _indxSize;
 
+    /** Whether flushes stream into ring buffers (otherwise each flush reallocates) */
+    bool _streaming;
+    /** The size of the vertex ring buffer in bytes */
+    GLsizeiptr _vertRingSize;
+    /** The next free byte of the vertex ring buffer */
+    GLsizeiptr _vertRingHead;
+    /** The size of the index ring buffer in bytes */
+    GLsizeiptr _indxRingSize;
+    /** The next free byte of the index ring buffer */
+    GLsizeiptr _indxRingHead;
+    
+    /** Whether vertices are uploaded in the packed layout (PackedVertex2) */
+    bool _packed;
+    /** Whether indices are uploaded as 16-bit (possible for small capacities) */
+    bool _shortIndices;
+    /** Staging memory for converted data when the buffers cannot be mapped */
+    std::vector<GLubyte> _staging;
+    
+    /** The pending sprite instances */
+    SpriteInstance* _instData;
+    /** The maximum number of pending sprite instances */
+    unsigned int _instMax;
+    /** The number of pending sprite instances */
+    unsigned int _instSize;
+    /** Whether rectangles are drawn as sprite instances (if the shader allows) */
+    bool _instancing;
+    /** The size of the instance ring buffer in bytes */
+    GLsizeiptr _instRingSize;
+    /** The next free byte of the instance ring buffer */
+    GLsizeiptr _instRingHead;
+    
+    /** Whether texture changes pick a texture slot instead of flushing */
+    bool _multiTexture;
+    /** The number of texture slots available (at most MAX_TEXTURE_SLOTS) */
+    unsigned int _slotMax;
+    /** The number of texture slots bound in this pass */
+    unsigned int _slotCount;
+    /** The textures bound to each slot */
+    std::shared_ptr<Texture> _slotTextures[MAX_TEXTURE_SLOTS];
+    /** The slot of the active texture */
+    GLfloat _slot;
+    /** The texture slot of each vertex in the current mesh */
+    GLfloat* _slotData;
+    /** The OpenGL buffer object for vertex texture slots */
+    GLuint _slotBuffer;
+    /** The size of the slot ring buffer in bytes */
+    GLsizeiptr _slotRingSize;
+    
+    /** The mesh being recorded (or nullptr if not recording) */
+    std::shared_ptr<SpriteMesh> _recording;
+    /** Whether instancing was enabled when recording began */
+    bool _recordInstancing;
+    /** Whether texture slots were in use when recording began */
+    bool _recordSlots;
+    
+    /** The stack of active render targets (innermost last) */
+    std::vector<Target> _targets;
+
     /** The active texture */
     std::shared_ptr<Texture> _texture;
     /** The active color */
@@ -125,6 +350,10 @@ private:
     unsigned int _vertTotal;
     /** The number of OpenGL calls in this pass (so far) */
     unsigned int _callTotal;
+    /** The number of bytes uploaded to the GPU in this pass (so far) */
+    size_t _uploadTotal;
+    /** The number of times the ring buffers wrapped in this pass (so far) */
+    unsigned int _wrapTotal;
     
     /** Whether this sprite batch has been initialized yet */
     bool _initialized;
@@ -306,6 +535,141 @@ public:
      */
     unsigned int getCallsMade() const { return _callTotal; }
 
+    /**
+     * Returns the number of bytes uploaded to the GPU in the latest pass (so far).
+     *
+     * This includes both vertex and index data. This value will be reset to 0
+     * whenever begin() is called.
+     *
+     * @return the number of bytes uploaded in the latest pass (so far).
+     */
+    size_t getBytesUploaded() const { return _uploadTotal; }
+
+    /**
+     * Returns the number of times the ring buffers wrapped in the latest pass (so far).
+     *
+     * Each wrap orphans the ring buffers. If this is regularly more than 0, the
+     * capacity (and hence the ring size) is too small for the scene. This value
+     * will be reset to 0 whenever begin() is called.
+     *
+     * @return the number of ring buffer wraps in the latest pass (so far).
+     */
+    unsigned int getBufferWraps() const { return _wrapTotal; }
+
+    /**
+     * Returns true if this sprite batch streams its meshes into ring buffers.
+     *
+     * When streaming, each flush writes into the next free region of a ring
+     * buffer (STREAM_RING_FACTOR times the capacity) with an unsynchronized
+     * map. When the ring is full, the storage is orphaned, so the CPU never
+     * writes to a region the GPU may still be reading. Otherwise, each flush
+     * reallocates the buffers with glBufferData.
+     *
+     * @return true if this sprite batch streams its meshes into ring buffers.
+     */
+    bool isStreaming() const { return _streaming; }
+
+    /**
+     * Sets whether this sprite batch streams its meshes into ring buffers.
+     *
+     * This value may NOT be changed during a drawing pass.
+     *
+     * @param value Whether this sprite batch streams its meshes into ring buffers.
+     */
+    void setStreaming(bool value);
+
+    /**
+     * Returns true if this sprite batch uploads vertices in the packed layout.
+     *
+     * The packed layout ({@link PackedVertex2}) stores texture coordinates as
+     * normalized 16-bit integers, so each vertex is 16 bytes instead of 20.
+     * Texture coordinates are clamped to [0,1], so this should not be used
+     * with repeating textures.
+     *
+     * @return true if this sprite batch uploads vertices in the packed layout.
+     */
+    bool isPacked() const { return _packed; }
+
+    /**
+     * Sets whether this sprite batch uploads vertices in the packed layout.
+     *
+     * The packed layout ({@link PackedVertex2}) stores texture coordinates as
+     * normalized 16-bit integers, so each vertex is 16 bytes instead of 20.
+     * Texture coordinates are clamped to [0,1], so this should not be used
+     * with repeating textures.
+     *
+     * This value may NOT be changed during a drawing pass.
+     *
+     * @param value Whether this sprite batch uploads vertices in the packed layout.
+     */
+    void setPacked(bool value);
+
+    /**
+     * Returns true if this sprite batch uploads indices as 16-bit integers.
+     *
+     * This is chosen automatically at initialization, and is true whenever
+     * every vertex in the ring buffer can be addressed by an unsigned short.
+     *
+     * @return true if this sprite batch uploads indices as 16-bit integers.
+     */
+    bool usesShortIndices() const { return _shortIndices; }
+
+    /**
+     * Returns true if this sprite batch draws rectangles as sprite instances.
+     *
+     * When instancing, a rectangular textured mesh sent to fill() is recorded
+     * as a single {@link SpriteInstance} (one small struct) instead of four
+     * transformed vertices and six indices.  The quads are expanded in the
+     * vertex shader with glDrawArraysInstanced.  This only takes effect if
+     * the shader supports instancing (the default shader does).
+     *
+     * @return true if this sprite batch draws rectangles as sprite instances.
+     */
+    bool isInstancing() const { return _instancing; }
+
+    /**
+     * Sets whether this sprite batch draws rectangles as sprite instances.
+     *
+     * When instancing, a rectangular textured mesh sent to fill() is recorded
+     * as a single {@link SpriteInstance} (one small struct) instead of four
+     * transformed vertices and six indices.  The quads are expanded in the
+     * vertex shader with glDrawArraysInstanced.  This only takes effect if
+     * the shader supports instancing (the default shader does).
+     *
+     * Changing this value will cause the sprite batch to flush.
+     *
+     * @param value Whether this sprite batch draws rectangles as sprite instances.
+     */
+    void setInstancing(bool value);
+
+    /**
+     * Returns true if this sprite batch binds several textures at once.
+     *
+     * In multi-texture mode, the sprite batch binds up to MAX_TEXTURE_SLOTS
+     * textures (fewer if the GPU has fewer units) and tags each vertex with
+     * the slot of its texture.  Changing the texture only flushes when all
+     * slots are in use.  This only takes effect if the shader supports
+     * texture slots (the default shader does).
+     *
+     * @return true if this sprite batch binds several textures at once.
+     */
+    bool isMultiTexture() const { return _multiTexture; }
+
+    /**
+     * Sets whether this sprite batch binds several textures at once.
+     *
+     * In multi-texture mode, the sprite batch binds up to MAX_TEXTURE_SLOTS
+     * textures (fewer if the GPU has fewer units) and tags each vertex with
+     * the slot of its texture.  Changing the texture only flushes when all
+     * slots are in use.  This only takes effect if the shader supports
+     * texture slots (the default shader does).
+     *
+     * This value may NOT be changed during a drawing pass.
+     *
+     * @param value Whether this sprite batch binds several textures at once.
+     */
+    void setMultiTexture(bool value);
+
     /**
      * Sets the shader for this sprite batch
      *
@@ -444,7 +808,7 @@ public:
      *
      * @return the destination blending factor
      */
-    GLenum getDestinationBlendFactor() const { return _srcFactor; }
+    GLenum getDestinationBlendFactor() const { return _dstFactor; }
     
     /**
      * Sets the blending equation for this sprite batch
@@ -473,6 +837,20 @@ public:
      */
     GLenum getBlendEquation() const { return _blendEquation; }
     
+    /**
+     * Sets the standard alpha blending for textures of the given kind.
+     *
+     * Straight-alpha textures blend with (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA),
+     * which is the default.  Premultiplied textures (see
+     * {@link Texture#isPremultiplied}) blend with (GL_ONE, GL_ONE_MINUS_SRC_ALPHA).
+     * In the latter case, the color of this sprite batch must also be
+     * premultiplied (see {@link Color4#getPremultiplied}).  Both presets use
+     * the blend equation GL_FUNC_ADD.
+     *
+     * @param premultiplied Whether to blend premultiplied colors
+     */
+    void setAlphaBlend(bool premultiplied);
+    
 #pragma mark -
 #pragma mark Rendering
     /**
@@ -516,6 +894,88 @@ public:
      */
     void flush();
 
+#pragma mark -
+#pragma mark Retained Meshes
+    /**
+     * Returns true if this sprite batch is recording into a mesh.
+     *
+     * @return true if this sprite batch is recording into a mesh.
+     */
+    bool isRecording() const { return _recording != nullptr; }
+    
+    /**
+     * Starts recording all subsequent drawing into the given mesh.
+     *
+     * Until {@link endRecording()} is called, shapes are added to the mesh
+     * instead of being drawn.  They are transformed and tinted exactly as
+     * they would be when drawn.  Any previous contents of the mesh are
+     * discarded.
+     *
+     * Sprite instances and texture slots are disabled while recording, as
+     * a mesh only stores plain vertices.  This method may only be called
+     * during a drawing pass, and recordings may not be nested.
+     *
+     * @param mesh  The mesh to record into
+     */
+    void beginRecording(const std::shared_ptr<SpriteMesh>& mesh);
+    
+    /**
+     * Completes the current recording, uploading the mesh to the GPU.
+     *
+     * Nothing is drawn.  Use {@link draw(const std::shared_ptr<SpriteMesh>&)}
+     * to draw the mesh.
+     */
+    void endRecording();
+    
+    /**
+     * Draws a previously recorded mesh.
+     *
+     * The mesh is drawn with one call per run, using the current perspective.
+     * The color, texture and blend state of this sprite batch are ignored, as
+     * they were baked in when the mesh was recorded.  They are restored
+     * afterwards.  This method flushes any pending shapes first.
+     *
+     * @param mesh  The mesh to draw
+     */
+    void draw(const std::shared_ptr<SpriteMesh>& mesh);
+
+#pragma mark -
+#pragma mark Render Targets
+    /**
+     * Returns true if this sprite batch is drawing into a texture.
+     *
+     * @return true if this sprite batch is drawing into a texture.
+     */
+    bool isTargeting() const { return !_targets.empty(); }
+    
+    /**
+     * Redirects all subsequent drawing into the given texture.
+     *
+     * The texture must have a framebuffer (see {@link Texture#initWithFramebuffer}).
+     * It is cleared to transparent, and the region bounds is mapped onto
+     * the whole texture, with the top of the region at texture coordinate
+     * 0.  Hence a rectangle filled with the texture reproduces the region.
+     *
+     * The alpha channel accumulates coverage while drawing into a target,
+     * so the texture holds premultiplied colors.  Draw it with the blend
+     * function GL_ONE, GL_ONE_MINUS_SRC_ALPHA.
+     *
+     * This method flushes any pending shapes first.  It may only be called
+     * during a drawing pass, but not while recording.  Targets may be nested.
+     *
+     * @param target    The texture to draw into
+     * @param bounds    The region to draw, in the current drawing coordinates
+     */
+    void beginTarget(const std::shared_ptr<Texture>& target, const Rect& bounds);
+    
+    /**
+     * Stops drawing into the texture given to the last {@link beginTarget}.
+     *
+     * The previous framebuffer, viewport and perspective are restored.
+     * This method flushes any pending shapes first.
+     */
+    void endTarget();
+
 #pragma mark -
 #pragma mark Solid Shapes
     /**
@@ -806,6 +1266,10 @@ public:
      * The vertices use their own color values.  However, if tint is true, these
      * values will be tinted (i.e. multiplied) by the current active color.
      *
+     * If the mesh is an axis-aligned textured rectangle (four vertices and
+     * six indices) and instancing is enabled, it is drawn as a single
+     * {@link SpriteInstance} instead of being transformed on the CPU.
+     *
      * @param vertices  The array of vertices
      * @param vsize     The size of the vertex array
      * @param voffset   The first element of the vertex array
@@ -834,6 +1298,10 @@ public:
      * The vertices use their own color values.  However, if tint is true, these
      * values will be tinted (i.e. multiplied) by the current active color.
      *
+     * If the mesh is an axis-aligned textured rectangle (four vertices and
+     * six indices) and instancing is enabled, it is drawn as a single
+     * {@link SpriteInstance} instead of being transformed on the CPU.
+     *
      * @param vertices  The array of vertices
      * @param vsize     The size of the vertex array
      * @param voffset   The first element of the vertex array
@@ -1828,6 +2296,17 @@ public:
 #pragma mark -
 #pragma mark Internal Helpers
 private:
+    /**
+     * Applies the given blend factors to OpenGL.
+     *
+     * While drawing into a render target, the alpha channel is blended
+     * separately so that the target accumulates coverage.
+     *
+     * @param srcFactor The source blending factor
+     * @param dstFactor The destination blending factor
+     */
+    void applyBlendFunc(GLenum srcFactor, GLenum dstFactor);
+    
     /**
      * Sets the current drawing command.
      *
@@ -1886,6 +2365,34 @@ private:
      */
     unsigned int prepare(const Poly2& poly, bool solid);
 
+    /**
+     * Returns true if the mesh was added to the buffer as a sprite instance.
+     *
+     * The mesh must be four vertices forming an axis-aligned rectangle whose
+     * texture coordinates vary along its axes, with a single color.  The
+     * transform is given as the images of the x and y axes and the origin.
+     * If the mesh does not qualify (or instancing is disabled), nothing is
+     * added and this method returns false.
+     *
+     * @param vertices  The four vertices of the rectangle
+     * @param xaxis     The image of the x-axis under the transform
+     * @param yaxis     The image of the y-axis under the transform
+     * @param offset    The image of the origin under the transform
+     * @param tint      Whether to tint with the active color
+     *
+     * @return true if the mesh was added to the buffer as a sprite instance.
+     */
+    bool prepareInstance(const Vertex2* vertices, const Vec2& xaxis, const Vec2& yaxis,
+                         const Vec2& offset, bool tint);
+
+    /**
+     * Draws the pending sprite instances.
+     *
+     * This is the instance counterpart of flush().  Pending meshes and pending
+     * instances are never present at the same time.
+     */
+    void flushInstances();
+
     /**
      * Returns the number of vertices added to the drawing buffer.
      *
@@ -46,6 +46,9 @@
 #include <cugl/renderer/CUTexture.h>
 #include <cugl/math/CUMat4.h>
 
+/** The number of texture slots the default shader can sample in one draw */
+#define MAX_TEXTURE_SLOTS 8
+
 namespace cugl {
 
 /**
@@ -68,6 +71,17 @@ namespace cugl {
  *      uPerspective:   The perspective matrix (combined modelview projection)
  *
  *      uTexture:       The shading texture
+ *
+ * A shader may optionally support instanced quads (see {@link SpriteInstance}).
+ * To do so, it must provide the attributes aAxes, aOrigin, aTexRect and aTint
+ * and the uniform uInstanced.  When uInstanced is true, the shader expands
+ * each instance into a four vertex triangle strip.  Shaders without these
+ * variables are still valid; the sprite batch just draws quads as meshes.
+ *
+ * Similarly, a shader may optionally support multi-texture batching.  To do
+ * so, it must provide the attribute aSlot (the texture slot of each vertex)
+ * and the uniform array uSlotTextures, holding the samplers for slots 1 to
+ * MAX_TEXTURE_SLOTS-1.  Slot 0 is always uTexture.
  * 
  * Any other attributes or uniforms will be ignored.
  */
@@ -84,6 +98,23 @@ private:
     GLint _uPerspective;
     /** The shader location for the texture uniform */
     GLint _uTexture;
+    
+    /** The shader location for the instance axes attribute (-1 if unsupported) */
+    GLint _aAxes;
+    /** The shader location for the instance origin attribute (-1 if unsupported) */
+    GLint _aOrigin;
+    /** The shader location for the instance texture rectangle attribute (-1 if unsupported) */
+    GLint _aTexRect;
+    /** The shader location for the instance tint attribute (-1 if unsupported) */
+    GLint _aTint;
+    /** The shader location for the instancing uniform (-1 if unsupported) */
+    GLint _uInstanced;
+    /** Whether the shader is currently drawing instances */
+    bool  _mInstanced;
+    /** The shader location for the texture slot attribute (-1 if unsupported) */
+    GLint _aSlot;
+    /** The shader location for the slot texture uniforms (-1 if unsupported) */
+    GLint _uSlotTextures;
 
     /** The current perspective matrix */
     Mat4  _mPerspective;
@@ -100,7 +131,10 @@ public:
      * You must initialize the shader to add a source and compiled it.
      */
     SpriteShader() : Shader(), _aPosition(-1), _aColor(-1), _aTexCoord(-1),
-                               _uPerspective(-1), _uTexture(-1) { }
+                               _uPerspective(-1), _uTexture(-1),
+                               _aAxes(-1), _aOrigin(-1), _aTexRect(-1), _aTint(-1),
+                               _uInstanced(-1), _mInstanced(false),
+                               _aSlot(-1), _uSlotTextures(-1) { }
 
     /**
      * Deletes this shader, disposing all resources.
@@ -258,6 +292,58 @@ public:
      */
     GLint getTextureUni() const { return _uTexture; }
     
+    /**
+     * Returns true if this shader can draw instanced quads.
+     *
+     * This is the case if the shader source declares all of the instance
+     * attributes and the uInstanced uniform.
+     *
+     * @return true if this shader can draw instanced quads.
+     */
+    bool supportsInstancing() const {
+        return _aAxes != -1 && _aOrigin != -1 && _aTexRect != -1 && _aTint != -1 && _uInstanced != -1;
+    }
+    
+    /**
+     * Returns true if this shader can sample from several texture slots at once.
+     *
+     * This is the case if the shader source declares the aSlot attribute and
+     * the uSlotTextures uniform array.
+     *
+     * @return true if this shader can sample from several texture slots at once.
+     */
+    bool supportsTextureSlots() const {
+        return _aSlot != -1 && _uSlotTextures != -1;
+    }
+    
+    /**
+     * Binds the texture to the given slot.
+     *
+     * Slot 0 is the texture set by {@link setTexture}.  Other slots are only
+     * sampled by vertices whose slot attribute selects them.  Slot textures
+     * are not retained between drawing passes.
+     *
+     * @param slot      The texture slot (1 to MAX_TEXTURE_SLOTS-1)
+     * @param texture   The texture to bind
+     */
+    void setSlotTexture(unsigned int slot, const std::shared_ptr<Texture>& texture);
+    
+    /**
+     * Returns true if this shader is currently drawing instanced quads.
+     *
+     * @return true if this shader is currently drawing instanced quads.
+     */
+    bool isInstanced() const { return _mInstanced; }
+    
+    /**
+     * Sets whether this shader is drawing instanced quads.
+     *
+     * This has no effect if the shader does not support instancing.
+     *
+     * @param value Whether this shader is drawing instanced quads.
+     */
+    void setInstanced(bool value);
+    
     /**
      * Sets the perspective matrix to use in the shader.
      *
@@ -301,10 +387,43 @@ public:
      * Because of limitations in OpenGL ES, we cannot draw anything without
      * both a vertex buffer object and an vertex array object.
      *
+     * The buffer is laid out as {@link Vertex2} unless packed is true, in
+     * which case it is laid out as {@link PackedVertex2}.
+     *
      * @param vArray    The vertex array object
      * @param vBuffer   The vertex buffer object
+     * @param packed    Whether the buffer uses the packed vertex layout
+     */
+    void attach(GLuint vArray, GLuint vBuffer, bool packed=false);
+    
+    /**
+     * Attaches the given instance buffer to this shader.
+     *
+     * The buffer is laid out as {@link SpriteInstance}, with one element per
+     * drawn quad starting at the given byte offset.  The instance attributes
+     * advance once per instance.  The per-vertex attributes are disabled on
+     * this vertex array, as the shader expands each quad itself.  This method
+     * should only be called if {@link supportsInstancing()} is true.
+     *
+     * @param vArray    The vertex array object for instances
+     * @param iBuffer   The instance buffer object
+     * @param offset    The byte offset of the first instance
+     */
+    void attachInstances(GLuint vArray, GLuint iBuffer, GLintptr offset=0);
+    
+    /**
+     * Attaches the given texture slot buffer to this shader.
+     *
+     * The buffer holds one GLfloat slot per vertex, parallel to the vertex
+     * buffer.  If enable is false, the slot attribute is disabled and every
+     * vertex samples slot 0.  This has no effect if the shader does not
+     * support texture slots.
+     *
+     * @param vArray    The vertex array object
+     * @param sBuffer   The slot buffer object
+     * @param enable    Whether to read slots from the buffer
      */
-    void attach(GLuint vArray, GLuint vBuffer);
+    void attachSlots(GLuint vArray, GLuint sBuffer, bool enable);
 
     /**
      * Binds this shader, making it active.
@@ -11,9 +11,189 @@
 
 #include <cugl/math/CUMathBase.h>
 #include <cugl/math/CUSize.h>
+#include <vector>
 
 namespace cugl {
 
+/**
+ * This class is a GPU-compressed image loaded from a KTX container.
+ *
+ * A KTX (version 1) file stores an image in the format that the GPU samples
+ * directly, such as ETC2 or ASTC, together with its full mipmap chain.
+ * These textures are uploaded as is with glCompressedTexImage2D, so there is
+ * no decoding at load time, and they use a fraction of the memory of RGBA.
+ *
+ * This class only parses the container; it never uses OpenGL.  Hence it is
+ * safe to load in any thread, and can be tested without a GPU.  Use
+ * {@link Texture#initWithContainer} to create a texture from it.  Only 2D
+ * compressed images are supported (no arrays, cubemaps or 3D textures).
+ */
+class TextureContainer {
+public:
+    /**
+     * This class is the location of one mipmap level in the container data.
+     */
+    class Level {
+    public:
+        /** The level width in pixels */
+        unsigned int width;
+        /** The level height in pixels */
+        unsigned int height;
+        /** The offset of the level image in the container data */
+        size_t offset;
+        /** The size of the level image in bytes */
+        size_t size;
+    };
+    
+private:
+    /** The container file contents */
+    std::vector<Uint8> _data;
+    /** The compressed internal format (e.g. GL_COMPRESSED_RGBA8_ETC2_EAC) */
+    GLenum _format;
+    /** The mipmap levels, from largest to smallest */
+    std::vector<Level> _levels;
+    
+    /**
+     * Parses the contents of _data, returning true if it is a valid container.
+     *
+     * @return true if _data is a valid container.
+     */
+    bool parse();
+    
+public:
+#pragma mark Constructors
+    /**
+     * Creates an empty container.
+     *
+     * You must call an init method to load the container data.
+     */
+    TextureContainer() : _format(0) {}
+    
+    /**
+     * Deletes this container, releasing all resources.
+     */
+    ~TextureContainer() { dispose(); }
+    
+    /**
+     * Releases the container data.
+     *
+     * You must reinitialize the container to use it.
+     */
+    void dispose();
+    
+    /**
+     * Initializes a container from a copy of the given KTX data.
+     *
+     * @param data  The KTX file contents
+     * @param size  The size of the data in bytes
+     *
+     * @return true if the data is a valid compressed KTX container.
+     */
+    bool initWithData(const void* data, size_t size);
+    
+    /**
+     * Initializes a container from the given KTX file.
+     *
+     * This method fails quietly if the file does not exist, as a missing
+     * container normally means the image should be loaded some other way.
+     * Files in the asset directory are read through the {@link AssetPack},
+     * if there is one.
+     *
+     * @param filename  The path to the KTX file
+     *
+     * @return true if the file is a valid compressed KTX container.
+     */
+    bool initWithFile(const std::string& filename);
+    
+    /**
+     * Returns a new container from a copy of the given KTX data.
+     *
+     * @param data  The KTX file contents
+     * @param size  The size of the data in bytes
+     *
+     * @return a new container from a copy of the given KTX data.
+     */
+    static std::shared_ptr<TextureContainer> allocWithData(const void* data, size_t size) {
+        std::shared_ptr<TextureContainer> result = std::make_shared<TextureContainer>();
+        return (result->initWithData(data,size) ? result : nullptr);
+    }
+    
+    /**
+     * Returns a new container from the given KTX file.
+     *
+     * This method fails quietly if the file does not exist, as a missing
+     * container normally means the image should be loaded some other way.
+     *
+     * @param filename  The path to the KTX file
+     *
+     * @return a new container from the given KTX file.
+     */
+    static std::shared_ptr<TextureContainer> allocWithFile(const std::string& filename) {
+        std::shared_ptr<TextureContainer> result = std::make_shared<TextureContainer>();
+        return (result->initWithFile(filename) ? result : nullptr);
+    }
+    
+#pragma mark Attributes
+    /**
+     * Returns the compressed internal format of this container.
+     *
+     * @return the compressed internal format of this container.
+     */
+    GLenum getFormat() const { return _format; }
+    
+    /**
+     * Returns the width of the largest level in pixels.
+     *
+     * @return the width of the largest level in pixels.
+     */
+    unsigned int getWidth() const { return _levels.empty() ? 0 : _levels[0].width; }
+    
+    /**
+     * Returns the height of the largest level in pixels.
+     *
+     * @return the height of the largest level in pixels.
+     */
+    unsigned int getHeight() const { return _levels.empty() ? 0 : _levels[0].height; }
+    
+    /**
+     * Returns the number of mipmap levels in this container.
+     *
+     * @return the number of mipmap levels in this container.
+     */
+    size_t getLevelCount() const { return _levels.size(); }
+    
+    /**
+     * Returns the given mipmap level, where level 0 is the largest.
+     *
+     * @param level The mipmap level
+     *
+     * @return the given mipmap level, where level 0 is the largest.
+     */
+    const Level& getLevel(size_t level) const { return _levels[level]; }
+    
+    /**
+     * Returns the compressed image data for the given mipmap level.
+     *
+     * @param level The mipmap level
+     *
+     * @return the compressed image data for the given mipmap level.
+     */
+    const Uint8* getLevelData(size_t level) const { return _data.data()+_levels[level].offset; }
+    
+    /**
+     * Returns the largest mipmap level that fits in the given size.
+     *
+     * This is the first level whose width and height are both at most
+     * maxsize.  If no level is that small, it is the last level.  A maxsize
+     * of 0 means there is no limit, and so it is always level 0.
+     *
+     * @param maxsize   The maximum width and height
+     *
+     * @return the largest mipmap level that fits in the given size.
+     */
+    size_t selectLevel(unsigned int maxsize) const;
+};
+
 /**
  * This is a class representing an OpenGL texture.
  *
@@ -80,6 +260,15 @@ private:
 
     /** Whether or not the texture has mip maps */
     bool _hasMipmaps;
+    
+    /** Whether or not the texture colors are premultiplied by alpha */
+    bool _premultiplied;
+    
+    /** Whether or not the texture data is GPU-compressed */
+    bool _compressed;
+    
+    /** The size of the compressed data in bytes (0 if not compressed) */
+    size_t _bytes;
 
     /// Texture atlas support
     /** Our parent, who owns the OpenGL texture (or nullptr if we own it) */
@@ -100,6 +289,9 @@ private:
     /** Whether or not this texture is currently active */
     bool _active;
     
+    /** The framebuffer drawing into this texture; 0 if there is none */
+    GLuint _framebuffer;
+    
 #pragma mark -
 #pragma mark Constructors
 public:
@@ -170,13 +362,56 @@ public:
      * includes (but is not limited to) PNG, JPEG, GIF, TIFF, BMP and PCX.
      *
      * The texture will be stored in RGBA format, even if it is a file format
-     * that does not support transparency (e.g. JPEG).
+     * that does not support transparency (e.g. JPEG).  If premultiply is
+     * true, the colors are multiplied by alpha as they are decoded.
      *
-     * @param filename  The file supporting the texture file.
+     * @param filename      The file supporting the texture file.
+     * @param premultiply   Whether to premultiply the colors by alpha
      *
      * @return true if initialization was successful.
      */
-    bool initWithFile(const std::string& filename);
+    bool initWithFile(const std::string& filename, bool premultiply=false);
+
+    /**
+     * Initializes an empty texture that can be drawn into.
+     *
+     * The texture is attached to a new framebuffer object, so that it may
+     * be used as a render target (see {@link SpriteBatch#beginTarget}).
+     * The dimensions need not be powers of two.  The texture is RGBA, with
+     * linear filtering, and its contents are undefined until drawn.
+     *
+     * When initialization is done, the texture is no longer bound.
+     *
+     * @param width     The texture width in pixels
+     * @param height    The texture height in pixels
+     *
+     * @return true if initialization was successful.
+     */
+    bool initWithFramebuffer(int width, int height);
+    
+    /**
+     * Initializes a texture with the compressed images in the given container.
+     *
+     * When initialization is done, the texture is no longer bound.  However,
+     * any other texture that was bound during initialization is also no longer
+     * bound.
+     *
+     * The base level of the texture is the largest level of the container
+     * that fits in maxsize (see {@link TextureContainer#selectLevel}), capped
+     * by GL_MAX_TEXTURE_SIZE.  That level and every smaller one are uploaded
+     * with glCompressedTexImage2D, so the texture has mipmaps whenever the
+     * container has more than one level.  Compressed textures cannot be
+     * modified with set() or {@link buildMipMaps}.
+     *
+     * This method fails if the container format is not supported by this
+     * device (see {@link getCompressedFormats}).
+     *
+     * @param container The parsed texture container
+     * @param maxsize   The maximum width and height (0 for no limit)
+     *
+     * @return true if initialization was successful.
+     */
+    bool initWithContainer(const TextureContainer& container, unsigned int maxsize=0);
 
 #pragma mark -
 #pragma mark Static Constructors
@@ -236,16 +471,105 @@ public:
      * includes (but is not limited to) PNG, JPEG, GIF, TIFF, BMP and PCX.
      *
      * The texture will be stored in RGBA format, even if it is a file format
-     * that does not support transparency (e.g. JPEG).
+     * that does not support transparency (e.g. JPEG).  If premultiply is
+     * true, the colors are multiplied by alpha as they are decoded.
      *
-     * @param filename  The file supporting the texture file.
+     * @param filename      The file supporting the texture file.
+     * @param premultiply   Whether to premultiply the colors by alpha
      *
      * @return a new texture with the given data
      */
-    static std::shared_ptr<Texture> allocWithFile(const std::string& filename) {
+    static std::shared_ptr<Texture> allocWithFile(const std::string& filename, bool premultiply=false) {
         std::shared_ptr<Texture> result = std::make_shared<Texture>();
-        return (result->initWithFile(filename) ? result : nullptr);
+        return (result->initWithFile(filename,premultiply) ? result : nullptr);
+    }
+    
+#pragma mark -
+#pragma mark Image Decoding
+    /**
+     * Returns a surface with the image in the given file, ready for upload.
+     *
+     * This method can load any file format supported by SDL_Image.  The
+     * pixels of the surface are RGBA in memory order, which is the layout
+     * expected by {@link initWithData} and {@link set}.  If premultiply is
+     * true, the colors are also multiplied by alpha.
+     *
+     * Images that SDL_Image already decodes as RGBA (the common case for
+     * PNG) are returned as is, premultiplied in place if necessary, so no
+     * second copy of the image is made.  Other images are converted to RGBA
+     * by SDL first.  Only the premultiplication uses SIMD; reordering the
+     * channels is left to SDL.  This method does not use OpenGL and so is
+     * safe to call from any thread.  Files in the asset directory are read
+     * through the {@link AssetPack}, if there is one.
+     *
+     * The caller owns the surface and must free it with SDL_FreeSurface.
+     *
+     * @param filename      The path to the image file
+     * @param premultiply   Whether to premultiply the colors by alpha
+     *
+     * @return a surface with the image in the given file (nullptr on failure)
+     */
+    static SDL_Surface* decode(const std::string& filename, bool premultiply=false);
+
+    /**
+     * Returns a new empty texture that can be drawn into.
+     *
+     * The texture is attached to a new framebuffer object, so that it may
+     * be used as a render target (see {@link SpriteBatch#beginTarget}).
+     * The dimensions need not be powers of two.  The texture is RGBA, with
+     * linear filtering, and its contents are undefined until drawn.
+     *
+     * When initialization is done, the texture is no longer bound.
+     *
+     * @param width     The texture width in pixels
+     * @param height    The texture height in pixels
+     *
+     * @return a new empty texture that can be drawn into.
+     */
+    static std::shared_ptr<Texture> allocWithFramebuffer(int width, int height) {
+        std::shared_ptr<Texture> result = std::make_shared<Texture>();
+        return (result->initWithFramebuffer(width, height) ? result : nullptr);
+    }
+    
+    /**
+     * Returns a new texture with the compressed images in the given container.
+     *
+     * When initialization is done, the texture is no longer bound.  However,
+     * any other texture that was bound during initialization is also no longer
+     * bound.
+     *
+     * The base level of the texture is the largest level of the container
+     * that fits in maxsize (see {@link TextureContainer#selectLevel}), capped
+     * by GL_MAX_TEXTURE_SIZE.  That level and every smaller one are uploaded
+     * with glCompressedTexImage2D, so the texture has mipmaps whenever the
+     * container has more than one level.  Compressed textures cannot be
+     * modified with set() or {@link buildMipMaps}.
+     *
+     * This method fails if the container format is not supported by this
+     * device (see {@link getCompressedFormats}).
+     *
+     * @param container The parsed texture container
+     * @param maxsize   The maximum width and height (0 for no limit)
+     *
+     * @return a new texture with the compressed images in the given container.
+     */
+    static std::shared_ptr<Texture> allocWithContainer(const TextureContainer& container,
+                                                       unsigned int maxsize=0) {
+        std::shared_ptr<Texture> result = std::make_shared<Texture>();
+        return (result->initWithContainer(container, maxsize) ? result : nullptr);
     }
+    
+    /**
+     * Returns the compressed formats supported by this device.
+     *
+     * This is the list reported by GL_COMPRESSED_TEXTURE_FORMATS.  ETC2 is
+     * required by OpenGLES 3, while ASTC is only available on newer mobile
+     * GPUs and is rare on desktop.  This method uses OpenGL, and so it must
+     * be called in the main thread.
+     *
+     * @return the compressed formats supported by this device.
+     */
+    static std::vector<GLenum> getCompressedFormats();
 
 #pragma mark -
 #pragma mark Setters
@@ -278,6 +602,24 @@ public:
      * @return a reference to this (modified) texture for chaining.
      */
     const Texture& set(const void *data);
+    
+    /**
+     * Sets a horizontal strip of this texture to the contents of the buffer.
+     *
+     * The buffer must have the correct data format.  In addition, the buffer
+     * must be size width*rows*format, and start at the given row.  Uploading
+     * a large texture a strip at a time bounds the main-thread cost of each
+     * call.
+     *
+     * This method binds the texture if it is not currently active.
+     *
+     * @param data  The buffer to read into the texture
+     * @param row   The first row to set
+     * @param rows  The number of rows to set
+     *
+     * @return a reference to this (modified) texture for chaining.
+     */
+    const Texture& set(const void *data, int row, int rows);
 
 #pragma mark -
 #pragma mark Attributes
@@ -288,6 +630,16 @@ public:
      */
     bool isReady() const { return _buffer != 0; }
 
+    /**
+     * Returns the framebuffer drawing into this texture.
+     *
+     * This value is 0 unless the texture was initialized with
+     * {@link initWithFramebuffer}.  Subtextures never have a framebuffer.
+     *
+     * @return the framebuffer drawing into this texture.
+     */
+    GLuint getFramebuffer() const { return _framebuffer; }
+
     /**
      * Returns whether this texture is actively in use.
      *
@@ -324,6 +676,41 @@ public:
      */
     void buildMipMaps();
     
+    /**
+     * Returns whether the data of this texture is GPU-compressed.
+     *
+     * Compressed textures are created with {@link initWithContainer}.  Their
+     * mipmaps come from the container, and their data cannot be changed.
+     *
+     * @return whether the data of this texture is GPU-compressed.
+     */
+    bool isCompressed() const {
+        return (_parent != nullptr ? _parent->isCompressed() : _compressed);
+    }
+    
+    /**
+     * Returns whether the colors of this texture are premultiplied by alpha.
+     *
+     * Premultiplied textures must be drawn with the premultiplied blend
+     * function (see {@link SpriteBatch#setAlphaBlend}).  This attribute
+     * only describes the texture data; it does not change it.
+     *
+     * @return whether the colors of this texture are premultiplied by alpha.
+     */
+    bool isPremultiplied() const {
+        return (_parent != nullptr ? _parent->isPremultiplied() : _premultiplied);
+    }
+    
+    /**
+     * Sets whether the colors of this texture are premultiplied by alpha.
+     *
+     * This attribute only describes the texture data; it does not change
+     * it.  It should be set by whoever uploaded the data.
+     *
+     * @param value Whether the colors of this texture are premultiplied by alpha.
+     */
+    void setPremultiplied(bool value) { _premultiplied = value; }
+    
     /**
      * Returns the OpenGL buffer for this texture.
      *
@@ -384,6 +771,17 @@ public:
      */
     PixelFormat getFormat() const { return _pixelFormat; }
     
+    /**
+     * Returns the GPU memory used by this texture in bytes.
+     *
+     * This is an estimate, as the driver may pad the texture.  Mipmaps add
+     * a third to the size of an uncompressed texture.  A subtexture shares
+     * the memory of its parent, and so its size is 0.
+     *
+     * @return the GPU memory used by this texture in bytes.
+     */
+    size_t getByteSize() const;
+    
     /**
      * Returns the min filter of this texture.
      *
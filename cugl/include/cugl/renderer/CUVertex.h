@@ -60,6 +60,74 @@ public:
     static const GLvoid* texcoordOffset()   { return (GLvoid*)offsetof(Vertex2, texcoord);  }
 };
 
+/**
+ * This class/struct represents the packed rendering information for a 2d vertex.
+ *
+ * This is the same as {@link Vertex2}, except that the texture coordinate is
+ * stored as two normalized 16-bit integers.  That makes the vertex 16 bytes
+ * instead of 20, at the cost of clamping texture coordinates to [0,1].
+ *
+ * The class is intended to be used as a struct.  The static methods are to
+ * compute the offset for VBO access.
+ */
+class PackedVertex2 {
+public:
+    /** The vertex position */
+    cugl::Vec2    position;
+    /** The vertex color */
+    cugl::Color4  color;
+    /** The vertex texture coordinate (normalized to 0..65535) */
+    GLushort      texcoord[2];
+    
+    /** The memory offset of the vertex position */
+    static const GLvoid* positionOffset()   { return (GLvoid*)offsetof(PackedVertex2, position);  }
+    /** The memory offset of the vertex color */
+    static const GLvoid* colorOffset()      { return (GLvoid*)offsetof(PackedVertex2, color);     }
+    /** The memory offset of the vertex texture coordinate */
+    static const GLvoid* texcoordOffset()   { return (GLvoid*)offsetof(PackedVertex2, texcoord);  }
+};
+
+/**
+ * This class/struct represents the rendering information for a textured quad.
+ *
+ * A sprite instance replaces the four vertices and six indices of an
+ * axis-aligned rectangle.  The vertex shader expands it into a quad whose
+ * corners are origin, origin+axisX, origin+axisY and origin+axisX+axisY
+ * (in world space).  The texture coordinates are interpolated from texMin
+ * (at origin) to texMax (at the opposite corner).
+ *
+ * The class is intended to be used as a struct.  The static methods are to
+ * compute the offset for VBO access.
+ */
+class SpriteInstance {
+public:
+    /** The world space edge of the quad along its local x-axis */
+    cugl::Vec2    axisX;
+    /** The world space edge of the quad along its local y-axis */
+    cugl::Vec2    axisY;
+    /** The world space position of the quad origin */
+    cugl::Vec2    origin;
+    /** The texture coordinate at the quad origin */
+    cugl::Vec2    texMin;
+    /** The texture coordinate at the corner opposite the origin */
+    cugl::Vec2    texMax;
+    /** The quad tint */
+    cugl::Color4  color;
+    /** The texture slot (for multi-texture batching) */
+    GLfloat       slot;
+    
+    /** The memory offset of the quad axes (axisX and axisY) */
+    static const GLvoid* axesOffset()       { return (GLvoid*)offsetof(SpriteInstance, axisX);  }
+    /** The memory offset of the quad origin */
+    static const GLvoid* originOffset()     { return (GLvoid*)offsetof(SpriteInstance, origin); }
+    /** The memory offset of the texture rectangle (texMin and texMax) */
+    static const GLvoid* texRectOffset()    { return (GLvoid*)offsetof(SpriteInstance, texMin); }
+    /** The memory offset of the quad tint */
+    static const GLvoid* colorOffset()      { return (GLvoid*)offsetof(SpriteInstance, color);  }
+    /** The memory offset of the texture slot */
+    static const GLvoid* slotOffset()       { return (GLvoid*)offsetof(SpriteInstance, slot);   }
+};
+
 /**
  * This class/struct represents the rendering information for a 2d vertex.
  *
@@ -6,9 +6,17 @@
 //  task is specified by a void function.  There are no guarantees about thread
 //  safety; that is responsibility of the author of each task.
 //
-//  This code is largely inspired from the Cocos2d file AudioEngine.cpp, from
-//  the code for asynchronous asset loading. We generalized that class added
-//  some notable safety changes.
+//  The pool is a work-stealing scheduler.  Each worker has its own deques of
+//  tasks (one per priority), and tasks spawned by a worker go to the back of
+//  its own deque without any locking.  An idle worker steals from the front of
+//  the others' deques, and tasks from other threads go in a shared queue.
+//  Workers with nothing to do sleep until a task arrives.  Tasks may belong to
+//  a group, which can be waited on or followed by continuation tasks.
+//
+//  This code was originally inspired by the Cocos2d file AudioEngine.cpp, from
+//  the code for asynchronous asset loading.  The deques follow Chase and Lev,
+//  "Dynamic Circular Work-Stealing Deque", with the memory orders of Le et al.,
+//  "Correct and Efficient Work-Stealing for Weak Memory Models".
 //
 //  CUGL zlib License:
 //      This software is provided 'as-is', without any express or implied
@@ -37,8 +45,12 @@
 #include <cugl/base/CUBase.h>
 #include <SDL/SDL.h>
 #include <condition_variable>
+#include <functional>
 #include <stdio.h>
-#include <queue>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <thread>
 
@@ -49,70 +61,268 @@
 
 namespace cugl {
 
+/** Forward reference to the thread pool */
+class ThreadPool;
+
+#pragma mark -
+#pragma mark Task Group
+
+/**
+ * Class to track a collection of tasks in a thread pool.
+ *
+ * A group counts the tasks added to it that have not yet finished.  You can
+ * wait for this count to reach zero, or add continuations to the group, which
+ * are tasks that are scheduled once the count reaches zero.  A continuation
+ * can belong to another group, so that groups may be chained.
+ *
+ * A group may be reused once it is done.  Its continuations are scheduled
+ * each time the count reaches zero, and then removed.
+ */
+class TaskGroup {
+private:
+    /** A task to schedule when the group is done */
+    class Continuation {
+    public:
+        /** The pool to run the task */
+        ThreadPool* pool;
+        /** The task function */
+        std::function<void()> task;
+        /** The task priority */
+        int priority;
+        /** The group of the task (may be nullptr) */
+        std::shared_ptr<TaskGroup> group;
+    };
+
+    /** The number of unfinished tasks (including pending continuations) */
+    std::atomic<size_t> _pending;
+    /** A mutex for the continuations and waiting */
+    std::mutex _mutex;
+    /** A condition variable to wake threads waiting on this group */
+    std::condition_variable _condition;
+    /** The tasks to schedule when the group is done */
+    std::vector<Continuation> _continuations;
+    /** The pool of each worker sleeping in wait (so that finish can wake it) */
+    std::vector<ThreadPool*> _parked;
+
+    /**
+     * Records that a task of this group has finished.
+     *
+     * If this was the last task, the waiting threads are woken up and the
+     * continuations are scheduled.
+     */
+    void finish();
+
+    /** Allow the thread pool to update the count */
+    friend class ThreadPool;
+
+public:
+    /**
+     * Creates an empty task group.
+     *
+     * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate a task group
+     * on the heap, use the static constructor instead.
+     */
+    TaskGroup() : _pending(0) {}
+
+    /**
+     * Returns a newly allocated empty task group.
+     *
+     * @return a newly allocated empty task group.
+     */
+    static std::shared_ptr<TaskGroup> alloc() {
+        return std::make_shared<TaskGroup>();
+    }
+
+    /**
+     * Returns the number of tasks in this group that have not finished.
+     *
+     * This count includes continuations that are not yet scheduled.
+     *
+     * @return the number of tasks in this group that have not finished.
+     */
+    size_t getPending() const { return _pending.load(); }
+
+    /**
+     * Returns true if every task in this group has finished.
+     *
+     * @return true if every task in this group has finished.
+     */
+    bool isDone() const { return _pending.load() == 0; }
+
+    /**
+     * Blocks until every task in this group has finished.
+     *
+     * If this is called by a worker thread, the worker runs other tasks of
+     * its pool while it waits, so that waiting inside a task cannot starve
+     * the pool.  When there are none, it sleeps with the idle workers until
+     * either a task arrives or the group is done.  It also stops waiting if
+     * its pool is stopped.  Any other thread sleeps until the group is done.
+     */
+    void wait();
+
+    // Copying is only allowed via shared pointer.
+    CU_DISALLOW_COPY_AND_ASSIGN(TaskGroup);
+};
+
 #pragma mark -
 #pragma mark Thread Pool
 
 /**
  *  Class to providing a collection of worker threads.
  *
- *  This is a general purpose class for performing tasks asynchronously.  There 
- *  is no notification process for when a task is complete.  Instead, your task 
- *  should either set a flag, or execute a callback when it is done.
+ *  This is a general purpose class for performing tasks asynchronously.  A
+ *  task may be added to a {@link TaskGroup}, which can be waited on or given
+ *  continuations.  Otherwise, your task should either set a flag, or execute
+ *  a callback when it is done.
  *
- *  There are some important safety considerations for using this class over
- *  direct thread objects. For example, stopping a thread pool does not shut it 
- *  down immediately; it just marks it for shutdown.  Because of mutex locks, 
- *  it is not safe to delete a thread pool until it is completely shutdown.
+ *  Each task has a priority.  A worker always takes the highest priority task
+ *  it can find, whether in its own deques, the shared queue or the deques of
+ *  other workers.  Tasks of the same priority from the same thread start in
+ *  order, unless they were added by a worker (which runs its newest first).
  *
- *  More importantly, we do not allow for detached threads. This makes no sense
- *  in this application, because the threads share a resource (_taskQueue) with 
- *  the main thread that will be deleted.  It is therefore unsafe for the 
- *  threads to ever detach.
+ *  Stopping a thread pool blocks until the workers have finished their current
+ *  tasks.  Tasks that have not started are discarded (though their groups are
+ *  still told that they are done), so it is safe for tasks to refer to objects
+ *  that are deleted once the pool is stopped.
  *
- *  See the class {@link AssetManager} for an example of how to use a thread 
+ *  We do not allow for detached threads. This makes no sense in this
+ *  application, because the threads share the task queues with the main thread
+ *  that will be deleted.  It is therefore unsafe for the threads to ever detach.
+ *
+ *  See the class {@link AssetManager} for an example of how to use a thread
  *  pool.
  */
 class ThreadPool {
+public:
+    /**
+     * The priority of a task.
+     *
+     * Lower values run first.
+     */
+    enum class Priority : int {
+        /** Work that a frame is waiting on (e.g. simulation) */
+        HIGH   = 0,
+        /** Ordinary work (e.g. asset loading); the default priority */
+        NORMAL = 1,
+        /** Work that can wait for everything else (e.g. background saves) */
+        LOW    = 2
+    };
+
 private:
+    /** The number of priority levels */
+    static const int PRIORITIES = 3;
+
+    /** A task waiting to run (defined in the implementation) */
+    class Task;
+    /** A worker thread and its deques (defined in the implementation) */
+    class Worker;
+
+    /** The worker of the current thread (nullptr if it is not a worker) */
+    static thread_local Worker* _current;
+
     /** The individual worker threads for this thread pool */
-#ifdef CU_SDL_THREADS
-    std::vector<SDL_Thread*> _workers;
-#else
-    std::vector<std::thread> _workers;
-#endif
-    
-    /** Tasks waiting to be assigned to a thread */
-    std::queue< std::function<void()> > _taskQueue;
-    
-    /** A mutex lock for the task queue */
+    std::vector<Worker*> _workers;
+
+    /** Tasks from other threads waiting to be assigned to a worker, by priority */
+    std::deque<Task*> _taskQueue[PRIORITIES];
+    /** The number of tasks in each shared queue (to skip the lock when empty) */
+    std::atomic<size_t> _queued[PRIORITIES];
+    /** A mutex lock for the shared task queues */
     std::mutex _queueMutex;
-    /** A condition variable to manage tasks waiting for a worker */
+
+    /** The number of tasks ever added (idle workers sleep until it changes) */
+    std::atomic<Uint64> _signal;
+    /** The number of sleeping workers */
+    std::atomic<int> _sleeping;
+    /** The number of awake workers looking for a task (new tasks wake no one if positive) */
+    std::atomic<int> _searching;
+    /** A mutex lock for sleeping workers */
+    std::mutex _sleepMutex;
+    /** A condition variable to manage workers waiting for a task */
     std::condition_variable _taskCondition;
-    
+
     /** Whether or not the thread pool has been marked for shutdown */
-    bool _stop;
-    /** The number of child threads that are completed */
-    int _complete;
-    
+    std::atomic<bool> _stop;
+    /** The number of worker threads still running */
+    std::atomic<int> _active;
+
     /**
-     * The body function of a single thread.
+     * The body function of a single worker.
      *
-     * This function pulls tasks from the task queue.  
+     * This function runs tasks until the pool stops, sleeping when there
+     * is nothing to do.
      *
-     * This implementation is safe to use with std::thread.
+     * @param worker    The worker for this thread
      */
-    void threadFunc();
+    void run(Worker* worker);
 
     /**
      * The body function of a single thread.
      *
-     * This function pulls tasks from the task queue.
+     * This implementation is safe to use with std::thread.
+     *
+     * @param worker    The worker for this thread
+     */
+    void threadFunc(Worker* worker);
+
+    /**
+     * The body function of a single thread.
      *
      * This static implementation uses the SDL thread API.  It should be used
      * on Android and Windows, which have special thread requirements.
+     *
+     * @param ptr   The worker for this thread
+     *
+     * @return 0 when the thread completes
      */
     static int sdlThreadFunc(void* ptr);
-    
+
+    /**
+     * Returns the next task for the given worker, or nullptr if there is none.
+     *
+     * For each priority in turn, the worker takes the newest task of its own
+     * deque, then the oldest task of the shared queue, and then steals the
+     * oldest task of another worker.
+     *
+     * @param worker    The worker looking for a task
+     *
+     * @return the next task for the given worker, or nullptr if there is none.
+     */
+    Task* next(Worker* worker);
+
+    /**
+     * Runs the given task, and then deletes it.
+     *
+     * @param task  The task to run
+     */
+    void execute(Task* task);
+
+    /**
+     * Schedules the given task, which is already counted by its group.
+     *
+     * The task is discarded if the pool is stopped.
+     *
+     * @param task      The task to schedule
+     * @param priority  The task priority
+     */
+    void submit(Task* task, int priority);
+
+    /**
+     * Wakes a sleeping worker, if there is one.
+     */
+    void wake();
+
+    /**
+     * Deletes a task without running it.
+     *
+     * The group of the task is still told that it is done.
+     *
+     * @param task  The task to discard
+     */
+    static void discard(Task* task);
+
+    /** Allow task groups to run tasks while waiting */
+    friend class TaskGroup;
 
 #pragma mark Constructors
 public:
@@ -121,35 +331,32 @@ public:
      *
      * You must initialize this thread pool before use.
      *
-     * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate a thread pool 
+     * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate a thread pool
      * on the heap, use one of the static constructors instead.
      */
-    ThreadPool() :_stop(false), _complete(0) { }
-    
+    ThreadPool();
+
     /**
      * Deletes this thread pool, destroying all resources.
      *
-     * It is a bad idea to destroy the thread pool if the pool is not yet shut
-     * down. The task queue is shared by the child threads, so we cannot delete
-     * it until all the threads complete.  This destructor will block unti 
-     * showndown.
+     * This destructor blocks until the workers have finished their current
+     * tasks.  Tasks that have not started are discarded.
      */
     ~ThreadPool() { dispose(); }
-    
+
     /**
      * Disposes this thread pool, releasing all memory.
      *
-     * A disposed thread pool can be safely reinitialized. However, it is a bad 
-     * idea to destroy the thread pool if the pool is not yet shut down. The 
-     * task queue is shared by the child threads, so we cannot delete it until 
-     * all the threads complete.  This destructor will block unti showndown.
+     * This method blocks until the workers have finished their current tasks.
+     * Tasks that have not started are discarded.  A disposed thread pool can
+     * be safely reinitialized.
      */
     void dispose();
-    
+
     /**
      * Initializes a thread pool with the given number of threads.
      *
-     * You can specify the number of simultaneous worker threads. We find that 
+     * You can specify the number of simultaneous worker threads. We find that
      * 4 is generally a good number, even if you have a lot of tasks.  Much
      * more than the number of cores on a machine is counter-productive.
      *
@@ -159,7 +366,7 @@ public:
      */
     virtual bool init(int threads = 4);
 
-    
+
 #pragma mark Static Constructors
     /**
      * Returns a newly allocated thread pool with the given number of threads.
@@ -176,41 +383,72 @@ public:
         std::shared_ptr<ThreadPool> result = std::make_shared<ThreadPool>();
         return (result->init(threads) ? result : nullptr);
     }
-    
-    
+
+
 #pragma mark Task Management
     /**
      * Adds a task to the thread pool.
      *
-     * A task is a void returning function with no parameters.  If you need 
-     * state in the task, you should use a method call for the state.  The task 
-     * will not be executed immediately, but must wait for the first available 
-     * worker.
+     * A task is a void returning function with no parameters.  If you need
+     * state in the task, you should use a method call for the state.  The task
+     * will not be executed immediately, but must wait for the first available
+     * worker.  The task has {@link Priority#NORMAL} priority.
      *
      * @param  task     the task function to add to the thread pool
      */
-    void addTask(const std::function<void()> &task);
-    
+    void addTask(const std::function<void()> &task) {
+        addTask(task, Priority::NORMAL, nullptr);
+    }
+
+    /**
+     * Adds a task with the given priority to the thread pool.
+     *
+     * If a group is specified, the task is counted by that group until it
+     * finishes (or is discarded).  A task added by a worker of this pool
+     * goes in that worker's own deque, and is the next task it runs.
+     *
+     * @param  task     the task function to add to the thread pool
+     * @param  priority the task priority
+     * @param  group    the group of the task (may be nullptr)
+     */
+    void addTask(const std::function<void()> &task, Priority priority,
+                 const std::shared_ptr<TaskGroup>& group = nullptr);
+
+    /**
+     * Adds a task to run once every task in the given group has finished.
+     *
+     * The continuation is counted by its own group (if any) as soon as it is
+     * added, so waiting on that group also waits for the group before it.  If
+     * the first group is already done, the task is scheduled immediately.
+     *
+     * @param  after    the group to wait for
+     * @param  task     the task function to add to the thread pool
+     * @param  priority the task priority
+     * @param  group    the group of the continuation (may be nullptr)
+     */
+    void addContinuation(const std::shared_ptr<TaskGroup>& after,
+                         const std::function<void()> &task, Priority priority = Priority::NORMAL,
+                         const std::shared_ptr<TaskGroup>& group = nullptr);
+
     /**
      * Stop the thread pool, marking it for shut down.
      *
-     * A stopped thread pool is marked for shutdown, but it shutdown has not 
-     * necessarily completed.  Shutdown will be complete when the current child 
-     * threads have finished with their tasks.
+     * This method blocks until every worker has finished its current task.
+     * Tasks that have not started are discarded, and tasks added afterwards
+     * are ignored.
      */
     void stop();
-    
+
     /**
      * Returns whether the thread pool has been stopped.
      *
-     * A stopped thread pool is marked for shutdown, but it shutdown has not
-     * necessarily completed.  Shutdown will be complete when the current child 
-     * threads have finished with their tasks.
+     * A stopped thread pool no longer accepts tasks.  Shutdown is complete
+     * once {@link stop} returns.
      *
      * @return whether the thread pool has been stopped.
      */
-    bool isStopped() const { return _stop; }
-    
+    bool isStopped() const { return _stop.load(); }
+
     /**
      * Returns whether the thread pool has been shut down.
      *
@@ -218,8 +456,15 @@ public:
      *
      * @return whether the thread pool has been shut down.
      */
-    bool isShutdown() const { return _workers.size() == _complete; }
-    
+    bool isShutdown() const { return _active.load() == 0; }
+
+    /**
+     * Returns the number of worker threads in this pool.
+     *
+     * @return the number of worker threads in this pool.
+     */
+    size_t getThreadCount() const { return _workers.size(); }
+
     // Copying is only allowed via shared pointer.
     CU_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
 };
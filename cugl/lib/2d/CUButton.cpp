@@ -449,6 +449,7 @@ void Button::setColor(Color4 color) {
     _upcolor = color;
     if (!_down || _downnode) {
         _tintColor = color;
+        setContentDirty();
     }
 }
 
@@ -512,6 +513,7 @@ void Button::setDown(bool down) {
         _downnode->setVisible(true);
     } else if (down) {
         _tintColor = _downcolor;
+        setContentDirty();
     }
     
     if (!down && _downnode && _upnode) {
@@ -519,6 +521,7 @@ void Button::setDown(bool down) {
         _downnode->setVisible(false);
     } else if (!down) {
         _tintColor = _upcolor;
+        setContentDirty();
     }
     
     if (_listener != nullptr) {
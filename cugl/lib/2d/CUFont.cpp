@@ -44,9 +44,11 @@
 //  Version: 7/6/16
 
 #include <cugl/renderer/CUTexture.h>
+#include <cugl/io/CUAssetPack.h>
 #include <cugl/util/CUDebug.h>
 #include <cugl/2d/CUFont.h>
 #include <algorithm>
+#include <cstring>
 #include <utf8/utf8.h>
 #include <deque>
 
@@ -54,6 +56,70 @@ using namespace cugl;
 
 /** The amount of border to put around a glyph to prevent bleeding. */
 #define GLYPH_BORDER    2
+/** The largest atlas dimension accepted by decodeAtlas */
+#define ATLAS_LIMIT     16384
+
+/**
+ * Appends a 32-bit word to the buffer in little-endian order
+ *
+ * @param data  The buffer
+ * @param value The word to append
+ */
+static void appendWord(std::vector<Uint8>& data, Uint32 value) {
+    value = SDL_SwapLE32(value);
+    size_t offset = data.size();
+    data.resize(offset+sizeof(Uint32));
+    std::memcpy(data.data()+offset, &value, sizeof(Uint32));
+}
+
+/**
+ * Reads a 32-bit little-endian word, returning false if the buffer is exhausted
+ *
+ * @param pos   The read position (advanced on success)
+ * @param end   The end of the buffer
+ * @param value The word read
+ *
+ * @return true if a word was read
+ */
+static bool readWord(const Uint8*& pos, const Uint8* end, Uint32& value) {
+    if (end-pos < (ptrdiff_t)sizeof(Uint32)) {
+        return false;
+    }
+    std::memcpy(&value, pos, sizeof(Uint32));
+    value = SDL_SwapLE32(value);
+    pos += sizeof(Uint32);
+    return true;
+}
+
+/**
+ * Appends a float to the buffer as its little-endian bit pattern
+ *
+ * @param data  The buffer
+ * @param value The float to append
+ */
+static void appendFloat(std::vector<Uint8>& data, float value) {
+    Uint32 bits;
+    std::memcpy(&bits, &value, sizeof(Uint32));
+    appendWord(data, bits);
+}
+
+/**
+ * Reads a float stored by appendFloat, returning false if the buffer is exhausted
+ *
+ * @param pos   The read position (advanced on success)
+ * @param end   The end of the buffer
+ * @param value The float read
+ *
+ * @return true if a float was read
+ */
+static bool readFloat(const Uint8*& pos, const Uint8* end, float& value) {
+    Uint32 bits;
+    if (!readWord(pos, end, bits)) {
+        return false;
+    }
+    std::memcpy(&value, &bits, sizeof(Uint32));
+    return true;
+}
 
 #pragma mark -
 #pragma mark Constructors
@@ -115,7 +181,8 @@ void Font::dispose() {
  *
  * The font size is fixed on initialization.  It cannot be changed without
  * disposing of the entire font.  However, all other attributes may be
- * changed.
+ * changed.  Files in the asset directory are read through the
+ * {@link AssetPack}, if there is one.
  *
  * @param file  The file with the font asset
  * @param size  The font size in points
@@ -127,7 +194,8 @@ bool Font::init(const std::string& file, int size) {
         CUAssertLog(false,"Font %s already loaded", _name.c_str());
         return false;
     }
-    _data = TTF_OpenFont(file.c_str(), size);
+    // The font reads its file lazily, so the stream stays open with it
+    _data = TTF_OpenFontRW(AssetPack::openFile(file,"rb"), 1, size);
     if (_data == nullptr) {
         CUAssertLog(false, "Font initialization error: %s", TTF_GetError());
         return false;
@@ -467,6 +535,151 @@ const std::shared_ptr<Texture>& Font::getAtlas() {
 
 }
 
+/**
+ * Appends the current atlas to the given buffer, returning true on success.
+ *
+ * The encoding contains the glyph layout, the glyph metrics, the kerning
+ * and the atlas pixels.  It may be restored with {@link decodeAtlas} to
+ * skip rasterizing the glyphs when the same font is loaded again (e.g.
+ * by the {@link AssetCache}).  This method fails if the atlas has no
+ * pixels, which is the case once {@link getAtlas()} has been called.
+ *
+ * @param data  The buffer to append the atlas to
+ *
+ * @return true if the atlas was encoded
+ */
+bool Font::encodeAtlas(std::vector<Uint8>& data) const {
+    if (!_hasAtlas || _surface == nullptr) {
+        return false;
+    }
+    
+    appendWord(data, (Uint32)_glyphset.size());
+    for(auto it = _glyphset.begin(); it != _glyphset.end(); ++it) {
+        appendWord(data, *it);
+    }
+    appendWord(data, (Uint32)_glyphmap.size());
+    for(auto it = _glyphmap.begin(); it != _glyphmap.end(); ++it) {
+        appendWord(data, it->first);
+        appendFloat(data, it->second.origin.x);
+        appendFloat(data, it->second.origin.y);
+        appendFloat(data, it->second.size.width);
+        appendFloat(data, it->second.size.height);
+    }
+    appendWord(data, (Uint32)_glyphsize.size());
+    for(auto it = _glyphsize.begin(); it != _glyphsize.end(); ++it) {
+        appendWord(data, it->first);
+        appendWord(data, (Uint32)it->second.minx);
+        appendWord(data, (Uint32)it->second.maxx);
+        appendWord(data, (Uint32)it->second.miny);
+        appendWord(data, (Uint32)it->second.maxy);
+        appendWord(data, (Uint32)it->second.advance);
+    }
+    appendWord(data, (Uint32)_kernmap.size());
+    for(auto it = _kernmap.begin(); it != _kernmap.end(); ++it) {
+        appendWord(data, it->first);
+        appendWord(data, (Uint32)it->second.size());
+        for(auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+            appendWord(data, jt->first);
+            appendWord(data, jt->second);
+        }
+    }
+    
+    size_t width = _surface->w*_surface->format->BytesPerPixel;
+    appendWord(data, (Uint32)_surface->w);
+    appendWord(data, (Uint32)_surface->h);
+    size_t offset = data.size();
+    data.resize(offset+width*_surface->h);
+    for(int row = 0; row < _surface->h; row++) {
+        std::memcpy(data.data()+offset, (Uint8*)_surface->pixels+row*_surface->pitch, width);
+        offset += width;
+    }
+    return true;
+}
+
+/**
+ * Restores an atlas encoded by {@link encodeAtlas}, returning true on success.
+ *
+ * The encoding must come from a font with the same source, size and
+ * settings.  As with {@link buildAtlasAsync()}, this method does not
+ * generate the OpenGL texture, so it is thread safe.  If the encoding
+ * is invalid, this font is left with no atlas.
+ *
+ * @param data  The encoded atlas
+ * @param size  The size of the encoding in bytes
+ *
+ * @return true if the atlas was restored
+ */
+bool Font::decodeAtlas(const Uint8* data, size_t size) {
+    clearAtlas();
+    const Uint8* pos = data;
+    const Uint8* end = data+size;
+    
+    // Every count is checked against the remaining bytes before reserving
+    Uint32 count = 0;
+    bool success = readWord(pos, end, count) && count <= (Uint32)(end-pos)/4;
+    for(Uint32 ii = 0; success && ii < count; ii++) {
+        Uint32 glyph;
+        success = readWord(pos, end, glyph);
+        _glyphset.push_back(glyph);
+    }
+    success = success && readWord(pos, end, count) && count <= (Uint32)(end-pos)/20;
+    for(Uint32 ii = 0; success && ii < count; ii++) {
+        Uint32 glyph;
+        Rect rect;
+        success = (readWord(pos, end, glyph) &&
+                   readFloat(pos, end, rect.origin.x) && readFloat(pos, end, rect.origin.y) &&
+                   readFloat(pos, end, rect.size.width) && readFloat(pos, end, rect.size.height));
+        _glyphmap[glyph] = rect;
+    }
+    success = success && readWord(pos, end, count) && count <= (Uint32)(end-pos)/24;
+    for(Uint32 ii = 0; success && ii < count; ii++) {
+        Uint32 glyph;
+        Uint32 values[5];
+        success = readWord(pos, end, glyph);
+        for(int jj = 0; success && jj < 5; jj++) {
+            success = readWord(pos, end, values[jj]);
+        }
+        Metrics metrics;
+        metrics.minx = (int)values[0];
+        metrics.maxx = (int)values[1];
+        metrics.miny = (int)values[2];
+        metrics.maxy = (int)values[3];
+        metrics.advance = (int)values[4];
+        _glyphsize[glyph] = metrics;
+    }
+    success = success && readWord(pos, end, count) && count <= (Uint32)(end-pos)/8;
+    for(Uint32 ii = 0; success && ii < count; ii++) {
+        Uint32 first, pairs;
+        success = readWord(pos, end, first) && readWord(pos, end, pairs) && pairs <= (Uint32)(end-pos)/8;
+        std::unordered_map<Uint32, Uint32>& kerning = _kernmap[first];
+        for(Uint32 jj = 0; success && jj < pairs; jj++) {
+            Uint32 second, amount;
+            success = readWord(pos, end, second) && readWord(pos, end, amount);
+            kerning[second] = amount;
+        }
+    }
+    
+    Uint32 w = 0, h = 0;
+    success = success && readWord(pos, end, w) && readWord(pos, end, h);
+    success = success && w > 0 && h > 0 && w <= ATLAS_LIMIT && h <= ATLAS_LIMIT;
+    if (success) {
+        _surface = allocSurface(w, h);
+        size_t width = (_surface == nullptr ? 0 : w*_surface->format->BytesPerPixel);
+        success = (_surface != nullptr && (size_t)(end-pos) == width*h);
+        for(Uint32 row = 0; success && row < h; row++) {
+            std::memcpy((Uint8*)_surface->pixels+row*_surface->pitch, pos, width);
+            pos += width;
+        }
+    }
+    
+    if (!success) {
+        clearAtlas();
+        return false;
+    }
+    _hasAtlas = true;
+    return true;
+}
+
 #pragma mark -
 #pragma mark Rendering
 /**
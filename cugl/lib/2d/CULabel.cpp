@@ -622,6 +622,7 @@ void Label::clearRenderData() {
     _vertices.clear();
     _indices.clear();
     _rendered = false;
+    setContentDirty();
 }
 
 /**
@@ -631,6 +632,7 @@ void Label::clearRenderData() {
  * colors.
  */
 void Label::updateColor() {
+    setContentDirty();
     if (!_rendered) {
         return;
     }
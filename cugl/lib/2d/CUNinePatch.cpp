@@ -298,6 +298,12 @@ void NinePatch::setContentSize(const Size& size) {
 void NinePatch::setTexture(const std::shared_ptr<Texture>& texture) {
     std::shared_ptr<Texture> temp = (texture == nullptr ? SpriteBatch::getBlankTexture() : texture);
     if (_texture != temp) {
+        // Follow the alpha convention of the texture, unless the blend is custom
+        bool was = _texture != nullptr && _texture->isPremultiplied();
+        if (was != temp->isPremultiplied() && _dstFactor == GL_ONE_MINUS_SRC_ALPHA &&
+            _srcFactor == (was ? GL_ONE : GL_SRC_ALPHA)) {
+            _srcFactor = (was ? GL_SRC_ALPHA : GL_ONE);
+        }
         _texture = temp;
         clearRenderData();
     }
@@ -355,6 +361,7 @@ void NinePatch::clearRenderData() {
     _vertices.clear();
     _indices.clear();
     _rendered = false;
+    setContentDirty();
 }
 
 /**
@@ -552,7 +559,7 @@ void NinePatch::draw(const std::shared_ptr<SpriteBatch>& batch, const Mat4& tran
         generateRenderData();
     }
         
-    batch->setColor(tint);
+    batch->setColor(_texture->isPremultiplied() ? tint.getPremultiplied() : tint);
     batch->setTexture(_texture);
     batch->setBlendEquation(_blendEquation);
     batch->setBlendFunc(_srcFactor, _dstFactor);
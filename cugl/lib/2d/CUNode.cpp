@@ -38,13 +38,63 @@
 #include <cugl/2d/CUScene.h>
 #include <cugl/2d/layout/CULayout.h>
 #include <cugl/renderer/CUCamera.h>
+#include <cugl/renderer/CUTexture.h>
 #include <cugl/util/CUStrings.h>
 #include <cugl/assets/CUAssetManager.h>
 #include <sstream>
 #include <algorithm>
+#include <cmath>
 
 using namespace cugl;
 
+/** The nodes holding a bitmap cache texture, most recently drawn first */
+static std::list<Node*> _bitmapCaches;
+/** The memory (in bytes) held by all bitmap cache textures */
+static size_t _bitmapCacheUsage = 0;
+/** The maximum memory (in bytes) for all bitmap cache textures */
+static size_t _bitmapCacheBudget = 32*1024*1024;
+
+/**
+ * Returns true if the matrix only uses the 2d affine entries.
+ *
+ * Such a matrix is a 2x3 matrix embedded in a 4x4 one: it has no z or
+ * projective terms.
+ *
+ * @param m The matrix to test
+ *
+ * @return true if the matrix only uses the 2d affine entries.
+ */
+static bool isAffine(const Mat4& m) {
+    return (m.m[2] == 0 && m.m[3] == 0 && m.m[6] == 0 && m.m[7] == 0 &&
+            m.m[8] == 0 && m.m[9] == 0 && m.m[10] == 1 && m.m[11] == 0 &&
+            m.m[14] == 0 && m.m[15] == 1);
+}
+
+/**
+ * Multiplies two 2d affine matrices, storing the result in dst.
+ *
+ * This is the same as Mat4::multiply(local,parent,dst), but it only
+ * computes the six entries of the 2x3 submatrix.
+ *
+ * @param local     The node to parent transform
+ * @param parent    The parent to world transform
+ * @param dst       A matrix to store the result in
+ */
+static void multiplyAffine(const Mat4& local, const Mat4& parent, Mat4* dst) {
+    const float* a = local.m;
+    const float* b = parent.m;
+    float m0  = b[0]*a[0]  + b[4]*a[1];
+    float m1  = b[1]*a[0]  + b[5]*a[1];
+    float m4  = b[0]*a[4]  + b[4]*a[5];
+    float m5  = b[1]*a[4]  + b[5]*a[5];
+    float m12 = b[0]*a[12] + b[4]*a[13] + b[12];
+    float m13 = b[1]*a[12] + b[5]*a[13] + b[13];
+    *dst = Mat4::IDENTITY;
+    dst->m[0]  = m0;  dst->m[1]  = m1;
+    dst->m[4]  = m4;  dst->m[5]  = m5;
+    dst->m[12] = m12; dst->m[13] = m13;
+}
+
 #pragma mark Constructors
 /**
  * Creates an uninitialized node.
@@ -65,10 +115,25 @@ _anchor(Vec2::ANCHOR_BOTTOM_LEFT),
 _scale(Vec2::ONE),
 _angle(0),
 _useTransform(false),
+_affine(true),
+_worldAffine(true),
+_worldDirty(true),
+_inverseDirty(true),
+_cullable(true),
+_subtreeCount(1),
+_subtreeUnbounded(false),
+_boundsDirty(true),
+_static(false),
+_staticMesh(nullptr),
+_cacheAsBitmap(false),
+_cacheTexture(nullptr),
+_cacheScale(0),
+_contentDirty(true),
 _parent(nullptr),
 _graph(nullptr),
 _zOrder(0),
 _zDirty(false),
+_zQueued(false),
 _childOffset(-2) {}
 
 /**
@@ -259,6 +324,15 @@ void Node::dispose() {
     _transform = Mat4::IDENTITY;
     _useTransform = false;
     _combined = Mat4::IDENTITY;
+    _affine = true;
+    _worldDirty = true;
+    _cullable = true;
+    _boundsDirty = true;
+    _static = false;
+    _staticMesh = nullptr;
+    releaseCache();
+    _cacheAsBitmap = false;
+    _contentDirty = true;
     _parent = nullptr;
     _graph = nullptr;
     _childOffset = -2;
@@ -267,6 +341,7 @@ void Node::dispose() {
     _hashOfName = 0;
     _zOrder = 0;
     _zDirty = false;
+    _zQueued = false;
 }
 
 /**
@@ -292,6 +367,10 @@ Node* Node::copy(Node* dst) {
     dst->_transform = _transform;
     dst->_useTransform = _useTransform;
     dst->_combined = _combined;
+    dst->_affine = _affine;
+    dst->_cullable = _cullable;
+    dst->setWorldDirty();
+    dst->setContentDirty();
     dst->_tag = _tag;
     dst->_name = _name;
     dst->_hashOfName = _hashOfName;
@@ -318,6 +397,8 @@ void Node::setPosition(float x, float y) {
     _combined.m[12] += (x-_position.x);
     _combined.m[13] += (y-_position.y);
     _position.set(x,y);
+    setWorldDirty();
+    if (_parent) { _parent->setContentDirty(); }
 }
 
 /**
@@ -337,6 +418,8 @@ void Node::setContentSize(const Size& size) {
     _position += _anchor*(size-_contentSize);
     _contentSize.set(size);
     if (!_useTransform) updateTransform();
+    setBoundsDirty();
+    setContentDirty();
     if (_layout) {
         doLayout();
     }
@@ -405,20 +488,74 @@ Size Node::getSize() const {
 }
 
 /**
- * Returns the matrix transforming node space to world space.
+ * Returns the cached matrix transforming node space to world space.
  *
- * This matrix is used to convert node coordinates into OpenGL coordinates.
- * It is the recursive (left-multiplied) transforms of all of its descendents.
+ * The matrix is recomputed first if this node or an ancestor changed.
  *
- * @return the matrix transforming node space to world space.
+ * @return the cached matrix transforming node space to world space.
  */
-Mat4 Node::getNodeToWorldTransform() const {
-    Mat4 result = _combined;
-    if (_parent) {
-        // Multiply on left
-        Mat4::multiply(result,_parent->getNodeToWorldTransform(),&result);
+const Mat4& Node::worldTransform() const {
+    if (_worldDirty) {
+        if (_parent) {
+            // Multiply on left
+            const Mat4& parent = _parent->worldTransform();
+            _worldAffine = _affine && _parent->_worldAffine;
+            if (_worldAffine) {
+                multiplyAffine(_combined,parent,&_world);
+            } else {
+                Mat4::multiply(_combined,parent,&_world);
+            }
+        } else {
+            _world = _combined;
+            _worldAffine = _affine;
+        }
+        _worldDirty = false;
+        _inverseDirty = true;
     }
-    return result;
+    return _world;
+}
+
+/**
+ * Returns the cached matrix transforming world space to node space.
+ *
+ * The matrix is recomputed first if this node or an ancestor changed.
+ *
+ * @return the cached matrix transforming world space to node space.
+ */
+const Mat4& Node::worldInverse() const {
+    const Mat4& world = worldTransform();
+    if (_inverseDirty) {
+        Mat4::invert(world,&_worldInverse);
+        _inverseDirty = false;
+    }
+    return _worldInverse;
+}
+
+/**
+ * Returns the world space bounding box of this node and its descendants.
+ *
+ * This is the union of the transformed content bounds of every node in
+ * this subtree, including invisible ones.  The value is cached, and is
+ * only recomputed when a node in the subtree moves, resizes or is added
+ * or removed.
+ *
+ * @return the world space bounding box of this node and its descendants.
+ */
+const Rect& Node::getSubtreeBounds() const {
+    if (_boundsDirty) {
+        const Mat4& world = worldTransform();
+        _subtreeBounds = world.transform(Rect(Vec2::ZERO, _contentSize));
+        // A projective transform has no meaningful 2d bounds
+        _subtreeUnbounded = !_cullable || !_worldAffine;
+        _subtreeCount = 1;
+        for(auto it = _children.begin(); it != _children.end(); ++it) {
+            _subtreeBounds.merge((*it)->getSubtreeBounds());
+            _subtreeUnbounded = _subtreeUnbounded || (*it)->_subtreeUnbounded;
+            _subtreeCount += (*it)->_subtreeCount;
+        }
+        _boundsDirty = false;
+    }
+    return _subtreeBounds;
 }
 
 /**
@@ -486,6 +623,64 @@ void Node::updateTransform() {
     }
     _combined.m[12] += _position.x-offset.x;
     _combined.m[13] += _position.y-offset.y;
+    _affine = !_useTransform || isAffine(_combined);
+    setWorldDirty();
+    if (_parent) { _parent->setContentDirty(); }
+}
+
+/**
+ * Marks the world transform of this node and its descendants as dirty.
+ *
+ * Descendants of a dirty node are always dirty, so this stops at any
+ * node that is already dirty.
+ */
+void Node::setWorldDirty() {
+    setBoundsDirty();
+    if (_worldDirty) {
+        return;
+    }
+    _worldDirty = true;
+    for(auto it = _children.begin(); it != _children.end(); ++it) {
+        (*it)->setWorldDirty();
+    }
+}
+
+/**
+ * Marks the subtree bounds of this node and its ancestors as dirty.
+ *
+ * Ancestors of a dirty node are always dirty, so this stops at any
+ * node that is already dirty.
+ */
+void Node::setBoundsDirty() {
+    for(Node* node = this; node != nullptr && !node->_boundsDirty; node = node->_parent) {
+        node->_boundsDirty = true;
+    }
+}
+
+/**
+ * Marks the drawing of this node as changed.
+ *
+ * This forces any static ancestor to bake its mesh again.  The built-in
+ * setters call this automatically.  A subclass with custom drawing code
+ * must call it whenever the output of draw() changes.
+ */
+void Node::setContentDirty() {
+    // Ancestors of a dirty node are always dirty
+    for(Node* node = this; node != nullptr && !node->_contentDirty; node = node->_parent) {
+        node->_contentDirty = true;
+    }
+}
+
+/**
+ * Marks this node and all of its descendants as unchanged.
+ *
+ * This is called once a static node has baked its mesh.
+ */
+void Node::cleanContent() {
+    _contentDirty = false;
+    for(auto it = _children.begin(); it != _children.end(); ++it) {
+        (*it)->cleanContent();
+    }
 }
 
 
@@ -586,14 +781,15 @@ void Node::addChild(const std::shared_ptr<Node>& child, int zval) {
     child->_zOrder = zval;
     
     // Check to see if we need resorting (including if child is dirty)
-    if (!_zDirty) {
-        if (child->_childOffset > 0) {
-            int zOther = _children.back()->getZOrder();
-            setZDirty(zOther > zval || child->isZDirty());
-        } else {
-            setZDirty(child->isZDirty());
+    if (child->_childOffset > 0) {
+        Node* last = _children.back().get();
+        if (last->_zQueued || last->_zOrder > zval) {
+            child->queueZMove(_zMoved);
         }
     }
+    if (!_zDirty) {
+        setZDirty(child->_zQueued || child->isZDirty());
+    }
     
     // Add the child
     _children.push_back(child);
@@ -618,6 +814,10 @@ void Node::addChild(const std::shared_ptr<Node>& child, int zval) {
 void Node::swapChild(const std::shared_ptr<Node>& child1, const std::shared_ptr<Node>& child2, bool inherit) {
     _children[child1->_childOffset] = child2;
     child2->_childOffset = child1->_childOffset;
+    child1->dequeueZMove(_zMoved);
+    if (child1->_zOrder != child2->_zOrder) {
+        child2->queueZMove(_zMoved);
+    }
     child2->setParent(this);
     child1->setParent(nullptr);
     child2->pushScene(_graph);
@@ -647,6 +847,7 @@ void Node::swapChild(const std::shared_ptr<Node>& child1, const std::shared_ptr<
 void Node::removeChild(unsigned int pos) {
     CUAssertLog(pos < _children.size(), "Position index out of bounds");
     std::shared_ptr<Node> child = _children[pos];
+    child->dequeueZMove(_zMoved);
     child->setParent(nullptr);
     child->pushScene(nullptr);
     child->_childOffset = -1;
@@ -715,9 +916,11 @@ void Node::removeAllChildren() {
     for(auto it = _children.begin(); it != _children.end(); ++it) {
         (*it)->setParent(nullptr);
         (*it)->_childOffset = -1;
+        (*it)->_zQueued = false;
         (*it)->pushScene(nullptr);
     }
     _children.clear();
+    _zMoved.clear();
     _zDirty = false;
 }
 
@@ -769,19 +972,42 @@ void Node::doLayout() {
  * @param z The local Z order value.
  */
 void Node::setZOrder(int z) {
+    if (_zOrder == z) {
+        return;
+    }
     _zOrder = z;
+    if (_parent) {
+        _parent->setContentDirty();
+    }
+    if (_zQueued || _childOffset < 0) {
+        return;
+    }
     
     // Notify the parent if we have a problem.
-    if (_parent != nullptr && !_parent->_zDirty) {
-        int size = (int)_parent->_children.size();
-        bool zd = (_childOffset > 0 && _parent->_children[_childOffset-1]->_zOrder > z);
-        zd = zd || (_childOffset < size-1 && _parent->_children[_childOffset+1]->_zOrder < z);
-        _parent->setZDirty(zd);
-    } else if (_graph != nullptr && !_graph->isZDirty()) {
-        int size = (int)_graph->getChildren().size();
-        bool zd = (_childOffset > 0 && _graph->getChild(_childOffset-1)->_zOrder > z);
-        zd = zd || (_childOffset < size-1 && _parent->getChild(_childOffset+1)->_zOrder < z);
-        _graph->setZDirty(zd);
+    std::vector<std::shared_ptr<Node>>* siblings = nullptr;
+    std::vector<Node*>* moved = nullptr;
+    if (_parent != nullptr) {
+        siblings = &(_parent->_children);
+        moved = &(_parent->_zMoved);
+    } else if (_graph != nullptr) {
+        siblings = &(_graph->_children);
+        moved = &(_graph->_zMoved);
+    } else {
+        return;
+    }
+    
+    // Neighbors are only trustworthy if nothing else has moved
+    int size = (int)siblings->size();
+    bool zd = !moved->empty();
+    zd = zd || (_childOffset > 0 && (*siblings)[_childOffset-1]->_zOrder > z);
+    zd = zd || (_childOffset < size-1 && (*siblings)[_childOffset+1]->_zOrder < z);
+    if (zd) {
+        queueZMove(*moved);
+        if (_parent != nullptr) {
+            _parent->setZDirty(true);
+        } else {
+            _graph->setZDirty(true);
+        }
     }
 }
 
@@ -829,6 +1055,94 @@ bool Node::compareNodeSibs(const std::shared_ptr<Node>& a, const std::shared_ptr
     (a->_zOrder == b->_zOrder && a->_childOffset < b->_childOffset);
 }
 
+/**
+ * Adds this node to the given list of children moved out of z-order.
+ *
+ * The node is only added if it is not already in the list.  The list
+ * must belong to the parent (or scene) of this node.
+ *
+ * @param moved The list of moved children of the parent
+ */
+void Node::queueZMove(std::vector<Node*>& moved) {
+    if (!_zQueued) {
+        _zQueued = true;
+        moved.push_back(this);
+    }
+}
+
+/**
+ * Removes this node from the given list of children moved out of z-order.
+ *
+ * This method is called when the node is removed from its parent.
+ *
+ * @param moved The list of moved children of the parent
+ */
+void Node::dequeueZMove(std::vector<Node*>& moved) {
+    if (_zQueued) {
+        _zQueued = false;
+        moved.erase(std::find(moved.begin(), moved.end(), this));
+    }
+}
+
+/**
+ * Restores the z-order of the given children.
+ *
+ * This method assumes that every child not in the moved list is in
+ * sorted order.  The moved children are removed, sorted, and merged back
+ * in, so the cost is proportional to the number of moved children (plus
+ * a linear merge).  If too many children have moved, it falls back to a
+ * full sort.  Either way, the moved list is empty afterwards.
+ *
+ * @param children  The children to resort
+ * @param moved     The children moved out of z-order
+ */
+void Node::resortChildren(std::vector<std::shared_ptr<Node>>& children, std::vector<Node*>& moved) {
+    if (moved.empty()) {
+        return;
+    }
+    
+    size_t first = 0;
+    if (4*moved.size() > children.size()) {
+        std::sort(children.begin(),children.end(),Node::compareNodeSibs);
+    } else {
+        // Pull out the moved children (the rest are still in order)
+        first = children.size();
+        for(auto it = moved.begin(); it != moved.end(); ++it) {
+            first = std::min(first,(size_t)(*it)->_childOffset);
+        }
+        std::vector<std::shared_ptr<Node>> displaced;
+        displaced.reserve(moved.size());
+        size_t jj = first;
+        for(size_t ii = first; ii < children.size(); ii++) {
+            if (children[ii]->_zQueued) {
+                displaced.push_back(std::move(children[ii]));
+            } else {
+                children[jj++] = std::move(children[ii]);
+            }
+        }
+        children.resize(jj);
+        
+        // Merge them back in
+        std::sort(displaced.begin(),displaced.end(),Node::compareNodeSibs);
+        auto pos = std::lower_bound(children.begin(), children.end(), displaced.front(), Node::compareNodeSibs);
+        first = std::min(first,(size_t)(pos-children.begin()));
+        size_t mid = children.size();
+        for(auto it = displaced.begin(); it != displaced.end(); ++it) {
+            children.push_back(std::move(*it));
+        }
+        std::inplace_merge(children.begin()+first, children.begin()+mid, children.end(), Node::compareNodeSibs);
+    }
+    
+    // Fix the offsets
+    for(size_t ii = first; ii < children.size(); ii++) {
+        children[ii]->_childOffset = (int)ii;
+    }
+    for(auto it = moved.begin(); it != moved.end(); ++it) {
+        (*it)->_zQueued = false;
+    }
+    moved.clear();
+}
+
 /**
  * Resorts the children of this node according to z-value.
  *
@@ -848,12 +1162,7 @@ bool Node::compareNodeSibs(const std::shared_ptr<Node>& a, const std::shared_ptr
  */
 void Node::sortZOrder() {
     if (_zDirty) {
-        std::sort(_children.begin(),_children.end(),Node::compareNodeSibs);
-        // Fix the offsets
-        int ii = 0;
-        for(auto it = _children.begin(); it != _children.end(); ++it ) {
-            (*it)->_childOffset = ii++;
-        }
+        resortChildren(_children,_zMoved);
         _zDirty = false;
         // Invariant guarantees this is the only way they are dirty
         for(auto it = _children.begin(); it != _children.end(); ++it ) {
@@ -881,18 +1190,325 @@ void Node::sortZOrder() {
  */
 void Node::render(const std::shared_ptr<SpriteBatch>& batch, const Mat4& transform, Color4 tint) {
     if (!_isVisible) { return; }
-    
     Mat4 matrix;
     Mat4::multiply(_combined,transform,&matrix);
+    renderSubtree(batch, transform, matrix, tint, false);
+}
+
+/**
+ * Draws this Node and all of its children with their cached world transforms.
+ *
+ * This is how a {@link Scene} draws its nodes.  If the scene culls, any
+ * subtree whose bounds lie outside of the viewport is skipped.
+ *
+ * @param batch     The SpriteBatch to draw with.
+ * @param tint      The tint to blend with the Node color.
+ */
+void Node::renderWorld(const std::shared_ptr<SpriteBatch>& batch, Color4 tint) {
+    if (!_isVisible) { return; }
+    
+    // A mesh being baked must be complete, whatever the camera
+    if (_graph && _graph->_culling && !batch->isRecording()) {
+        const Rect& bounds = getSubtreeBounds();
+        if (!_subtreeUnbounded && !bounds.doesIntersect(_graph->_viewBounds)) {
+            _graph->_culledTotal += _subtreeCount;
+            return;
+        }
+    }
+    const Mat4& transform = (_parent ? _parent->worldTransform() : Mat4::IDENTITY);
+    renderSubtree(batch, transform, worldTransform(), tint, true);
+}
+
+/**
+ * Draws this visible Node and all of its children.
+ *
+ * This is the part of render() and renderWorld() after the transform is
+ * known.  The children are drawn with renderWorld() if world is true,
+ * and with render() otherwise.
+ *
+ * @param batch     The SpriteBatch to draw with.
+ * @param transform The global transformation matrix of the parent.
+ * @param matrix    The global transformation matrix of this node.
+ * @param tint      The tint to blend with the Node color.
+ * @param world     Whether the matrices are the cached world transforms
+ */
+void Node::renderSubtree(const std::shared_ptr<SpriteBatch>& batch, const Mat4& transform,
+                         const Mat4& matrix, Color4 tint, bool world) {
+    if (_static && !batch->isRecording()) {
+        renderStatic(batch, transform, tint);
+        return;
+    }
+    if (_cacheAsBitmap) {
+        if (batch->isRecording()) {
+            // A mesh bakes the full subtree and cleans it, leaving the texture stale
+            releaseCache();
+        } else if (renderCached(batch, matrix, tint)) {
+            return;
+        }
+    }
+    
     Color4 color = _tintColor;
     if (_hasParentColor) {
         color *= tint;
     }
 
+    if (_graph) { _graph->_drawnTotal++; }
     draw(batch,matrix,color);
     for(auto it = _children.begin(); it != _children.end(); ++it) {
-        (*it)->render(batch, matrix, color);
+        if (world) {
+            (*it)->renderWorld(batch, color);
+        } else {
+            (*it)->render(batch, matrix, color);
+        }
+    }
+}
+
+/**
+ * Draws this static subtree from its retained mesh.
+ *
+ * The mesh is baked first if it is missing or out of date.  The
+ * arguments are those that render() would receive.
+ *
+ * @param batch     The SpriteBatch to draw with.
+ * @param transform The global transformation matrix.
+ * @param tint      The tint to blend with the Node color.
+ */
+void Node::renderStatic(const std::shared_ptr<SpriteBatch>& batch, const Mat4& transform, Color4 tint) {
+    if (_staticMesh == nullptr) {
+        _staticMesh = SpriteMesh::alloc();
+        _contentDirty = true;
+    }
+    // Moving this node moves the whole mesh, so compare our own matrix
+    Mat4 matrix;
+    Mat4::multiply(_combined, transform, &matrix);
+    if (_contentDirty || _staticTransform != matrix || _staticTint != tint) {
+        batch->beginRecording(_staticMesh);
+        render(batch, transform, tint);
+        batch->endRecording();
+        _staticTransform = matrix;
+        _staticTint = tint;
+        cleanContent();
+    }
+    if (_graph) { _graph->_drawnTotal++; }
+    batch->draw(_staticMesh);
+}
+
+/**
+ * Sets whether this subtree is drawn from a retained mesh.
+ *
+ * A static subtree bakes everything it draws (fully transformed and
+ * tinted) into a {@link SpriteMesh} on the GPU.  Later frames draw that
+ * mesh with one call per texture, skipping the subtree entirely.  The
+ * mesh is baked again whenever a node in the subtree changes, or when
+ * this node is drawn with a different transform or tint.
+ *
+ * This is intended for layers that rarely change, such as backgrounds
+ * and decorations.  The default value is false.
+ *
+ * @param value Whether this subtree is drawn from a retained mesh.
+ */
+void Node::setStatic(bool value) {
+    _static = value;
+    if (!_static) {
+        _staticMesh = nullptr;
+    }
+    setContentDirty();
+}
+
+/**
+ * Draws this cached subtree from its offscreen texture.
+ *
+ * The texture is drawn first if it is missing or out of date. This
+ * method returns false, drawing nothing, if the subtree cannot be
+ * cached.  The caller should then draw it normally.
+ *
+ * @param batch     The SpriteBatch to draw with.
+ * @param matrix    The global transformation matrix of this node.
+ * @param tint      The tint to blend with the Node color.
+ *
+ * @return true if the subtree was drawn from its texture.
+ */
+bool Node::renderCached(const std::shared_ptr<SpriteBatch>& batch, const Mat4& matrix, Color4 tint) {
+    const Rect& world = getSubtreeBounds();
+    if (_subtreeUnbounded || world.size.width <= 0 || world.size.height <= 0) {
+        releaseCache();
+        return false;
+    }
+    
+    // The length of a node unit on screen, up to the viewport size
+    Mat4 full;
+    Mat4::multiply(matrix, batch->getPerspective(), &full);
+    float scale = std::max(Vec2(full.m[0],full.m[1]).length(), Vec2(full.m[4],full.m[5]).length());
+    
+    std::shared_ptr<Texture> texture = _cacheTexture;
+    if (texture == nullptr || _contentDirty || scale > _cacheScale*1.01f || scale < _cacheScale*0.5f) {
+        static GLint maxSize = 0;
+        if (maxSize == 0) {
+            glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        }
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        float sx = Vec2(full.m[0]*viewport[2], full.m[1]*viewport[3]).length()/2;
+        float sy = Vec2(full.m[4]*viewport[2], full.m[5]*viewport[3]).length()/2;
+        float pixels = std::max(sx, sy);
+        
+        Rect bounds = worldInverse().transform(world);
+        float extent = std::max(bounds.size.width, bounds.size.height)*pixels;
+        if (extent > maxSize) {
+            pixels *= maxSize/extent;
+        }
+        int width  = std::max(1, (int)std::ceil(bounds.size.width*pixels));
+        int height = std::max(1, (int)std::ceil(bounds.size.height*pixels));
+        size_t bytes = (size_t)width*height*4;
+        if (bytes > _bitmapCacheBudget) {
+            releaseCache();
+            return false;
+        }
+        
+        // Round the region out to whole pixels so texels are square
+        bounds.size.width  = width/pixels;
+        bounds.size.height = height/pixels;
+        if (texture == nullptr || texture->getWidth() != width || texture->getHeight() != height) {
+            releaseCache();
+            evictCaches(bytes);
+            texture = Texture::allocWithFramebuffer(width, height);
+            if (texture == nullptr) {
+                return false;
+            }
+            _cacheTexture = texture;
+            _bitmapCacheUsage += bytes;
+            _bitmapCaches.push_front(this);
+            _cacheEntry = _bitmapCaches.begin();
+        }
+        _cacheBounds = bounds;
+        _cacheScale = scale;
+        
+        // Draw the subtree in node space, without the tint of our ancestors
+        Mat4 local = Mat4::IDENTITY;
+        batch->beginTarget(texture, bounds);
+        draw(batch, local, _tintColor);
+        for(auto it = _children.begin(); it != _children.end(); ++it) {
+            (*it)->render(batch, local, _tintColor);
+        }
+        batch->endTarget();
+        cleanContent();
+    }
+    
+    // A nested cache may have evicted us while drawing, so check before moving
+    if (_cacheTexture != nullptr) {
+        _bitmapCaches.splice(_bitmapCaches.begin(), _bitmapCaches, _cacheEntry);
+    }
+    
+    if (_graph) { _graph->_drawnTotal++; }
+    GLenum equation  = batch->getBlendEquation();
+    GLenum srcFactor = batch->getSourceBlendFactor();
+    GLenum dstFactor = batch->getDestinationBlendFactor();
+    batch->setBlendEquation(GL_FUNC_ADD);
+    batch->setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    batch->setTexture(texture);
+    batch->setColor((_hasParentColor ? tint : Color4::WHITE).getPremultiplied());
+    batch->fill(_cacheBounds, Vec2::ZERO, matrix);
+    batch->setBlendFunc(srcFactor, dstFactor);
+    batch->setBlendEquation(equation);
+    return true;
+}
+
+/**
+ * Releases the offscreen texture of this node, if any.
+ *
+ * The memory is returned to the shared bitmap cache budget.
+ */
+void Node::releaseCache() {
+    if (_cacheTexture == nullptr) {
+        return;
+    }
+    _bitmapCacheUsage -= (size_t)_cacheTexture->getWidth()*_cacheTexture->getHeight()*4;
+    _bitmapCaches.erase(_cacheEntry);
+    _cacheTexture = nullptr;
+    _cacheScale = 0;
+}
+
+/**
+ * Releases bitmap cache textures until the given amount fits the budget.
+ *
+ * Textures are released in least-recently-drawn order.  The nodes keep
+ * caching, and draw their textures again when next rendered.
+ *
+ * @param bytes     The memory (in bytes) about to be allocated
+ */
+void Node::evictCaches(size_t bytes) {
+    while (!_bitmapCaches.empty() && _bitmapCacheUsage+bytes > _bitmapCacheBudget) {
+        _bitmapCaches.back()->releaseCache();
+    }
+}
+
+/**
+ * Sets whether this subtree is drawn from an offscreen texture.
+ *
+ * A cached subtree is drawn once into a texture sized to its bounds,
+ * and is then drawn as a single textured quad.  The texture is redrawn
+ * whenever a node in the subtree changes, or when this node is scaled
+ * up (or far down) from the size the texture was made for.
+ *
+ * @param value Whether this subtree is drawn from an offscreen texture.
+ */
+void Node::setCacheAsBitmap(bool value) {
+    _cacheAsBitmap = value;
+    if (!_cacheAsBitmap) {
+        releaseCache();
     }
+    setContentDirty();
+}
+
+/**
+ * Returns the maximum memory (in bytes) for all bitmap caches.
+ *
+ * @return the maximum memory (in bytes) for all bitmap caches.
+ */
+size_t Node::getBitmapCacheBudget() {
+    return _bitmapCacheBudget;
+}
+
+/**
+ * Sets the maximum memory (in bytes) for all bitmap caches.
+ *
+ * If the current usage exceeds the new budget, the least recently
+ * drawn textures are released immediately.
+ *
+ * @param bytes The maximum memory (in bytes) for all bitmap caches.
+ */
+void Node::setBitmapCacheBudget(size_t bytes) {
+    _bitmapCacheBudget = bytes;
+    evictCaches(0);
+}
+
+/**
+ * Returns the memory (in bytes) currently held by bitmap caches.
+ *
+ * @return the memory (in bytes) currently held by bitmap caches.
+ */
+size_t Node::getBitmapCacheUsage() {
+    return _bitmapCacheUsage;
+}
+
+/**
+ * Returns a render key for the given texture and blend state.
+ *
+ * The result is never {@link RENDER_KEY_NONE}.
+ *
+ * @param texture   The texture (nullptr for a solid color)
+ * @param equation  The blend equation
+ * @param srcFactor The source blend factor
+ * @param dstFactor The destination blend factor
+ *
+ * @return a render key for the given texture and blend state.
+ */
+Uint64 Node::makeRenderKey(const std::shared_ptr<Texture>& texture, GLenum equation,
+                           GLenum srcFactor, GLenum dstFactor) {
+    // Texture in the high word, blend state hashed into the low word
+    GLuint buffer = (texture == nullptr ? SpriteBatch::getBlankTexture() : texture)->getBuffer();
+    Uint32 blend = (((Uint32)equation*31u)+(Uint32)srcFactor)*31u+(Uint32)dstFactor;
+    return ((Uint64)buffer << 32) | (Uint64)(blend | 0x80000000u);
 }
 
 /**
@@ -384,7 +384,7 @@ void PathNode::draw(const std::shared_ptr<SpriteBatch>& batch, const Mat4& trans
         generateRenderData();
     }
     
-    batch->setColor(tint);
+    batch->setColor(_texture->isPremultiplied() ? tint.getPremultiplied() : tint);
     batch->setTexture(_texture);
     batch->setBlendEquation(_blendEquation);
     batch->setBlendFunc(_srcFactor, _dstFactor);
@@ -123,7 +123,7 @@ void PolygonNode::draw(const std::shared_ptr<SpriteBatch>& batch, const Mat4& tr
         generateRenderData();
     }
     
-    batch->setColor(tint);
+    batch->setColor(_texture->isPremultiplied() ? tint.getPremultiplied() : tint);
     batch->setTexture(_texture);
     batch->setBlendEquation(_blendEquation);
     batch->setBlendFunc(_srcFactor, _dstFactor);
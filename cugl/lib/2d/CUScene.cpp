@@ -43,6 +43,7 @@
 #include <cugl/util/CUStrings.h>
 #include <sstream>
 #include <algorithm>
+#include <cfloat>
 
 using namespace cugl;
 
@@ -63,7 +64,11 @@ _srcFactor(GL_SRC_ALPHA),
 _dstFactor(GL_ONE_MINUS_SRC_ALPHA),
 _zDirty(false),
 _zSort(false),
-_active(false)
+_active(false),
+_deferred(false),
+_culling(true),
+_drawnTotal(0),
+_culledTotal(0)
 {}
 
 /**
@@ -80,6 +85,13 @@ void Scene::dispose() {
     _zDirty = false;
     _zSort  = false;
     _active = false;
+    _deferred = false;
+    _packets.clear();
+    _queue.clear();
+    _groups.clear();
+    _culling = true;
+    _drawnTotal = 0;
+    _culledTotal = 0;
 }
 
 /**
@@ -241,14 +253,15 @@ void Scene::addChild(const std::shared_ptr<Node>& child, int zval) {
     child->_zOrder = zval;
     
     // Check to see if we need resorting (including if child is dirty)
-    if (!_zDirty) {
-        if (child->_childOffset > 0) {
-            int zOther = _children.back()->getZOrder();
-            setZDirty(zOther > zval || child->isZDirty());
-        } else {
-            setZDirty(child->isZDirty());
+    if (child->_childOffset > 0) {
+        Node* last = _children.back().get();
+        if (last->_zQueued || last->_zOrder > zval) {
+            child->queueZMove(_zMoved);
         }
     }
+    if (!_zDirty) {
+        setZDirty(child->_zQueued || child->isZDirty());
+    }
     
     // Add the child
     _children.push_back(child);
@@ -273,6 +286,10 @@ void Scene::swapChild(const std::shared_ptr<Node>& child1, const std::shared_ptr
                       bool inherit) {
     _children[child1->_childOffset] = child2;
     child2->_childOffset = child1->_childOffset;
+    child1->dequeueZMove(_zMoved);
+    if (child1->_zOrder != child2->_zOrder) {
+        child2->queueZMove(_zMoved);
+    }
     child2->setParent(nullptr);
     child1->setParent(nullptr);
     child2->pushScene(this);
@@ -302,6 +319,7 @@ void Scene::swapChild(const std::shared_ptr<Node>& child1, const std::shared_ptr
 void Scene::removeChild(unsigned int pos) {
     CUAssertLog(pos < _children.size(), "Position index out of bounds");
     std::shared_ptr<Node> child = _children[pos];
+    child->dequeueZMove(_zMoved);
     child->setParent(nullptr);
     child->pushScene(nullptr);
     child->_childOffset = -1;
@@ -372,9 +390,11 @@ void Scene::removeAllChildren() {
     for(auto it = _children.begin(); it != _children.end(); ++it) {
         (*it)->setParent(nullptr);
         (*it)->_childOffset = -1;
+        (*it)->_zQueued = false;
         (*it)->pushScene(nullptr);
     }
     _children.clear();
+    _zMoved.clear();
     _zDirty = false;
 }
 
@@ -389,12 +409,7 @@ void Scene::removeAllChildren() {
  */
 void Scene::sortZOrder() {
     if (_zDirty) {
-        std::sort(_children.begin(),_children.end(),Node::compareNodeSibs);
-        // Fix the offsets
-        int ii = 0;
-        for(auto it = _children.begin(); it != _children.end(); ++it ) {
-            (*it)->_childOffset = ii++;
-        }
+        Node::resortChildren(_children,_zMoved);
         _zDirty = false;
         for(auto it = _children.begin(); it != _children.end(); ++it ) {
             (*it)->sortZOrder();
@@ -424,11 +439,143 @@ void Scene::render(const std::shared_ptr<SpriteBatch>& batch) {
     
     batch->begin(_camera->getCombined());
     
-    for(auto it = _children.begin(); it != _children.end(); ++it) {
-        (*it)->render(batch, Mat4::IDENTITY, _color);
+    // The viewport is the unit cube in normalized device coordinates
+    _viewBounds = _camera->getInverseProjectView().transform(Rect(-1,-1,2,2));
+    _drawnTotal  = 0;
+    _culledTotal = 0;
+    
+    if (_deferred) {
+        _packets.clear();
+        for(auto it = _children.begin(); it != _children.end(); ++it) {
+            collect(it->get(), _color);
+        }
+        sortPackets();
+        for(auto it = _queue.begin(); it != _queue.end(); ++it) {
+            RenderPacket& packet = _packets[*it];
+            if (packet.key == RENDER_KEY_NONE) {
+                packet.node->renderWorld(batch, packet.tint);
+            } else {
+                packet.node->draw(batch, packet.transform, packet.tint);
+            }
+        }
+    } else {
+        for(auto it = _children.begin(); it != _children.end(); ++it) {
+            (*it)->renderWorld(batch, _color);
+        }
     }
 
     batch->end();
     batch->setBlendFunc(_srcFactor, _dstFactor);
     batch->setBlendEquation(_blendEquation);
 }
+
+#pragma mark -
+#pragma mark Internal Helpers
+/**
+ * Collects draw packets for the given node and its descendants.
+ *
+ * Packets are appended in pre-order.  Invisible subtrees, culled subtrees
+ * and nodes that draw nothing of their own are skipped.  A static or
+ * cached subtree becomes a single packet for its mesh or texture.
+ *
+ * @param node      The node to collect
+ * @param tint      The absolute tint of the parent
+ */
+void Scene::collect(Node* node, Color4 tint) {
+    if (!node->_isVisible) { return; }
+    if (_culling) {
+        const Rect& bounds = node->getSubtreeBounds();
+        if (!node->_subtreeUnbounded && !bounds.doesIntersect(_viewBounds)) {
+            _culledTotal += node->_subtreeCount;
+            return;
+        }
+    }
+    if (node->_static || node->_cacheAsBitmap) {
+        RenderPacket packet;
+        packet.node = node;
+        packet.tint = tint;
+        packet.key  = RENDER_KEY_NONE;
+        packet.bounds = node->getSubtreeBounds();
+        if (node->_subtreeUnbounded) {
+            packet.bounds = Rect(-FLT_MAX/2, -FLT_MAX/2, FLT_MAX, FLT_MAX);
+        }
+        _packets.push_back(packet);
+        return;
+    }
+    _drawnTotal++;
+    
+    // Mirror Node::render so that draw() gets identical arguments
+    const Mat4& matrix = node->worldTransform();
+    Color4 color = node->_tintColor;
+    if (node->_hasParentColor) {
+        color *= tint;
+    }
+    
+    Uint64 key = node->getRenderKey();
+    if (key != RENDER_KEY_NONE) {
+        RenderPacket packet;
+        packet.node = node;
+        packet.transform = matrix;
+        packet.tint = color;
+        packet.key  = key;
+        if (node->_cullable) {
+            packet.bounds = matrix.transform(Rect(Vec2::ZERO, node->_contentSize));
+        } else {
+            // Drawing may leave the bounds, so never move this past anything
+            packet.bounds = Rect(-FLT_MAX/2, -FLT_MAX/2, FLT_MAX, FLT_MAX);
+        }
+        _packets.push_back(packet);
+    }
+    for(auto it = node->_children.begin(); it != node->_children.end(); ++it) {
+        collect(it->get(), color);
+    }
+}
+
+/**
+ * Orders the collected packets so that equal states are adjacent.
+ *
+ * Each packet joins the latest group with the same state, provided no
+ * packet of a later group overlaps it.  Otherwise it starts a new group.
+ * The queue is then sorted once by group, so that it submits the groups
+ * in order of creation.  Packets that overlap never change their relative
+ * order.  Static and cached subtrees are never grouped.
+ */
+void Scene::sortPackets() {
+    _groups.clear();
+    for(unsigned int ii = 0; ii < _packets.size(); ii++) {
+        RenderPacket& packet = _packets[ii];
+        packet.group = (unsigned int)_groups.size();
+        
+        // Search back through the later groups, as they are drawn in between
+        size_t seen = 0;
+        bool blocked = false;
+        for(size_t gg = _groups.size(); gg > 0 && !blocked && seen < RENDER_QUEUE_WINDOW; gg--) {
+            unsigned int newest = _groups[gg-1];
+            if (packet.key != RENDER_KEY_NONE && _packets[newest].key == packet.key) {
+                packet.group = (unsigned int)(gg-1);
+                break;
+            }
+            for(unsigned int jj = newest; jj != RENDER_GROUP_END && !blocked &&
+                seen < RENDER_QUEUE_WINDOW; jj = _packets[jj].next) {
+                blocked = _packets[jj].bounds.doesIntersect(packet.bounds);
+                seen++;
+            }
+        }
+        
+        if (packet.group == _groups.size()) {
+            packet.next = RENDER_GROUP_END;
+            _groups.push_back(ii);
+        } else {
+            packet.next = _groups[packet.group];
+            _groups[packet.group] = ii;
+        }
+    }
+    
+    _queue.resize(_packets.size());
+    for(unsigned int ii = 0; ii < _packets.size(); ii++) {
+        _queue[ii] = ii;
+    }
+    std::stable_sort(_queue.begin(), _queue.end(), [this](unsigned int a, unsigned int b) {
+        return _packets[a].group < _packets[b].group;
+    });
+}
@@ -350,8 +350,15 @@ bool TexturedNode::initWithData(const SceneLoader* loader, const std::shared_ptr
 void TexturedNode::setTexture(const std::shared_ptr<Texture>& texture) {
     std::shared_ptr<Texture> temp = (texture == nullptr ? SpriteBatch::getBlankTexture() : texture);
     if (_texture != temp) {
+        // Follow the alpha convention of the texture, unless the blend is custom
+        bool was = _texture != nullptr && _texture->isPremultiplied();
+        if (was != temp->isPremultiplied() && _dstFactor == GL_ONE_MINUS_SRC_ALPHA &&
+            _srcFactor == (was ? GL_ONE : GL_SRC_ALPHA)) {
+            _srcFactor = (was ? GL_SRC_ALPHA : GL_ONE);
+        }
         _texture = temp;
         updateTextureCoords();
+        setContentDirty();
     }
 }
 
@@ -384,11 +391,15 @@ void TexturedNode::setPolygon(const Poly2& poly) {
  */
 void TexturedNode::shiftPolygon(float dx, float dy) {
     _polygon += Vec2(dx,dy);
-    float w = (float)_texture->getWidth();
-    float h = (float)_texture->getHeight();
+    setContentDirty();
+    // Scale by the texture span, as the texture may be a region of an atlas
+    float ds = dx*(_texture->getMaxS()-_texture->getMinS())/_texture->getWidth();
+    float dt = dy*(_texture->getMaxT()-_texture->getMinT())/_texture->getHeight();
+    if (_flipHorizontal) { ds = -ds; }
+    if (_flipVertical)   { dt = -dt; }
     for(auto it = _vertices.begin(); it != _vertices.end(); ++it) {
-        it->texcoord.x += dx/w;
-        it->texcoord.y -= dy/h;
+        it->texcoord.x += ds;
+        it->texcoord.y -= dt;
     }
 }
 
@@ -486,7 +497,7 @@ void TexturedNode::generateRenderData() {
 void TexturedNode::clearRenderData() {
     _vertices.clear();
     _rendered = false;
-    
+    setContentDirty();
 }
 
 /**
@@ -497,6 +508,7 @@ void TexturedNode::clearRenderData() {
  * of the texture.
  */
 void TexturedNode::updateTextureCoords() {
+    setContentDirty();
     if (!_rendered) {
         return;
     }
@@ -505,14 +517,12 @@ void TexturedNode::updateTextureCoords() {
     float h = (float)_texture->getHeight();
     Vec2 offset = _polygon.getBounds().origin;
     for(auto it = _vertices.begin(); it != _vertices.end(); ++it) {
-        it->texcoord.x = (it->position.x+offset.x)/w;
-        it->texcoord.y = (it->position.y+offset.y)/h;
-        if (_flipHorizontal) {
-            it->texcoord.x = 1-it->texcoord.x;
-        }
-        if (!_flipVertical) {
-            it->texcoord.y = 1-it->texcoord.y;
-        }
+        float s = (it->position.x+offset.x)/w;
+        float t = (it->position.y+offset.y)/h;
+        if (_flipHorizontal) { s = 1-s; }
+        if (!_flipVertical)  { t = 1-t; }
+        it->texcoord.x = s*_texture->getMaxS()+(1-s)*_texture->getMinS();
+        it->texcoord.y = t*_texture->getMaxT()+(1-t)*_texture->getMinT();
     }
 }
 
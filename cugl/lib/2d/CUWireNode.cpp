@@ -377,7 +377,7 @@ void WireNode::draw(const std::shared_ptr<SpriteBatch>& batch, const Mat4& trans
         generateRenderData();
     }
     
-    batch->setColor(tint);
+    batch->setColor(_texture->isPremultiplied() ? tint.getPremultiplied() : tint);
     batch->setTexture(_texture);
     batch->setBlendEquation(_blendEquation);
     batch->setBlendFunc(_srcFactor, _dstFactor);
@@ -46,17 +46,21 @@
 //  Version: 1/7/18
 //
 #include <cugl/cugl.h>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
 
 using namespace cugl;
 
 #pragma mark -
 #pragma mark Constructors
 /**
- * Initializes a new asset manager with two auxiliary threads.
+ * Initializes a new asset manager with one auxiliary thread per spare core.
  *
- * The asset manager will have a thread pool of size 2, giving it two
- * threads to load assets asynchronously.  These threads have no effect on
- * synchronous loading and will sleep when no assets are being loaded.
+ * The asset manager will have a thread pool with one thread for each CPU
+ * core other than the main one (and at least one thread).  These threads
+ * load assets asynchronously.  They have no effect on synchronous loading
+ * and will sleep when no assets are being loaded.
  *
  * This initializer does not attach any loaders.  It simply creates an
  * object that is ready to accept loader objects.
@@ -64,7 +68,27 @@ using namespace cugl;
  * @return true if the asset manager was initialized successfully
  */
 bool AssetManager::init() {
-    _workers = ThreadPool::alloc(1);
+    return init((unsigned int)std::max(1,SDL_GetCPUCount()-1));
+}
+
+/**
+ * Initializes a new asset manager with the given number of auxiliary threads.
+ *
+ * The asset manager will have a thread pool of the given size, allowing it
+ * load assets asynchronously.  These threads have no effect on synchronous
+ * loading and will sleep when no assets are being loaded.  If threads is
+ * 0, all assets are loaded in the main thread, even asynchronous ones.
+ *
+ * This initializer does not attach any loaders.  It simply creates an
+ * object that is ready to accept loader objects.
+ *
+ * @param threads   The number of threads for asynchronous loading
+ *
+ * @return true if the asset manager was initialized successfully
+ */
+bool AssetManager::init(unsigned int threads) {
+    _workers = threads > 0 ? ThreadPool::alloc(threads) : nullptr;
+    _cache = AssetCache::alloc(Application::get()->getSaveDirectory()+"cache");
     return true;
 }
 
@@ -77,11 +101,55 @@ bool AssetManager::init() {
  */
 void AssetManager::dispose() {
     detachAll();
+    _requests.clear();
     _workers = nullptr;
+    _cache = nullptr;
 }
 
 #pragma mark -
 #pragma mark Internal Asset Loading
+/**
+ * Returns the size in bytes of the source of the given directory entry.
+ *
+ * This is the weight of the asset for {@link AssetManager#progress}.  An
+ * entry without a source file (such as an inline scene) has weight 1.
+ *
+ * @param json  The directory entry for the asset
+ *
+ * @return the size in bytes of the source of the given directory entry.
+ */
+static size_t sourceBytes(const std::shared_ptr<JsonValue>& json) {
+    std::vector<std::string> files;
+    if (json->isString()) {
+        files.push_back(json->asString());
+    } else if (json->has("pack")) {
+        std::shared_ptr<JsonValue> pack = json->get("pack");
+        for(int ii = 0; ii < pack->size(); ii++) {
+            files.push_back(pack->get(ii)->asString());
+        }
+    } else if (json->has("file")) {
+        files.push_back(json->getString("file"));
+    }
+    
+    size_t result = 0;
+    std::shared_ptr<AssetPack> assets = AssetPack::get();
+    for(auto it = files.begin(); it != files.end(); ++it) {
+        AssetPack::Entry entry;
+        if (assets != nullptr && assets->find(*it,entry)) {
+            result += (size_t)entry.size;
+            continue;
+        }
+        std::string path = Application::get()->getAssetDirectory()+*it;
+        SDL_RWops* file = SDL_RWFromFile(path.c_str(),"rb");
+        if (file != nullptr) {
+            Sint64 size = SDL_RWsize(file);
+            result += (size > 0 ? (size_t)size : 0);
+            SDL_RWclose(file);
+        }
+    }
+    return std::max(result,(size_t)1);
+}
+
 /**
  * Synchronously reads an asset category from a JSON file
  *
@@ -126,55 +194,47 @@ bool AssetManager::readCategory(size_t hash, const std::shared_ptr<JsonValue>& j
 }
 
 /**
- * Asynchronously reads an asset category from a JSON file
+ * Adds an asset category to the dependency graph for asynchronous loading.
  *
- * JSON directories provide a robust way for us to load a collection of
- * assets. Instead of having to define parameters like asset key, font
- * size, or texture wrap in the code, we can specify them in a JSON file.
- * This JSON file (called the asset directory) is read by the asset manager,
- * and directs the various loaders to load in assets.
+ * Each asset in the category becomes a {@link Request}.  Assets that are
+ * already loaded, or already requested, are skipped.  Nothing is handed
+ * to the loaders yet, as dependencies may refer to assets in categories
+ * that have not been added.
  *
- * Currently JSON loading supports five types of assets, with the following
- * names: "textures", "fonts", "music", "soundfx", and "jsons".  See the
- * method {@link BaseLoader#read} in each of the individual loaders for a
- * description of the suported JSON format. A loader must still be attached
- * for the asset manager to read that type of asset.  If the asset directory
- * contains an asset for which there is no attached asset manager, those
- * specific assets will not be loaded.
- *
- * As an asynchronous read, all asset loading will take place outside of
- * the main thread.  However, assets such as fonts and textures will need
- * the OpenGL context to complete, so part of their asset loading may take
- * place in the main thread via the {@link Application#schedule} interface.
- * You may either poll this interface to determine when the assets are
- * loaded or use optional callbacks.
- *
- * The optional callback function will be called each time an individual
- * asset loads or fails to load.  However, if the entire category fails
- * to load, the callback function will be given the asset category name
- * (e.g. "soundfx") as the asset key.
+ * If there is no loader for this category, the callback function will
+ * be given the asset category name (e.g. "soundfx") as the asset key.
  *
  * @param hash      The hash of the asset type
  * @param json      The child of asset directory with these assets
  * @param callback  An optional callback after each asset is loaded
+ * @param added     The list to append the new requests to
  */
 void AssetManager::readCategory(size_t hash, const std::shared_ptr<JsonValue>& json,
-                                LoaderCallback callback) {
+                                LoaderCallback callback, std::vector<AssetId>& added) {
     auto it = _handlers.find(hash);
-    std::shared_ptr<BaseLoader> loader = it->second;
-    if (loader == nullptr) {
+    if (it == _handlers.end() || it->second == nullptr) {
         if (callback) {
-            Application::get()->schedule([=] {
-                callback(json->key(),false);
-                return false;
-            });
+            callback(json->key(),false);
         }
         return;
     }
     
+    std::shared_ptr<BaseLoader> loader = it->second;
     for(int ii = 0; ii < json->size(); ii++) {
         std::shared_ptr<JsonValue> child = json->get(ii);
-        loader->loadAsync(child, callback);
+        AssetId id(hash,child->key());
+        if (_requests.find(id) != _requests.end() || loader->contains(child->key())) {
+            continue;
+        }
+        
+        Request& request = _requests[id];
+        request.json = child;
+        request.callback = callback;
+        request.blockers = 0;
+        request.issued = false;
+        request.bytes = sourceBytes(child);
+        _pendingBytes += request.bytes;
+        added.push_back(id);
     }
 }
 
@@ -212,49 +272,115 @@ bool AssetManager::purgeCategory(size_t hash, const std::shared_ptr<JsonValue>&
 }
 
 /**
- * Synchronizes the asset manager to wait until all assets have finished.
+ * Links the given requests to the requests they depend on.
  *
- * This method is necessary for assets whose construction depends on
- * previously loaded assets (e.g. scene graphs).  In the current architecture,
- * this method is only correct if the asset manager loads assets in a
- * single thread.
+ * Dependencies are reported by {@link BaseLoader#getDependencies}.  A
+ * dependency that is already loaded is ignored.  A dependency on a key
+ * that is neither loaded nor requested (such as a region of a texture
+ * atlas) waits on every pending request of that asset type.
+ *
+ * @param added     The newly added requests
  */
-void AssetManager::sync() {
-    _workers->addTask([=](void) {
-        this->block();
-        this->block(); // Two blocks force one complete cycle
-    });
+void AssetManager::linkRequests(const std::vector<AssetId>& added) {
+    std::vector<AssetId> deps;
+    for(auto it = added.begin(); it != added.end(); ++it) {
+        Request& request = _requests[*it];
+        deps.clear();
+        _handlers[it->first]->getDependencies(request.json,deps);
+        
+        for(auto jt = deps.begin(); jt != deps.end(); ++jt) {
+            if (*jt == *it) {
+                continue;
+            }
+            auto kt = _requests.find(*jt);
+            if (kt != _requests.end()) {
+                kt->second.dependents.push_back(*it);
+                request.blockers++;
+                continue;
+            }
+            
+            auto ht = _handlers.find(jt->first);
+            if (ht == _handlers.end() || ht->second->contains(jt->second)) {
+                continue;
+            }
+            
+            // Unknown key: wait on everything of that type
+            for(kt = _requests.begin(); kt != _requests.end(); ++kt) {
+                if (kt->first.first == jt->first && kt->first != *it) {
+                    kt->second.dependents.push_back(*it);
+                    request.blockers++;
+                }
+            }
+        }
+    }
 }
 
 /**
- * Blocks the asset manager until the next animation frame.
+ * Hands the given request to its loader.
+ *
+ * The request must have no unfinished dependencies.  Its callback is
+ * wrapped so that {@link completeRequest} is called when it finishes.
  *
- * Any assets queued after a block will not be added to thread pool
- * until at least one animation frame has passed.  This method is used
- * to implement the {@link sync()} method.
+ * @param id    The request identifier
  */
-void AssetManager::block() {
-    Application::get()->schedule([=](void){
-        this->resume();
-        return false;
+void AssetManager::issueRequest(const AssetId& id) {
+    auto it = _requests.find(id);
+    if (it == _requests.end() || it->second.issued) {
+        return;
+    }
+    it->second.issued = true;
+    
+    // Copy everything out first; without workers the load completes re-entrantly
+    std::shared_ptr<BaseLoader> loader = _handlers[id.first];
+    std::shared_ptr<JsonValue> json = it->second.json;
+    LoaderCallback callback = it->second.callback;
+    std::shared_ptr<bool> done = std::make_shared<bool>(false);
+    bool scheduled = loader->loadAsync(json, [=](const std::string& key, bool success) {
+        *done = true;
+        if (callback) {
+            callback(key,success);
+        }
+        this->completeRequest(id);
     });
-    _wait = true;
-    while (_wait) {
-        int delay = (int)(500/Application::get()->getFPS());
-        SDL_Delay(delay);
+    
+    // A load that never reached a worker may skip the callback, pool or not
+    if (!scheduled && !*done) {
+        bool success = loader->contains(id.second);
+        if (callback) {
+            callback(id.second,success);
+        }
+        completeRequest(id);
     }
-    return;
 }
 
 /**
- * Resumes a previously blocked the asset manager.
+ * Records that the given request has finished loading.
  *
- * Any assets queued after a block will not be added to thread pool
- * until at least one animation frame has passed.  This method is used
- * to implement the {@link sync()} method.
+ * Any dependents with no other unfinished dependencies are handed to
+ * their loaders.  This method is called in the main thread, whether
+ * or not the asset loaded successfully.
+ *
+ * @param id    The request identifier
  */
-void AssetManager::resume() {
-    _wait = false;
+void AssetManager::completeRequest(const AssetId& id) {
+    auto it = _requests.find(id);
+    if (it == _requests.end()) {
+        return;
+    }
+    std::vector<AssetId> dependents = std::move(it->second.dependents);
+    _pendingBytes -= it->second.bytes;
+    _loadedBytes  += it->second.bytes;
+    _requests.erase(it);
+    
+    for(auto jt = dependents.begin(); jt != dependents.end(); ++jt) {
+        auto kt = _requests.find(*jt);
+        if (kt != _requests.end() && kt->second.blockers > 0) {
+            kt->second.blockers--;
+            if (kt->second.blockers == 0) {
+                issueRequest(*jt);
+            }
+        }
+    }
 }
 
 #pragma mark -
@@ -334,13 +460,11 @@ bool AssetManager::loadDirectory(const std::shared_ptr<JsonValue>& json) {
  * @return true if all assets specified in the directory were successfully loaded.
  */
 bool AssetManager::loadDirectory(const std::string& directory) {
-    std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(directory);
-    if (reader == nullptr) {
+    std::shared_ptr<JsonValue> json = readJson(directory);
+    if (json == nullptr) {
         CULogError("No asset directory located at '%s'",directory.c_str());
         return false;
     }
-    
-    std::shared_ptr<JsonValue> json = reader->readJson();
     return loadDirectory(json);
 }
 
@@ -377,28 +501,37 @@ bool AssetManager::loadDirectory(const std::string& directory) {
  * @param callback  An optional callback after each asset is loaded
  */
 void AssetManager::loadDirectoryAsync(const std::shared_ptr<JsonValue>& json, LoaderCallback callback) {
+    if (_requests.empty()) {
+        _loadedBytes  = 0;
+        _pendingBytes = 0;
+    }
+    
+    std::vector<AssetId> added;
     for(int ii = 0; ii < json->size(); ii++) {
         std::shared_ptr<JsonValue> child = json->get(ii);
         if (child->key() == "textures") {
-            readCategory(typeid(Texture).hash_code(),child,callback);
+            readCategory(typeid(Texture).hash_code(),child,callback,added);
         } else if (child->key() == "soundfx") {
-            readCategory(typeid(Sound).hash_code(),child,callback);
+            readCategory(typeid(Sound).hash_code(),child,callback,added);
         } else if (child->key() == "music") {
-            readCategory(typeid(Music).hash_code(),child,callback);
+            readCategory(typeid(Music).hash_code(),child,callback,added);
         } else if (child->key() == "fonts") {
-            readCategory(typeid(Font).hash_code(),child,callback);
+            readCategory(typeid(Font).hash_code(),child,callback,added);
         } else if (child->key() == "jsons") {
-            readCategory(typeid(JsonValue).hash_code(),child,callback);
-        } else if (child->key() != "scenes") {
+            readCategory(typeid(JsonValue).hash_code(),child,callback,added);
+        } else if (child->key() == "scenes") {
+            readCategory(typeid(Node).hash_code(),child,callback,added);
+        } else {
             CULogError("Unknown asset category '%s'",child->key().c_str());
         }
     }
     
-    // Scenes are read after everything else.
-    std::shared_ptr<JsonValue> child = json->get("scenes");
-    sync();
-    if (child) {
-        readCategory(typeid(Node).hash_code(),child,callback);
+    linkRequests(added);
+    for(auto it = added.begin(); it != added.end(); ++it) {
+        auto jt = _requests.find(*it);
+        if (jt != _requests.end() && !jt->second.issued && jt->second.blockers == 0) {
+            issueRequest(*it);
+        }
     }
 }
 
@@ -435,18 +568,29 @@ void AssetManager::loadDirectoryAsync(const std::shared_ptr<JsonValue>& json, Lo
  * @param callback  An optional callback after each asset is loaded
  */
 void AssetManager::loadDirectoryAsync(const std::string& directory, LoaderCallback callback) {
-    _preload = true;
-    
-    std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(directory);
-    if (reader == nullptr && callback != nullptr) {
-        callback("",false);
+    if (_workers == nullptr) {
+        std::shared_ptr<JsonValue> json = readJson(directory);
+        if (json != nullptr) {
+            loadDirectoryAsync(json,callback);
+        } else if (callback) {
+            callback("",false);
+        }
         return;
     }
     
+    // Parse off the main thread, but build the graph on it
+    _preload = true;
     _workers->addTask([=](void) {
-        std::shared_ptr<JsonValue> json = reader->readJson();
-        loadDirectoryAsync(json,callback);
-        _preload = false;
+        std::shared_ptr<JsonValue> json = this->readJson(directory);
+        Application::get()->schedule([=](void) {
+            if (json != nullptr) {
+                this->loadDirectoryAsync(json,callback);
+            } else if (callback) {
+                callback("",false);
+            }
+            this->_preload = false;
+            return false;
+        });
     });
 }
 
@@ -496,16 +640,35 @@ bool AssetManager::unloadDirectory(const std::shared_ptr<JsonValue>& json) {
  * @param directory The path to the JSON asset directory
  */
 bool AssetManager::unloadDirectory(const std::string& directory) {
-    std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(directory);
-    if (reader == nullptr) {
+    std::shared_ptr<JsonValue> json = readJson(directory);
+    if (json == nullptr) {
         CULogError("No asset directory located at '%s'",directory.c_str());
         return false;
     }
-    
-    std::shared_ptr<JsonValue> json = reader->readJson();
     return unloadDirectory(json);
 }
 
+/**
+ * Returns the JSON in the given asset file.
+ *
+ * If there is a cache, the JSON is read from it when the file has not
+ * changed since it was cached (see {@link AssetCache#readJson}).  Otherwise
+ * it is parsed with {@link JsonReader}.  This method is safe to call from
+ * any thread.
+ *
+ * @param source    The JSON file, relative to the asset directory
+ *
+ * @return the JSON in the given asset file (nullptr on failure)
+ */
+std::shared_ptr<JsonValue> AssetManager::readJson(const std::string& source) const {
+    std::shared_ptr<AssetCache> cache = _cache;
+    if (cache != nullptr) {
+        return cache->readJson(source);
+    }
+    std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(source);
+    return (reader == nullptr ? nullptr : reader->readJson());
+}
+
 #pragma mark -
 #pragma mark Progress Monitoring
 /**
@@ -546,5 +709,512 @@ size_t AssetManager::waitCount() const {
     for(auto it = _handlers.begin(); it != _handlers.end(); ++it) {
         result += it->second->waitCount();
     }
+    for(auto it = _requests.begin(); it != _requests.end(); ++it) {
+        if (!it->second.issued) {
+            result++;
+        }
+    }
     return _preload ? result+1 : result;
 }
+
+/**
+ * Returns the loader progress as a percentage.
+ *
+ * This method returns a value between 0 and 1.  A value of 0 means no
+ * assets have been loaded.  A value of 1 means that all assets have been 
+ * loaded.
+ *
+ * Anything in-between indicates that there are assets which have been 
+ * loaded asynchronously and have not completed loading. It is not safe to 
+ * use asynchronously loaded assets until all loading is complete.
+ *
+ * Assets from an asynchronous directory load are weighted by the size of
+ * their source files, so one large texture counts for more than many
+ * small sounds.  Other asynchronous loads count each asset equally.
+ *
+ * @return the loader progress as a percentage.
+ */
+float AssetManager::progress() const {
+    if (_preload) {
+        return 0.0f;
+    } else if (_loadedBytes+_pendingBytes > 0) {
+        return ((float)_loadedBytes)/(_loadedBytes+_pendingBytes);
+    }
+    size_t size = loadCount()+waitCount();
+    return (size == 0 ? 0.0f : ((float)loadCount())/size);
+}
+
+#pragma mark -
+#pragma mark Memory Management
+/**
+ * Returns the memory used by all loaded assets in bytes.
+ *
+ * The value returned is the sum of the memory for all attached loaders.
+ * See {@link BaseLoader#getMemory}.
+ *
+ * @return the memory used by all loaded assets in bytes.
+ */
+size_t AssetManager::getMemory() const {
+    size_t result = 0;
+    for(auto it = _handlers.begin(); it != _handlers.end(); ++it) {
+        result += it->second->getMemory();
+    }
+    return result;
+}
+
+#pragma mark -
+#pragma mark Asset Cache
+/** The first word of every cache file ("CUAC") */
+#define CACHE_MAGIC     0x43415543
+/** The version of the cache file layout (bump to invalidate every entry) */
+#define CACHE_VERSION   1
+/** The suffix of cache files */
+#define CACHE_SUFFIX    ".bin"
+/** The size of the chunks read when hashing a source file */
+#define CACHE_CHUNK     (64*1024)
+/** The FNV-1a 64-bit offset basis */
+#define FNV_OFFSET      0xcbf29ce484222325ULL
+/** The FNV-1a 64-bit prime */
+#define FNV_PRIME       0x100000001b3ULL
+
+/**
+ * Returns the hash updated with the given word
+ *
+ * This is FNV-1a over 64-bit words rather than bytes, which is four to
+ * eight times faster and plenty for detecting a changed file.
+ *
+ * @param hash  The current hash
+ * @param word  The word to add
+ *
+ * @return the hash updated with the given word
+ */
+static inline Uint64 mixHash(Uint64 hash, Uint64 word) {
+    return (hash ^ word)*FNV_PRIME;
+}
+
+/**
+ * Returns the stamp for the current contents of the given source files
+ *
+ * The sources are relative to the asset directory.  This method returns
+ * 0 if any of the sources cannot be read.
+ *
+ * @param sources   The source files of an entry
+ *
+ * @return the stamp for the current contents of the given source files
+ */
+Uint64 AssetCache::stamp(const std::vector<std::string>& sources) const {
+    std::string root = Application::get()->getAssetDirectory();
+    std::shared_ptr<AssetPack> pack = AssetPack::get();
+    Uint64 hash = FNV_OFFSET;
+    std::vector<Uint8> buffer;
+    for(auto it = sources.begin(); it != sources.end(); ++it) {
+        // A pack records the hash of each entry, so nothing need be read
+        AssetPack::Entry entry;
+        if (pack != nullptr && pack->find(*it,entry)) {
+            hash = mixHash(mixHash(hash, entry.size), entry.hash);
+            continue;
+        }
+        
+        std::string path = root+(*it);
+        SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+        if (file == nullptr) {
+            return 0;
+        }
+        hash = mixHash(hash, (Uint64)SDL_RWsize(file));
+        
+        // Prefer the modification time, as it does not require reading the file
+        Pathname pathname(path);
+        Uint64 modified = pathname.isAbsolute() ? pathname.lastModified() : 0;
+        if (modified != 0) {
+            hash = mixHash(hash, modified);
+        } else {
+            buffer.resize(CACHE_CHUNK);
+            size_t amount = 0;
+            while ((amount = SDL_RWread(file, buffer.data(), 1, CACHE_CHUNK)) > 0) {
+                size_t ii = 0;
+                for(; ii+sizeof(Uint64) <= amount; ii += sizeof(Uint64)) {
+                    Uint64 word;
+                    std::memcpy(&word, buffer.data()+ii, sizeof(Uint64));
+                    hash = mixHash(hash, word);
+                }
+                for(; ii < amount; ii++) {
+                    hash = mixHash(hash, buffer[ii]);
+                }
+            }
+        }
+        SDL_RWclose(file);
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+/**
+ * Returns the path of the cache file for the given key
+ *
+ * @param key   The entry key
+ *
+ * @return the path of the cache file for the given key
+ */
+std::string AssetCache::entryPath(const std::string& key) const {
+    Uint64 hash = FNV_OFFSET;
+    for(auto it = key.begin(); it != key.end(); ++it) {
+        hash = mixHash(hash, (Uint8)*it);
+    }
+    char name[17];
+    SDL_snprintf(name, sizeof(name), "%08x%08x", (Uint32)(hash >> 32), (Uint32)hash);
+    return _directory+name+CACHE_SUFFIX;
+}
+
+/**
+ * Initializes a cache in the given directory.
+ *
+ * The directory is created if it does not exist.
+ *
+ * @param directory The cache directory
+ *
+ * @return true if the cache was initialized successfully
+ */
+bool AssetCache::init(const std::string& directory) {
+    if (!_directory.empty()) {
+        CUAssertLog(false, "Cache is already initialized");
+        return false; // In case asserts are off.
+    }
+    
+    Pathname path(directory);
+    if (!path.isDirectory()) {
+        path.createPath();
+    }
+    if (!path.isDirectory()) {
+        CULogError("Could not create the asset cache '%s'", directory.c_str());
+        return false;
+    }
+    
+    _directory = path.getAbsoluteName();
+    if (_directory.empty() || _directory.back() != Pathname::getSeparator()[0]) {
+        _directory.append(Pathname::getSeparator());
+    }
+    return true;
+}
+
+/**
+ * Reads the payload of the given entry, returning true on a hit.
+ *
+ * The entry is a hit if it exists and its stamp matches the current
+ * source files.  The sources are relative to the asset directory.
+ *
+ * @param key       The entry key
+ * @param sources   The source files of the entry
+ * @param data      The vector to store the payload
+ *
+ * @return true if the entry is present and up to date
+ */
+bool AssetCache::read(const std::string& key, const std::vector<std::string>& sources, std::vector<Uint8>& data) {
+    data.clear();
+    if (_directory.empty()) {
+        return false;
+    }
+    
+    SDL_RWops* file = SDL_RWFromFile(entryPath(key).c_str(), "rb");
+    if (file == nullptr) {
+        _misses++;
+        return false;
+    }
+    
+    Uint32 magic   = SDL_ReadLE32(file);
+    Uint32 version = SDL_ReadLE32(file);
+    Uint64 entry   = SDL_ReadLE64(file);
+    Uint64 rawsize = SDL_ReadLE64(file);
+    Uint64 stored  = SDL_ReadLE64(file);
+    Uint32 keysize = SDL_ReadLE32(file);
+    Sint64 remain  = SDL_RWsize(file)-SDL_RWtell(file);
+    
+    bool success = magic == CACHE_MAGIC && version == CACHE_VERSION && keysize == key.size();
+    success = success && remain >= 0 && (Uint64)remain == keysize+stored && stored <= rawsize;
+    success = success && rawsize <= (stored+1)*256;  // The best LZ4 can do
+    if (success) {
+        std::string name(keysize, ' ');
+        success = SDL_RWread(file, &name[0], 1, keysize) == keysize && name == key;
+    }
+    
+    // Only stamp the sources for a plausible entry, as stamping may hash them
+    success = success && entry == stamp(sources);
+    if (success) {
+        data.resize((size_t)rawsize);
+        if (stored == rawsize) {
+            success = SDL_RWread(file, data.data(), 1, (size_t)stored) == stored;
+        } else {
+            std::vector<Uint8> block((size_t)stored);
+            success = SDL_RWread(file, block.data(), 1, (size_t)stored) == stored;
+            success = success && decompress(block.data(), block.size(), data.data(), data.size());
+        }
+    }
+    SDL_RWclose(file);
+    
+    if (!success) {
+        data.clear();
+        _misses++;
+        return false;
+    }
+    _hits++;
+    return true;
+}
+
+/**
+ * Writes the payload of the given entry, stamped with its source files.
+ *
+ * The sources are relative to the asset directory.  This method fails
+ * if any of them cannot be read.
+ *
+ * @param key       The entry key
+ * @param sources   The source files of the entry
+ * @param data      The payload
+ *
+ * @return true if the entry was written
+ */
+bool AssetCache::write(const std::string& key, const std::vector<std::string>& sources, const std::vector<Uint8>& data) {
+    Uint64 entry = stamp(sources);
+    if (_directory.empty() || entry == 0) {
+        return false;
+    }
+    
+    std::vector<Uint8> block;
+    compress(data.data(), data.size(), block);
+    bool packed = block.size() < data.size();
+    const std::vector<Uint8>& payload = packed ? block : data;
+    
+    // Workers may write the same entry at once, so every write gets its own file
+    static std::atomic<Uint32> writes(0);
+    std::string path = entryPath(key);
+    std::string temp = path+"."+cugl::to_string((Uint64)SDL_ThreadID())+"-"+cugl::to_string(writes++)+".tmp";
+    SDL_RWops* file = SDL_RWFromFile(temp.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    
+    bool success = SDL_WriteLE32(file, CACHE_MAGIC) && SDL_WriteLE32(file, CACHE_VERSION);
+    success = success && SDL_WriteLE64(file, entry) && SDL_WriteLE64(file, data.size());
+    success = success && SDL_WriteLE64(file, payload.size()) && SDL_WriteLE32(file, (Uint32)key.size());
+    success = success && SDL_RWwrite(file, key.data(), 1, key.size()) == key.size();
+    success = success && SDL_RWwrite(file, payload.data(), 1, payload.size()) == payload.size();
+    success = (SDL_RWclose(file) == 0) && success;
+    
+    // Readers only ever see a complete entry or none at all
+    Pathname written(temp);
+    if (!success || !written.syncFile() || !written.renameTo(path)) {
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Returns the JSON in the given asset file, using the cache if possible.
+ *
+ * On a miss, the file is parsed with {@link JsonReader} and the result
+ * is written to the cache in the binary form of {@link JsonValue#toBinary}.
+ *
+ * @param source    The JSON file, relative to the asset directory
+ *
+ * @return the JSON in the given asset file (nullptr on failure)
+ */
+std::shared_ptr<JsonValue> AssetCache::readJson(const std::string& source) {
+    std::string key = "json:"+source;
+    std::vector<std::string> sources(1, source);
+    std::vector<Uint8> data;
+    if (read(key, sources, data)) {
+        std::shared_ptr<JsonValue> json = JsonValue::allocWithBinary(data.data(), data.size());
+        if (json != nullptr) {
+            return json;
+        }
+    }
+    
+    std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(source);
+    std::shared_ptr<JsonValue> json = (reader == nullptr ? nullptr : reader->readJson());
+    if (json != nullptr) {
+        data.clear();
+        json->toBinary(data);
+        write(key, sources, data);
+    }
+    return json;
+}
+
+/**
+ * Deletes every entry in this cache.
+ */
+void AssetCache::clear() {
+    if (_directory.empty()) {
+        return;
+    }
+    
+    std::vector<std::string> files = Pathname(_directory).list();
+    for(auto it = files.begin(); it != files.end(); ++it) {
+        if (it->find(CACHE_SUFFIX) != std::string::npos) {
+            std::remove((_directory+(*it)).c_str());
+        }
+    }
+}
+
+/** The number of bits in the hash of the LZ4 match finder */
+#define LZ4_HASHLOG     16
+/** The minimum length of an LZ4 match */
+#define LZ4_MINMATCH    4
+/** The number of bytes at the end of a block that must be literals */
+#define LZ4_LASTLITERALS 5
+/** The last match must start at least this many bytes before the end */
+#define LZ4_MFLIMIT     12
+/** The largest offset of an LZ4 match */
+#define LZ4_MAXOFFSET   65535
+
+/**
+ * Appends an LZ4 length, whose first 4 bits are already in the token
+ *
+ * @param output    The compressed buffer
+ * @param length    The length to encode
+ */
+static void appendLength(std::vector<Uint8>& output, size_t length) {
+    if (length >= 15) {
+        length -= 15;
+        for(; length >= 255; length -= 255) {
+            output.push_back(255);
+        }
+        output.push_back((Uint8)length);
+    }
+}
+
+/**
+ * Appends the LZ4 block compression of the given data to the buffer.
+ *
+ * This is the block format of LZ4 (without the frame header), so it
+ * may be decompressed by any LZ4 implementation given the original
+ * size.  The compressor is greedy and favors speed over ratio.
+ *
+ * @param data      The data to compress
+ * @param size      The size of the data in bytes
+ * @param output    The buffer to append the compressed data to
+ */
+void AssetCache::compress(const Uint8* data, size_t size, std::vector<Uint8>& output) {
+    output.reserve(output.size()+size+size/255+16);
+    
+    size_t anchor = 0;
+    if (size > LZ4_MFLIMIT) {
+        // Positions are stored plus one, so that 0 means empty
+        std::vector<Uint32> table(1 << LZ4_HASHLOG, 0);
+        size_t limit = size-LZ4_MFLIMIT;
+        size_t pos = 0;
+        while (pos < limit) {
+            Uint32 sequence;
+            std::memcpy(&sequence, data+pos, sizeof(Uint32));
+            Uint32 hash = (sequence*2654435761U) >> (32-LZ4_HASHLOG);
+            size_t match = table[hash];
+            table[hash] = (Uint32)(pos+1);
+            
+            Uint32 previous = 0;
+            if (match > 0) {
+                std::memcpy(&previous, data+match-1, sizeof(Uint32));
+            }
+            if (match == 0 || pos-(match-1) > LZ4_MAXOFFSET || previous != sequence) {
+                pos++;
+                continue;
+            }
+            match--;
+            
+            size_t length = LZ4_MINMATCH;
+            size_t most = size-LZ4_LASTLITERALS-pos;
+            while (length < most && data[match+length] == data[pos+length]) {
+                length++;
+            }
+            
+            size_t literals = pos-anchor;
+            size_t offset = pos-match;
+            size_t extra  = length-LZ4_MINMATCH;
+            output.push_back((Uint8)((std::min(literals,(size_t)15) << 4) | std::min(extra,(size_t)15)));
+            appendLength(output, literals);
+            output.insert(output.end(), data+anchor, data+pos);
+            output.push_back((Uint8)(offset & 0xff));
+            output.push_back((Uint8)(offset >> 8));
+            appendLength(output, extra);
+            
+            pos += length;
+            anchor = pos;
+        }
+    }
+    
+    size_t literals = size-anchor;
+    output.push_back((Uint8)(std::min(literals,(size_t)15) << 4));
+    appendLength(output, literals);
+    output.insert(output.end(), data+anchor, data+size);
+}
+
+/**
+ * Decompresses an LZ4 block, returning true if it is valid.
+ *
+ * The block must decompress to exactly the given output size.  Every
+ * read and write is bounds checked, so a corrupt block fails safely.
+ *
+ * @param data      The compressed data
+ * @param size      The size of the compressed data in bytes
+ * @param output    The buffer for the decompressed data
+ * @param capacity  The expected size of the decompressed data
+ *
+ * @return true if the block is valid
+ */
+bool AssetCache::decompress(const Uint8* data, size_t size, Uint8* output, size_t capacity) {
+    size_t pos = 0;
+    size_t out = 0;
+    while (pos < size) {
+        Uint8 token = data[pos++];
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            Uint8 next = 255;
+            while (next == 255) {
+                if (pos >= size) {
+                    return false;
+                }
+                next = data[pos++];
+                literals += next;
+            }
+        }
+        if (literals > size-pos || literals > capacity-out) {
+            return false;
+        }
+        std::memcpy(output+out, data+pos, literals);
+        pos += literals;
+        out += literals;
+        if (pos == size) {
+            break;  // The last sequence has no match
+        }
+        
+        if (size-pos < 2) {
+            return false;
+        }
+        size_t offset = data[pos] | (data[pos+1] << 8);
+        pos += 2;
+        size_t length = token & 15;
+        if (length == 15) {
+            Uint8 next = 255;
+            while (next == 255) {
+                if (pos >= size) {
+                    return false;
+                }
+                next = data[pos++];
+                length += next;
+            }
+        }
+        length += LZ4_MINMATCH;
+        if (offset == 0 || offset > out || length > capacity-out) {
+            return false;
+        }
+        
+        // Matches may overlap their own output, which repeats the pattern
+        Uint8* dst = output+out;
+        const Uint8* src = dst-offset;
+        if (offset >= length) {
+            std::memcpy(dst, src, length);
+        } else {
+            for(size_t ii = 0; ii < length; ii++) {
+                dst[ii] = src[ii];
+            }
+        }
+        out += length;
+    }
+    return out == capacity;
+}
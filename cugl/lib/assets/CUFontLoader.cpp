@@ -47,6 +47,7 @@
 #include <cugl/base/CUApplication.h>
 #include <cugl/io/CUPathname.h>
 #include <SDL/SDL_ttf.h>
+#include <mutex>
 
 using namespace cugl;
 
@@ -57,6 +58,9 @@ using namespace cugl;
 /** The default character set (ASCII) */
 #define UNKNOWN_SIZE    12
 
+/** Serializes font creation across the asset workers */
+static std::mutex _fontMutex;
+
 #pragma mark -
 #pragma mark Constructor
 
@@ -82,6 +86,10 @@ _charset(UNKNOWN_CHARS) {
  * Hence this method does the maximum amount of work that can be done in
  * asynchronous font loading.
  *
+ * If the loader has an {@link AssetCache}, the rasterized atlas is read
+ * from it instead when the font file is unchanged, and written to it
+ * otherwise.  The font file is still opened for its measurements.
+ *
  * @param source    The pathname to the asset
  * @param charset   The atlas character set
  * @param charset   The font size
@@ -99,17 +107,39 @@ std::shared_ptr<Font> FontLoader::preload(const std::string& source, const std::
     
     std::string path = Application::get()->getAssetDirectory();
     path.append(source);
+    
+    std::string key;
+    std::vector<Uint8> data;
+    std::vector<std::string> sources(1,source);
+    bool cached = false;
+    if (_cache != nullptr) {
+        key = "font:"+source+":"+std::to_string(size)+":"+charset;
+        cached = _cache->read(key,sources,data);
+    }
+    
+    // FreeType is not thread-safe, so workers take turns with fonts
+    std::lock_guard<std::mutex> lock(_fontMutex);
     std::shared_ptr<Font> result = Font::alloc(path.c_str(),size);
     if (result == nullptr) {
         return result;
     }
     
+    if (cached && result->decodeAtlas(data.data(),data.size())) {
+        return result;
+    }
+    
     if (charset.empty()) {
         result->buildAtlasAsync();
     } else {
         result->buildAtlasAsync(charset);
     }
-   
+    
+    if (_cache != nullptr) {
+        data.clear();
+        if (result->encodeAtlas(data)) {
+            _cache->write(key,sources,data);
+        }
+    }
     return result;
 }
 
@@ -119,7 +149,7 @@ std::shared_ptr<Font> FontLoader::preload(const std::string& source, const std::
  * This method finishes the asset loading started in {@link preload}.  As
  * atlas generation requires OpenGL, this step is not safe to be done in a
  * separate thread.  Instead, it takes place in the main CUGL thread via
- ( {@link Application#schedule}.
+ * {@link Application#defer}.
  *
  * The font atlas will use the default character set.
  *
@@ -131,10 +161,9 @@ std::shared_ptr<Font> FontLoader::preload(const std::string& source, const std::
  * @param callback  An optional callback for asynchronous loading
  */
 void FontLoader::materialize(const std::string& key, const std::shared_ptr<Font>& font, LoaderCallback callback) {
-    std::shared_ptr<Texture> texture = font->getAtlas();
-    
     bool success = false;
     if (font != nullptr) {
+        font->getAtlas();
         _assets[key] = font;
         success = true;
     }
@@ -183,7 +212,7 @@ bool FontLoader::read(const std::string& key, const std::string& source, int siz
     } else {
         _loader->addTask([=](void) {
             std::shared_ptr<Font> font = this->preload(source,_charset,size);
-            Application::get()->schedule([=](void){
+            this->defer(key,0,[=](void) {
                 this->materialize(key,font,callback);
                 return false;
             });
@@ -227,6 +256,7 @@ bool FontLoader::read(const std::shared_ptr<JsonValue>& json, LoaderCallback cal
     std::string source  = json->getString("file",UNKNOWN_SOURCE);
     std::string charset = json->getString("charset",UNKNOWN_CHARS);
     int size = json->getInt("size",UNKNOWN_SIZE);
+    int priority = json->getInt("priority",0);
     
     bool success = false;
     if (_loader == nullptr || !async) {
@@ -240,7 +270,7 @@ bool FontLoader::read(const std::shared_ptr<JsonValue>& json, LoaderCallback cal
     } else {
         _loader->addTask([=](void) {
             std::shared_ptr<Font> font = this->preload(source,charset,size);
-            Application::get()->schedule([=](void){
+            this->defer(key,priority,[=](void) {
                 this->materialize(key,font,callback);
                 return false;
             });
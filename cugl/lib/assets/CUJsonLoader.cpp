@@ -51,6 +51,25 @@ using namespace cugl;
 /** What the source name is if we do not know it */
 #define UNKNOWN_SOURCE  "<unknown>"
 
+/**
+ * Returns the JSON in the given asset file (nullptr on failure)
+ *
+ * If the loader has an {@link AssetCache}, the parsed value is read from
+ * it when the file is unchanged.  This method is safe to call outside
+ * of the main thread.
+ *
+ * @param source    The pathname to the asset
+ *
+ * @return the JSON in the given asset file (nullptr on failure)
+ */
+std::shared_ptr<JsonValue> JsonLoader::preload(const std::string& source) {
+    if (_cache != nullptr) {
+        return _cache->readJson(source);
+    }
+    std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(source);
+    return (reader == nullptr ? nullptr : reader->readJson());
+}
+
 /**
  * Finishes loading the Json file, cleaning up the wait queues.
  *
@@ -104,14 +123,12 @@ bool JsonLoader::read(const std::string& key, const std::string& source, LoaderC
     
     bool success = false;
     if (_loader == nullptr || !async) {
-        std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(source);
-        std::shared_ptr<JsonValue> json = (reader == nullptr ? nullptr : reader->readJson());
+        std::shared_ptr<JsonValue> json = preload(source);
         success = (json != nullptr);
         materialize(key,json,callback);
     } else {
         _loader->addTask([=](void) {
-            std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(source);
-            std::shared_ptr<JsonValue> json = (reader == nullptr ? nullptr : reader->readJson());
+            std::shared_ptr<JsonValue> json = this->preload(source);
             Application::get()->schedule([=](void) {
                 this->materialize(key,json,callback);
                 return false;
@@ -155,14 +172,12 @@ bool JsonLoader::read(const std::shared_ptr<JsonValue>& json, LoaderCallback cal
     
     bool success = false;
     if (_loader == nullptr || !async) {
-        std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(source);
-        std::shared_ptr<JsonValue> json = (reader == nullptr ? nullptr : reader->readJson());
+        std::shared_ptr<JsonValue> json = preload(source);
         success = (json != nullptr);
         materialize(key,json,callback);
     } else {
         _loader->addTask([=](void) {
-            std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(source);
-            std::shared_ptr<JsonValue> json = (reader == nullptr ? nullptr : reader->readJson());
+            std::shared_ptr<JsonValue> json = this->preload(source);
             Application::get()->schedule([=](void) {
                 this->materialize(key,json,callback);
                 return false;
@@ -44,6 +44,7 @@
 #include <cugl/assets/CUJsonValue.h>
 #include <cugl/util/CUDebug.h>
 #include <cugl/util/CUStrings.h>
+#include <cstring>
 
 using namespace cugl;
 
@@ -1210,3 +1211,169 @@ std::string JsonValue::toString(bool format) const {
     }
     return "";
 }
+
+/** The deepest nesting accepted by the binary decoder */
+#define BINARY_DEPTH    256
+
+/**
+ * Appends a plain value to a binary buffer
+ *
+ * @param data  The buffer to append to
+ * @param value The value to append
+ */
+template <typename T>
+static void appendBinary(std::vector<Uint8>& data, T value) {
+    const Uint8* bytes = (const Uint8*)&value;
+    data.insert(data.end(), bytes, bytes+sizeof(T));
+}
+
+/**
+ * Appends a length-prefixed string to a binary buffer
+ *
+ * @param data  The buffer to append to
+ * @param value The string to append
+ */
+static void appendBinary(std::vector<Uint8>& data, const std::string& value) {
+    appendBinary(data, (Uint32)value.size());
+    data.insert(data.end(), value.begin(), value.end());
+}
+
+/**
+ * Reads a plain value from binary data, returning false if it is truncated
+ *
+ * @param pos   The current position (advanced on success)
+ * @param end   The end of the data
+ * @param value The value to store the result
+ *
+ * @return true if the value was read
+ */
+template <typename T>
+static bool readBinary(const Uint8*& pos, const Uint8* end, T& value) {
+    if ((size_t)(end-pos) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+/**
+ * Reads a length-prefixed string from binary data, returning false if it is truncated
+ *
+ * @param pos   The current position (advanced on success)
+ * @param end   The end of the data
+ * @param value The string to store the result
+ *
+ * @return true if the string was read
+ */
+static bool readBinary(const Uint8*& pos, const Uint8* end, std::string& value) {
+    Uint32 size;
+    if (!readBinary(pos, end, size) || (size_t)(end-pos) < size) {
+        return false;
+    }
+    value.assign((const char*)pos, size);
+    pos += size;
+    return true;
+}
+
+/**
+ * Appends a binary representation of this JSON to the given buffer.
+ *
+ * The binary form stores every node with its type, key and value, and
+ * may be read back with {@link allocWithBinary}.  It uses the native
+ * byte order, so it is only suitable for data that stays on the device,
+ * such as an {@link AssetCache}.
+ *
+ * @param data  The buffer to append to
+ */
+void JsonValue::toBinary(std::vector<Uint8>& data) const {
+    appendBinary(data, (Uint8)_type);
+    appendBinary(data, _key);
+    switch (_type) {
+        case Type::NullType:
+            break;
+        case Type::BoolType:
+            appendBinary(data, (Uint8)(_longValue != 0));
+            break;
+        case Type::NumberType:
+            appendBinary(data, (Sint64)_longValue);
+            appendBinary(data, _doubleValue);
+            break;
+        case Type::StringType:
+            appendBinary(data, _stringValue);
+            break;
+        case Type::ArrayType:
+        case Type::ObjectType:
+            appendBinary(data, (Uint32)_children.size());
+            for(auto it = _children.begin(); it != _children.end(); ++it) {
+                (*it)->toBinary(data);
+            }
+            break;
+    }
+}
+
+/**
+ * Returns a newly allocated JsonValue decoded from the binary data
+ *
+ * The data is in the format written by {@link toBinary}.  On success,
+ * pos is advanced past the value.  This method returns nullptr if the
+ * data is truncated or malformed.
+ *
+ * @param pos   The current position in the data
+ * @param end   The end of the data
+ * @param depth The nesting depth of this value
+ *
+ * @return a newly allocated JsonValue decoded from the binary data
+ */
+std::shared_ptr<JsonValue> JsonValue::fromBinary(const Uint8*& pos, const Uint8* end, unsigned int depth) {
+    Uint8 type;
+    std::string key;
+    if (depth > BINARY_DEPTH || !readBinary(pos, end, type) || !readBinary(pos, end, key) ||
+        type > (Uint8)Type::ObjectType) {
+        return nullptr;
+    }
+    
+    std::shared_ptr<JsonValue> result = JsonValue::alloc((Type)type);
+    result->_key = key;
+    bool success = true;
+    switch (result->_type) {
+        case Type::NullType:
+            break;
+        case Type::BoolType:
+        {
+            Uint8 value;
+            success = readBinary(pos, end, value);
+            result->_longValue = value;
+            break;
+        }
+        case Type::NumberType:
+        {
+            Sint64 value;
+            success = readBinary(pos, end, value) && readBinary(pos, end, result->_doubleValue);
+            result->_longValue = (long)value;
+            break;
+        }
+        case Type::StringType:
+            success = readBinary(pos, end, result->_stringValue);
+            break;
+        case Type::ArrayType:
+        case Type::ObjectType:
+        {
+            Uint32 count;
+            success = readBinary(pos, end, count) && count <= (size_t)(end-pos);
+            if (success) {
+                result->_children.reserve(count);
+            }
+            for(Uint32 ii = 0; success && ii < count; ii++) {
+                std::shared_ptr<JsonValue> child = fromBinary(pos, end, depth+1);
+                success = child != nullptr;
+                if (success) {
+                    child->_parent = result.get();
+                    result->_children.push_back(child);
+                }
+            }
+            break;
+        }
+    }
+    return success ? result : nullptr;
+}
@@ -53,6 +53,7 @@
 #include <cugl/util/CUStrings.h>
 #include <cugl/2d/cu_2d.h>
 #include <cugl/2d/layout/cu_layout.h>
+#include <cugl/renderer/CUTexture.h>
 #include <locale>
 #include <algorithm>
 
@@ -240,7 +241,7 @@ std::shared_ptr<Node> SceneLoader::build(const std::string& key, const std::shar
  * This method finishes the asset loading started in {@link preload}. This
  * step is not safe to be done in a separate thread, as it accesses the
  * main asset table.  Therefore, it takes place in the main CUGL thread
- * via {@link Application#schedule}.  The scene is stored using the name
+ * via {@link Application#defer}.  The scene is stored using the name
  * of the root Node as a key.
  *
  * This method supports an optional callback function which reports whether
@@ -307,9 +308,10 @@ bool SceneLoader::read(const std::string& key, const std::string& source,
         _loader->addTask([=](void) {
             std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(source);
             std::shared_ptr<JsonValue> json = (reader == nullptr ? nullptr : reader->readJson());
-            std::shared_ptr<Node> node = build(key,json);
-            node->doLayout();
-            Application::get()->schedule([=](void) {
+            // Widgets look up other loaders, which are only safe in the main thread
+            this->defer(key,0,[=](void) {
+                std::shared_ptr<Node> node = this->build(key,json);
+                if (node != nullptr) { node->doLayout(); }
                 this->materialize(node,callback);
                 return false;
             });
@@ -370,13 +372,12 @@ bool SceneLoader::read(const std::shared_ptr<JsonValue>& json, LoaderCallback ca
             _queue.erase(key);
         }
     } else {
-        _loader->addTask([=](void) {
-            std::shared_ptr<Node> node = build(key,json);
-            node->doLayout();
-            Application::get()->schedule([=](void) {
-                this->materialize(node,callback);
-                return false;
-            });
+        // Widgets look up other loaders, which are only safe in the main thread
+        defer(key,json->getInt("priority",0),[=](void) {
+            std::shared_ptr<Node> node = this->build(key,json);
+            if (node != nullptr) { node->doLayout(); }
+            this->materialize(node,callback);
+            return false;
         });
     }
     
@@ -426,5 +427,47 @@ bool SceneLoader::attach(const std::string& key, const std::shared_ptr<Node>& no
     return success;
 }
 
+/**
+ * Recursively adds the textures and fonts named in a JSON tree to deps.
+ *
+ * @param json  The JSON tree to scan
+ * @param deps  The list to append the dependencies to
+ */
+static void scanDependencies(const JsonValue* json, std::vector<std::pair<size_t,std::string>>& deps) {
+    for(int ii = 0; ii < json->size(); ii++) {
+        const JsonValue* child = json->get(ii).get();
+        if (child->isString()) {
+            const std::string& name = child->key();
+            if (name == "texture" || name == "background" || name == "foreground" ||
+                name == "left_cap" || name == "right_cap") {
+                deps.push_back(std::make_pair(typeid(Texture).hash_code(),child->asString()));
+            } else if (name == "font") {
+                deps.push_back(std::make_pair(typeid(Font).hash_code(),child->asString()));
+            }
+        } else if (child->isObject() || child->isArray()) {
+            scanDependencies(child, deps);
+        }
+    }
+}
+
+/**
+ * Adds the textures and fonts used by the given scene to deps.
+ *
+ * The scene is scanned for the widget attributes that name other
+ * assets: "texture", "background", "foreground", "left_cap" and
+ * "right_cap" for textures, and "font" for fonts.  This includes the
+ * nested widgets of buttons and sliders.  An asynchronous directory
+ * load builds the scene once these assets have finished loading.
+ *
+ * @param json  The directory entry for the scene
+ * @param deps  The list to append the dependencies to
+ */
+void SceneLoader::getDependencies(const std::shared_ptr<JsonValue>& json,
+                                  std::vector<std::pair<size_t,std::string>>& deps) const {
+    if (json != nullptr) {
+        scanDependencies(json.get(), deps);
+    }
+}
+
 
 
@@ -45,7 +45,11 @@
 //
 #include <cugl/assets/CUTextureLoader.h>
 #include <cugl/base/CUApplication.h>
+#include <cugl/util/CUStrings.h>
 #include <SDL/SDL_image.h>
+#include <algorithm>
+#include <cstring>
+#include <array>
 
 using namespace cugl;
 
@@ -58,6 +62,10 @@ using namespace cugl;
 #define UNKNOWN_MAGFLT  "linear"
 /** The default wrap rule */
 #define UNKNOWN_WRAP    "clamp"
+/** The default maximum size of an atlas page */
+#define DEFAULT_PAGE    2048
+/** The maximum number of bytes to upload to the GPU in one call */
+#define UPLOAD_STRIP    (256*1024)
 
 /**
  * Returns the OpenGL enum for the given min filter name
@@ -124,6 +132,64 @@ GLuint decodeWrap(const std::string& name) {
     return GL_CLAMP_TO_EDGE;
 }
 
+/**
+ * Appends the given RGBA surface to a cache payload
+ *
+ * The payload is the width and height (little-endian) followed by the
+ * pixel rows, without any pitch padding.
+ *
+ * @param surface   The surface to append
+ * @param data      The cache payload
+ */
+static void writeSurface(SDL_Surface* surface, std::vector<Uint8>& data) {
+    size_t offset = data.size();
+    size_t width  = surface->w*4;
+    data.resize(offset+8+width*surface->h);
+    Uint32 header[2] = { SDL_SwapLE32((Uint32)surface->w), SDL_SwapLE32((Uint32)surface->h) };
+    std::memcpy(data.data()+offset, header, 8);
+    offset += 8;
+    for(int row = 0; row < surface->h; row++) {
+        std::memcpy(data.data()+offset, (Uint8*)surface->pixels+row*surface->pitch, width);
+        offset += width;
+    }
+}
+
+/**
+ * Returns the RGBA surface stored in the given cache payload
+ *
+ * This function reads a surface written by {@link writeSurface}, and
+ * advances the position past it.  It returns nullptr if the payload is
+ * too short.  The caller owns the surface.
+ *
+ * @param pos   The read position in the payload
+ * @param end   The end of the payload
+ *
+ * @return the RGBA surface stored in the given cache payload
+ */
+static SDL_Surface* readSurface(const Uint8*& pos, const Uint8* end) {
+    if (end-pos < 8) {
+        return nullptr;
+    }
+    Uint32 header[2];
+    std::memcpy(header, pos, 8);
+    Uint32 w = SDL_SwapLE32(header[0]);
+    Uint32 h = SDL_SwapLE32(header[1]);
+    size_t width = (size_t)w*4;
+    if (w == 0 || h == 0 || w > 16384 || h > 16384 || (size_t)(end-pos-8) < width*h) {
+        return nullptr;
+    }
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surface == nullptr) {
+        return nullptr;
+    }
+    pos += 8;
+    for(Uint32 row = 0; row < h; row++) {
+        std::memcpy((Uint8*)surface->pixels+row*surface->pitch, pos, width);
+        pos += width;
+    }
+    return surface;
+}
+
 #pragma mark -
 #pragma mark Constructor
 
@@ -152,11 +218,17 @@ _mipmaps(false) {
  * we need to create an OpenGL texture.  Hence this method does the maximum
  * amount of work that can be done in asynchronous texture loading.
  *
- * @param source    The pathname to the asset
+ * The image is decoded straight into the upload layout by {@link Texture#decode},
+ * which also premultiplies the colors by alpha if requested.  If the loader
+ * has an {@link AssetCache}, the decoded pixels are read from it instead when
+ * the image is unchanged, and written to it otherwise.
+ *
+ * @param source        The pathname to the asset
+ * @param premultiply   Whether to premultiply the colors by alpha
  *
  * @return the SDL_Surface with the texture information
  */
-SDL_Surface* TextureLoader::preload(const std::string& source) {
+SDL_Surface* TextureLoader::preload(const std::string& source, bool premultiply) {
     // Make sure we reference the asset directory
 #if defined (__WINDOWS__)
     bool absolute = (bool)strstr(source.c_str(),":") || source[0] == '\\';
@@ -165,43 +237,170 @@ SDL_Surface* TextureLoader::preload(const std::string& source) {
 #endif
     CUAssertLog(!absolute, "This loader does not accept absolute paths for assets");
     
+    std::string key;
+    std::vector<Uint8> data;
+    std::vector<std::string> sources(1,source);
+    if (_cache != nullptr) {
+        key = "texture:"+source+(premultiply ? ":premultiply" : "");
+        if (_cache->read(key,sources,data)) {
+            const Uint8* pos = data.data();
+            SDL_Surface* surface = readSurface(pos,pos+data.size());
+            if (surface != nullptr) {
+                return surface;
+            }
+        }
+    }
+    
     std::string path = Application::get()->getAssetDirectory();
     path.append(source);
-    SDL_Surface* surface = IMG_Load(path.c_str());
+    SDL_Surface* surface = Texture::decode(path,premultiply);
+    if (surface != nullptr && _cache != nullptr) {
+        data.clear();
+        writeSurface(surface,data);
+        _cache->write(key,sources,data);
+    }
+    return surface;
+}
+
+/**
+ * Loads the first usable compressed container of a directory entry.
+ *
+ * The "compressed" value of the entry is either a path or an array of
+ * paths to KTX files, in order of preference.  This method returns the
+ * first container that exists, parses, and has one of the given formats.
+ * It returns nullptr if there is none, in which case the entry should
+ * fall back to its "file".
+ *
+ * This method does not use OpenGL, and so it is safe to call outside of
+ * the main thread.  The formats should come from {@link Texture#getCompressedFormats},
+ * queried in the main thread.
+ *
+ * @param json      The asset directory entry
+ * @param formats   The compressed formats supported by this device
+ *
+ * @return the first usable compressed container of a directory entry.
+ */
+std::shared_ptr<TextureContainer> TextureLoader::preloadCompressed(const std::shared_ptr<JsonValue>& json,
+                                                                   const std::vector<GLenum>& formats) {
+    JsonValue* child = json->get("compressed").get();
+    if (child == nullptr || formats.empty()) {
+        return nullptr;
+    }
+    
+    std::vector<std::string> sources;
+    if (child->isString()) {
+        sources.push_back(child->asString());
+    } else {
+        for(int ii = 0; ii < child->size(); ii++) {
+            sources.push_back(child->get(ii)->asString(UNKNOWN_SOURCE));
+        }
+    }
+    
+    for(auto it = sources.begin(); it != sources.end(); ++it) {
+        std::string path = Application::get()->getAssetDirectory();
+        path.append(*it);
+        std::shared_ptr<TextureContainer> container = TextureContainer::allocWithFile(path);
+        if (container != nullptr &&
+            std::find(formats.begin(), formats.end(), container->getFormat()) != formats.end()) {
+            return container;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Returns a texture for the given image, loaded in the main thread.
+ *
+ * This is the synchronous counterpart of {@link preload} and {@link upload},
+ * so it also benefits from the asset cache.
+ *
+ * @param source        The pathname to the asset
+ * @param premultiply   Whether to premultiply the colors by alpha
+ *
+ * @return a texture for the given image (nullptr on failure)
+ */
+std::shared_ptr<Texture> TextureLoader::build(const std::string& source, bool premultiply) {
+    SDL_Surface* surface = preload(source,premultiply);
     if (surface == nullptr) {
         return nullptr;
     }
     
-    SDL_Surface* normal;
-#if CU_MEMORY_ORDER == CU_ORDER_REVERSED
-    normal = SDL_ConvertSurfaceFormat(surface,SDL_PIXELFORMAT_ABGR8888,0);
-#else
-    normal = SDL_ConvertSurfaceFormat(surface,SDL_PIXELFORMAT_RGBA8888,0);
-#endif
+    std::shared_ptr<Texture> texture = Texture::allocWithData(surface->pixels, surface->w, surface->h);
     SDL_FreeSurface(surface);
-    return normal;
+    if (texture != nullptr) {
+        texture->setName(source);
+        texture->setPremultiplied(premultiply);
+    }
+    return texture;
 }
 
 /**
- * Creates an OpenGL texture from the SDL_Surface, and assigns it the given key.
+ * Uploads the next strip of the surface to the texture.
+ *
+ * The texture is created on the first call.  Each call uploads at most
+ * a fixed number of bytes, so that one large image cannot blow the frame
+ * budget.  This step is not safe to be done in a separate thread.  Instead,
+ * it takes place in the main CUGL thread via {@link Application#defer}.
+ *
+ * If the surface is nullptr (because it failed to load), the texture
+ * stays nullptr.
  *
- * This method finishes the asset loading started in {@link preload}.  This
- * step is not safe to be done in a separate thread.  Instead, it takes
- * place in the main CUGL thread via {@link Application#schedule}.
+ * @param state     The upload state
+ *
+ * @return true if there are more rows to upload
+ */
+bool TextureLoader::upload(Upload& state) {
+    if (state.container != nullptr) {
+        state.texture = Texture::allocWithContainer(*state.container);
+        state.container = nullptr;
+        return false;
+    }
+    
+    SDL_Surface* surface = state.surface;
+    if (surface == nullptr) {
+        return false;
+    }
+    
+    if (state.texture == nullptr) {
+        state.texture = Texture::alloc(surface->w, surface->h);
+        if (state.texture == nullptr) {
+            return false;
+        }
+    }
+    
+    int rows = std::min(std::max(1, UPLOAD_STRIP/surface->pitch), surface->h-state.row);
+    state.texture->bind();
+    state.texture->set((Uint8*)surface->pixels+state.row*surface->pitch, state.row, rows);
+    state.texture->unbind();
+    state.row += rows;
+    if (state.row < surface->h) {
+        return true;
+    }
+    
+    SDL_FreeSurface(surface);
+    state.surface = nullptr;
+    return false;
+}
+
+/**
+ * Finishes an uploaded texture, and assigns it the given key.
+ *
+ * This method finishes the asset loading started in {@link preload} and
+ * {@link upload}.  This step is not safe to be done in a separate thread.
+ * Instead, it takes place in the main CUGL thread via {@link Application#defer}.
  *
  * The loaded texture will have default parameters for scaling and wrap.
- * It will not have any mipmaps.
+ * It will only have a mipmap if that is the default.
  *
  * This method supports an optional callback function which reports whether
  * the asset was successfully materialized.
  *
  * @param key       The key to access the asset after loading
- * @param surface   The SDL_Surface to convert
+ * @param texture   The uploaded texture (nullptr on failure)
  * @param callback  An optional callback for asynchronous loading
  */
-void TextureLoader::materialize(const std::string& key, SDL_Surface* surface, LoaderCallback callback) {
-    std::shared_ptr<Texture> texture = Texture::allocWithData(surface->pixels, surface->w, surface->h);
-    
+void TextureLoader::materialize(const std::string& key, const std::shared_ptr<Texture>& texture,
+                                LoaderCallback callback) {
     bool success = false;
     if (texture != nullptr) {
         _assets[key] = texture;
@@ -222,11 +421,11 @@ void TextureLoader::materialize(const std::string& key, SDL_Surface* surface, Lo
 }
                                 
 /**
- * Creates an OpenGL texture from the SDL_Surface accoring to the directory entry.
+ * Finishes an uploaded texture accoring to the directory entry.
  *
- * This method finishes the asset loading started in {@link preload}.  This
- * step is not safe to be done in a separate thread.  Instead, it takes
- * place in the main CUGL thread via {@link Application#schedule}.
+ * This method finishes the asset loading started in {@link preload} and
+ * {@link upload}.  This step is not safe to be done in a separate thread.
+ * Instead, it takes place in the main CUGL thread via {@link Application#defer}.
  *
  * This version of read provides support for JSON directories. A texture
  * directory entry has the following values
@@ -236,7 +435,7 @@ void TextureLoader::materialize(const std::string& key, SDL_Surface* surface, Lo
  *      "minfilter":    The name of the min filter ("nearest", "linear";
  *                      with mipmaps, "nearest-nearest", "linear-nearest",
  *                      "nearest-linear", or "linear-linear")
- *      "magfilter":    The name of the min filter ("nearest" or "linear")
+ *      "magfilter":    The name of the mag filter ("nearest" or "linear")
  *      "wrapS":        The s-coord wrap rule ("clamp", "repeat", or "mirrored")
  *      "wrapT":        The t-coord wrap rule ("clamp", "repeat", or "mirrored")
  *
@@ -246,24 +445,25 @@ void TextureLoader::materialize(const std::string& key, SDL_Surface* surface, Lo
  * the asset was successfully materialized.
  *
  * @param json      The asset directory entry
- * @param surface   The SDL_Surface to convert
+ * @param texture   The uploaded texture (nullptr on failure)
  * @param callback  An optional callback for asynchronous loading
  */
-void TextureLoader::materialize(const std::shared_ptr<JsonValue>& json, SDL_Surface* surface, LoaderCallback callback) {
-    std::shared_ptr<Texture> texture = Texture::allocWithData(surface->pixels, surface->w, surface->h);
+void TextureLoader::materialize(const std::shared_ptr<JsonValue>& json, const std::shared_ptr<Texture>& texture,
+                                LoaderCallback callback) {
     std::string key = json->key();
 
     bool success = false;
     if (texture != nullptr) {
         GLuint minflt = decodeMinFilter(json->getString("minfilter",UNKNOWN_MINFLT));
-        GLuint magflt = decodeMinFilter(json->getString("magfilter",UNKNOWN_MAGFLT));
+        GLuint magflt = decodeMagFilter(json->getString("magfilter",UNKNOWN_MAGFLT));
         GLuint wrapS = decodeWrap(json->getString("wrapS",UNKNOWN_WRAP));
         GLuint wrapT = decodeWrap(json->getString("wrapT",UNKNOWN_WRAP));
         bool mipmaps = json->getBool("mipmaps",false);
 
         _assets[key] = texture;
+        texture->setPremultiplied(json->getBool("premultiply",false) && !texture->isCompressed());
         texture->bind();
-        if (mipmaps) { texture->buildMipMaps(); }
+        if (mipmaps && !texture->isCompressed()) { texture->buildMipMaps(); }
         texture->setMinFilter(minflt);
         texture->setMagFilter(magflt);
         texture->setWrapS(wrapS);
@@ -306,7 +506,7 @@ bool TextureLoader::read(const std::string& key, const std::string& source, Load
     
     bool success = false;
     if (_loader == nullptr || !async) {
-        std::shared_ptr<Texture> texture = Texture::allocWithFile(source);
+        std::shared_ptr<Texture> texture = build(source,false);
         success = (texture != nullptr);
         if (success) { 
 			_assets[key] = texture;
@@ -314,9 +514,12 @@ bool TextureLoader::read(const std::string& key, const std::string& source, Load
         _queue.erase(key);
     } else {
         _loader->addTask([=](void) {
-            SDL_Surface* surface = this->preload(source);
-            Application::get()->schedule([=](void){
-                this->materialize(key,surface,callback);
+            std::shared_ptr<Upload> state = std::make_shared<Upload>(this->preload(source));
+            this->defer(key,0,[=](void) {
+                if (this->upload(*state)) {
+                    return true;
+                }
+                this->materialize(key,state->texture,callback);
                 return false;
             });
         });
@@ -355,9 +558,17 @@ bool TextureLoader::read(const std::string& key, const std::string& source, Load
  *      "minfilter":    The name of the min filter ("nearest", "linear";
  *                      with mipmaps, "nearest-nearest", "linear-nearest",
  *                      "nearest-linear", or "linear-linear")
- *      "magfilter":    The name of the min filter ("nearest" or "linear")
+ *      "magfilter":    The name of the mag filter ("nearest" or "linear")
  *      "wrapS":        The s-coord wrap rule ("clamp", "repeat", or "mirrored")
  *      "wrapT":        The t-coord wrap rule ("clamp", "repeat", or "mirrored")
+ *      "premultiply":  Whether to premultiply the colors by alpha (bool)
+ *      "priority":     The main-thread priority of an asynchronous load (int)
+ *      "compressed":   A KTX path, or array of paths, to use before "file"
+ *
+ * A compressed container is only used if this device supports its format
+ * (see {@link preloadCompressed}).  Otherwise the entry falls back to the
+ * "file" image.  Containers carry their own mipmaps, and are not
+ * premultiplied at load time.
  *
  * @param json      The directory entry for the asset
  * @param callback  An optional callback for asynchronous loading
@@ -372,20 +583,71 @@ bool TextureLoader::read(const std::shared_ptr<JsonValue>& json, LoaderCallback
     }
     _queue.emplace(key);
     
+    if (json->has("pack")) {
+        if (_loader == nullptr || !async) {
+            std::vector<PackedImage> images;
+            std::vector<std::shared_ptr<Upload>> pages;
+            for(SDL_Surface* surface : preloadPack(json,images)) {
+                pages.push_back(std::make_shared<Upload>(surface));
+            }
+            while (uploadPack(key,pages)) {}
+            return materializePack(json,pages,images,nullptr);
+        }
+        int priority = json->getInt("priority",0);
+        _loader->addTask([=](void) {
+            std::vector<PackedImage> images;
+            std::vector<std::shared_ptr<Upload>> pages;
+            for(SDL_Surface* surface : this->preloadPack(json,images)) {
+                pages.push_back(std::make_shared<Upload>(surface));
+            }
+            this->defer(key,priority,[=](void) {
+                if (this->uploadPack(key,pages)) {
+                    return true;
+                }
+                this->materializePack(json,pages,images,callback);
+                return false;
+            });
+        });
+        return false;
+    }
+    
     std::string source = json->getString("file",UNKNOWN_SOURCE);
+    bool premultiply = json->getBool("premultiply",false);
     bool success = false;
+    std::vector<GLenum> formats;
+    if (json->has("compressed")) {
+        formats = Texture::getCompressedFormats();
+    }
+    
     if (_loader == nullptr || !async) {
-        std::shared_ptr<Texture> texture = Texture::allocWithFile(source);
+        std::shared_ptr<TextureContainer> container = preloadCompressed(json,formats);
+        std::shared_ptr<Texture> texture;
+        if (container != nullptr) {
+            texture = Texture::allocWithContainer(*container);
+        } else {
+            texture = build(source,premultiply);
+        }
         success = (texture != nullptr);
         if (success) { 
 			_assets[key] = texture;
 		}
         _queue.erase(key);
     } else {
+        int priority = json->getInt("priority",0);
         _loader->addTask([=](void) {
-            SDL_Surface* surface = this->preload(source);
-            Application::get()->schedule([=](void){
-                this->materialize(json,surface,callback);
+            std::shared_ptr<TextureContainer> container = this->preloadCompressed(json,formats);
+            std::shared_ptr<Upload> state;
+            if (container != nullptr) {
+                state = std::make_shared<Upload>(nullptr);
+                state->container = container;
+            } else {
+                state = std::make_shared<Upload>(this->preload(source,premultiply));
+            }
+            this->defer(key,priority,[=](void) {
+                if (this->upload(*state)) {
+                    return true;
+                }
+                this->materialize(json,state->texture,callback);
                 return false;
             });
         });
@@ -394,14 +656,14 @@ bool TextureLoader::read(const std::shared_ptr<JsonValue>& json, LoaderCallback
     if (success) {
         // Get the settings if they exist
         GLuint minflt = decodeMinFilter(json->getString("minfilter",UNKNOWN_MINFLT));
-        GLuint magflt = decodeMinFilter(json->getString("magfilter",UNKNOWN_MAGFLT));
+        GLuint magflt = decodeMagFilter(json->getString("magfilter",UNKNOWN_MAGFLT));
         GLuint wrapS = decodeWrap(json->getString("wrapS",UNKNOWN_WRAP));
         GLuint wrapT = decodeWrap(json->getString("wrapT",UNKNOWN_WRAP));
         bool mipmaps = json->getBool("mipmaps",false);
         
         std::shared_ptr<Texture> texture = get(key);
         texture->bind();
-        if (mipmaps) { texture->buildMipMaps(); }
+        if (mipmaps && !texture->isCompressed()) { texture->buildMipMaps(); }
         texture->setMinFilter(minflt);
         texture->setMagFilter(magflt);
         texture->setWrapS(wrapS);
@@ -436,9 +698,26 @@ bool TextureLoader::purge(const std::shared_ptr<JsonValue>& json) {
         return false;
     }
     _assets.erase(it);
+    _revision++;
     
-    JsonValue* child = json->get("atlas").get();
+    // Packed atlases may have additional pages and members
+    for(int ii = 1; (it = _assets.find(key+"_"+cugl::to_string(ii))) != _assets.end(); ii++) {
+        _assets.erase(it);
+    }
+    
+    JsonValue* child = json->get("pack").get();
     bool success = true;
+    if (child) {
+        for(int ii = 0; ii < child->size(); ii++) {
+            auto jt = _assets.find(child->get(ii)->key());
+            success = (jt != _assets.end()) && success;
+            if (jt != _assets.end()) {
+                _assets.erase(jt);
+            }
+        }
+    }
+    
+    child = json->get("atlas").get();
     if (child) {
         for(int ii = 0; ii < child->size(); ii++) {
             JsonValue* item = child->get(ii).get();
@@ -454,6 +733,72 @@ bool TextureLoader::purge(const std::shared_ptr<JsonValue>& json) {
     return success;
 }
 
+/**
+ * Returns true if any of the given textures is referenced outside this loader.
+ *
+ * The regions of an atlas refer to their page.  Those references do not
+ * count if the regions are among the given textures.
+ *
+ * @param keys  The keys of the textures
+ *
+ * @return true if any of the given textures is referenced outside this loader.
+ */
+bool TextureLoader::inUse(const std::vector<std::string>& keys) const {
+    std::unordered_map<const Texture*,long> regions;
+    for(auto it = keys.begin(); it != keys.end(); ++it) {
+        auto jt = _assets.find(*it);
+        if (jt != _assets.end() && jt->second->isSubTexture()) {
+            regions[jt->second->getParent().get()]++;
+        }
+    }
+    
+    for(auto it = keys.begin(); it != keys.end(); ++it) {
+        auto jt = _assets.find(*it);
+        if (jt == _assets.end()) {
+            continue;
+        }
+        // This loader holds one reference, and the regions the rest
+        auto kt = regions.find(jt->second.get());
+        long owned = 1+(kt == regions.end() ? 0 : kt->second);
+        if (jt->second.use_count() > owned) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Adds the keys of the textures loaded for the given directory entry to keys.
+ *
+ * A packed atlas loads its pages and the regions of each packed image,
+ * while an atlas file loads its texture and each named region.  These
+ * textures are evicted and reloaded together.
+ *
+ * @param json  The directory entry for the texture
+ * @param keys  The list to append the keys to
+ */
+void TextureLoader::getMembers(const std::shared_ptr<JsonValue>& json, std::vector<std::string>& keys) const {
+    std::string key = json->key();
+    keys.push_back(key);
+    for(int ii = 1; verify(key+"_"+cugl::to_string(ii)); ii++) {
+        keys.push_back(key+"_"+cugl::to_string(ii));
+    }
+    
+    JsonValue* child = json->get("pack").get();
+    if (child) {
+        for(int ii = 0; ii < child->size(); ii++) {
+            keys.push_back(child->get(ii)->key());
+        }
+    }
+    
+    child = json->get("atlas").get();
+    if (child) {
+        for(int ii = 0; ii < child->size(); ii++) {
+            keys.push_back(key+"_"+child->get(ii)->key());
+        }
+    }
+}
+
 #pragma mark -
 #pragma mark Atlas Support
 /**
@@ -483,3 +828,293 @@ void TextureLoader::parseAtlas(const std::shared_ptr<JsonValue>& json, const std
     }
 }
 
+
+#pragma mark -
+#pragma mark Atlas Packing
+/**
+ * Copies an image into an atlas page, extruding its edges into the padding
+ *
+ * Both surfaces must have the same 32-bit pixel format.  The image is placed
+ * with its top left corner at (x,y), and the padding pixels around it are
+ * copies of the nearest edge pixel.
+ *
+ * @param image     The image to copy
+ * @param page      The atlas page
+ * @param x         The left edge of the image in the page
+ * @param y         The top edge of the image in the page
+ * @param padding   The number of padding pixels on each side
+ */
+static void blitExtruded(SDL_Surface* image, SDL_Surface* page, int x, int y, int padding) {
+    int w = image->w;
+    int h = image->h;
+    for(int row = -padding; row < h+padding; row++) {
+        int srow = std::min(std::max(row,0),h-1);
+        const Uint32* src = (const Uint32*)((const Uint8*)image->pixels+srow*image->pitch);
+        Uint32* dst = (Uint32*)((Uint8*)page->pixels+(y+row)*page->pitch)+x;
+        std::memcpy(dst, src, w*sizeof(Uint32));
+        for(int col = 1; col <= padding; col++) {
+            dst[-col]    = src[0];
+            dst[w-1+col] = src[w-1];
+        }
+    }
+}
+
+/**
+ * Assigns each image a page and position using shelf packing
+ *
+ * The images are sorted by decreasing height and placed left to right in
+ * rows (shelves).  Each image goes in the first shelf, on any page, with
+ * room for it.  Otherwise it starts a new shelf in the first page with room,
+ * or else a new page.  Looking back at earlier pages matters once there is
+ * padding, as a padded sheet that is half a page tall leaves the rest of
+ * its page to the shorter sheets.
+ *
+ * The size of each page is stored in sizes as a (width, height) pair.
+ *
+ * @param images    The images to place
+ * @param maxsize   The maximum width and height of a page
+ * @param padding   The number of padding pixels on each side of an image
+ * @param sizes     The vector to store the page sizes
+ *
+ * @return true if every image fits in a page
+ */
+static bool packShelves(std::vector<TextureLoader::PackedImage>& images, int maxsize, int padding,
+                        std::vector<std::pair<int,int>>& sizes) {
+    std::vector<size_t> order(images.size());
+    for(size_t ii = 0; ii < order.size(); ii++) {
+        order[ii] = ii;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return images[a].height > images[b].height;
+    });
+    
+    // Each shelf is (page, y, height, used width)
+    std::vector<std::array<int,4>> shelves;
+    for(auto it = order.begin(); it != order.end(); ++it) {
+        TextureLoader::PackedImage& image = images[*it];
+        int cw = image.width +2*padding;
+        int ch = image.height+2*padding;
+        if (cw > maxsize || ch > maxsize) {
+            CULogError("Image '%s' (%dx%d) does not fit in an atlas page of size %d",
+                       image.key.c_str(), image.width, image.height, maxsize);
+            return false;
+        }
+        
+        auto shelf = shelves.begin();
+        while (shelf != shelves.end() && ((*shelf)[2] < ch || (*shelf)[3]+cw > maxsize)) {
+            ++shelf;
+        }
+        if (shelf == shelves.end()) {
+            int page = 0;
+            while (page < (int)sizes.size() && sizes[page].second+ch > maxsize) {
+                page++;
+            }
+            if (page == (int)sizes.size()) {
+                sizes.push_back(std::make_pair(0,0));
+            }
+            std::array<int,4> next = {{ page, sizes[page].second, ch, 0 }};
+            shelf = shelves.insert(shelves.end(), next);
+        }
+        
+        int page = (*shelf)[0];
+        image.page = page;
+        image.x = (*shelf)[3]+padding;
+        image.y = (*shelf)[1]+padding;
+        (*shelf)[3] += cw;
+        sizes[page].first  = std::max(sizes[page].first,(*shelf)[3]);
+        sizes[page].second = std::max(sizes[page].second,(*shelf)[1]+(*shelf)[2]);
+    }
+    return true;
+}
+
+/**
+ * Loads and packs the images of an atlas entry outside the main thread.
+ *
+ * A packed directory entry has a "pack" object in place of a "file". Each
+ * child of this object maps an asset key to the path of an image. All of
+ * the images are decoded and arranged into one or more pages of at most
+ * "maxsize" pixels per side (default 2048), separated by "padding" pixels
+ * (default 0). The padding is filled by extruding the image edges so that
+ * linear filtering does not bleed in neighboring images.
+ *
+ * The images vector is cleared and filled with the placement of each
+ * image.  If any image fails to load or does not fit in a page, this
+ * method returns an empty vector.
+ *
+ * @param json      The asset directory entry
+ * @param images    The vector to store the image placements
+ *
+ * @return the SDL_Surface for each atlas page
+ */
+std::vector<SDL_Surface*> TextureLoader::preloadPack(const std::shared_ptr<JsonValue>& json,
+                                                     std::vector<PackedImage>& images) {
+    std::vector<SDL_Surface*> pages;
+    std::vector<SDL_Surface*> sources;
+    images.clear();
+    
+    JsonValue* pack = json->get("pack").get();
+    int maxsize = json->getInt("maxsize",DEFAULT_PAGE);
+    int padding = json->getInt("padding",0);
+    bool premultiply = json->getBool("premultiply",false);
+    
+    bool success = true;
+    for(int ii = 0; success && ii < pack->size(); ii++) {
+        JsonValue* item = pack->get(ii).get();
+        SDL_Surface* surface = preload(item->asString(UNKNOWN_SOURCE),premultiply);
+        if (surface == nullptr) {
+            CULogError("Could not load '%s' for atlas '%s'", item->asString().c_str(), json->key().c_str());
+            success = false;
+        } else {
+            PackedImage image;
+            image.key = item->key();
+            image.page = 0;
+            image.x = 0;
+            image.y = 0;
+            image.width  = surface->w;
+            image.height = surface->h;
+            images.push_back(image);
+            sources.push_back(surface);
+        }
+    }
+    
+    std::vector<std::pair<int,int>> sizes;
+    success = success && packShelves(images,maxsize,padding,sizes);
+    for(auto it = sizes.begin(); success && it != sizes.end(); ++it) {
+        SDL_Surface* page = SDL_CreateRGBSurfaceWithFormat(0, it->first, it->second, 32,
+                                                           sources[0]->format->format);
+        if (page == nullptr) {
+            success = false;
+        } else {
+            SDL_FillRect(page, NULL, 0);
+            pages.push_back(page);
+        }
+    }
+    
+    for(size_t ii = 0; ii < sources.size(); ii++) {
+        if (success) {
+            const PackedImage& image = images[ii];
+            blitExtruded(sources[ii], pages[image.page], image.x, image.y, padding);
+        }
+        SDL_FreeSurface(sources[ii]);
+    }
+    
+    if (!success) {
+        for(auto it = pages.begin(); it != pages.end(); ++it) {
+            SDL_FreeSurface(*it);
+        }
+        pages.clear();
+        images.clear();
+    }
+    return pages;
+}
+
+/**
+ * Uploads the next strip of the pages of a packed atlas.
+ *
+ * The pages are uploaded in order, one strip per call, with {@link upload}.
+ * Hence a large atlas is spread over several frames, exactly like a large
+ * image.  This step is not safe to be done in a separate thread.  Instead,
+ * it takes place in the main CUGL thread via {@link Application#defer}.
+ *
+ * If a page is larger than the OpenGL texture limit, or its texture cannot
+ * be created, this method stops and leaves that texture nullptr.
+ *
+ * @param key       The key of the atlas
+ * @param pages     The upload state for each atlas page
+ *
+ * @return true if there are more strips to upload
+ */
+bool TextureLoader::uploadPack(const std::string& key, const std::vector<std::shared_ptr<Upload>>& pages) {
+    for(auto it = pages.begin(); it != pages.end(); ++it) {
+        Upload& state = **it;
+        if (state.surface == nullptr) {
+            continue;
+        }
+        if (state.texture == nullptr) {
+            GLint limit = 0;
+            glGetIntegerv(GL_MAX_TEXTURE_SIZE, &limit);
+            if (state.surface->w > limit || state.surface->h > limit) {
+                CULogError("Atlas '%s' page is %dx%d, but textures are limited to %d",
+                           key.c_str(), state.surface->w, state.surface->h, limit);
+                return false;
+            }
+        }
+        if (upload(state)) {
+            return true;
+        }
+        // The next page starts on the next call, unless this one failed
+        return state.texture != nullptr && it+1 != pages.end();
+    }
+    return false;
+}
+
+/**
+ * Assigns the keys of a packed atlas once its pages are uploaded.
+ *
+ * This method finishes the asset loading started in {@link preloadPack}
+ * and {@link uploadPack}.  It is not safe to be done in a separate thread.
+ * Instead, it takes place in the main CUGL thread via {@link Application#defer}.
+ *
+ * The first page is assigned the key of the directory entry, and any
+ * later page n has the suffix _n.  Each packed image is then assigned its
+ * own key as a subtexture of its page.  Hence a packed image is accessed
+ * exactly as if it had been loaded on its own, but all images on the same
+ * page can be drawn by a {@link SpriteBatch} without a flush.
+ *
+ * This method supports an optional callback function which reports
+ * whether the asset was successfully materialized.
+ *
+ * @param json      The asset directory entry
+ * @param pages     The upload state for each atlas page
+ * @param images    The placement of each image in the pages
+ * @param callback  An optional callback for asynchronous loading
+ *
+ * @return true if the atlas was successfully materialized
+ */
+bool TextureLoader::materializePack(const std::shared_ptr<JsonValue>& json, const std::vector<std::shared_ptr<Upload>>& pages,
+                                    const std::vector<PackedImage>& images, LoaderCallback callback) {
+    std::string key = json->key();
+    GLuint minflt = decodeMinFilter(json->getString("minfilter",UNKNOWN_MINFLT));
+    GLuint magflt = decodeMagFilter(json->getString("magfilter",UNKNOWN_MAGFLT));
+    GLuint wrapS = decodeWrap(json->getString("wrapS",UNKNOWN_WRAP));
+    GLuint wrapT = decodeWrap(json->getString("wrapT",UNKNOWN_WRAP));
+    bool mipmaps = json->getBool("mipmaps",false);
+    
+    bool success = !pages.empty();
+    std::vector<std::shared_ptr<Texture>> textures;
+    for(auto it = pages.begin(); it != pages.end(); ++it) {
+        // A page is only complete once its surface is released
+        std::shared_ptr<Texture> texture = (*it)->texture;
+        success = success && texture != nullptr && (*it)->surface == nullptr;
+        if (success) {
+            texture->setPremultiplied(json->getBool("premultiply",false));
+            texture->bind();
+            if (mipmaps) { texture->buildMipMaps(); }
+            texture->setMinFilter(minflt);
+            texture->setMagFilter(magflt);
+            texture->setWrapS(wrapS);
+            texture->setWrapT(wrapT);
+            texture->unbind();
+            textures.push_back(texture);
+        }
+    }
+    
+    if (success) {
+        for(size_t ii = 0; ii < textures.size(); ii++) {
+            _assets[ii == 0 ? key : key+"_"+cugl::to_string((Sint32)ii)] = textures[ii];
+        }
+        for(auto it = images.begin(); it != images.end(); ++it) {
+            const std::shared_ptr<Texture>& page = textures[it->page];
+            float w = (float)page->getWidth();
+            float h = (float)page->getHeight();
+            _assets[it->key] = page->getSubTexture(it->x/w, (it->x+it->width)/w,
+                                                   it->y/h, (it->y+it->height)/h);
+        }
+    }
+    
+    if (callback != nullptr) {
+        callback(key,success);
+    }
+    _queue.erase(key);
+    return success;
+}
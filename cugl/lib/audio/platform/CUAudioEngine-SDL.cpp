@@ -35,6 +35,7 @@
 #include <cugl/audio/CUMusic.h>
 #include <cugl/audio/CUAudioEngine.h>
 #include <cugl/util/CUDebug.h>
+#include <cugl/io/CUAssetPack.h>
 #include <SDL/SDL_mixer.h>
 #include <vector>
 
@@ -241,7 +242,7 @@ void AudioStop() {
  * @return an in-memory PCM buffer for the given audio asset
  */
 AudioBuffer* AudioLoadBuffer(const char* file) {
-    Mix_Chunk* data = Mix_LoadWAV(file);
+    Mix_Chunk* data = Mix_LoadWAV_RW(AssetPack::openFile(file,"rb"), 1);
     if (!data) {
         return nullptr;
     }
@@ -337,7 +338,8 @@ double AudioGetBufferSampleRate(AudioBuffer* source) {
  * @return an audio stream for the given music asset
  */
 AudioStream* AudioLoadStream(const char* file) {
-    Mix_Music* data = Mix_LoadMUS(file);
+    // The music streams from its file, so the stream stays open with it
+    Mix_Music* data = Mix_LoadMUS_RW(AssetPack::openFile(file,"rb"), 1);
     if (!data) {
         return nullptr;
     }
@@ -37,6 +37,7 @@
 #include <cugl/util/CUDebug.h>
 #include <SDL/SDL_ttf.h>
 #include <algorithm>
+#include <atomic>
 
 /** The default screen width */
 #define DEFAULT_WIDTH   1024
@@ -44,12 +45,45 @@
 #define DEFAULT_HEIGHT  576
 /** The default smoothing window for fps calculation */
 #define FPS_WINDOW      10
+/** The default time budget (in microseconds) for deferred work each frame */
+#define DEFAULT_DEFER   4000
 
 using namespace cugl;
 
 /** A weak pointer to the single application that is running */
 Application* Application::_theapp = nullptr;
 
+/**
+ * A scheduled callback, or a request to cancel one.
+ *
+ * Both kinds are posted to the inbox, linked by next.  In the timer wheel,
+ * each bucket is a doubly linked list, so a callback can be removed in
+ * constant time.
+ */
+struct Application::Timer {
+    /** The callback identifier */
+    Uint32 id;
+    /** The callback function */
+    std::function<bool()> callback;
+    /** The reoccurrence period (0 if called every frame) */
+    Uint32 period;
+    /** The wheel time when due (just the delay while in the inbox) */
+    Uint64 deadline;
+    /** Whether this is a request to cancel the callback id */
+    bool cancel;
+    /** The wheel level (WHEEL_LEVELS for overflow, -1 if not in the wheel) */
+    int level;
+    /** The bucket in the wheel level */
+    int slot;
+    /** The previous callback in the bucket */
+    Timer* prev;
+    /** The next callback in the bucket (or the inbox) */
+    Timer* next;
+    
+    Timer() : id(0), period(0), deadline(0), cancel(false),
+    level(-1), slot(0), prev(nullptr), next(nullptr) {}
+};
+
 
 #pragma mark -
 #pragma mark Constructors
@@ -72,10 +106,21 @@ _highdpi(true),
 _finish(0),
 _start(0),
 _funcid(0),
+_inbox(nullptr),
+_overflow(nullptr),
+_clock(0),
+_deferid(0),
+_deferBudget(DEFAULT_DEFER),
 _clearColor(Color4f::CORNFLOWER) // Ah, XNA
 {
     _display.size.set(DEFAULT_WIDTH,DEFAULT_HEIGHT);
     setFPS(60.0f);
+    for(int ii = 0; ii < WHEEL_LEVELS; ii++) {
+        _occupied[ii] = 0;
+        for(int jj = 0; jj < WHEEL_SLOTS; jj++) {
+            _wheel[ii][jj] = nullptr;
+        }
+    }
 #if (CU_PLATFORM == CU_PLATFORM_IPHONE || CU_PLATFORM == CU_PLATFORM_ANDROID)
     _fullscreen = true;
 #endif
@@ -108,6 +153,7 @@ void Application::dispose() {
     _fpswindow.clear();
     _clearColor = Color4f::CORNFLOWER;
     setFPS(60.0f);
+    clearCallbacks();
 }
 
 /**
@@ -303,6 +349,7 @@ bool Application::step() {
     bool running = getInput();
     if (running &&  _state == State::FOREGROUND) {
         processCallbacks(millis);
+        processDeferred();
         update(lastframe);
 
         glClearColor(_clearColor.r, _clearColor.g, _clearColor.b, _clearColor.a);
@@ -370,15 +417,7 @@ void Application::quit() {
  * @return a unique identifier to unschedule the callback
  */
 Uint32 Application::schedule(std::function<bool()> callback, Uint32 time) {
-    scheduable item;
-    item.callback = callback;
-    item.period = time;
-    item.timer  = time;
-	{
-		std::unique_lock<std::mutex> lk(_queueMutex);
-		_callbacks.emplace(_funcid++, item);
-	}
-    return _funcid-1;
+    return schedule(callback, time, time);
 }
 
 /**
@@ -409,15 +448,14 @@ Uint32 Application::schedule(std::function<bool()> callback, Uint32 time) {
  * @return a unique identifier to unschedule the callback
  */
 Uint32 Application::schedule(std::function<bool()> callback, Uint32 time, Uint32 period) {
-    scheduable item;
-    item.callback = callback;
-    item.period = period;
-    item.timer  = time;
-	{
-		std::unique_lock<std::mutex> lk(_queueMutex);
-		_callbacks.emplace(_funcid++, item);
-	}
-    return _funcid-1;
+    Uint32 id = _funcid++;
+    Timer* timer = new Timer();
+    timer->id = id;
+    timer->callback = callback;
+    timer->period = period;
+    timer->deadline = time;
+    post(timer);
+    return id;
 }
 
 /**
@@ -428,58 +466,329 @@ Uint32 Application::schedule(std::function<bool()> callback, Uint32 time, Uint32
  * be executed.  Once unscheduled, a callback must be re-scheduled in
  * order to be activated again.
  *
- * The callback is identified by its function pointer. Therefore, you
- * should be careful when scheduling anonymous closures.
+ * The callback is identified by the unique identifier returned by the
+ * appropriate schedule function.  This method is safe to call from any
+ * thread.  The callback is removed at the start of the next animation
+ * frame, before any callbacks run.
+ *
+ * @param id    The callback identifier
  */
 void Application::unschedule(Uint32 id) {
-	std::unique_lock<std::mutex> lk(_queueMutex);
-    auto it = _callbacks.find(id);
-    if (it != _callbacks.end()) {
-        _callbacks.erase(it);
+    Timer* cancel = new Timer();
+    cancel->id = id;
+    cancel->cancel = true;
+    post(cancel);
+}
+
+/**
+ * Defers main-thread work to run under the per-frame work budget.
+ *
+ * Deferred work is executed after the scheduled callbacks, but only
+ * until the budget set by {@link setDeferBudget} is spent for that
+ * frame.  Whatever is left waits for the next frame.  Work with a
+ * larger priority runs first.
+ *
+ * The work function returns true if it has more to do, and false when
+ * it is done.  Long tasks (such as texture uploads) should be broken
+ * into pieces this way, so that the budget can stop them part way.
+ *
+ * This method is safe to call from any thread.  The work is guaranteed
+ * to be executed in the main thread.
+ *
+ * @param work      The work function
+ * @param priority  The work priority (larger runs first)
+ *
+ * @return a unique identifier for the deferred work
+ */
+Uint32 Application::defer(std::function<bool()> work, int priority) {
+    deferrable item;
+    item.work = work;
+    item.priority = priority;
+    std::unique_lock<std::mutex> lk(_queueMutex);
+    Uint32 id = _deferid++;
+    _deferred.emplace(id, item);
+    _deferOrder.emplace(-priority, id);
+    return id;
+}
+
+/**
+ * Changes the priority of deferred work that has not finished.
+ *
+ * This allows work that has become urgent (such as an asset that is
+ * needed on screen now) to jump the queue.
+ *
+ * @param id        The deferred work identifier
+ * @param priority  The new work priority (larger runs first)
+ *
+ * @return true if the work was still pending
+ */
+bool Application::prioritize(Uint32 id, int priority) {
+    std::unique_lock<std::mutex> lk(_queueMutex);
+    auto it = _deferred.find(id);
+    if (it == _deferred.end()) {
+        return false;
     }
+    _deferOrder.erase(std::make_pair(-it->second.priority, id));
+    it->second.priority = priority;
+    _deferOrder.emplace(-priority, id);
+    return true;
+}
+
+/**
+ * Returns the number of pieces of deferred work that have not finished.
+ *
+ * @return the number of pieces of deferred work that have not finished.
+ */
+size_t Application::getDeferredCount() {
+    std::unique_lock<std::mutex> lk(_queueMutex);
+    return _deferred.size();
 }
 
 /**
  * Processes all of the scheduled callback functions.
  *
  * This method wakes up any sleeping callbacks that should be executed.
- * If they are a one time callback, or if they return false, they are deleted.  
- * If they are a reoccuring callback and return true, the timer is reset.
+ * If they return false, they are deleted.  Otherwise the timer is reset.
+ * The callbacks are kept in a hierarchical timer wheel, so the cost of
+ * a frame depends on the number of callbacks that are due, not on the
+ * number that are scheduled.
  *
  * @param millis    The number of milliseconds since last called
  */
 void Application::processCallbacks(Uint32 millis) {
-	std::vector<Uint32> indeces;
-	std::vector<scheduable> actives;
-	{
-		std::unique_lock<std::mutex> lk(_queueMutex);
-		for (auto it = _callbacks.begin(); it != _callbacks.end(); ++it) {
-			if (it->second.timer < millis) {
-				indeces.push_back(it->first);
-				actives.push_back(it->second);
-				it->second.timer -= std::min(it->second.timer, millis);
-				it->second.timer += it->second.period;
-			} else {
-				it->second.timer -= millis;
-			}
-		}
-	}
+    // Empty the inbox, oldest first
+    Timer* posted = _inbox.exchange(nullptr, std::memory_order_acquire);
+    Timer* inbox = nullptr;
+    while (posted != nullptr) {
+        Timer* timer = posted;
+        posted = posted->next;
+        timer->next = inbox;
+        inbox = timer;
+    }
+    while (inbox != nullptr) {
+        Timer* timer = inbox;
+        inbox = inbox->next;
+        if (timer->cancel) {
+            auto it = _callbacks.find(timer->id);
+            if (it != _callbacks.end()) {
+                remove(it->second);
+                delete it->second;
+                _callbacks.erase(it);
+            }
+            delete timer;
+        } else {
+            // Due once more than the delay has passed
+            timer->deadline += _clock+1;
+            _callbacks.emplace(timer->id, timer);
+            insert(timer);
+        }
+    }
+    
+    // Advance the wheel bucket by bucket, skipping the empty ones
+    Uint64 target = _clock+millis;
+    Timer* ready = nullptr;
+    Timer* last  = nullptr;
+    while (true) {
+        int level = -1;
+        int slot  = 0;
+        for(int ii = 0; ii < WHEEL_LEVELS && level < 0; ii++) {
+            int digit = (int)((_clock >> (WHEEL_BITS*ii)) & (WHEEL_SLOTS-1));
+            Uint64 mask = _occupied[ii] & (~(Uint64)0 << digit);
+            if (mask) {
+                level = ii;
+                while (!(mask & ((Uint64)1 << slot))) {
+                    slot++;
+                }
+            }
+        }
+        
+        // The earliest time a callback in the bucket may be due
+        Uint64 start;
+        Timer* bucket;
+        if (level >= 0) {
+            int shift = WHEEL_BITS*level;
+            start  = (_clock & ~(((Uint64)1 << (shift+WHEEL_BITS))-1)) | ((Uint64)slot << shift);
+            bucket = _wheel[level][slot];
+        } else if (_overflow != nullptr) {
+            int shift = WHEEL_BITS*WHEEL_LEVELS;
+            start  = ((_clock >> shift)+1) << shift;
+            bucket = _overflow;
+        } else {
+            break;
+        }
+        if (start > target) {
+            break;
+        }
+        
+        _clock = start;
+        while (bucket != nullptr) {
+            Timer* timer = bucket;
+            bucket = bucket->next;
+            remove(timer);
+            if (level == 0) {
+                if (last == nullptr) {
+                    ready = timer;
+                } else {
+                    last->next = timer;
+                }
+                last = timer;
+            } else {
+                // Move the callback down a level (or into the wheel)
+                insert(timer);
+            }
+        }
+    }
+    _clock = target;
+    
+    while (ready != nullptr) {
+        Timer* timer = ready;
+        ready = ready->next;
+        timer->next = nullptr;
+        if (timer->callback()) {
+            timer->deadline = _clock+timer->period+1;
+            insert(timer);
+        } else {
+            _callbacks.erase(timer->id);
+            delete timer;
+        }
+    }
+}
 
-	// These can take a while, so do them outside lock
-	for (int ii = 0; ii < actives.size(); ii++) {
-		if (actives[ii].callback()) {
-			indeces[ii] = (Uint32)-1;
-		}
-	}
+/**
+ * Adds a new callback or cancellation to the inbox.
+ *
+ * This method is lock-free and safe to call from any thread.  The
+ * inbox is emptied into the timer wheel at the start of each frame.
+ *
+ * @param timer The callback or cancellation
+ */
+void Application::post(Timer* timer) {
+    Timer* head = _inbox.load(std::memory_order_relaxed);
+    do {
+        timer->next = head;
+    } while (!_inbox.compare_exchange_weak(head, timer, std::memory_order_release,
+                                           std::memory_order_relaxed));
+}
 
-	{
-		std::unique_lock<std::mutex> lk(_queueMutex);
-		for (auto it = indeces.begin(); it != indeces.end(); ++it) {
-			if (*it != (Uint32)-1) {
-				_callbacks.erase(*it);
-			}
-		}
-	}
+/**
+ * Adds a callback to the timer wheel, according to its deadline.
+ *
+ * The level is the highest digit in which the deadline differs from the
+ * wheel time.  So a callback moves down a level each time the wheel
+ * reaches its bucket, until it is in level 0 at its exact deadline.
+ *
+ * @param timer The callback to add
+ */
+void Application::insert(Timer* timer) {
+    Uint64 due = std::max(timer->deadline, _clock);
+    Uint64 diff = due ^ _clock;
+    int level = 0;
+    while (level < WHEEL_LEVELS && (diff >> (WHEEL_BITS*(level+1))) != 0) {
+        level++;
+    }
+    
+    Timer** head;
+    timer->level = level;
+    if (level < WHEEL_LEVELS) {
+        timer->slot = (int)((due >> (WHEEL_BITS*level)) & (WHEEL_SLOTS-1));
+        _occupied[level] |= (Uint64)1 << timer->slot;
+        head = &_wheel[level][timer->slot];
+    } else {
+        head = &_overflow;
+    }
+    timer->prev = nullptr;
+    timer->next = *head;
+    if (*head != nullptr) {
+        (*head)->prev = timer;
+    }
+    *head = timer;
+}
+
+/**
+ * Removes a callback from its bucket of the timer wheel.
+ *
+ * @param timer The callback to remove
+ */
+void Application::remove(Timer* timer) {
+    if (timer->level < 0) {
+        return;
+    }
+    
+    Timer** head = (timer->level < WHEEL_LEVELS ? &_wheel[timer->level][timer->slot] : &_overflow);
+    if (timer->prev != nullptr) {
+        timer->prev->next = timer->next;
+    } else {
+        *head = timer->next;
+    }
+    if (timer->next != nullptr) {
+        timer->next->prev = timer->prev;
+    }
+    if (timer->level < WHEEL_LEVELS && *head == nullptr) {
+        _occupied[timer->level] &= ~((Uint64)1 << timer->slot);
+    }
+    timer->level = -1;
+    timer->prev = nullptr;
+    timer->next = nullptr;
+}
+
+/**
+ * Deletes all scheduled callbacks, including those still in the inbox.
+ */
+void Application::clearCallbacks() {
+    Timer* posted = _inbox.exchange(nullptr, std::memory_order_acquire);
+    while (posted != nullptr) {
+        Timer* timer = posted;
+        posted = posted->next;
+        delete timer;
+    }
+    for (auto it = _callbacks.begin(); it != _callbacks.end(); ++it) {
+        delete it->second;
+    }
+    _callbacks.clear();
+    for(int ii = 0; ii < WHEEL_LEVELS; ii++) {
+        _occupied[ii] = 0;
+        for(int jj = 0; jj < WHEEL_SLOTS; jj++) {
+            _wheel[ii][jj] = nullptr;
+        }
+    }
+    _overflow = nullptr;
+    _clock = 0;
+}
+
+/**
+ * Processes deferred work until the frame budget is spent.
+ *
+ * Work runs in priority order, and work of equal priority runs in the
+ * order it was deferred.  At least one piece of work runs each frame,
+ * so that an undersized budget cannot stall the queue.
+ */
+void Application::processDeferred() {
+    Timestamp start;
+    Timestamp now;
+    do {
+        Uint32 id;
+        std::function<bool()> work;
+        {
+            std::unique_lock<std::mutex> lk(_queueMutex);
+            if (_deferOrder.empty()) {
+                return;
+            }
+            id = _deferOrder.begin()->second;
+            work = _deferred[id].work;
+        }
+        
+        // This can take a while, so do it outside lock
+        bool more = work();
+        if (!more) {
+            std::unique_lock<std::mutex> lk(_queueMutex);
+            auto it = _deferred.find(id);
+            if (it != _deferred.end()) {
+                _deferOrder.erase(std::make_pair(-it->second.priority, id));
+                _deferred.erase(it);
+            }
+        }
+        now.mark();
+    } while (Timestamp::ellapsedMicros(start,now) < _deferBudget);
 }
 
 
@@ -0,0 +1,716 @@
+//
+//  CUAssetPack.cpp
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides support for an asset pack.  A pack is a single file
+//  that holds every file of the asset directory, so that loading an asset
+//  does not have to open a file of its own.  This is much faster on Android,
+//  where each asset is a separate lookup in the APK.
+//
+//  The pack is mapped into memory when the platform allows it, and each entry
+//  is read through an SDL_RWops that points straight into the mapping.  The
+//  I/O classes and the asset loaders resolve asset paths through the pack,
+//  falling back to the asset directory if an asset is not in it.  Packs are
+//  built from the asset directory with the packassets.py tool.
+//
+//  This class uses our standard shared-pointer architecture.
+//
+//  1. The constructor does not perform any initialization; it just sets all
+//     attributes to their defaults.
+//
+//  2. All initialization takes place via init methods, which can fail if an
+//     object is initialized more than once.
+//
+//  3. All allocation takes place via static constructors which return a shared
+//     pointer.
+//
+//  CUGL zlib License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+#include <cugl/io/CUAssetPack.h>
+#include <cugl/assets/CULoader.h>
+#include <cugl/base/CUApplication.h>
+#include <cugl/util/CUDebug.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#if defined (__WINDOWS__)
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+#if defined (__ANDROID__)
+    #include <jni.h>
+    #include <android/asset_manager_jni.h>
+#endif
+
+using namespace cugl;
+
+/** The pack magic number ("CUPK") */
+#define PACK_MAGIC      0x4B505543
+/** The current pack version */
+#define PACK_VERSION    1
+/** The size of the pack header */
+#define PACK_HEADER     16
+/** The size of an index entry */
+#define PACK_ENTRY      40
+/** The alignment of the entry data */
+#define PACK_ALIGN      16
+/** The largest expansion of an LZ4 block */
+#define PACK_RATIO      256
+
+#pragma mark -
+#pragma mark Support Functions
+/**
+ * Returns the little-endian 32-bit value at the given address
+ *
+ * @param data  The value address
+ *
+ * @return the little-endian 32-bit value at the given address
+ */
+static Uint32 readLE32(const Uint8* data) {
+    Uint32 value;
+    std::memcpy(&value, data, sizeof(Uint32));
+    return SDL_SwapLE32(value);
+}
+
+/**
+ * Returns the little-endian 64-bit value at the given address
+ *
+ * @param data  The value address
+ *
+ * @return the little-endian 64-bit value at the given address
+ */
+static Uint64 readLE64(const Uint8* data) {
+    Uint64 value;
+    std::memcpy(&value, data, sizeof(Uint64));
+    return SDL_SwapLE64(value);
+}
+
+#if defined (__ANDROID__)
+/**
+ * Returns a file descriptor for an asset stored uncompressed in the APK
+ *
+ * The asset is the length bytes of the file starting at start.  This
+ * method returns -1 if the asset does not exist or is compressed in the
+ * APK (it is only stored as is if build.gradle lists it as noCompress).
+ *
+ * @param path      The asset path
+ * @param start     Pointer to store the start of the asset in the file
+ * @param length    Pointer to store the length of the asset
+ *
+ * @return a file descriptor for an asset stored uncompressed in the APK
+ */
+static int openApkAsset(const std::string& path, Sint64* start, Sint64* length) {
+    JNIEnv* env = (JNIEnv*)SDL_AndroidGetJNIEnv();
+    jobject activity = (jobject)SDL_AndroidGetActivity();
+    if (env == nullptr || activity == nullptr) {
+        return -1;
+    }
+    
+    int result = -1;
+    jclass clazz = env->GetObjectClass(activity);
+    jmethodID method = env->GetMethodID(clazz, "getAssets", "()Landroid/content/res/AssetManager;");
+    jobject assets = (method == nullptr ? nullptr : env->CallObjectMethod(activity, method));
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+    } else if (assets != nullptr) {
+        AAssetManager* manager = AAssetManager_fromJava(env, assets);
+        AAsset* asset = (manager == nullptr ? nullptr : AAssetManager_open(manager, path.c_str(), AASSET_MODE_RANDOM));
+        if (asset != nullptr) {
+            off64_t offset, size;
+            result = AAsset_openFileDescriptor64(asset, &offset, &size);
+            *start  = (Sint64)offset;
+            *length = (Sint64)size;
+            AAsset_close(asset);
+        }
+    }
+    if (assets != nullptr) {
+        env->DeleteLocalRef(assets);
+    }
+    env->DeleteLocalRef(clazz);
+    env->DeleteLocalRef(activity);
+    return result;
+}
+#endif
+
+/**
+ * The state of a stream for a pack entry
+ *
+ * The stream reads the pack mapping, a buffer of its own, or (for an
+ * uncompressed entry of a pack that is not mapped) the pack file itself.
+ * It keeps the pack alive, so that the mapping and file outlive the stream.
+ */
+class PackStream {
+public:
+    /** The pack of the entry */
+    std::shared_ptr<const AssetPack> pack;
+    /** The entry contents, if they are not read from the mapping */
+    std::vector<Uint8> owned;
+    /** The start of the entry contents (nullptr to read the pack file) */
+    const Uint8* base;
+    /** The pack file, if the entry is read from it */
+    SDL_RWops* file;
+    /** The mutex guarding the pack file */
+    std::mutex* mutex;
+    /** The offset of the entry in the pack file */
+    Sint64 offset;
+    /** The size of the entry contents */
+    Sint64 size;
+    /** The current read position */
+    Sint64 pos;
+};
+
+/**
+ * Returns the size of the entry of a pack stream
+ *
+ * @param context   The pack stream
+ *
+ * @return the size of the entry of a pack stream
+ */
+static Sint64 SDLCALL packSize(SDL_RWops* context) {
+    return ((PackStream*)context->hidden.unknown.data1)->size;
+}
+
+/**
+ * Seeks to a position in a pack stream, returning the new position
+ *
+ * As with SDL memory streams, the position is clamped to the entry.
+ *
+ * @param context   The pack stream
+ * @param offset    The offset from whence
+ * @param whence    One of RW_SEEK_SET, RW_SEEK_CUR or RW_SEEK_END
+ *
+ * @return the new position of the pack stream
+ */
+static Sint64 SDLCALL packSeek(SDL_RWops* context, Sint64 offset, int whence) {
+    PackStream* stream = (PackStream*)context->hidden.unknown.data1;
+    Sint64 pos = 0;
+    switch (whence) {
+        case RW_SEEK_SET:
+            pos = offset;
+            break;
+        case RW_SEEK_CUR:
+            pos = stream->pos+offset;
+            break;
+        case RW_SEEK_END:
+            pos = stream->size+offset;
+            break;
+        default:
+            return SDL_SetError("Unknown value for 'whence'");
+    }
+    stream->pos = std::max((Sint64)0, std::min(pos, stream->size));
+    return stream->pos;
+}
+
+/**
+ * Reads objects from a pack stream, returning the number read
+ *
+ * @param context   The pack stream
+ * @param ptr       The buffer to read into
+ * @param size      The size of an object in bytes
+ * @param maxnum    The maximum number of objects to read
+ *
+ * @return the number of objects read
+ */
+static size_t SDLCALL packRead(SDL_RWops* context, void* ptr, size_t size, size_t maxnum) {
+    PackStream* stream = (PackStream*)context->hidden.unknown.data1;
+    if (size == 0 || maxnum == 0 || maxnum > std::numeric_limits<size_t>::max()/size) {
+        return 0;
+    }
+    size_t available = (size_t)(stream->size-stream->pos);
+    size_t amount = std::min(size*maxnum, available-available % size);
+    if (stream->base != nullptr) {
+        std::memcpy(ptr, stream->base+stream->pos, amount);
+    } else if (amount > 0) {
+        // Streams share the pack file, so seek on every read
+        std::lock_guard<std::mutex> lock(*(stream->mutex));
+        if (SDL_RWseek(stream->file, stream->offset+stream->pos, RW_SEEK_SET) < 0) {
+            return 0;
+        }
+        amount = SDL_RWread(stream->file, ptr, 1, amount);
+        amount -= amount % size;
+    }
+    stream->pos += amount;
+    return amount/size;
+}
+
+/**
+ * Fails to write to a pack stream, as pack entries are read-only
+ *
+ * @param context   The pack stream
+ * @param ptr       The buffer to write from
+ * @param size      The size of an object in bytes
+ * @param num       The number of objects to write
+ *
+ * @return 0, as nothing is written
+ */
+static size_t SDLCALL packWrite(SDL_RWops* context, const void* ptr, size_t size, size_t num) {
+    SDL_SetError("Asset pack entries are read-only");
+    return 0;
+}
+
+/**
+ * Closes a pack stream, releasing its entry
+ *
+ * @param context   The pack stream
+ *
+ * @return 0, as closing cannot fail
+ */
+static int SDLCALL packClose(SDL_RWops* context) {
+    delete (PackStream*)context->hidden.unknown.data1;
+    SDL_FreeRW(context);
+    return 0;
+}
+
+#pragma mark -
+#pragma mark Constructors
+/**
+ * Creates an unopened asset pack.
+ *
+ * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+ * the heap, use one of the static constructors instead.
+ */
+AssetPack::AssetPack() :
+_mapping(nullptr),
+_mapsize(0),
+_mapskip(0),
+_file(nullptr),
+_index(nullptr),
+_names(nullptr),
+_count(0) {
+}
+
+/**
+ * Closes this asset pack, releasing all resources.
+ *
+ * You must reinitialize the pack to use it.
+ */
+void AssetPack::dispose() {
+    unmap();
+    if (_file != nullptr) {
+        SDL_RWclose(_file);
+        _file = nullptr;
+    }
+    _header.clear();
+    _index = nullptr;
+    _names = nullptr;
+    _count = 0;
+    _path.clear();
+}
+
+/**
+ * Initializes the asset pack in the given file.
+ *
+ * This method fails quietly (returning false) if the file does not
+ * exist, but logs an error if it is not a valid pack.
+ *
+ * @param path  The path to the pack file
+ *
+ * @return true if the pack was opened successfully
+ */
+bool AssetPack::init(const std::string& path) {
+    if (!_path.empty()) {
+        return false;
+    }
+
+    const Uint8* header = nullptr;
+    Uint64 size = 0;
+    if (map(path)) {
+        header = _mapping;
+        size = _mapsize;
+    } else {
+        // Without a mapping, keep the file open and copy the tables
+        _file = SDL_RWFromFile(path.c_str(), "rb");
+        if (_file == nullptr) {
+            return false;
+        }
+        Sint64 total = SDL_RWsize(_file);
+        size = (total > 0 ? (Uint64)total : 0);
+        _header.resize(PACK_HEADER);
+        if (size >= PACK_HEADER && SDL_RWread(_file, _header.data(), PACK_HEADER, 1) == 1) {
+            Uint64 tables = PACK_HEADER+(Uint64)readLE32(_header.data()+8)*PACK_ENTRY+readLE32(_header.data()+12);
+            if (tables <= size) {
+                _header.resize((size_t)tables);
+                if (SDL_RWread(_file, _header.data()+PACK_HEADER, 1, _header.size()-PACK_HEADER) == _header.size()-PACK_HEADER) {
+                    header = _header.data();
+                }
+            }
+        }
+    }
+
+    if (header == nullptr || !validate(header, size)) {
+        CULogError("'%s' is not a valid asset pack", path.c_str());
+        dispose();
+        return false;
+    }
+    _path = path;
+    return true;
+}
+
+/**
+ * Maps the given file into memory, returning true on success
+ *
+ * @param path  The file to map
+ *
+ * @return true if the file was mapped
+ */
+bool AssetPack::map(const std::string& path) {
+#if defined (__WINDOWS__)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 ||
+        (Uint64)size.QuadPart > std::numeric_limits<size_t>::max()) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return false;
+    }
+    void* address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (address == NULL) {
+        return false;
+    }
+    _mapsize = (size_t)size.QuadPart;
+    _mapping = (Uint8*)address;
+#else
+    Sint64 start = 0;
+    Sint64 length = 0;
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file >= 0) {
+        struct stat status;
+        length = (fstat(file, &status) == 0 ? (Sint64)status.st_size : 0);
+    }
+#if defined (__ANDROID__)
+    else {
+        // A pack inside the APK is mapped from the APK itself
+        file = openApkAsset(path, &start, &length);
+    }
+#endif
+    if (file < 0) {
+        return false;
+    } else if (length <= 0 || (Uint64)length > std::numeric_limits<size_t>::max()/2) {
+        ::close(file);
+        return false;
+    }
+    
+    // The mapping must start on a page boundary
+    Sint64 skip = start % sysconf(_SC_PAGESIZE);
+    void* address = mmap(nullptr, (size_t)(length+skip), PROT_READ, MAP_PRIVATE, file, (off_t)(start-skip));
+    ::close(file);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    _mapping = (Uint8*)address+skip;
+    _mapsize = (size_t)length;
+    _mapskip = (size_t)skip;
+#endif
+    return true;
+}
+
+/**
+ * Unmaps the pack file, if it is mapped
+ */
+void AssetPack::unmap() {
+    if (_mapping == nullptr) {
+        return;
+    }
+#if defined (__WINDOWS__)
+    UnmapViewOfFile(_mapping);
+#else
+    munmap(_mapping-_mapskip, _mapsize+_mapskip);
+#endif
+    _mapping = nullptr;
+    _mapsize = 0;
+    _mapskip = 0;
+}
+
+/**
+ * Returns true if the header, index and name table are valid
+ *
+ * This method also checks that every entry lies within the pack, so
+ * that later reads need no checks of their own.  On success, it sets
+ * the index and name table.
+ *
+ * @param header    The start of the pack (or a copy of its tables)
+ * @param size      The size of the pack file
+ *
+ * @return true if the header, index and name table are valid
+ */
+bool AssetPack::validate(const Uint8* header, Uint64 size) {
+    if (size < PACK_HEADER || readLE32(header) != PACK_MAGIC || readLE32(header+4) != PACK_VERSION) {
+        return false;
+    }
+    Uint32 count = readLE32(header+8);
+    Uint32 namesize = readLE32(header+12);
+    Uint64 tables = PACK_HEADER+(Uint64)count*PACK_ENTRY+namesize;
+    if (tables > size) {
+        return false;
+    }
+
+    const Uint8* index = header+PACK_HEADER;
+    const Uint8* names = index+(size_t)count*PACK_ENTRY;
+    for(Uint32 ii = 0; ii < count; ii++) {
+        const Uint8* entry = index+(size_t)ii*PACK_ENTRY;
+        Uint32 nameoff = readLE32(entry);
+        Uint32 namelen = readLE32(entry+4);
+        Uint64 offset = readLE64(entry+8);
+        Uint64 stored = readLE64(entry+16);
+        Uint64 length = readLE64(entry+24);
+        if ((Uint64)nameoff+namelen > namesize || offset < tables || offset % PACK_ALIGN != 0 ||
+            offset > size || stored > size-offset || stored > length ||
+            length > std::numeric_limits<size_t>::max() || (stored < length && length/PACK_RATIO > stored)) {
+            return false;
+        }
+
+        // Names must be strictly increasing for the binary search
+        if (ii > 0) {
+            const Uint8* prev = entry-PACK_ENTRY;
+            Uint32 prevlen = readLE32(prev+4);
+            int cmp = std::memcmp(names+readLE32(prev), names+nameoff, std::min(prevlen,namelen));
+            if (cmp > 0 || (cmp == 0 && prevlen >= namelen)) {
+                return false;
+            }
+        }
+    }
+
+    _count = count;
+    _index = index;
+    _names = names;
+    return true;
+}
+
+#pragma mark -
+#pragma mark Entries
+/**
+ * Returns the position of the given entry in the index, or -1 if missing
+ *
+ * @param name  The entry name
+ *
+ * @return the position of the given entry in the index, or -1 if missing
+ */
+Sint64 AssetPack::search(const std::string& name) const {
+    size_t lo = 0;
+    size_t hi = _count;
+    while (lo < hi) {
+        size_t mid = lo+(hi-lo)/2;
+        const Uint8* entry = _index+mid*PACK_ENTRY;
+        size_t namelen = readLE32(entry+4);
+        int cmp = std::memcmp(_names+readLE32(entry), name.data(), std::min(namelen,name.size()));
+        if (cmp == 0) {
+            cmp = (namelen < name.size() ? -1 : (namelen > name.size() ? 1 : 0));
+        }
+        if (cmp == 0) {
+            return (Sint64)mid;
+        } else if (cmp < 0) {
+            lo = mid+1;
+        } else {
+            hi = mid;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Returns true if this pack has an entry of the given name, storing its location.
+ *
+ * @param name  The entry name, relative to the asset directory
+ * @param entry The entry to store the location
+ *
+ * @return true if this pack has an entry of the given name.
+ */
+bool AssetPack::find(const std::string& name, Entry& entry) const {
+    Sint64 pos = search(name);
+    if (pos < 0) {
+        return false;
+    }
+    const Uint8* data = _index+(size_t)pos*PACK_ENTRY;
+    entry.offset = readLE64(data+8);
+    entry.stored = readLE64(data+16);
+    entry.size = readLE64(data+24);
+    entry.hash = readLE64(data+32);
+    return true;
+}
+
+/**
+ * Returns the name of the entry at the given position.
+ *
+ * The entries are sorted by name.
+ *
+ * @param pos   The entry position
+ *
+ * @return the name of the entry at the given position.
+ */
+std::string AssetPack::getName(size_t pos) const {
+    CUAssertLog(pos < _count, "Entry %zu is out of range", pos);
+    const Uint8* entry = _index+pos*PACK_ENTRY;
+    return std::string((const char*)_names+readLE32(entry), readLE32(entry+4));
+}
+
+/**
+ * Returns a read-only stream for the given entry.
+ *
+ * The stream must be closed with SDL_RWclose.  If the entry is
+ * uncompressed, the stream reads the mapping in place, or the pack file
+ * if the pack is not mapped.  Otherwise, the entry is decompressed into
+ * a buffer owned by the stream.  This method returns nullptr if the entry
+ * does not exist.
+ *
+ * @param name  The entry name, relative to the asset directory
+ *
+ * @return a read-only stream for the given entry.
+ */
+SDL_RWops* AssetPack::open(const std::string& name) const {
+    Entry entry;
+    if (!find(name,entry)) {
+        return nullptr;
+    }
+
+    std::unique_ptr<PackStream> stream(new PackStream());
+    stream->pack = shared_from_this();
+    stream->base = nullptr;
+    stream->file = nullptr;
+    stream->mutex = nullptr;
+    stream->offset = (Sint64)entry.offset;
+    stream->size = (Sint64)entry.size;
+    stream->pos  = 0;
+
+    const Uint8* data = nullptr;
+    std::vector<Uint8> buffer;
+    if (_mapping != nullptr) {
+        data = _mapping+entry.offset;
+    } else if (entry.stored == entry.size) {
+        // Stream the entry from the file, as it may be large (e.g. music)
+        stream->file  = _file;
+        stream->mutex = &_fileMutex;
+    } else {
+        std::lock_guard<std::mutex> lock(_fileMutex);
+        buffer.resize((size_t)entry.stored);
+        if (SDL_RWseek(_file, (Sint64)entry.offset, RW_SEEK_SET) < 0 ||
+            SDL_RWread(_file, buffer.data(), 1, buffer.size()) != buffer.size()) {
+            CULogError("Could not read '%s' from asset pack '%s'", name.c_str(), _path.c_str());
+            return nullptr;
+        }
+        data = buffer.data();
+    }
+
+    if (entry.stored < entry.size) {
+        stream->owned.resize((size_t)entry.size);
+        if (!AssetCache::decompress(data, (size_t)entry.stored, stream->owned.data(), stream->owned.size())) {
+            CULogError("Entry '%s' of asset pack '%s' is corrupt", name.c_str(), _path.c_str());
+            return nullptr;
+        }
+        stream->base = stream->owned.data();
+    } else {
+        stream->base = data;
+    }
+
+    SDL_RWops* result = SDL_AllocRW();
+    if (result == nullptr) {
+        return nullptr;
+    }
+    result->size  = packSize;
+    result->seek  = packSeek;
+    result->read  = packRead;
+    result->write = packWrite;
+    result->close = packClose;
+    result->type  = SDL_RWOPS_UNKNOWN;
+    result->hidden.unknown.data1 = stream.release();
+    return result;
+}
+
+#pragma mark -
+#pragma mark Asset Resolution
+/**
+ * Returns the pack in the asset directory, or nullptr if there is none.
+ *
+ * The pack is the file {@link CU_ASSET_PACK} in the asset directory.  It
+ * is opened on the first call, and stays open until the program exits.
+ *
+ * @return the pack in the asset directory, or nullptr if there is none.
+ */
+std::shared_ptr<AssetPack> AssetPack::get() {
+    static std::mutex mutex;
+    static std::shared_ptr<AssetPack> pack;
+    static bool opened = false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!opened && Application::get() != nullptr) {
+        opened = true;
+        pack = alloc(Application::get()->getAssetDirectory()+CU_ASSET_PACK);
+    }
+    return pack;
+}
+
+/**
+ * Returns a read-only stream for the given asset.
+ *
+ * The asset is taken from the pack in the asset directory if it is there,
+ * and otherwise from the asset directory itself.  This method returns
+ * nullptr if the asset does not exist.
+ *
+ * @param source    The asset path, relative to the asset directory
+ *
+ * @return a read-only stream for the given asset.
+ */
+SDL_RWops* AssetPack::openAsset(const std::string& source) {
+    return openFile(Application::get()->getAssetDirectory()+source, "rb");
+}
+
+/**
+ * Returns a stream for the given file, resolving assets through the pack.
+ *
+ * This is a replacement for SDL_RWFromFile.  If the file is opened for
+ * reading and is in the asset directory, it is taken from the pack when
+ * the pack has it.  Otherwise, this is the same as SDL_RWFromFile.
+ *
+ * Pack entries are always binary, so "r" reads carriage returns on
+ * every platform.
+ *
+ * @param path  The full path to the file
+ * @param mode  The SDL_RWFromFile mode
+ *
+ * @return a stream for the given file (nullptr on failure)
+ */
+SDL_RWops* AssetPack::openFile(const std::string& path, const char* mode) {
+    std::shared_ptr<AssetPack> pack = (mode[0] == 'r' && !strchr(mode,'+') ? get() : nullptr);
+    if (pack != nullptr) {
+        std::string root = Application::get()->getAssetDirectory();
+        if (path.compare(0, root.size(), root) == 0) {
+            // Pack names always use forward slashes
+            std::string name = path.substr(root.size());
+            std::replace(name.begin(), name.end(), '\\', '/');
+            SDL_RWops* result = pack->open(name);
+            if (result != nullptr) {
+                return result;
+            }
+        }
+    }
+    return SDL_RWFromFile(path.c_str(), mode);
+}
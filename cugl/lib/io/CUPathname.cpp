@@ -36,6 +36,7 @@
 //
 #include <cugl/base/CUBase.h>
 #include <stdio.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 
 #if defined (__ANDROID__) 
@@ -797,6 +798,35 @@ bool Pathname::deleteFile()  {
     return false;
 }
 
+/**
+ * Flushes the file denoted by this pathname to storage.
+ *
+ * Closing a file only hands its contents to the operating system.  This
+ * method blocks until they are on the storage device, so that a file
+ * written and then renamed over another cannot turn up empty after a
+ * crash.
+ *
+ * @return true if the file was successfully flushed.
+ */
+bool Pathname::syncFile() {
+#if defined (__WINDOWS__)
+    int fd = _open(_fullpath.c_str(), _O_RDWR | _O_BINARY);
+    if (fd < 0) {
+        return false;
+    }
+    bool result = _commit(fd) == 0;
+    _close(fd);
+#else
+    int fd = open(_fullpath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool result = fsync(fd) == 0;
+    close(fd);
+#endif
+    return result;
+}
+
 /**
  * Creates the directory named by this pathname.
  *
@@ -900,7 +930,8 @@ bool Pathname::createPath() {
  * for this pathname will no longer exist. The file will now be referred
  * to via the provided pathname.
  *
- * This method will fail if there is no file for this pathname.
+ * This method will fail if there is no file for this pathname.  If there
+ * is already a file at the new pathname, it is replaced (on every platform).
  *
  * @param path  The new pathname for this file.
  *
@@ -908,7 +939,13 @@ bool Pathname::createPath() {
  */
 bool Pathname::renameTo(const Pathname& dest)  {
     if (exists()) {
+#if defined (__WINDOWS__)
+        // Unlike POSIX, the Windows rename fails if the destination exists
+        return MoveFileExA(_fullpath.c_str(), dest._fullpath.c_str(),
+                           MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
         return std::rename(_fullpath.c_str(),dest._fullpath.c_str()) == 0;
+#endif
     }
     return false;
 }
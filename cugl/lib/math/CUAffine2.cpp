@@ -606,6 +606,23 @@ cugl::Rect* Affine2::transform(const Affine2& aff, const Rect& rect, Rect* dst)
     return dst;
 }
 
+/**
+ * Transforms an array of points in place by the given affine transform.
+ *
+ * Consecutive points start stride bytes apart, which allows this method
+ * to transform the positions inside of an array of vertices.  The default
+ * stride is a packed array of Vec2.
+ *
+ * @param aff       The affine transform.
+ * @param points    The first point to transform.
+ * @param count     The number of points to transform.
+ * @param stride    The distance in bytes between consecutive points.
+ */
+void Affine2::transformPoints(const Affine2& aff, Vec2* points, size_t count, size_t stride) {
+    float coeffs[6] = { aff.m[0], aff.m[2], aff.m[1], aff.m[3], aff.offset.x, aff.offset.y };
+    transformPoints2(coeffs, points, count, stride);
+}
+
 /**
  * Returns a copy of the given rectangle transformed.
  *
@@ -1183,6 +1183,24 @@ cugl::Rect* Mat4::transform(const Mat4& mat, const Rect& rect, Rect* dst) {
     return dst;
 }
 
+/**
+ * Transforms an array of points in place by the given matrix.
+ *
+ * The points are treated as 2d points (z = 0, w = 1), so translation is
+ * applied.  Consecutive points start stride bytes apart, which allows
+ * this method to transform the positions inside of an array of vertices.
+ * The default stride is a packed array of Vec2.
+ *
+ * @param mat       The transform matrix.
+ * @param points    The first point to transform.
+ * @param count     The number of points to transform.
+ * @param stride    The distance in bytes between consecutive points.
+ */
+void Mat4::transformPoints(const Mat4& mat, Vec2* points, size_t count, size_t stride) {
+    float coeffs[6] = { mat.m[0], mat.m[1], mat.m[4], mat.m[5], mat.m[12], mat.m[13] };
+    transformPoints2(coeffs, points, count, stride);
+}
+
 /**
  * Decomposes the scale, rotation and translation components of the given matrix.
  *
@@ -7,6 +7,13 @@
 //
 
 #include <cugl/math/CUMathBase.h>
+#if defined (CU_MATH_KERNEL_AVX2)
+    #include <immintrin.h>
+#elif defined (CU_MATH_KERNEL_SSE2)
+    #include <emmintrin.h>
+#elif defined (CU_MATH_KERNEL_NEON)
+    #include <arm_neon.h>
+#endif
 
 /**
  * Returns the power of two greater than or equal to x
@@ -24,3 +31,112 @@ int nextPOT(int x) {
     x = x | (x >>16);
     return x + 1;
 }
+
+/**
+ * Applies a 2d affine transform to an array of points in place.
+ *
+ * The transform is the six values (a, b, c, d, tx, ty), so that each point
+ * (x,y) becomes (a*x+c*y+tx, b*x+d*y+ty).  A point is a pair of floats, and
+ * consecutive points start stride bytes apart.  Hence this can transform
+ * the positions of an array of vertices, as well as a plain Vec2 array.  A
+ * stride of 2*sizeof(float) is the fastest case.
+ *
+ * This function uses AVX2, SSE2 or NEON when the compiler supports them,
+ * and falls back to scalar code otherwise.
+ *
+ * @param affine    The six transform values
+ * @param points    The first point to transform
+ * @param count     The number of points
+ * @param stride    The distance in bytes between consecutive points
+ */
+void transformPoints2(const float* affine, void* points, size_t count, size_t stride) {
+    char* base = (char*)points;
+    size_t ii = 0;
+    
+#if defined (CU_MATH_KERNEL_SSE2)
+    // Two points per register: [x0 y0 x1 y1]
+    __m128 ab = _mm_setr_ps(affine[0],affine[1],affine[0],affine[1]);
+    __m128 cd = _mm_setr_ps(affine[2],affine[3],affine[2],affine[3]);
+    __m128 tt = _mm_setr_ps(affine[4],affine[5],affine[4],affine[5]);
+    if (stride == 2*sizeof(float)) {
+        float* data = (float*)base;
+#if defined (CU_MATH_KERNEL_AVX2)
+        __m256 ab8 = _mm256_set_m128(ab,ab);
+        __m256 cd8 = _mm256_set_m128(cd,cd);
+        __m256 tt8 = _mm256_set_m128(tt,tt);
+        for(; ii+4 <= count; ii += 4) {
+            __m256 v  = _mm256_loadu_ps(data+2*ii);
+            __m256 xx = _mm256_permute_ps(v, _MM_SHUFFLE(2,2,0,0));
+            __m256 yy = _mm256_permute_ps(v, _MM_SHUFFLE(3,3,1,1));
+            v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(xx,ab8),_mm256_mul_ps(yy,cd8)),tt8);
+            _mm256_storeu_ps(data+2*ii, v);
+        }
+#endif
+        for(; ii+2 <= count; ii += 2) {
+            __m128 v  = _mm_loadu_ps(data+2*ii);
+            __m128 xx = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,2,0,0));
+            __m128 yy = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,3,1,1));
+            v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx,ab),_mm_mul_ps(yy,cd)),tt);
+            _mm_storeu_ps(data+2*ii, v);
+        }
+    } else {
+        for(; ii+2 <= count; ii += 2) {
+            float* p0 = (float*)(base+ii*stride);
+            float* p1 = (float*)(base+(ii+1)*stride);
+            __m128 v = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)p0);
+            v = _mm_loadh_pi(v, (const __m64*)p1);
+            __m128 xx = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,2,0,0));
+            __m128 yy = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,3,1,1));
+            v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx,ab),_mm_mul_ps(yy,cd)),tt);
+            _mm_storel_pi((__m64*)p0, v);
+            _mm_storeh_pi((__m64*)p1, v);
+        }
+    }
+#elif defined (CU_MATH_KERNEL_NEON)
+    if (stride == 2*sizeof(float)) {
+        // Four points per iteration, deinterleaved into x and y lanes
+        float* data = (float*)base;
+        float32x4_t a  = vdupq_n_f32(affine[0]);
+        float32x4_t b  = vdupq_n_f32(affine[1]);
+        float32x4_t c  = vdupq_n_f32(affine[2]);
+        float32x4_t d  = vdupq_n_f32(affine[3]);
+        float32x4_t tx = vdupq_n_f32(affine[4]);
+        float32x4_t ty = vdupq_n_f32(affine[5]);
+        for(; ii+4 <= count; ii += 4) {
+            float32x4x2_t v = vld2q_f32(data+2*ii);
+            float32x4x2_t r;
+            r.val[0] = vmlaq_f32(vmlaq_f32(tx, v.val[0], a), v.val[1], c);
+            r.val[1] = vmlaq_f32(vmlaq_f32(ty, v.val[0], b), v.val[1], d);
+            vst2q_f32(data+2*ii, r);
+        }
+    } else {
+        // Two points per register: [x0 y0 x1 y1]
+        float32x2_t ab2 = vld1_f32(affine);
+        float32x2_t cd2 = vld1_f32(affine+2);
+        float32x2_t tt2 = vld1_f32(affine+4);
+        float32x4_t ab = vcombine_f32(ab2,ab2);
+        float32x4_t cd = vcombine_f32(cd2,cd2);
+        float32x4_t tt = vcombine_f32(tt2,tt2);
+        for(; ii+2 <= count; ii += 2) {
+            float* p0 = (float*)(base+ii*stride);
+            float* p1 = (float*)(base+(ii+1)*stride);
+            float32x2_t v0 = vld1_f32(p0);
+            float32x2_t v1 = vld1_f32(p1);
+            float32x4_t xx = vcombine_f32(vdup_lane_f32(v0,0),vdup_lane_f32(v1,0));
+            float32x4_t yy = vcombine_f32(vdup_lane_f32(v0,1),vdup_lane_f32(v1,1));
+            float32x4_t r  = vmlaq_f32(vmlaq_f32(tt, xx, ab), yy, cd);
+            vst1_f32(p0, vget_low_f32(r));
+            vst1_f32(p1, vget_high_f32(r));
+        }
+    }
+#endif
+    
+    // Scalar fallback (and the remainder of the vector loops)
+    for(; ii < count; ii++) {
+        float* p = (float*)(base+ii*stride);
+        float x = p[0];
+        float y = p[1];
+        p[0] = affine[0]*x+affine[2]*y+affine[4];
+        p[1] = affine[1]*x+affine[3]*y+affine[5];
+    }
+}
@@ -774,11 +774,7 @@ Poly2& Poly2::operator*=(const Vec2& scale) {
  * @return This polygon with the vertices transformed
  */
 Poly2& Poly2::operator*=(const Affine2& transform) {
-    Vec2 tmp;
-    for(int ii = 0; ii < _vertices.size(); ii++) {
-        Affine2::transform(transform,_vertices[ii], &tmp);
-        _vertices[ii] = tmp;
-    }
+    Affine2::transformPoints(transform, _vertices.data(), _vertices.size());
     
     computeBounds();
     return *this;
@@ -794,11 +790,7 @@ Poly2& Poly2::operator*=(const Affine2& transform) {
  * @return This polygon with the vertices transformed
  */
 Poly2& Poly2::operator*=(const Mat4& transform) {
-    Vec2 tmp;
-    for(int ii = 0; ii < _vertices.size(); ii++) {
-        Mat4::transform(transform,_vertices[ii], &tmp);
-        _vertices[ii] = tmp;
-    }
+    Mat4::transformPoints(transform, _vertices.data(), _vertices.size());
     
     computeBounds();
     return *this;
@@ -7,6 +7,10 @@
 //  much slower than non-vectorized computation because of the small size of
 //  the matrix.
 //
+//  The matrix data is not guaranteed to be 16-byte aligned (heap allocations
+//  on 32-bit Windows are only 8-byte aligned), so all access to the columns
+//  uses unaligned loads and stores.
+//
 //  Because math objects are intended to be on the stack, we do not provide
 //  any shared pointer support in this class.
 //
@@ -46,10 +50,10 @@
  */
 Mat4* Mat4::add(const Mat4& mat, float scalar, Mat4* dst) {
     __m128 s = _mm_set1_ps(scalar);
-    dst->col[0] = _mm_add_ps(mat.col[0], s);
-    dst->col[1] = _mm_add_ps(mat.col[1], s);
-    dst->col[2] = _mm_add_ps(mat.col[2], s);
-    dst->col[3] = _mm_add_ps(mat.col[3], s);
+    _mm_storeu_ps(&dst->m[0], _mm_add_ps(_mm_loadu_ps(&mat.m[0]), s));
+    _mm_storeu_ps(&dst->m[4], _mm_add_ps(_mm_loadu_ps(&mat.m[4]), s));
+    _mm_storeu_ps(&dst->m[8], _mm_add_ps(_mm_loadu_ps(&mat.m[8]), s));
+    _mm_storeu_ps(&dst->m[12], _mm_add_ps(_mm_loadu_ps(&mat.m[12]), s));
     return dst;
 }
 
@@ -63,10 +67,10 @@ Mat4* Mat4::add(const Mat4& mat, float scalar, Mat4* dst) {
  * @return A reference to dst for chaining
  */
 Mat4* Mat4::add(const Mat4& m1, const Mat4& m2, Mat4* dst) {
-    dst->col[0] = _mm_add_ps(m1.col[0], m2.col[0]);
-    dst->col[1] = _mm_add_ps(m1.col[1], m2.col[1]);
-    dst->col[2] = _mm_add_ps(m1.col[2], m2.col[2]);
-    dst->col[3] = _mm_add_ps(m1.col[3], m2.col[3]);
+    _mm_storeu_ps(&dst->m[0], _mm_add_ps(_mm_loadu_ps(&m1.m[0]), _mm_loadu_ps(&m2.m[0])));
+    _mm_storeu_ps(&dst->m[4], _mm_add_ps(_mm_loadu_ps(&m1.m[4]), _mm_loadu_ps(&m2.m[4])));
+    _mm_storeu_ps(&dst->m[8], _mm_add_ps(_mm_loadu_ps(&m1.m[8]), _mm_loadu_ps(&m2.m[8])));
+    _mm_storeu_ps(&dst->m[12], _mm_add_ps(_mm_loadu_ps(&m1.m[12]), _mm_loadu_ps(&m2.m[12])));
     return dst;
 }
 
@@ -81,10 +85,10 @@ Mat4* Mat4::add(const Mat4& m1, const Mat4& m2, Mat4* dst) {
  */
 Mat4* Mat4::subtract(const Mat4& mat, float scalar, Mat4* dst) {
     __m128 s = _mm_set1_ps(scalar);
-    dst->col[0] = _mm_sub_ps(mat.col[0], s);
-    dst->col[1] = _mm_sub_ps(mat.col[1], s);
-    dst->col[2] = _mm_sub_ps(mat.col[2], s);
-    dst->col[3] = _mm_sub_ps(mat.col[3], s);
+    _mm_storeu_ps(&dst->m[0], _mm_sub_ps(_mm_loadu_ps(&mat.m[0]), s));
+    _mm_storeu_ps(&dst->m[4], _mm_sub_ps(_mm_loadu_ps(&mat.m[4]), s));
+    _mm_storeu_ps(&dst->m[8], _mm_sub_ps(_mm_loadu_ps(&mat.m[8]), s));
+    _mm_storeu_ps(&dst->m[12], _mm_sub_ps(_mm_loadu_ps(&mat.m[12]), s));
     return dst;
 }
 
@@ -98,10 +102,10 @@ Mat4* Mat4::subtract(const Mat4& mat, float scalar, Mat4* dst) {
  * @return A reference to dst for chaining
  */
 Mat4* Mat4::subtract(const Mat4& m1, const Mat4& m2, Mat4* dst) {
-    dst->col[0] = _mm_sub_ps(m1.col[0], m2.col[0]);
-    dst->col[1] = _mm_sub_ps(m1.col[1], m2.col[1]);
-    dst->col[2] = _mm_sub_ps(m1.col[2], m2.col[2]);
-    dst->col[3] = _mm_sub_ps(m1.col[3], m2.col[3]);
+    _mm_storeu_ps(&dst->m[0], _mm_sub_ps(_mm_loadu_ps(&m1.m[0]), _mm_loadu_ps(&m2.m[0])));
+    _mm_storeu_ps(&dst->m[4], _mm_sub_ps(_mm_loadu_ps(&m1.m[4]), _mm_loadu_ps(&m2.m[4])));
+    _mm_storeu_ps(&dst->m[8], _mm_sub_ps(_mm_loadu_ps(&m1.m[8]), _mm_loadu_ps(&m2.m[8])));
+    _mm_storeu_ps(&dst->m[12], _mm_sub_ps(_mm_loadu_ps(&m1.m[12]), _mm_loadu_ps(&m2.m[12])));
     return dst;
 }
 
@@ -116,10 +120,10 @@ Mat4* Mat4::subtract(const Mat4& m1, const Mat4& m2, Mat4* dst) {
  */
 Mat4* Mat4::multiply(const Mat4& mat, float scalar, Mat4* dst) {
     __m128 s = _mm_set1_ps(scalar);
-    dst->col[0] = _mm_mul_ps(mat.col[0], s);
-    dst->col[1] = _mm_mul_ps(mat.col[1], s);
-    dst->col[2] = _mm_mul_ps(mat.col[2], s);
-    dst->col[3] = _mm_mul_ps(mat.col[3], s);
+    _mm_storeu_ps(&dst->m[0], _mm_mul_ps(_mm_loadu_ps(&mat.m[0]), s));
+    _mm_storeu_ps(&dst->m[4], _mm_mul_ps(_mm_loadu_ps(&mat.m[4]), s));
+    _mm_storeu_ps(&dst->m[8], _mm_mul_ps(_mm_loadu_ps(&mat.m[8]), s));
+    _mm_storeu_ps(&dst->m[12], _mm_mul_ps(_mm_loadu_ps(&mat.m[12]), s));
     return dst;
 }
 
@@ -136,18 +140,22 @@ Mat4* Mat4::multiply(const Mat4& mat, float scalar, Mat4* dst) {
  * @return A reference to dst for chaining
  */
 Mat4* Mat4::multiply(const Mat4& m1, const Mat4& m2, Mat4* dst) {
+    __m128 c0 = _mm_loadu_ps(&m2.m[0]);
+    __m128 c1 = _mm_loadu_ps(&m2.m[4]);
+    __m128 c2 = _mm_loadu_ps(&m2.m[8]);
+    __m128 c3 = _mm_loadu_ps(&m2.m[12]);
     __m128 dst0, dst1, dst2, dst3;
     {
-		__m128 col = m1.col[0];
+		__m128 col = _mm_loadu_ps(&m1.m[0]);
         __m128 e0 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(0, 0, 0, 0));
         __m128 e1 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(1, 1, 1, 1));
         __m128 e2 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(2, 2, 2, 2));
         __m128 e3 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(3, 3, 3, 3));
         
-        __m128 v0 = _mm_mul_ps(m2.col[0], e0);
-        __m128 v1 = _mm_mul_ps(m2.col[1], e1);
-        __m128 v2 = _mm_mul_ps(m2.col[2], e2);
-        __m128 v3 = _mm_mul_ps(m2.col[3], e3);
+        __m128 v0 = _mm_mul_ps(c0, e0);
+        __m128 v1 = _mm_mul_ps(c1, e1);
+        __m128 v2 = _mm_mul_ps(c2, e2);
+        __m128 v3 = _mm_mul_ps(c3, e3);
         
         __m128 a0 = _mm_add_ps(v0, v1);
         __m128 a1 = _mm_add_ps(v2, v3);
@@ -157,16 +165,16 @@ Mat4* Mat4::multiply(const Mat4& m1, const Mat4& m2, Mat4* dst) {
     }
     
     {
-		__m128 col = m1.col[1];
+		__m128 col = _mm_loadu_ps(&m1.m[4]);
 		__m128 e0 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(0, 0, 0, 0));
 		__m128 e1 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(1, 1, 1, 1));
 		__m128 e2 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(2, 2, 2, 2));
 		__m128 e3 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(3, 3, 3, 3));
 
-        __m128 v0 = _mm_mul_ps(m2.col[0], e0);
-        __m128 v1 = _mm_mul_ps(m2.col[1], e1);
-        __m128 v2 = _mm_mul_ps(m2.col[2], e2);
-        __m128 v3 = _mm_mul_ps(m2.col[3], e3);
+        __m128 v0 = _mm_mul_ps(c0, e0);
+        __m128 v1 = _mm_mul_ps(c1, e1);
+        __m128 v2 = _mm_mul_ps(c2, e2);
+        __m128 v3 = _mm_mul_ps(c3, e3);
         
         __m128 a0 = _mm_add_ps(v0, v1);
         __m128 a1 = _mm_add_ps(v2, v3);
@@ -176,16 +184,16 @@ Mat4* Mat4::multiply(const Mat4& m1, const Mat4& m2, Mat4* dst) {
     }
     
     {
-		__m128 col = m1.col[2];
+		__m128 col = _mm_loadu_ps(&m1.m[8]);
 		__m128 e0 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(0, 0, 0, 0));
 		__m128 e1 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(1, 1, 1, 1));
 		__m128 e2 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(2, 2, 2, 2));
 		__m128 e3 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(3, 3, 3, 3));
 
-        __m128 v0 = _mm_mul_ps(m2.col[0], e0);
-        __m128 v1 = _mm_mul_ps(m2.col[1], e1);
-        __m128 v2 = _mm_mul_ps(m2.col[2], e2);
-        __m128 v3 = _mm_mul_ps(m2.col[3], e3);
+        __m128 v0 = _mm_mul_ps(c0, e0);
+        __m128 v1 = _mm_mul_ps(c1, e1);
+        __m128 v2 = _mm_mul_ps(c2, e2);
+        __m128 v3 = _mm_mul_ps(c3, e3);
         
         __m128 a0 = _mm_add_ps(v0, v1);
         __m128 a1 = _mm_add_ps(v2, v3);
@@ -195,16 +203,16 @@ Mat4* Mat4::multiply(const Mat4& m1, const Mat4& m2, Mat4* dst) {
     }
     
     {
-		__m128 col = m1.col[3];
+		__m128 col = _mm_loadu_ps(&m1.m[12]);
 		__m128 e0 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(0, 0, 0, 0));
 		__m128 e1 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(1, 1, 1, 1));
 		__m128 e2 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(2, 2, 2, 2));
 		__m128 e3 = _mm_shuffle_ps(col, col, _MM_SHUFFLE(3, 3, 3, 3));
 
-        __m128 v0 = _mm_mul_ps(m2.col[0], e0);
-        __m128 v1 = _mm_mul_ps(m2.col[1], e1);
-        __m128 v2 = _mm_mul_ps(m2.col[2], e2);
-        __m128 v3 = _mm_mul_ps(m2.col[3], e3);
+        __m128 v0 = _mm_mul_ps(c0, e0);
+        __m128 v1 = _mm_mul_ps(c1, e1);
+        __m128 v2 = _mm_mul_ps(c2, e2);
+        __m128 v3 = _mm_mul_ps(c3, e3);
         
         __m128 a0 = _mm_add_ps(v0, v1);
         __m128 a1 = _mm_add_ps(v2, v3);
@@ -212,10 +220,10 @@ Mat4* Mat4::multiply(const Mat4& m1, const Mat4& m2, Mat4* dst) {
         
         dst3 = a2;
     }
-    dst->col[0] = dst0;
-    dst->col[1] = dst1;
-    dst->col[2] = dst2;
-    dst->col[3] = dst3;
+    _mm_storeu_ps(&dst->m[0], dst0);
+    _mm_storeu_ps(&dst->m[4], dst1);
+    _mm_storeu_ps(&dst->m[8], dst2);
+    _mm_storeu_ps(&dst->m[12], dst3);
     return dst;
 }
 
@@ -229,10 +237,10 @@ Mat4* Mat4::multiply(const Mat4& m1, const Mat4& m2, Mat4* dst) {
  */
 Mat4* Mat4::negate(const Mat4& mat, Mat4* dst) {
     __m128 z = _mm_setzero_ps();
-    dst->col[0] = _mm_sub_ps(z, mat.col[0]);
-    dst->col[1] = _mm_sub_ps(z, mat.col[1]);
-    dst->col[2] = _mm_sub_ps(z, mat.col[2]);
-    dst->col[3] = _mm_sub_ps(z, mat.col[3]);
+    _mm_storeu_ps(&dst->m[0], _mm_sub_ps(z, _mm_loadu_ps(&mat.m[0])));
+    _mm_storeu_ps(&dst->m[4], _mm_sub_ps(z, _mm_loadu_ps(&mat.m[4])));
+    _mm_storeu_ps(&dst->m[8], _mm_sub_ps(z, _mm_loadu_ps(&mat.m[8])));
+    _mm_storeu_ps(&dst->m[12], _mm_sub_ps(z, _mm_loadu_ps(&mat.m[12])));
     return dst;
 }
 
@@ -249,15 +257,19 @@ Mat4* Mat4::negate(const Mat4& mat, Mat4* dst) {
  * @return A reference to dst for chaining
  */
 Mat4* Mat4::transpose(const Mat4& m1, Mat4* dst) {
-    __m128 tmp0 = _mm_shuffle_ps(m1.col[0], m1.col[1], 0x44);
-    __m128 tmp2 = _mm_shuffle_ps(m1.col[0], m1.col[1], 0xEE);
-    __m128 tmp1 = _mm_shuffle_ps(m1.col[2], m1.col[3], 0x44);
-    __m128 tmp3 = _mm_shuffle_ps(m1.col[2], m1.col[3], 0xEE);
+    __m128 c0 = _mm_loadu_ps(&m1.m[0]);
+    __m128 c1 = _mm_loadu_ps(&m1.m[4]);
+    __m128 c2 = _mm_loadu_ps(&m1.m[8]);
+    __m128 c3 = _mm_loadu_ps(&m1.m[12]);
+    __m128 tmp0 = _mm_shuffle_ps(c0, c1, 0x44);
+    __m128 tmp2 = _mm_shuffle_ps(c0, c1, 0xEE);
+    __m128 tmp1 = _mm_shuffle_ps(c2, c3, 0x44);
+    __m128 tmp3 = _mm_shuffle_ps(c2, c3, 0xEE);
     
-    dst->col[0] = _mm_shuffle_ps(tmp0, tmp1, 0x88);
-    dst->col[1] = _mm_shuffle_ps(tmp0, tmp1, 0xDD);
-    dst->col[2] = _mm_shuffle_ps(tmp2, tmp3, 0x88);
-    dst->col[3] = _mm_shuffle_ps(tmp2, tmp3, 0xDD);
+    _mm_storeu_ps(&dst->m[0], _mm_shuffle_ps(tmp0, tmp1, 0x88));
+    _mm_storeu_ps(&dst->m[4], _mm_shuffle_ps(tmp0, tmp1, 0xDD));
+    _mm_storeu_ps(&dst->m[8], _mm_shuffle_ps(tmp2, tmp3, 0x88));
+    _mm_storeu_ps(&dst->m[12], _mm_shuffle_ps(tmp2, tmp3, 0xDD));
     return dst;
 }
 
@@ -274,14 +286,15 @@ Mat4* Mat4::transpose(const Mat4& m1, Mat4* dst) {
  * @return A reference to dst for chaining
  */
 Vec4* Mat4::transform(const Mat4& mat, const Vec4& vec, Vec4* dst) {
-    __m128 col1 = _mm_shuffle_ps(vec.v, vec.v, _MM_SHUFFLE(0, 0, 0, 0));
-    __m128 col2 = _mm_shuffle_ps(vec.v, vec.v, _MM_SHUFFLE(1, 1, 1, 1));
-    __m128 col3 = _mm_shuffle_ps(vec.v, vec.v, _MM_SHUFFLE(2, 2, 2, 2));
-    __m128 col4 = _mm_shuffle_ps(vec.v, vec.v, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 v = _mm_loadu_ps(&vec.x);
+    __m128 col1 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 col2 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 col3 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+    __m128 col4 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
     
-    dst->v = _mm_add_ps(
-                        _mm_add_ps(_mm_mul_ps(mat.col[0], col1), _mm_mul_ps(mat.col[1], col2)),
-                        _mm_add_ps(_mm_mul_ps(mat.col[2], col3), _mm_mul_ps(mat.col[3], col4))
-                        );
+    _mm_storeu_ps(&dst->x, _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&mat.m[0]), col1), _mm_mul_ps(_mm_loadu_ps(&mat.m[4]), col2)),
+                        _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&mat.m[8]), col3), _mm_mul_ps(_mm_loadu_ps(&mat.m[12]), col4))
+                        ));
     return dst;
 }
\ No newline at end of file
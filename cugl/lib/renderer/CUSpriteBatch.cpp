@@ -13,6 +13,8 @@
 #include <cugl/math/CUPoly2.h>
 #include <cugl/util/CUDebug.h>
 #include <SDL/SDL_image.h>
+#include <algorithm>
+#include <cstring>
 
 using namespace cugl;
 
@@ -32,6 +34,191 @@ static unsigned char cu_2x2_white_image[] = {
 /** The blank texture corresponding to cu_2x2_white_image */
 std::shared_ptr<Texture> SpriteBatch::_blank;
 
+/**
+ * Writes the vertices to dst in the upload layout.
+ *
+ * @param dst       The destination memory
+ * @param src       The vertices to write
+ * @param size      The number of vertices
+ * @param packed    Whether to write the packed layout (PackedVertex2)
+ */
+static void writeVertices(void* dst, const Vertex2* src, unsigned int size, bool packed) {
+    if (!packed) {
+        std::memcpy(dst, src, size*sizeof(Vertex2));
+        return;
+    }
+    PackedVertex2* out = (PackedVertex2*)dst;
+    for(unsigned int ii = 0; ii < size; ii++) {
+        out[ii].position = src[ii].position;
+        out[ii].color = src[ii].color;
+        out[ii].texcoord[0] = (GLushort)(clampf(src[ii].texcoord.x,0,1)*65535.0f+0.5f);
+        out[ii].texcoord[1] = (GLushort)(clampf(src[ii].texcoord.y,0,1)*65535.0f+0.5f);
+    }
+}
+
+/**
+ * Writes the indices to dst in the upload layout, rebased by the given vertex.
+ *
+ * @param dst       The destination memory
+ * @param src       The indices to write
+ * @param size      The number of indices
+ * @param base      The vertex offset to add to each index
+ * @param shorts    Whether to write 16-bit indices
+ */
+static void writeIndices(void* dst, const GLuint* src, unsigned int size, GLuint base, bool shorts) {
+    if (shorts) {
+        GLushort* out = (GLushort*)dst;
+        for(unsigned int ii = 0; ii < size; ii++) {
+            out[ii] = (GLushort)(src[ii]+base);
+        }
+    } else if (base) {
+        GLuint* out = (GLuint*)dst;
+        for(unsigned int ii = 0; ii < size; ii++) {
+            out[ii] = src[ii]+base;
+        }
+    } else {
+        std::memcpy(dst, src, size*sizeof(GLuint));
+    }
+}
+
+
+#pragma mark -
+#pragma mark Sprite Mesh
+/**
+ * Creates an empty mesh with no buffers.
+ *
+ * The buffers are only allocated when a mesh is first recorded.
+ */
+SpriteMesh::SpriteMesh() :
+_vertArray(0),
+_vertBuffer(0),
+_indxBuffer(0),
+_vertSize(0),
+_indxSize(0) {
+}
+
+/**
+ * Deletes the buffers and empties this mesh.
+ */
+void SpriteMesh::dispose() {
+    if (_vertArray) { glDeleteVertexArrays(1,&_vertArray); _vertArray = 0; }
+    if (_indxBuffer) { glDeleteBuffers(1,&_indxBuffer); _indxBuffer = 0; }
+    if (_vertBuffer) { glDeleteBuffers(1,&_vertBuffer); _vertBuffer = 0; }
+    clear();
+}
+
+/**
+ * Removes all geometry so that the mesh may be recorded again.
+ *
+ * The buffers are kept so they can be reused.
+ */
+void SpriteMesh::clear() {
+    _vertices.clear();
+    _runs.clear();
+    _vertSize = 0;
+    _indxSize = 0;
+}
+
+/**
+ * Appends the given geometry to this mesh.
+ *
+ * The geometry is added to a run with the given state.  The indices are
+ * relative to the given vertices.
+ *
+ * @param vertices  The vertices to add
+ * @param vsize     The number of vertices to add
+ * @param indices   The indices to add
+ * @param isize     The number of indices to add
+ * @param texture   The texture of the geometry
+ * @param command   The drawing command
+ * @param equation  The blend equation
+ * @param srcFactor The source blend factor
+ * @param dstFactor The destination blend factor
+ */
+void SpriteMesh::append(const Vertex2* vertices, unsigned int vsize, const GLuint* indices, unsigned int isize,
+                        const std::shared_ptr<Texture>& texture, GLenum command,
+                        GLenum equation, GLenum srcFactor, GLenum dstFactor) {
+    Vec2 lo = vertices[0].position;
+    Vec2 hi = lo;
+    for(unsigned int ii = 1; ii < vsize; ii++) {
+        const Vec2& p = vertices[ii].position;
+        lo.set(std::min(lo.x,p.x),std::min(lo.y,p.y));
+        hi.set(std::max(hi.x,p.x),std::max(hi.y,p.y));
+    }
+    Rect bounds(lo,Size(hi.x-lo.x,hi.y-lo.y));
+    
+    // Join the latest run with this state, unless a later run is in the way
+    Run* target = nullptr;
+    for(auto it = _runs.rbegin(); it != _runs.rend(); ++it) {
+        if (it->texture->getBuffer() == texture->getBuffer() && it->command == command &&
+            it->equation == equation && it->srcFactor == srcFactor && it->dstFactor == dstFactor) {
+            target = &(*it);
+            break;
+        } else if (it->bounds.doesIntersect(bounds)) {
+            break;
+        }
+    }
+    if (target == nullptr) {
+        Run run;
+        run.texture = texture;
+        run.command = command;
+        run.equation  = equation;
+        run.srcFactor = srcFactor;
+        run.dstFactor = dstFactor;
+        run.bounds = bounds;
+        run.offset = 0;
+        run.count  = 0;
+        _runs.push_back(run);
+        target = &_runs.back();
+    } else {
+        target->bounds.merge(bounds);
+    }
+    
+    GLuint base = (GLuint)_vertices.size();
+    _vertices.insert(_vertices.end(), vertices, vertices+vsize);
+    for(unsigned int ii = 0; ii < isize; ii++) {
+        target->indices.push_back(indices[ii]+base);
+    }
+}
+
+/**
+ * Uploads the recorded geometry to the GPU.
+ *
+ * The CPU copy of the geometry is discarded afterwards.
+ *
+ * @return true if the upload was successful.
+ */
+bool SpriteMesh::upload() {
+    if (!_vertArray) { glGenVertexArrays(1, &_vertArray); }
+    if (!_vertBuffer) { glGenBuffers(1, &_vertBuffer); }
+    if (!_indxBuffer) { glGenBuffers(1, &_indxBuffer); }
+    if (!_vertArray || !_vertBuffer || !_indxBuffer) {
+        CULogError("Unable to generate buffers for a sprite mesh");
+        clear();
+        return false;
+    }
+    
+    // Concatenate the runs so that each is a contiguous range
+    std::vector<GLuint> indices;
+    for(auto it = _runs.begin(); it != _runs.end(); ++it) {
+        it->offset = (GLsizei)indices.size();
+        it->count  = (GLsizei)it->indices.size();
+        indices.insert(indices.end(), it->indices.begin(), it->indices.end());
+        std::vector<GLuint>().swap(it->indices);
+    }
+    _vertSize = (unsigned int)_vertices.size();
+    _indxSize = (unsigned int)indices.size();
+    
+    // The element buffer binding belongs to the vertex array
+    glBindVertexArray(_vertArray);
+    glBindBuffer( GL_ARRAY_BUFFER, _vertBuffer );
+    glBufferData( GL_ARRAY_BUFFER, _vertSize*sizeof(Vertex2), _vertices.data(), GL_STATIC_DRAW );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, _indxBuffer );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, _indxSize*sizeof(GLuint), indices.data(), GL_STATIC_DRAW );
+    std::vector<Vertex2>().swap(_vertices);
+    return true;
+}
+
 #pragma mark Constructors
 /**
  * Creates a degenerate sprite batch with no buffers.
@@ -45,10 +232,35 @@ _indxData(nullptr),
 _vertArray(0),
 _vertBuffer(0),
 _indxBuffer(0),
+_instArray(0),
+_instBuffer(0),
 _vertMax(0),
 _vertSize(0),
 _indxMax(0),
 _indxSize(0),
+_streaming(true),
+_vertRingSize(0),
+_vertRingHead(0),
+_indxRingSize(0),
+_indxRingHead(0),
+_packed(false),
+_shortIndices(false),
+_instData(nullptr),
+_instMax(0),
+_instSize(0),
+_instancing(true),
+_instRingSize(0),
+_instRingHead(0),
+_multiTexture(false),
+_slotMax(1),
+_slotCount(0),
+_slot(0),
+_slotData(nullptr),
+_slotBuffer(0),
+_slotRingSize(0),
+_recording(nullptr),
+_recordInstancing(false),
+_recordSlots(false),
 _color(Color4::WHITE),
 _perspective(Mat4::IDENTITY),
 _command(GL_TRIANGLES),
@@ -58,6 +270,8 @@ _dstFactor(GL_ONE_MINUS_SRC_ALPHA),
 _texture(nullptr),
 _vertTotal(0),
 _callTotal(0),
+_uploadTotal(0),
+_wrapTotal(0),
 _initialized(false),
 _active(false) {
 }
@@ -70,7 +284,12 @@ _active(false) {
 void SpriteBatch::dispose() {
     if (_vertData) { delete[] _vertData; _vertData = nullptr; }
     if (_indxData) { delete[] _indxData; _indxData = nullptr; }
+    if (_instData) { delete[] _instData; _instData = nullptr; }
+    if (_slotData) { delete[] _slotData; _slotData = nullptr; }
+    if (_slotBuffer) { glDeleteBuffers(1,&_slotBuffer); _slotBuffer = 0; }
     if (_vertArray) { glDeleteVertexArrays(1,&_vertArray); _vertArray = 0; }
+    if (_instArray) { glDeleteVertexArrays(1,&_instArray); _instArray = 0; }
+    if (_instBuffer) { glDeleteBuffers(1,&_instBuffer); _instBuffer = 0; }
     if (_indxBuffer) { glDeleteBuffers(1,&_indxBuffer); _indxBuffer = 0; }
     if (_vertBuffer) { glDeleteBuffers(1,&_vertBuffer); _vertBuffer = 0; }
     if (_shader != nullptr) { _shader = nullptr; }
@@ -81,6 +300,31 @@ void SpriteBatch::dispose() {
     _vertSize = 0;
     _indxMax  = 0;
     _indxSize = 0;
+    _streaming = true;
+    _vertRingSize = 0;
+    _vertRingHead = 0;
+    _indxRingSize = 0;
+    _indxRingHead = 0;
+    _packed = false;
+    _shortIndices = false;
+    _staging.clear();
+    _instMax  = 0;
+    _instSize = 0;
+    _instancing = true;
+    _instRingSize = 0;
+    _instRingHead = 0;
+    _multiTexture = false;
+    _slotMax = 1;
+    _slotCount = 0;
+    _slot = 0;
+    _slotRingSize = 0;
+    for(int ii = 0; ii < MAX_TEXTURE_SLOTS; ii++) {
+        _slotTextures[ii] = nullptr;
+    }
+    _recording = nullptr;
+    _recordInstancing = false;
+    _recordSlots = false;
+    _targets.clear();
     _color = Color4::WHITE;
     _perspective = Mat4::IDENTITY;
     _command = GL_TRIANGLES;
@@ -90,6 +334,8 @@ void SpriteBatch::dispose() {
     
     _vertTotal = 0;
     _callTotal = 0;
+    _uploadTotal = 0;
+    _wrapTotal = 0;
 
     _initialized = false;
     _active = false;
@@ -170,6 +416,16 @@ bool SpriteBatch::init(unsigned int capacity, std::shared_ptr<SpriteShader> shad
     _indxMax = _capacity*3;
     _indxData = new GLuint[_indxMax];
     
+    // Rebased indices address the whole ring, so that must fit in 16 bits.
+    // The ring is sized in Vertex2, but holds more of the smaller packed vertex.
+    size_t ringVerts = STREAM_RING_FACTOR * _vertMax * sizeof(Vertex2) / sizeof(PackedVertex2);
+    _shortIndices = (ringVerts <= 65536);
+    
+    // An instance replaces four vertices
+    _instMax = _capacity/4;
+    _instData = new SpriteInstance[_instMax];
+    _slotData = new GLfloat[_vertMax];
+    
     // Generate the buffers
     glGenBuffers(1, &_vertBuffer);
     if (!validateBuffer(_vertBuffer, "Unable to unable to generate Vertex Buffer Object")) {
@@ -189,13 +445,46 @@ bool SpriteBatch::init(unsigned int capacity, std::shared_ptr<SpriteShader> shad
         return false;
     }
     
-    // Bind and link the buffers
+    glGenVertexArrays (1, &_instArray);
+    if (!validateBuffer(_instArray, "Unable to unable to generate Instance Array Object")) {
+        dispose();
+        return false;
+    }
+    
+    glGenBuffers(1, &_instBuffer);
+    if (!validateBuffer(_instBuffer, "Unable to unable to generate Instance Buffer Object")) {
+        dispose();
+        return false;
+    }
+    _instRingSize = STREAM_RING_FACTOR * _instMax * sizeof(SpriteInstance);
+    _instRingHead = 0;
+    glBindBuffer( GL_ARRAY_BUFFER, _instBuffer );
+    glBufferData( GL_ARRAY_BUFFER, _instRingSize, NULL, GL_STREAM_DRAW );
+    
+    glGenBuffers(1, &_slotBuffer);
+    if (!validateBuffer(_slotBuffer, "Unable to unable to generate Slot Buffer Object")) {
+        dispose();
+        return false;
+    }
+    // Slots parallel the vertex ring, whose smallest vertex is packed
+    _slotRingSize = ringVerts * sizeof(GLfloat);
+    glBindBuffer( GL_ARRAY_BUFFER, _slotBuffer );
+    glBufferData( GL_ARRAY_BUFFER, _slotRingSize, NULL, GL_STREAM_DRAW );
+    
+    GLint units = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &units);
+    _slotMax = (units < MAX_TEXTURE_SLOTS ? (units > 0 ? units : 1) : MAX_TEXTURE_SLOTS);
+    
+    // Bind and link the buffers (sized for streaming)
+    _vertRingSize = STREAM_RING_FACTOR * _vertMax * sizeof(Vertex2);
+    _indxRingSize = STREAM_RING_FACTOR * _indxMax * sizeof(GLuint);
+    _vertRingHead = _indxRingHead = 0;
     glBindBuffer( GL_ARRAY_BUFFER, _vertBuffer );
     glBindVertexArray(_vertArray);
-    glBufferData( GL_ARRAY_BUFFER, _vertSize * sizeof(Vertex2), _vertData, GL_DYNAMIC_DRAW );
+    glBufferData( GL_ARRAY_BUFFER, _vertRingSize, NULL, GL_STREAM_DRAW );
 
     glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, _indxBuffer );
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, _indxSize * sizeof(GLuint), _indxData, GL_DYNAMIC_DRAW );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, _indxRingSize, NULL, GL_STREAM_DRAW );
     _texture = SpriteBatch::getBlankTexture();
     return true;
 }
@@ -226,9 +515,41 @@ void SpriteBatch::setShader(const std::shared_ptr<SpriteShader>& shader) {
  * subtexture will not cause a pipeline flush.  This is an important
  * argument for using texture atlases.
  *
+ * In multi-texture mode, a new texture is bound to a free texture slot
+ * instead, and the sprite batch only flushes when all slots are in use.
+ *
  * @param color The active texture for this sprite batch
  */
 void SpriteBatch::setTexture(const std::shared_ptr<Texture>& texture) {
+    if (_active && _slotCount > 0) {
+        // Multi-texture mode: reuse or claim a slot, flushing only on overflow
+        const std::shared_ptr<Texture>& next = (texture == nullptr ? getBlankTexture() : texture);
+        for(unsigned int ii = 0; ii < _slotCount; ii++) {
+            if (_slotTextures[ii]->getBuffer() == next->getBuffer()) {
+                _slot = (GLfloat)ii;
+                _texture = next;
+                return;
+            }
+        }
+        if (_slotCount < _slotMax) {
+            _shader->setSlotTexture(_slotCount, next);
+            _slotTextures[_slotCount] = next;
+            _slot = (GLfloat)_slotCount;
+            _slotCount++;
+        } else {
+            flush();
+            for(unsigned int ii = 1; ii < _slotCount; ii++) {
+                _slotTextures[ii] = nullptr;
+            }
+            _shader->setTexture(next);
+            _slotTextures[0] = next;
+            _slotCount = 1;
+            _slot = 0;
+        }
+        _texture = next;
+        return;
+    }
+    
     if (texture == nullptr) {
         if (_texture != nullptr && _texture->getBuffer() != getBlankTexture()->getBuffer()) {
             if (_active) { flush(); }
@@ -299,7 +620,7 @@ void SpriteBatch::setPerspective(const Mat4& perspective) {
 void SpriteBatch::setBlendFunc(GLenum srcFactor, GLenum dstFactor) {
     if (_active && (_srcFactor != srcFactor || _dstFactor != dstFactor)) {
         flush();
-        glBlendFunc(srcFactor, dstFactor);
+        applyBlendFunc(srcFactor, dstFactor);
     }
     
     _srcFactor = srcFactor;
@@ -329,6 +650,23 @@ void SpriteBatch::setBlendEquation(GLenum equation) {
     _blendEquation = equation;
 }
 
+/**
+ * Sets the standard alpha blending for textures of the given kind.
+ *
+ * Straight-alpha textures blend with (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA),
+ * which is the default.  Premultiplied textures (see
+ * {@link Texture#isPremultiplied}) blend with (GL_ONE, GL_ONE_MINUS_SRC_ALPHA).
+ * In the latter case, the color of this sprite batch must also be
+ * premultiplied (see {@link Color4#getPremultiplied}).  Both presets use
+ * the blend equation GL_FUNC_ADD.
+ *
+ * @param premultiplied Whether to blend premultiplied colors
+ */
+void SpriteBatch::setAlphaBlend(bool premultiplied) {
+    setBlendEquation(GL_FUNC_ADD);
+    setBlendFunc(premultiplied ? GL_ONE : GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
 /**
  * Returns the current drawing command.
  *
@@ -344,6 +682,67 @@ void SpriteBatch::setCommand(GLenum command) {
     _command = command;
 }
 
+/**
+ * Sets whether this sprite batch streams its meshes into ring buffers.
+ *
+ * This value may NOT be changed during a drawing pass.
+ *
+ * @param value Whether this sprite batch streams its meshes into ring buffers.
+ */
+void SpriteBatch::setStreaming(bool value) {
+    CUAssertLog(!_active, "Attempt to change streaming while drawing is active");
+    if (_streaming != value) {
+        _streaming = value;
+        // Force the ring buffers to be respecified on the next flush
+        _vertRingHead = _vertRingSize;
+        _indxRingHead = _indxRingSize;
+        _instRingHead = _instRingSize;
+    }
+}
+
+/**
+ * Sets whether this sprite batch binds several textures at once.
+ *
+ * This value may NOT be changed during a drawing pass.
+ *
+ * @param value Whether this sprite batch binds several textures at once.
+ */
+void SpriteBatch::setMultiTexture(bool value) {
+    CUAssertLog(!_active, "Attempt to change multi-texture mode while drawing is active");
+    _multiTexture = value;
+}
+
+/**
+ * Sets whether this sprite batch draws rectangles as sprite instances.
+ *
+ * Changing this value will cause the sprite batch to flush.
+ *
+ * @param value Whether this sprite batch draws rectangles as sprite instances.
+ */
+void SpriteBatch::setInstancing(bool value) {
+    if (_instancing != value) {
+        if (_active) { flush(); }
+        _instancing = value;
+    }
+}
+
+/**
+ * Sets whether this sprite batch uploads vertices in the packed layout.
+ *
+ * This value may NOT be changed during a drawing pass.
+ *
+ * @param value Whether this sprite batch uploads vertices in the packed layout.
+ */
+void SpriteBatch::setPacked(bool value) {
+    CUAssertLog(!_active, "Attempt to change vertex layout while drawing is active");
+    if (_packed != value) {
+        _packed = value;
+        // The ring head must stay a multiple of the vertex size
+        _vertRingHead = _vertRingSize;
+        _indxRingHead = _indxRingSize;
+    }
+}
+
 
 
 #pragma mark -
@@ -362,15 +761,28 @@ void SpriteBatch::begin() {
     glDepthMask(false);
     glEnable(GL_BLEND);
     glBlendEquation(_blendEquation);
-    glBlendFunc(_srcFactor, _dstFactor);
+    applyBlendFunc(_srcFactor, _dstFactor);
     
     // DO NOT CLEAR.  This responsibility lies elsewhere
     
     _shader->bind();
     _shader->setPerspective(_perspective);
     _shader->setTexture(_texture);
-    _shader->attach(_vertArray, _vertBuffer);
+    _shader->attach(_vertArray, _vertBuffer, _packed);
+    _shader->setInstanced(false);
     _active = true;
+    
+    // Slot 0 is the active texture; the rest are claimed as textures change
+    bool slots = _multiTexture && _slotMax > 1 && _shader->supportsTextureSlots();
+    _shader->attachSlots(_vertArray, _slotBuffer, slots);
+    _slotTextures[0] = _texture;
+    _slotCount = (slots ? 1 : 0);
+    _slot = 0;
+    
+    _vertTotal = 0;
+    _callTotal = 0;
+    _uploadTotal = 0;
+    _wrapTotal = 0;
 }
 
 /**
@@ -380,8 +792,11 @@ void SpriteBatch::begin() {
  * Must always be called after a call to {@link #begin()}.
  */
 void SpriteBatch::end() {
+    CUAssertLog(_targets.empty(), "Drawing ended with an active render target");
     flush();
     _shader->unbind();
+    // Do not leave a vertex array (e.g. the instance one) bound for other code
+    glBindVertexArray(0);
     _active = false;
 
 }
@@ -395,27 +810,321 @@ void SpriteBatch::end() {
  * previuosly drawn shapes.
  */
 void SpriteBatch::flush() {
+    if (_instSize > 0) {
+        flushInstances();
+        return;
+    }
     if (_indxSize == 0 || _vertSize == 0) {
         _vertSize = _indxSize = 0;
         return;
     }
+    if (_recording != nullptr) {
+        _recording->append(_vertData, _vertSize, _indxData, _indxSize, _texture, _command,
+                           _blendEquation, _srcFactor, _dstFactor);
+        _vertSize = _indxSize = 0;
+        return;
+    }
     
+    GLsizeiptr vertStride = _packed ? sizeof(PackedVertex2) : sizeof(Vertex2);
+    GLsizeiptr indxStride = _shortIndices ? sizeof(GLushort) : sizeof(GLuint);
+    GLenum indxType = _shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    GLsizeiptr vertBytes = _vertSize * vertStride;
+    GLsizeiptr indxBytes = _indxSize * indxStride;
     glBindVertexArray (_vertArray);
     glBindBuffer( GL_ARRAY_BUFFER, _vertBuffer );
-    glBufferData( GL_ARRAY_BUFFER, _vertSize * sizeof(Vertex2), _vertData, GL_DYNAMIC_DRAW );
-    
-    // Set index data and render
     glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, _indxBuffer );
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, _indxSize * sizeof(GLuint), _indxData, GL_DYNAMIC_DRAW );
-    glDrawElements(_command, _indxSize, GL_UNSIGNED_INT, NULL );
+    _shader->setInstanced(false);
+    
+    if (!_streaming) {
+        if (_staging.size() < (size_t)(vertBytes > indxBytes ? vertBytes : indxBytes)) {
+            _staging.resize(vertBytes > indxBytes ? vertBytes : indxBytes);
+        }
+        writeVertices(_staging.data(), _vertData, _vertSize, _packed);
+        glBufferData( GL_ARRAY_BUFFER, vertBytes, _staging.data(), GL_DYNAMIC_DRAW );
+        writeIndices(_staging.data(), _indxData, _indxSize, 0, _shortIndices);
+        glBufferData( GL_ELEMENT_ARRAY_BUFFER, indxBytes, _staging.data(), GL_DYNAMIC_DRAW );
+        if (_slotCount > 0) {
+            glBindBuffer( GL_ARRAY_BUFFER, _slotBuffer );
+            glBufferData( GL_ARRAY_BUFFER, _vertSize*sizeof(GLfloat), _slotData, GL_DYNAMIC_DRAW );
+            _uploadTotal += _vertSize*sizeof(GLfloat);
+        }
+        glDrawElements(_command, _indxSize, indxType, NULL );
+    } else {
+        // Orphan the storage when full; the GPU keeps the old copy until it is done
+        bool wrapped = false;
+        if (_vertRingHead+vertBytes > _vertRingSize || _indxRingHead+indxBytes > _indxRingSize) {
+            glBufferData( GL_ARRAY_BUFFER, _vertRingSize, NULL, GL_STREAM_DRAW );
+            glBufferData( GL_ELEMENT_ARRAY_BUFFER, _indxRingSize, NULL, GL_STREAM_DRAW );
+            _vertRingHead = _indxRingHead = 0;
+            _wrapTotal++;
+            wrapped = true;
+        }
+        
+        // The attributes point at the start of the buffer, so rebase the indices
+        GLuint base = (GLuint)(_vertRingHead / vertStride);
+        
+        // Nothing is drawing from the free region, so no need to synchronize
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        void* dst = glMapBufferRange( GL_ARRAY_BUFFER, _vertRingHead, vertBytes, access );
+        if (dst) {
+            writeVertices(dst, _vertData, _vertSize, _packed);
+            glUnmapBuffer( GL_ARRAY_BUFFER );
+        } else {
+            if (_staging.size() < (size_t)vertBytes) { _staging.resize(vertBytes); }
+            writeVertices(_staging.data(), _vertData, _vertSize, _packed);
+            glBufferSubData( GL_ARRAY_BUFFER, _vertRingHead, vertBytes, _staging.data() );
+        }
+        dst = glMapBufferRange( GL_ELEMENT_ARRAY_BUFFER, _indxRingHead, indxBytes, access );
+        if (dst) {
+            writeIndices(dst, _indxData, _indxSize, base, _shortIndices);
+            glUnmapBuffer( GL_ELEMENT_ARRAY_BUFFER );
+        } else {
+            if (_staging.size() < (size_t)indxBytes) { _staging.resize(indxBytes); }
+            writeIndices(_staging.data(), _indxData, _indxSize, base, _shortIndices);
+            glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, _indxRingHead, indxBytes, _staging.data() );
+        }
+        
+        // Slots are indexed by the same rebased vertex, so they share its ring position
+        if (_slotCount > 0) {
+            GLsizeiptr slotHead  = base*sizeof(GLfloat);
+            GLsizeiptr slotBytes = _vertSize*sizeof(GLfloat);
+            glBindBuffer( GL_ARRAY_BUFFER, _slotBuffer );
+            if (wrapped) {
+                glBufferData( GL_ARRAY_BUFFER, _slotRingSize, NULL, GL_STREAM_DRAW );
+            }
+            dst = glMapBufferRange( GL_ARRAY_BUFFER, slotHead, slotBytes, access );
+            if (dst) {
+                std::memcpy(dst, _slotData, slotBytes);
+                glUnmapBuffer( GL_ARRAY_BUFFER );
+            } else {
+                glBufferSubData( GL_ARRAY_BUFFER, slotHead, slotBytes, _slotData );
+            }
+            _uploadTotal += slotBytes;
+        }
+        
+        glDrawElements(_command, _indxSize, indxType, (GLvoid*)_indxRingHead );
+        _vertRingHead += vertBytes;
+        _indxRingHead += indxBytes;
+    }
     
     // Increment the counters
     _vertTotal += _indxSize;
     _callTotal++;
+    _uploadTotal += vertBytes+indxBytes;
     
     _vertSize = _indxSize = 0;
 }
 
+
+#pragma mark -
+#pragma mark Retained Meshes
+/**
+ * Starts recording all subsequent drawing into the given mesh.
+ *
+ * Until {@link endRecording()} is called, shapes are added to the mesh
+ * instead of being drawn.  They are transformed and tinted exactly as
+ * they would be when drawn.  Any previous contents of the mesh are
+ * discarded.
+ *
+ * Sprite instances and texture slots are disabled while recording, as
+ * a mesh only stores plain vertices.  This method may only be called
+ * during a drawing pass, and recordings may not be nested.
+ *
+ * @param mesh  The mesh to record into
+ */
+void SpriteBatch::beginRecording(const std::shared_ptr<SpriteMesh>& mesh) {
+    CUAssertLog(_active, "Attempt to record a mesh while drawing is inactive");
+    CUAssertLog(_recording == nullptr, "Attempt to nest mesh recordings");
+    flush();
+    mesh->clear();
+    _recording = mesh;
+    _recordInstancing = _instancing;
+    _instancing = false;
+    
+    // Recorded vertices cannot refer to slots, so use the classic texture path
+    _recordSlots = (_slotCount > 0);
+    _slotCount = 0;
+}
+
+/**
+ * Completes the current recording, uploading the mesh to the GPU.
+ *
+ * Nothing is drawn.  Use {@link draw(const std::shared_ptr<SpriteMesh>&)}
+ * to draw the mesh.
+ */
+void SpriteBatch::endRecording() {
+    CUAssertLog(_recording != nullptr, "There is no active mesh recording");
+    flush();
+    _recording->upload();
+    _recording = nullptr;
+    _instancing = _recordInstancing;
+    if (_recordSlots) {
+        // Start over with the active texture in slot 0
+        for(unsigned int ii = 1; ii < MAX_TEXTURE_SLOTS; ii++) {
+            _slotTextures[ii] = nullptr;
+        }
+        _shader->setTexture(_texture);
+        _slotTextures[0] = _texture;
+        _slotCount = 1;
+        _slot = 0;
+    }
+}
+
+/**
+ * Draws a previously recorded mesh.
+ *
+ * The mesh is drawn with one call per run, using the current perspective.
+ * The color, texture and blend state of this sprite batch are ignored, as
+ * they were baked in when the mesh was recorded.  They are restored
+ * afterwards.  This method flushes any pending shapes first.
+ *
+ * @param mesh  The mesh to draw
+ */
+void SpriteBatch::draw(const std::shared_ptr<SpriteMesh>& mesh) {
+    CUAssertLog(_active, "Attempt to draw a mesh while drawing is inactive");
+    CUAssertLog(_recording == nullptr, "Attempt to draw a mesh while recording");
+    if (mesh->isEmpty()) {
+        return;
+    }
+    flush();
+    
+    _shader->setInstanced(false);
+    _shader->attach(mesh->_vertArray, mesh->_vertBuffer, false);
+    _shader->attachSlots(mesh->_vertArray, _slotBuffer, false);
+    
+    GLenum equation  = _blendEquation;
+    GLenum srcFactor = _srcFactor;
+    GLenum dstFactor = _dstFactor;
+    GLuint texture = (_slotCount > 0 ? _slotTextures[0] : _texture)->getBuffer();
+    for(auto it = mesh->_runs.begin(); it != mesh->_runs.end(); ++it) {
+        if (it->texture->getBuffer() != texture) {
+            _shader->setTexture(it->texture);
+            texture = it->texture->getBuffer();
+        }
+        if (it->equation != equation) {
+            glBlendEquation(it->equation);
+            equation = it->equation;
+        }
+        if (it->srcFactor != srcFactor || it->dstFactor != dstFactor) {
+            applyBlendFunc(it->srcFactor, it->dstFactor);
+            srcFactor = it->srcFactor;
+            dstFactor = it->dstFactor;
+        }
+        glDrawElements(it->command, it->count, GL_UNSIGNED_INT, (GLvoid*)(it->offset*sizeof(GLuint)));
+        _vertTotal += it->count;
+        _callTotal++;
+    }
+    
+    // Restore the state of the batch
+    if (texture != _texture->getBuffer()) {
+        _shader->setTexture(_texture);
+    }
+    if (equation != _blendEquation) {
+        glBlendEquation(_blendEquation);
+    }
+    if (srcFactor != _srcFactor || dstFactor != _dstFactor) {
+        applyBlendFunc(_srcFactor, _dstFactor);
+    }
+    if (_slotCount > 0) {
+        // Slot 0 was rebound, so start over with the active texture
+        for(unsigned int ii = 1; ii < _slotCount; ii++) {
+            _slotTextures[ii] = nullptr;
+        }
+        _slotTextures[0] = _texture;
+        _slotCount = 1;
+        _slot = 0;
+    }
+}
+
+#pragma mark -
+#pragma mark Render Targets
+/**
+ * Redirects all subsequent drawing into the given texture.
+ *
+ * The texture must have a framebuffer (see {@link Texture#initWithFramebuffer}).
+ * It is cleared to transparent, and the region bounds is mapped onto
+ * the whole texture, with the top of the region at texture coordinate
+ * 0.  Hence a rectangle filled with the texture reproduces the region.
+ *
+ * The alpha channel accumulates coverage while drawing into a target,
+ * so the texture holds premultiplied colors.  Draw it with the blend
+ * function GL_ONE, GL_ONE_MINUS_SRC_ALPHA.
+ *
+ * This method flushes any pending shapes first.  It may only be called
+ * during a drawing pass, but not while recording.  Targets may be nested.
+ *
+ * @param target    The texture to draw into
+ * @param bounds    The region to draw, in the current drawing coordinates
+ */
+void SpriteBatch::beginTarget(const std::shared_ptr<Texture>& target, const Rect& bounds) {
+    CUAssertLog(_active, "Attempt to draw into a texture while drawing is inactive");
+    CUAssertLog(_recording == nullptr, "Attempt to draw into a texture while recording");
+    CUAssertLog(target->getFramebuffer(), "Texture %s has no framebuffer", target->getName().c_str());
+    flush();
+    
+    Target state;
+    state.texture = target;
+    state.perspective = _perspective;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &state.framebuffer);
+    glGetIntegerv(GL_VIEWPORT, state.viewport);
+    bool outer = _targets.empty();
+    _targets.push_back(state);
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, target->getFramebuffer());
+    glViewport(0, 0, target->getWidth(), target->getHeight());
+    GLfloat clear[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clear);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glClearColor(clear[0], clear[1], clear[2], clear[3]);
+    if (outer) {
+        applyBlendFunc(_srcFactor, _dstFactor);
+    }
+    
+    // Flip vertically so that the top row is texture coordinate 0
+    Mat4 projection;
+    Mat4::createOrthographicOffCenter(bounds.getMinX(), bounds.getMaxX(),
+                                      bounds.getMaxY(), bounds.getMinY(), -1, 1, &projection);
+    setPerspective(projection);
+}
+
+/**
+ * Stops drawing into the texture given to the last {@link beginTarget}.
+ *
+ * The previous framebuffer, viewport and perspective are restored.
+ * This method flushes any pending shapes first.
+ */
+void SpriteBatch::endTarget() {
+    CUAssertLog(!_targets.empty(), "There is no active render target");
+    flush();
+    
+    Target state = _targets.back();
+    _targets.pop_back();
+    glBindFramebuffer(GL_FRAMEBUFFER, state.framebuffer);
+    glViewport(state.viewport[0], state.viewport[1], state.viewport[2], state.viewport[3]);
+    setPerspective(state.perspective);
+    if (_targets.empty()) {
+        applyBlendFunc(_srcFactor, _dstFactor);
+    }
+}
+
+/**
+ * Applies the given blend factors to OpenGL.
+ *
+ * While drawing into a render target, the alpha channel is blended
+ * separately so that the target accumulates coverage.
+ *
+ * @param srcFactor The source blending factor
+ * @param dstFactor The destination blending factor
+ */
+void SpriteBatch::applyBlendFunc(GLenum srcFactor, GLenum dstFactor) {
+    if (_targets.empty()) {
+        glBlendFunc(srcFactor, dstFactor);
+    } else {
+        glBlendFuncSeparate(srcFactor, dstFactor, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    }
+}
+
 #pragma mark -
 #pragma mark Solid Shapes
 
@@ -467,9 +1176,7 @@ void SpriteBatch::fill(const Rect& rect,  const Vec2& origin, const Vec2& scale,
     transform.rotateZ(angle);
     transform.translate((Vec3)(origin+offset));
     
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= transform;
-    }
+    Mat4::transformPoints(transform, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -499,9 +1206,7 @@ void SpriteBatch::fill(const Rect& rect, const Vec2& origin, const Mat4& transfo
     matrix *= transform;
     matrix.translate(origin.x,origin.y,0);
 
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= matrix;
-    }
+    Mat4::transformPoints(matrix, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -531,9 +1236,7 @@ void SpriteBatch::fill(const Rect& rect, const Vec2& origin, const Affine2& tran
     matrix *= transform;
     matrix.translate(origin);
     
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= matrix;
-    }
+    Affine2::transformPoints(matrix, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -639,9 +1342,7 @@ void SpriteBatch::fill(const Poly2& poly, const Vec2& origin, const Vec2& scale,
     transform.rotateZ(angle);
     transform.translate((Vec3)(origin+offset));
     
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= transform;
-    }
+    Mat4::transformPoints(transform, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -682,9 +1383,7 @@ void SpriteBatch::fill(const Poly2& poly, const Vec2& origin, const Mat4& transf
     matrix *= transform;
     matrix.translate(origin.x,origin.y,0);
 
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= matrix;
-    }
+    Mat4::transformPoints(matrix, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -725,9 +1424,7 @@ void SpriteBatch::fill(const Poly2& poly, const Vec2& origin, const Affine2& tra
     matrix *= transform;
     matrix.translate(origin);
 
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= matrix;
-    }
+    Affine2::transformPoints(matrix, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -744,6 +1441,10 @@ void SpriteBatch::fill(const Poly2& poly, const Vec2& origin, const Affine2& tra
  * The vertices use their own color values.  However, if tint is true, these
  * values will be tinted (i.e. multiplied) by the current active color.
  *
+ * If the mesh is an axis-aligned textured rectangle (four vertices and
+ * six indices) and instancing is enabled, it is drawn as a single
+ * {@link SpriteInstance} instead of being transformed on the CPU.
+ *
  * @param vertices  The array of vertices
  * @param vsize     The size of the vertex array
  * @param voffset   The first element of the vertex array
@@ -756,12 +1457,16 @@ void SpriteBatch::fill(const Poly2& poly, const Vec2& origin, const Affine2& tra
 void SpriteBatch::fill(const Vertex2* vertices, unsigned int vsize, unsigned int voffset,
                        const unsigned short* indices, unsigned int isize, unsigned int ioffset,
                        const Mat4& transform, bool tint) {
+    if (vsize == 4 && isize == 6 &&
+        prepareInstance(vertices+voffset, Vec2(transform.m[0],transform.m[1]),
+                        Vec2(transform.m[4],transform.m[5]),
+                        Vec2(transform.m[12],transform.m[13]), tint)) {
+        return;
+    }
     setCommand(GL_TRIANGLES);
     unsigned int count = prepare(vertices,vsize,voffset,indices,isize,ioffset,true,tint);
     
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= transform;
-    }
+    Mat4::transformPoints(transform, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -779,6 +1484,10 @@ void SpriteBatch::fill(const Vertex2* vertices, unsigned int vsize, unsigned int
  * The vertices use their own color values.  However, if tint is true, these
  * values will be tinted (i.e. multiplied) by the current active color.
  *
+ * If the mesh is an axis-aligned textured rectangle (four vertices and
+ * six indices) and instancing is enabled, it is drawn as a single
+ * {@link SpriteInstance} instead of being transformed on the CPU.
+ *
  * @param vertices  The array of vertices
  * @param vsize     The size of the vertex array
  * @param voffset   The first element of the vertex array
@@ -791,12 +1500,15 @@ void SpriteBatch::fill(const Vertex2* vertices, unsigned int vsize, unsigned int
 void SpriteBatch::fill(const Vertex2* vertices, unsigned int vsize, unsigned int voffset,
                        const unsigned short* indices, unsigned int isize, unsigned int ioffset,
                        const Affine2& transform, bool tint) {
+    if (vsize == 4 && isize == 6 &&
+        prepareInstance(vertices+voffset, Vec2(transform.m[0],transform.m[2]),
+                        Vec2(transform.m[1],transform.m[3]), transform.offset, tint)) {
+        return;
+    }
     setCommand(GL_TRIANGLES);
     unsigned int count = prepare(vertices,vsize,voffset,indices,isize,ioffset,true,tint);
     
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= transform;
-    }
+    Affine2::transformPoints(transform, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 #pragma mark -
@@ -852,9 +1564,7 @@ void SpriteBatch::outline(const Rect& rect, const Vec2& origin, const Vec2& scal
     transform.rotateZ(angle);
     transform.translate((Vec3)(origin+offset));
     
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= transform;
-    }
+    Mat4::transformPoints(transform, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -885,9 +1595,7 @@ void SpriteBatch::outline(const Rect& rect, const Vec2& origin, const Mat4& tran
     matrix *= transform;
     matrix.translate(origin.x,origin.y,0);
     
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= matrix;
-    }
+    Mat4::transformPoints(matrix, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -918,9 +1626,7 @@ void SpriteBatch::outline(const Rect& rect, const Vec2& origin, const Affine2& t
     matrix *= transform;
     matrix.translate(origin.x,origin.y);
 
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= matrix;
-    }
+    Affine2::transformPoints(matrix, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -1026,9 +1732,7 @@ void SpriteBatch::outline(const Poly2& poly, const Vec2& origin, const Vec2& sca
     transform.rotateZ(angle);
     transform.translate((Vec3)(origin+offset));
     
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= transform;
-    }
+    Mat4::transformPoints(transform, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 
 }
 
@@ -1070,9 +1774,7 @@ void SpriteBatch::outline(const Poly2& poly, const Vec2& origin, const Mat4& tra
     matrix *= transform;
     matrix.translate(origin.x,origin.y,0);
 
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= matrix;
-    }
+    Mat4::transformPoints(matrix, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -1113,9 +1815,7 @@ void SpriteBatch::outline(const Poly2& poly, const Vec2& origin, const Affine2&
     matrix *= transform;
     matrix.translate(origin.x,origin.y);
 
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= matrix;
-    }
+    Affine2::transformPoints(matrix, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -1148,9 +1848,7 @@ void SpriteBatch::outline(const Vertex2* vertices, unsigned int vsize, unsigned
     setCommand(GL_LINES);
     unsigned int count = prepare(vertices,vsize,voffset,indices,isize,ioffset,false,tint);
     
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= transform;
-    }
+    Mat4::transformPoints(transform, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 /**
@@ -1183,9 +1881,7 @@ void SpriteBatch::outline(const Vertex2* vertices, unsigned int vsize, unsigned
     setCommand(GL_LINES);
     unsigned int count = prepare(vertices,vsize,voffset,indices,isize,ioffset,false,tint);
     
-    for(int ii = 1; ii <= count; ii++) {
-        _vertData[_vertSize-ii].position *= transform;
-    }
+    Affine2::transformPoints(transform, &_vertData[_vertSize-count].position, count, sizeof(Vertex2));
 }
 
 #pragma mark -
@@ -1396,7 +2092,7 @@ bool SpriteBatch::validateBuffer(GLuint buffer, const char* message) {
  * @return the number of vertices added to the drawing buffer.
  */
 unsigned int SpriteBatch::prepare(const Rect& rect, bool solid) {
-    if (_vertSize+4 > _vertMax ||  _indxSize+8 > _indxMax) {
+    if (_instSize > 0 || _vertSize+4 > _vertMax ||  _indxSize+8 > _indxMax) {
         flush();
     }
     
@@ -1407,6 +2103,7 @@ unsigned int SpriteBatch::prepare(const Rect& rect, bool solid) {
         Vec2 point = (*it);
         _vertData[vstart+ii].position = point;
         _vertData[vstart+ii].color = _color;
+        _slotData[vstart+ii] = _slot;
         
         float value = (point.x-rect.origin.x)/rect.size.width;
         _vertData[vstart+ii].texcoord.x = value*_texture->getMaxS()+(1-value)*_texture->getMinS();
@@ -1441,7 +2138,7 @@ unsigned int SpriteBatch::prepare(const Rect& rect, bool solid) {
 unsigned int SpriteBatch::prepare(const Poly2& poly, bool solid) {
     CUAssertLog((solid ? poly.getIndices().size() % 3 : poly.getIndices().size() % 2) == 0,
                 "Polynomial has the wrong number of indices: %d", (int)poly.getIndices().size());
-    if (_vertSize+poly.getVertices().size() > _vertMax ||
+    if (_instSize > 0 || _vertSize+poly.getVertices().size() > _vertMax ||
         _indxSize+poly.getIndices().size()  > _indxMax) {
         flush();
     }
@@ -1452,6 +2149,7 @@ unsigned int SpriteBatch::prepare(const Poly2& poly, bool solid) {
         Vec2 point = (*it);
         _vertData[vstart+ii].position = point;
         _vertData[vstart+ii].color = _color;
+        _slotData[vstart+ii] = _slot;
         
         float value = point.x/_texture->getWidth();
         _vertData[vstart+ii].texcoord.x = value*_texture->getMaxS()+(1-value)*_texture->getMinS();
@@ -1494,7 +2192,7 @@ unsigned int SpriteBatch::prepare(const Vertex2* vertices, unsigned int vsize, u
                                   bool solid, bool tint) {
     CUAssertLog((solid ? isize % 3 : isize % 2) == 0,
                 "Vertex mesh has the wrong number of indices: %d", isize);
-    if (_vertSize+vsize > _vertMax || _indxSize+isize  > _indxMax) {
+    if (_instSize > 0 || _vertSize+vsize > _vertMax || _indxSize+isize  > _indxMax) {
         flush();
     }
     
@@ -1503,6 +2201,7 @@ unsigned int SpriteBatch::prepare(const Vertex2* vertices, unsigned int vsize, u
     Vertex2 temp;
     for(int kk = voffset; ii < vsize; ii++) {
         _vertData[vstart+ii] = vertices[kk+ii];
+        _slotData[vstart+ii] = _slot;
         if (tint) {
             _vertData[vstart+ii].color *= _color;
         }
@@ -1519,6 +2218,121 @@ unsigned int SpriteBatch::prepare(const Vertex2* vertices, unsigned int vsize, u
     return ii;
 }
 
+/**
+ * Returns true if the mesh was added to the buffer as a sprite instance.
+ *
+ * The mesh must be four vertices forming an axis-aligned rectangle whose
+ * texture coordinates vary along its axes, with a single color.  The
+ * transform is given as the images of the x and y axes and the origin.
+ * If the mesh does not qualify (or instancing is disabled), nothing is
+ * added and this method returns false.
+ *
+ * @param vertices  The four vertices of the rectangle
+ * @param xaxis     The image of the x-axis under the transform
+ * @param yaxis     The image of the y-axis under the transform
+ * @param offset    The image of the origin under the transform
+ * @param tint      Whether to tint with the active color
+ *
+ * @return true if the mesh was added to the buffer as a sprite instance.
+ */
+bool SpriteBatch::prepareInstance(const Vertex2* vertices, const Vec2& xaxis, const Vec2& yaxis,
+                                  const Vec2& offset, bool tint) {
+    if (!_instancing || _instMax == 0 || !_shader->supportsInstancing()) {
+        return false;
+    }
+    
+    // Find the corners; each vertex must sit on a distinct one
+    float minx = vertices[0].position.x, maxx = minx;
+    float miny = vertices[0].position.y, maxy = miny;
+    for(int ii = 1; ii < 4; ii++) {
+        minx = std::min(minx,vertices[ii].position.x);
+        maxx = std::max(maxx,vertices[ii].position.x);
+        miny = std::min(miny,vertices[ii].position.y);
+        maxy = std::max(maxy,vertices[ii].position.y);
+    }
+    const Vertex2* corner[4] = { nullptr, nullptr, nullptr, nullptr };
+    for(int ii = 0; ii < 4; ii++) {
+        const Vec2& p = vertices[ii].position;
+        if ((p.x != minx && p.x != maxx) || (p.y != miny && p.y != maxy) ||
+            vertices[ii].color != vertices[0].color) {
+            return false;
+        }
+        int code = (p.x == maxx ? 1 : 0) | (p.y == maxy ? 2 : 0);
+        if (corner[code] != nullptr) {
+            return false;
+        }
+        corner[code] = vertices+ii;
+    }
+    
+    // Texture coordinates must be separable (s from x, t from y)
+    Vec2 tmin = corner[0]->texcoord;
+    Vec2 tmax = corner[3]->texcoord;
+    if (corner[1]->texcoord != Vec2(tmax.x,tmin.y) || corner[2]->texcoord != Vec2(tmin.x,tmax.y)) {
+        return false;
+    }
+    
+    if (_indxSize > 0 || _instSize >= _instMax) {
+        flush();
+    }
+    
+    float width  = maxx-minx;
+    float height = maxy-miny;
+    SpriteInstance* inst = _instData+_instSize;
+    inst->axisX  = xaxis*width;
+    inst->axisY  = yaxis*height;
+    inst->origin = offset+xaxis*minx+yaxis*miny;
+    inst->texMin = tmin;
+    inst->texMax = tmax;
+    inst->color  = vertices[0].color;
+    inst->slot   = _slot;
+    if (tint) {
+        inst->color *= _color;
+    }
+    _instSize++;
+    return true;
+}
 
-
+/**
+ * Draws the pending sprite instances.
+ *
+ * This is the instance counterpart of flush().  Pending meshes and pending
+ * instances are never present at the same time.
+ */
+void SpriteBatch::flushInstances() {
+    GLsizeiptr bytes = _instSize * sizeof(SpriteInstance);
+    glBindBuffer( GL_ARRAY_BUFFER, _instBuffer );
+    
+    GLintptr start = 0;
+    if (!_streaming) {
+        glBufferData( GL_ARRAY_BUFFER, bytes, _instData, GL_DYNAMIC_DRAW );
+    } else {
+        if (_instRingHead+bytes > _instRingSize) {
+            glBufferData( GL_ARRAY_BUFFER, _instRingSize, NULL, GL_STREAM_DRAW );
+            _instRingHead = 0;
+            _wrapTotal++;
+        }
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        void* dst = glMapBufferRange( GL_ARRAY_BUFFER, _instRingHead, bytes, access );
+        if (dst) {
+            std::memcpy(dst, _instData, bytes);
+            glUnmapBuffer( GL_ARRAY_BUFFER );
+        } else {
+            glBufferSubData( GL_ARRAY_BUFFER, _instRingHead, bytes, _instData );
+        }
+        start = _instRingHead;
+        _instRingHead += bytes;
+    }
+    
+    // Each instance is a four vertex strip expanded by the shader
+    _shader->setInstanced(true);
+    _shader->attachInstances(_instArray, _instBuffer, start);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, _instSize);
+    
+    // Increment the counters (as the equivalent indexed mesh)
+    _vertTotal += 6*_instSize;
+    _callTotal++;
+    _uploadTotal += bytes;
+    
+    _instSize = 0;
+}
 
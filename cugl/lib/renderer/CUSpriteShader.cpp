@@ -54,6 +54,13 @@
 #define TEXCOORD_ATTRIBUTE  "aTexCoord"
 #define PERSPECTIVE_UNIFORM "uPerspective"
 #define TEXTURE_UNIFORM     "uTexture"
+#define AXES_ATTRIBUTE      "aAxes"
+#define ORIGIN_ATTRIBUTE    "aOrigin"
+#define TEXRECT_ATTRIBUTE   "aTexRect"
+#define TINT_ATTRIBUTE      "aTint"
+#define INSTANCED_UNIFORM   "uInstanced"
+#define SLOT_ATTRIBUTE      "aSlot"
+#define SLOTS_UNIFORM       "uSlotTextures[0]"
 #define TEXTURE_POSITION    0
 
 using namespace cugl;
@@ -122,6 +129,42 @@ void SpriteShader::setTexture(const std::shared_ptr<Texture>& texture) {
     }
 }
 
+/**
+ * Binds the texture to the given slot.
+ *
+ * Slot 0 is the texture set by {@link setTexture}.  Other slots are only
+ * sampled by vertices whose slot attribute selects them.  Slot textures
+ * are not retained between drawing passes.
+ *
+ * @param slot      The texture slot (1 to MAX_TEXTURE_SLOTS-1)
+ * @param texture   The texture to bind
+ */
+void SpriteShader::setSlotTexture(unsigned int slot, const std::shared_ptr<Texture>& texture) {
+    CUAssertLog(slot > 0 && slot < MAX_TEXTURE_SLOTS, "Texture slot %d is out of range", slot);
+    if (_active) {
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_POSITION + slot);
+        glBindTexture(GL_TEXTURE_2D, texture->getBuffer());
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_POSITION);
+    }
+}
+
+/**
+ * Sets whether this shader is drawing instanced quads.
+ *
+ * This has no effect if the shader does not support instancing.
+ *
+ * @param value Whether this shader is drawing instanced quads.
+ */
+void SpriteShader::setInstanced(bool value) {
+    if (!supportsInstancing() || _mInstanced == value) {
+        return;
+    }
+    _mInstanced = value;
+    if (_active) {
+        glUniform1i(_uInstanced, _mInstanced ? 1 : 0);
+    }
+}
+
 #pragma mark -
 #pragma mark Rendering
 
@@ -134,12 +177,27 @@ void SpriteShader::setTexture(const std::shared_ptr<Texture>& texture) {
  * @param vArray    The vertex array object
  * @param vBuffer   The vertex buffer object
  */
-void SpriteShader::attach(GLuint vArray, GLuint vBuffer) {
+void SpriteShader::attach(GLuint vArray, GLuint vBuffer, bool packed) {
     CUAssertLog(_active, "This shader is not currently active");
 
     glBindVertexArray(vArray);
     glBindBuffer(GL_ARRAY_BUFFER, vBuffer);
     
+    // Attribute arrays are vertex array state, so enable them here (not in bind)
+    glEnableVertexAttribArray(_aPosition);
+    glEnableVertexAttribArray(_aColor);
+    glEnableVertexAttribArray(_aTexCoord);
+    
+    if (packed) {
+        glVertexAttribPointer( _aPosition, 2, GL_FLOAT, GL_FALSE, sizeof(PackedVertex2),
+                              PackedVertex2::positionOffset());
+        glVertexAttribPointer( _aColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedVertex2),
+                              PackedVertex2::colorOffset());
+        glVertexAttribPointer( _aTexCoord, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex2),
+                              PackedVertex2::texcoordOffset());
+        return;
+    }
+    
     glVertexAttribPointer( _aPosition, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex2),
                           Vertex2::positionOffset());
     glVertexAttribPointer( _aColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex2),
@@ -148,6 +206,85 @@ void SpriteShader::attach(GLuint vArray, GLuint vBuffer) {
                           Vertex2::texcoordOffset());
 }
 
+/**
+ * Attaches the given instance buffer to this shader.
+ *
+ * The buffer is laid out as {@link SpriteInstance}, with one element per
+ * drawn quad starting at the given byte offset.  The instance attributes
+ * advance once per instance.  This method should only be called if
+ * {@link supportsInstancing()} is true.
+ *
+ * @param vArray    The vertex array object for instances
+ * @param iBuffer   The instance buffer object
+ * @param offset    The byte offset of the first instance
+ */
+void SpriteShader::attachInstances(GLuint vArray, GLuint iBuffer, GLintptr offset) {
+    CUAssertLog(_active, "This shader is not currently active");
+    CUAssertLog(supportsInstancing(), "This shader does not support instancing");
+    
+    glBindVertexArray(vArray);
+    glBindBuffer(GL_ARRAY_BUFFER, iBuffer);
+    
+    // The quad is expanded from gl_VertexID, so the vertex attributes have no buffer
+    glDisableVertexAttribArray(_aPosition);
+    glDisableVertexAttribArray(_aColor);
+    glDisableVertexAttribArray(_aTexCoord);
+    
+    const GLubyte* base = (const GLubyte*)NULL + offset;
+    glEnableVertexAttribArray(_aAxes);
+    glVertexAttribPointer( _aAxes, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+                          base+(size_t)SpriteInstance::axesOffset());
+    glVertexAttribDivisor( _aAxes, 1 );
+    glEnableVertexAttribArray(_aOrigin);
+    glVertexAttribPointer( _aOrigin, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+                          base+(size_t)SpriteInstance::originOffset());
+    glVertexAttribDivisor( _aOrigin, 1 );
+    glEnableVertexAttribArray(_aTexRect);
+    glVertexAttribPointer( _aTexRect, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+                          base+(size_t)SpriteInstance::texRectOffset());
+    glVertexAttribDivisor( _aTexRect, 1 );
+    glEnableVertexAttribArray(_aTint);
+    glVertexAttribPointer( _aTint, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteInstance),
+                          base+(size_t)SpriteInstance::colorOffset());
+    glVertexAttribDivisor( _aTint, 1 );
+    if (supportsTextureSlots()) {
+        glEnableVertexAttribArray(_aSlot);
+        glVertexAttribPointer( _aSlot, 1, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+                              base+(size_t)SpriteInstance::slotOffset());
+        glVertexAttribDivisor( _aSlot, 1 );
+    }
+}
+
+/**
+ * Attaches the given texture slot buffer to this shader.
+ *
+ * The buffer holds one GLfloat slot per vertex, parallel to the vertex
+ * buffer.  If enable is false, the slot attribute is disabled and every
+ * vertex samples slot 0.  This has no effect if the shader does not
+ * support texture slots.
+ *
+ * @param vArray    The vertex array object
+ * @param sBuffer   The slot buffer object
+ * @param enable    Whether to read slots from the buffer
+ */
+void SpriteShader::attachSlots(GLuint vArray, GLuint sBuffer, bool enable) {
+    CUAssertLog(_active, "This shader is not currently active");
+    if (!supportsTextureSlots()) {
+        return;
+    }
+    
+    glBindVertexArray(vArray);
+    if (enable) {
+        glBindBuffer(GL_ARRAY_BUFFER, sBuffer);
+        glEnableVertexAttribArray(_aSlot);
+        glVertexAttribPointer( _aSlot, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), 0 );
+    } else {
+        // A disabled attribute reads the constant value instead
+        glDisableVertexAttribArray(_aSlot);
+        glVertexAttrib1f(_aSlot, 0.0f);
+    }
+}
+
 /**
  * Binds this shader, making it active.
  *
@@ -155,9 +292,9 @@ void SpriteShader::attach(GLuint vArray, GLuint vBuffer) {
  */
 void SpriteShader::bind() {
     Shader::bind();
-    glEnableVertexAttribArray(_aPosition);
-    glEnableVertexAttribArray(_aColor);
-    glEnableVertexAttribArray(_aTexCoord);
+    if (supportsInstancing()) {
+        glUniform1i(_uInstanced, _mInstanced ? 1 : 0);
+    }
     if (_mTexture != nullptr) {
         glActiveTexture(GL_TEXTURE0 + TEXTURE_POSITION);
         glBindTexture(GL_TEXTURE_2D, _mTexture->getBuffer());
@@ -171,9 +308,6 @@ void SpriteShader::bind() {
  */
 void SpriteShader::unbind() {
     glBindTexture(GL_TEXTURE_2D, 0);
-    glDisableVertexAttribArray(_aPosition);
-    glDisableVertexAttribArray(_aColor);
-    glDisableVertexAttribArray(_aTexCoord);
     Shader::unbind();
 }
 
@@ -226,10 +360,32 @@ bool SpriteShader::compile() {
         return false;
     }
     
+    // Instancing is optional (custom shaders need not support it)
+    _aAxes = glGetAttribLocation( _program, AXES_ATTRIBUTE );
+    _aOrigin = glGetAttribLocation( _program, ORIGIN_ATTRIBUTE );
+    _aTexRect = glGetAttribLocation( _program, TEXRECT_ATTRIBUTE );
+    _aTint = glGetAttribLocation( _program, TINT_ATTRIBUTE );
+    _uInstanced = glGetUniformLocation( _program, INSTANCED_UNIFORM );
+    _mInstanced = false;
+    
+    // As are texture slots
+    _aSlot = glGetAttribLocation( _program, SLOT_ATTRIBUTE );
+    _uSlotTextures = glGetUniformLocation( _program, SLOTS_UNIFORM );
+    
     // Set the texture location and matrix
     bind();
     glUniformMatrix4fv(_uPerspective,1,false,_mPerspective.m);
     glUniform1i(_uTexture, TEXTURE_POSITION);
+    if (supportsInstancing()) {
+        glUniform1i(_uInstanced, 0);
+    }
+    if (supportsTextureSlots()) {
+        GLint units[MAX_TEXTURE_SLOTS-1];
+        for(int ii = 0; ii < MAX_TEXTURE_SLOTS-1; ii++) {
+            units[ii] = TEXTURE_POSITION+ii+1;
+        }
+        glUniform1iv(_uSlotTextures, MAX_TEXTURE_SLOTS-1, units);
+    }
     unbind();
     
     return true;
@@ -261,6 +417,10 @@ bool SpriteShader::validateVariable(GLint variable, const char* name) {
  */
 void SpriteShader::dispose() {
     if (_mTexture != nullptr) { _mTexture.reset(); }
+    _aAxes = _aOrigin = _aTexRect = _aTint = -1;
+    _uInstanced = -1;
+    _mInstanced = false;
+    _aSlot = _uSlotTextures = -1;
     Shader::dispose();
 }
 
@@ -9,8 +9,17 @@
 #include <SDL/SDL.h>
 #include <SDL/SDL_image.h>
 #include <cugl/renderer/CUTexture.h>
+#include <cugl/io/CUAssetPack.h>
 #include <cugl/util/CUDebug.h>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
+
+#if defined (CU_MATH_KERNEL_SSE2)
+    #include <emmintrin.h>
+#elif defined (CU_MATH_KERNEL_NEON)
+    #include <arm_neon.h>
+#endif
 
 using namespace cugl;
 
@@ -33,12 +42,16 @@ _magFilter(GL_LINEAR),
 _wrapS(GL_CLAMP_TO_EDGE),
 _wrapT(GL_CLAMP_TO_EDGE),
 _hasMipmaps(false),
+_premultiplied(false),
+_compressed(false),
+_bytes(0),
 _parent(nullptr),
 _minS(0),
 _maxS(1),
 _minT(0),
 _maxT(1),
-_active(false) {}
+_active(false),
+_framebuffer(0) {}
 
 /**
  * Deletes the OpenGL texture and resets all attributes.
@@ -51,6 +64,10 @@ void Texture::dispose() {
         if (_parent == nullptr) {
             glDeleteTextures(1, &_buffer);
         }
+        if (_framebuffer != 0) {
+            glDeleteFramebuffers(1, &_framebuffer);
+            _framebuffer = 0;
+        }
         _buffer = 0;
         _width = 0; _height = 0;
         _pixelFormat = PixelFormat::UNDEFINED;
@@ -61,6 +78,9 @@ void Texture::dispose() {
         _minS = _minT = 0;
         _maxS = _maxT = 1;
         _hasMipmaps = false;
+        _premultiplied = false;
+        _compressed = false;
+        _bytes = 0;
         _active = false;
     }
 }
@@ -161,37 +181,305 @@ bool Texture::initWithData(const void *data, int width, int height, Texture::Pix
  * includes (but is not limited to) PNG, JPEG, GIF, TIFF, BMP and PCX.
  *
  * The texture will be stored in RGBA format, even if it is a file format
- * that does not support transparency (e.g. JPEG).
+ * that does not support transparency (e.g. JPEG).  If premultiply is
+ * true, the colors are multiplied by alpha as they are decoded.
  *
- * @param filename  The file supporting the texture file.
- * @param height    The texture height in pixels
- * @param format    The texture data format
+ * @param filename      The file supporting the texture file.
+ * @param premultiply   Whether to premultiply the colors by alpha
  *
  * @return true if initialization was successful.
  */
-bool Texture::initWithFile(const std::string& filename) {
-    SDL_Surface* surface = IMG_Load(filename.c_str());
+bool Texture::initWithFile(const std::string& filename, bool premultiply) {
+    SDL_Surface* surface = decode(filename,premultiply);
     if (surface == nullptr) {
         return false;
     }
+
+    bool result = initWithData(surface->pixels, surface->w, surface->h);
+    SDL_FreeSurface(surface);
+    if (result) {
+        setName(filename);
+        _premultiplied = premultiply;
+    }
+    return result;
+}
+
+/**
+ * Initializes an empty texture that can be drawn into.
+ *
+ * The texture is attached to a new framebuffer object, so that it may
+ * be used as a render target (see {@link SpriteBatch#beginTarget}).
+ * The dimensions need not be powers of two.  The texture is RGBA, with
+ * linear filtering, and its contents are undefined until drawn.
+ *
+ * When initialization is done, the texture is no longer bound.
+ *
+ * @param width     The texture width in pixels
+ * @param height    The texture height in pixels
+ *
+ * @return true if initialization was successful.
+ */
+bool Texture::initWithFramebuffer(int width, int height) {
+    _minFilter = GL_LINEAR;
+    if (!initWithData(nullptr, width, height)) {
+        return false;
+    }
+
+    GLint previous;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glGenFramebuffers(1, &_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _buffer, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        CULogError("Framebuffer for %dx%d texture is incomplete: 0x%x", width, height, status);
+        dispose();
+        return false;
+    }
+    setName("<framebuffer>");
+    return true;
+}
+
+/**
+ * Initializes a texture with the compressed images in the given container.
+ *
+ * When initialization is done, the texture is no longer bound.  However,
+ * any other texture that was bound during initialization is also no longer
+ * bound.
+ *
+ * The base level of the texture is the largest level of the container
+ * that fits in maxsize (see {@link TextureContainer#selectLevel}), capped
+ * by GL_MAX_TEXTURE_SIZE.  That level and every smaller one are uploaded
+ * with glCompressedTexImage2D, so the texture has mipmaps whenever the
+ * container has more than one level.  Compressed textures cannot be
+ * modified with set() or {@link buildMipMaps}.
+ *
+ * This method fails if the container format is not supported by this
+ * device (see {@link getCompressedFormats}).
+ *
+ * @param container The parsed texture container
+ * @param maxsize   The maximum width and height (0 for no limit)
+ *
+ * @return true if initialization was successful.
+ */
+bool Texture::initWithContainer(const TextureContainer& container, unsigned int maxsize) {
+    if (_buffer) {
+        CUAssertLog(false, "Texture is already initialized");
+        return false; // In case asserts are off.
+    } else if (container.getLevelCount() == 0) {
+        return false;
+    }
+    
+    std::vector<GLenum> formats = getCompressedFormats();
+    if (std::find(formats.begin(), formats.end(), container.getFormat()) == formats.end()) {
+        CULogError("Compressed texture format 0x%x is not supported", container.getFormat());
+        return false;
+    }
+    
+    GLint limit = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &limit);
+    if (maxsize == 0 || maxsize > (unsigned int)limit) {
+        maxsize = (unsigned int)limit;
+    }
+    size_t base = container.selectLevel(maxsize);
+    size_t count = container.getLevelCount()-base;
+    
+    glGenTextures(1, &_buffer);
+    if (_buffer == 0) {
+        return false;
+    }
+    
+    // A partial chain is only complete if GL knows where it ends
+    const TextureContainer::Level& first = container.getLevel(base);
+    _width  = first.width;
+    _height = first.height;
+    _pixelFormat = PixelFormat::RGBA;
+    _compressed  = true;
+    _hasMipmaps  = count > 1;
+    glBindTexture(GL_TEXTURE_2D, _buffer);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, _minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, _magFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, _wrapS);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, _wrapT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)count-1);
+    _bytes = 0;
+    for(size_t ii = 0; ii < count; ii++) {
+        const TextureContainer::Level& level = container.getLevel(base+ii);
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)ii, container.getFormat(),
+                               level.width, level.height, 0, (GLsizei)level.size,
+                               container.getLevelData(base+ii));
+        _bytes += level.size;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        CULogError("Could not upload compressed texture: 0x%x", error);
+        dispose();
+        return false;
+    }
     
-    SDL_Surface* normal;
-#if CU_MEMORY_ORDER == CU_ORDER_REVERSED
-    normal = SDL_ConvertSurfaceFormat(surface,SDL_PIXELFORMAT_ABGR8888,0);
+    std::stringstream ss;
+    ss << "@" << (const void*)&container;
+    setName(ss.str());
+    return true;
+}
+
+/**
+ * Returns the compressed formats supported by this device.
+ *
+ * This is the list reported by GL_COMPRESSED_TEXTURE_FORMATS.  ETC2 is
+ * required by OpenGLES 3, while ASTC is only available on newer mobile
+ * GPUs and is rare on desktop.  This method uses OpenGL, and so it must
+ * be called in the main thread.
+ *
+ * @return the compressed formats supported by this device.
+ */
+std::vector<GLenum> Texture::getCompressedFormats() {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+    std::vector<GLint> values(std::max(count,0));
+    if (count > 0) {
+        glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, values.data());
+    }
+    return std::vector<GLenum>(values.begin(), values.end());
+}
+
+#pragma mark -
+#pragma mark Image Decoding
+/**
+ * Returns x/255 rounded to the nearest integer, for x in [0,255*255]
+ *
+ * @param x     The value to divide
+ *
+ * @return x/255 rounded to the nearest integer
+ */
+static inline Uint32 div255(Uint32 x) {
+    x += 128;
+    return (x+(x >> 8)) >> 8;
+}
+
+/**
+ * Multiplies the colors of a row of RGBA pixels by alpha in place.
+ *
+ * The pixels must be RGBA in memory order.  Four pixels are processed at
+ * a time when SSE2 or NEON is available.  The alpha channel is unchanged.
+ *
+ * @param pixels        The row of pixels
+ * @param count         The number of pixels in the row
+ */
+static void premultiplyRow(Uint32* pixels, int count) {
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    const int rs = 0,  gs = 8,  bs = 16, as = 24;
 #else
-    normal = SDL_ConvertSurfaceFormat(surface,SDL_PIXELFORMAT_RGBA8888,0);
+    const int rs = 24, gs = 16, bs = 8,  as = 0;
 #endif
-    SDL_FreeSurface(surface);
-    if (normal == nullptr) {
-        return false;
+    
+    int ii = 0;
+#if defined (CU_MATH_KERNEL_SSE2)
+    // SSE2 is little-endian only, so R is in the low byte
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i half = _mm_set1_epi32(128);
+    for(; ii+4 <= count; ii += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(pixels+ii));
+        __m128i r = _mm_and_si128(p,mask);
+        __m128i g = _mm_and_si128(_mm_srli_epi32(p,8),mask);
+        __m128i b = _mm_and_si128(_mm_srli_epi32(p,16),mask);
+        __m128i a = _mm_srli_epi32(p,24);
+        // Each lane is below 256, so a 16-bit multiply is exact
+        r = _mm_add_epi32(_mm_mullo_epi16(r,a),half);
+        g = _mm_add_epi32(_mm_mullo_epi16(g,a),half);
+        b = _mm_add_epi32(_mm_mullo_epi16(b,a),half);
+        r = _mm_srli_epi32(_mm_add_epi32(r,_mm_srli_epi32(r,8)),8);
+        g = _mm_srli_epi32(_mm_add_epi32(g,_mm_srli_epi32(g,8)),8);
+        b = _mm_srli_epi32(_mm_add_epi32(b,_mm_srli_epi32(b,8)),8);
+        p = _mm_or_si128(_mm_or_si128(r,_mm_slli_epi32(g,8)),
+                         _mm_or_si128(_mm_slli_epi32(b,16),_mm_slli_epi32(a,24)));
+        _mm_storeu_si128((__m128i*)(pixels+ii),p);
+    }
+#elif defined (CU_MATH_KERNEL_NEON)
+    const uint32x4_t mask = vdupq_n_u32(0xff);
+    const uint32x4_t half = vdupq_n_u32(128);
+    const int32x4_t rsv = vdupq_n_s32(rs);
+    const int32x4_t gsv = vdupq_n_s32(gs);
+    const int32x4_t bsv = vdupq_n_s32(bs);
+    const int32x4_t asv = vdupq_n_s32(as);
+    for(; ii+4 <= count; ii += 4) {
+        uint32x4_t p = vld1q_u32(pixels+ii);
+        uint32x4_t r = vandq_u32(vshlq_u32(p,vnegq_s32(rsv)),mask);
+        uint32x4_t g = vandq_u32(vshlq_u32(p,vnegq_s32(gsv)),mask);
+        uint32x4_t b = vandq_u32(vshlq_u32(p,vnegq_s32(bsv)),mask);
+        uint32x4_t a = vandq_u32(vshlq_u32(p,vnegq_s32(asv)),mask);
+        r = vaddq_u32(vmulq_u32(r,a),half);
+        g = vaddq_u32(vmulq_u32(g,a),half);
+        b = vaddq_u32(vmulq_u32(b,a),half);
+        r = vshrq_n_u32(vaddq_u32(r,vshrq_n_u32(r,8)),8);
+        g = vshrq_n_u32(vaddq_u32(g,vshrq_n_u32(g,8)),8);
+        b = vshrq_n_u32(vaddq_u32(b,vshrq_n_u32(b,8)),8);
+        p = vorrq_u32(vorrq_u32(vshlq_u32(r,rsv),vshlq_u32(g,gsv)),
+                      vorrq_u32(vshlq_u32(b,bsv),vshlq_u32(a,asv)));
+        vst1q_u32(pixels+ii,p);
+    }
+#endif
+    for(; ii < count; ii++) {
+        Uint32 p = pixels[ii];
+        Uint32 a = (p >> as) & 0xff;
+        Uint32 r = div255(((p >> rs) & 0xff)*a);
+        Uint32 g = div255(((p >> gs) & 0xff)*a);
+        Uint32 b = div255(((p >> bs) & 0xff)*a);
+        pixels[ii] = (r << rs) | (g << gs) | (b << bs) | (a << as);
     }
+}
 
-    bool result = initWithData(normal->pixels, normal->w, normal->h);
-    SDL_FreeSurface(normal);
-    if (result) setName(filename);
-    return result;
+/**
+ * Returns a surface with the image in the given file, ready for upload.
+ *
+ * This method can load any file format supported by SDL_Image.  The
+ * pixels of the surface are RGBA in memory order, which is the layout
+ * expected by {@link initWithData} and {@link set}.  If premultiply is
+ * true, the colors are also multiplied by alpha.
+ *
+ * Images that SDL_Image already decodes as RGBA (the common case for
+ * PNG) are returned as is, premultiplied in place if necessary, so no
+ * second copy of the image is made.  Other images are converted to RGBA
+ * by SDL first.  Only the premultiplication uses SIMD; reordering the
+ * channels is left to SDL.  This method does not use OpenGL and so is
+ * safe to call from any thread.  Files in the asset directory are read
+ * through the {@link AssetPack}, if there is one.
+ *
+ * The caller owns the surface and must free it with SDL_FreeSurface.
+ *
+ * @param filename      The path to the image file
+ * @param premultiply   Whether to premultiply the colors by alpha
+ *
+ * @return a surface with the image in the given file (nullptr on failure)
+ */
+SDL_Surface* Texture::decode(const std::string& filename, bool premultiply) {
+    SDL_Surface* surface = IMG_Load_RW(AssetPack::openFile(filename,"rb"),1);
+    if (surface == nullptr) {
+        return nullptr;
+    }
+    
+    if (surface->format->format != SDL_PIXELFORMAT_RGBA32) {
+        // SDL writes the new layout to a new surface, and never touches ours
+        SDL_Surface* normal = SDL_ConvertSurfaceFormat(surface,SDL_PIXELFORMAT_RGBA32,0);
+        SDL_FreeSurface(surface);
+        surface = normal;
+    }
+    if (surface == nullptr || !premultiply) {
+        return surface;
+    }
+    
+    // The format is unchanged, so only the pixel values are modified
+    for(int row = 0; row < surface->h; row++) {
+        Uint32* pixels = (Uint32*)((Uint8*)surface->pixels+row*surface->pitch);
+        premultiplyRow(pixels,surface->w);
+    }
+    return surface;
 }
 
+
 #pragma mark -
 #pragma mark Setters
 
@@ -208,12 +496,38 @@ bool Texture::initWithFile(const std::string& filename) {
  * @return a reference to this (modified) texture for chaining.
  */
 const Texture& Texture::set(const void *data) {
+    CUAssertLog(!_compressed, "Cannot set the data of a compressed texture");
     if (!_active) { bind(); }
     glTexImage2D(GL_TEXTURE_2D, 0, (GLenum)_pixelFormat, _width, _height, 0,
                  (GLenum)_pixelFormat, GL_UNSIGNED_BYTE, data);
     return *this;
 }
 
+/**
+ * Sets a horizontal strip of this texture to the contents of the buffer.
+ *
+ * The buffer must have the correct data format.  In addition, the buffer
+ * must be size width*rows*format, and start at the given row.  Uploading
+ * a large texture a strip at a time bounds the main-thread cost of each
+ * call.
+ *
+ * This method binds the texture if it is not currently active.
+ *
+ * @param data  The buffer to read into the texture
+ * @param row   The first row to set
+ * @param rows  The number of rows to set
+ *
+ * @return a reference to this (modified) texture for chaining.
+ */
+const Texture& Texture::set(const void *data, int row, int rows) {
+    CUAssertLog(row >= 0 && row+rows <= _height, "Rows [%d,%d) are out of range", row, row+rows);
+    CUAssertLog(!_compressed, "Cannot set the data of a compressed texture");
+    if (!_active) { bind(); }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, _width, rows,
+                    (GLenum)_pixelFormat, GL_UNSIGNED_BYTE, data);
+    return *this;
+}
+
 
 #pragma mark -
 #pragma mark Attributes
@@ -229,6 +543,7 @@ void Texture::buildMipMaps() {
     CUAssertLog(nextPOT(_width)  == _width,  "Width  %d is not a power of two", _width);
     CUAssertLog(nextPOT(_height) == _height, "Height %d is not a power of two", _height);
     CUAssertLog(_parent == nullptr, "Cannot build mipmaps for a subtexture");
+    CUAssertLog(!_compressed, "Cannot build mipmaps for a compressed texture");
     CUAssertLog(_active, "Texture is not active");
     glGenerateMipmap(GL_TEXTURE_2D);
     _hasMipmaps = true;
@@ -296,6 +611,27 @@ void Texture::setWrapT(GLuint wrap) {
     }
 }
 
+/**
+ * Returns the GPU memory used by this texture in bytes.
+ *
+ * This is an estimate, as the driver may pad the texture.  Mipmaps add
+ * a third to the size of an uncompressed texture.  A subtexture shares
+ * the memory of its parent, and so its size is 0.
+ *
+ * @return the GPU memory used by this texture in bytes.
+ */
+size_t Texture::getByteSize() const {
+    if (_parent != nullptr || _buffer == 0) {
+        return 0;
+    } else if (_compressed) {
+        return _bytes;
+    }
+    
+    size_t texel = (_pixelFormat == PixelFormat::RED || _pixelFormat == PixelFormat::ALPHA) ? 1 : 4;
+    size_t result = (size_t)_width*_height*texel;
+    return (_hasMipmaps ? result+result/3 : result);
+}
+
 /**
  * Returns a string representation of this texture for debugging purposes.
  *
@@ -367,8 +703,9 @@ std::shared_ptr<Texture> Texture::getSubTexture(GLfloat minS, GLfloat maxS,
     // These values can be left alone.
     
     // Set the size information
-    result->_width  = (unsigned int)((maxS-minS)*source->_width);
-    result->_height = (unsigned int)((maxT-minT)*source->_height);
+    // Round, as atlas regions are pixel aligned but the span may not be exact
+    result->_width  = (unsigned int)((maxS-minS)*source->_width+0.5f);
+    result->_height = (unsigned int)((maxT-minT)*source->_height+0.5f);
     result->_minS = minS;
     result->_maxS = maxS;
     result->_minT = minT;
@@ -412,5 +749,191 @@ void Texture::unbind() {
     _active = false;
 }
 
+#pragma mark -
+#pragma mark Texture Container
+/** The 12 byte identifier that starts every KTX 1.1 file */
+static const Uint8 KTX_IDENTIFIER[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+/** The endianness field as read by a reader of the same byte order */
+#define KTX_ENDIAN      0x04030201
+/** The size of the KTX header (identifier plus 13 words) */
+#define KTX_HEADER      64
 
+/**
+ * Returns the 32-bit word at the given position, swapping it if necessary
+ *
+ * @param data  The container data
+ * @param pos   The byte offset of the word
+ * @param swap  Whether the file has the opposite byte order
+ *
+ * @return the 32-bit word at the given position
+ */
+static Uint32 readWord(const Uint8* data, size_t pos, bool swap) {
+    Uint32 word;
+    std::memcpy(&word, data+pos, sizeof(Uint32));
+    return swap ? SDL_Swap32(word) : word;
+}
 
+/**
+ * Releases the container data.
+ *
+ * You must reinitialize the container to use it.
+ */
+void TextureContainer::dispose() {
+    _data.clear();
+    _data.shrink_to_fit();
+    _levels.clear();
+    _format = 0;
+}
+
+/**
+ * Initializes a container from a copy of the given KTX data.
+ *
+ * @param data  The KTX file contents
+ * @param size  The size of the data in bytes
+ *
+ * @return true if the data is a valid compressed KTX container.
+ */
+bool TextureContainer::initWithData(const void* data, size_t size) {
+    if (!_levels.empty()) {
+        CUAssertLog(false, "Container is already initialized");
+        return false; // In case asserts are off.
+    }
+    _data.assign((const Uint8*)data, (const Uint8*)data+size);
+    if (!parse()) {
+        dispose();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Initializes a container from the given KTX file.
+ *
+ * This method fails quietly if the file does not exist, as a missing
+ * container normally means the image should be loaded some other way.
+ * Files in the asset directory are read through the {@link AssetPack},
+ * if there is one.
+ *
+ * @param filename  The path to the KTX file
+ *
+ * @return true if the file is a valid compressed KTX container.
+ */
+bool TextureContainer::initWithFile(const std::string& filename) {
+    if (!_levels.empty()) {
+        CUAssertLog(false, "Container is already initialized");
+        return false; // In case asserts are off.
+    }
+    
+    SDL_RWops* file = AssetPack::openFile(filename, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    
+    Sint64 size = SDL_RWsize(file);
+    bool success = size > 0;
+    if (success) {
+        _data.resize((size_t)size);
+        success = SDL_RWread(file, _data.data(), 1, (size_t)size) == (size_t)size;
+    }
+    SDL_RWclose(file);
+    
+    if (!success || !parse()) {
+        CULogError("Could not read texture container '%s'", filename.c_str());
+        dispose();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parses the contents of _data, returning true if it is a valid container.
+ *
+ * @return true if _data is a valid container.
+ */
+bool TextureContainer::parse() {
+    const Uint8* data = _data.data();
+    size_t size = _data.size();
+    if (size < KTX_HEADER || std::memcmp(data, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0) {
+        return false;
+    }
+    
+    bool swap = false;
+    Uint32 endian = readWord(data, 12, false);
+    if (endian == SDL_Swap32(KTX_ENDIAN)) {
+        swap = true;
+    } else if (endian != KTX_ENDIAN) {
+        return false;
+    }
+    
+    Uint32 glType   = readWord(data, 16, swap);
+    Uint32 glFormat = readWord(data, 24, swap);
+    Uint32 internal = readWord(data, 28, swap);
+    Uint32 width    = readWord(data, 36, swap);
+    Uint32 height   = readWord(data, 40, swap);
+    Uint32 depth    = readWord(data, 44, swap);
+    Uint32 elements = readWord(data, 48, swap);
+    Uint32 faces    = readWord(data, 52, swap);
+    Uint32 levels   = readWord(data, 56, swap);
+    Uint32 keyvalue = readWord(data, 60, swap);
+    if (glType != 0 || glFormat != 0) {
+        CULogError("Texture container is not compressed");
+        return false;
+    } else if (width == 0 || height == 0 || depth != 0 || elements != 0 || faces != 1) {
+        CULogError("Texture container is not a 2D image");
+        return false;
+    } else if (levels > 32) {
+        return false;
+    }
+    
+    // A level count of 0 asks the reader to generate mipmaps
+    levels = std::max(levels, (Uint32)1);
+    size_t pos = KTX_HEADER+(size_t)keyvalue;
+    for(Uint32 ii = 0; ii < levels; ii++) {
+        if (pos+sizeof(Uint32) > size) {
+            _levels.clear();
+            return false;
+        }
+        
+        Level level;
+        level.width  = std::max(width  >> ii, (Uint32)1);
+        level.height = std::max(height >> ii, (Uint32)1);
+        level.size   = readWord(data, pos, swap);
+        level.offset = pos+sizeof(Uint32);
+        if (level.size == 0 || level.size > size-level.offset) {
+            _levels.clear();
+            return false;
+        }
+        _levels.push_back(level);
+        
+        // Each level is padded to a multiple of four bytes
+        pos = level.offset+((level.size+3) & ~(size_t)3);
+    }
+    
+    _format = internal;
+    return true;
+}
+
+/**
+ * Returns the largest mipmap level that fits in the given size.
+ *
+ * This is the first level whose width and height are both at most
+ * maxsize.  If no level is that small, it is the last level.  A maxsize
+ * of 0 means there is no limit, and so it is always level 0.
+ *
+ * @param maxsize   The maximum width and height
+ *
+ * @return the largest mipmap level that fits in the given size.
+ */
+size_t TextureContainer::selectLevel(unsigned int maxsize) const {
+    if (maxsize == 0 || _levels.empty()) {
+        return 0;
+    }
+    for(size_t ii = 0; ii < _levels.size(); ii++) {
+        if (_levels[ii].width <= maxsize && _levels[ii].height <= maxsize) {
+            return ii;
+        }
+    }
+    return _levels.size()-1;
+}
@@ -47,11 +47,27 @@ in vec4 outColor;
 // Texture result from vertex shader
 in vec2 outTexCoord;
 
-// Texture map
+// Texture slot from vertex shader
+flat in int outSlot;
+
+// Texture map (slot 0) and the extra slots for multi-texture batching
 uniform sampler2D uTexture;
+uniform sampler2D uSlotTextures[7];
+
+// Sampler arrays may only be indexed by constants
+vec4 slotColor(vec2 coord) {
+    if (outSlot == 1) { return texture(uSlotTextures[0], coord); }
+    if (outSlot == 2) { return texture(uSlotTextures[1], coord); }
+    if (outSlot == 3) { return texture(uSlotTextures[2], coord); }
+    if (outSlot == 4) { return texture(uSlotTextures[3], coord); }
+    if (outSlot == 5) { return texture(uSlotTextures[4], coord); }
+    if (outSlot == 6) { return texture(uSlotTextures[5], coord); }
+    if (outSlot == 7) { return texture(uSlotTextures[6], coord); }
+    return texture(uTexture, coord);
+}
 
 void main(void) {
-    frag_color = texture(uTexture, outTexCoord)*outColor;
+    frag_color = slotColor(outTexCoord)*outColor;
 }
 
 /////////// SHADER END //////////
@@ -77,11 +93,27 @@ in vec4 outColor;
 // Texture result from vertex shader
 in vec2 outTexCoord;
                                          
-// Texture map
+// Texture slot from vertex shader
+flat in int outSlot;
+
+// Texture map (slot 0) and the extra slots for multi-texture batching
 uniform sampler2D uTexture;
+uniform sampler2D uSlotTextures[7];
+
+// Sampler arrays may only be indexed by constants
+vec4 slotColor(vec2 coord) {
+    if (outSlot == 1) { return texture(uSlotTextures[0], coord); }
+    if (outSlot == 2) { return texture(uSlotTextures[1], coord); }
+    if (outSlot == 3) { return texture(uSlotTextures[2], coord); }
+    if (outSlot == 4) { return texture(uSlotTextures[3], coord); }
+    if (outSlot == 5) { return texture(uSlotTextures[4], coord); }
+    if (outSlot == 6) { return texture(uSlotTextures[5], coord); }
+    if (outSlot == 7) { return texture(uSlotTextures[6], coord); }
+    return texture(uTexture, coord);
+}
 
 void main(void) {
-    frag_color = texture(uTexture, outTexCoord)*outColor;
+    frag_color = slotColor(outTexCoord)*outColor;
 }
 
 /////////// SHADER END //////////
@@ -47,14 +47,34 @@ out vec4 outColor;
 in  vec2 aTexCoord;
 out vec2 outTexCoord;
 
+// Texture slot (for multi-texture batching)
+in float aSlot;
+flat out int outSlot;
+
+// Sprite instances (quad axes, origin, texture rectangle and tint)
+in vec4 aAxes;
+in vec2 aOrigin;
+in vec4 aTexRect;
+in vec4 aTint;
+uniform bool uInstanced;
+
 // Matrices
 uniform mat4 uPerspective;
 
-// Transform and pass through
+// Transform and pass through (or expand the instance into a quad strip)
 void main(void) {
-    gl_Position = uPerspective*aPosition;
-    outColor = aColor;
-    outTexCoord = aTexCoord;
+    if (uInstanced) {
+        vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+        vec2 position = aOrigin + aAxes.xy*corner.x + aAxes.zw*corner.y;
+        gl_Position = uPerspective*vec4(position, 0.0, 1.0);
+        outColor = aTint;
+        outTexCoord = mix(aTexRect.xy, aTexRect.zw, corner);
+    } else {
+        gl_Position = uPerspective*aPosition;
+        outColor = aColor;
+        outTexCoord = aTexCoord;
+    }
+    outSlot = int(aSlot+0.5);
 }
 
 /////////// SHADER END //////////
@@ -11,6 +11,7 @@
 #include "CUDebug.h"
 #include "CUStrings.h"
 #include "CUNode.h"
+#include "CUSpriteBatch.h"
 #include <chrono>
 
 /** Data type for timestamp support */
@@ -760,11 +761,79 @@ void testNode() {
 }
     
 
+#pragma mark -
+#pragma mark Benchmarks
+
+/**
+ * Times transform queries and rendering for a deep static hierarchy.
+ *
+ * The hierarchy is a chain of nodes, each slightly offset, scaled and
+ * rotated from its parent.  The cached passes should only pay for the
+ * traversal, while the dirty passes recompute every world transform.
+ */
+void benchNodeTransforms() {
+    CULog("Running benchmarks for Node transforms.\n");
+    const int depth  = 256;
+    const int passes = 1000;
+    
+    std::shared_ptr<Node> root = Node::allocWithBounds(Size(10,10));
+    std::shared_ptr<Node> leaf = root;
+    for(int ii = 1; ii < depth; ii++) {
+        std::shared_ptr<Node> child = Node::allocWithBounds(Size(10,10));
+        child->setPosition(1,1);
+        child->setScale(1.001f);
+        child->setAngle(0.01f);
+        leaf->addChild(child);
+        leaf = child;
+    }
+    
+    Vec2 sum;
+    timestamp_t start = std::chrono::high_resolution_clock::now();
+    for(int ii = 0; ii < passes; ii++) {
+        sum += leaf->worldToNodeCoords(Vec2(ii,ii));
+    }
+    timestamp_t end = std::chrono::high_resolution_clock::now();
+    CULog("Static leaf queries: %lld us",
+          (long long)std::chrono::duration_cast<std::chrono::microseconds>(end-start).count());
+    
+    start = std::chrono::high_resolution_clock::now();
+    for(int ii = 0; ii < passes; ii++) {
+        root->setPosition(ii,ii);
+        sum += leaf->worldToNodeCoords(Vec2(ii,ii));
+    }
+    end = std::chrono::high_resolution_clock::now();
+    CULog("Dirty leaf queries: %lld us",
+          (long long)std::chrono::duration_cast<std::chrono::microseconds>(end-start).count());
+    
+    std::shared_ptr<SpriteBatch> batch = SpriteBatch::alloc();
+    batch->begin();
+    start = std::chrono::high_resolution_clock::now();
+    for(int ii = 0; ii < passes; ii++) {
+        root->render(batch);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    CULog("Static renders: %lld us",
+          (long long)std::chrono::duration_cast<std::chrono::microseconds>(end-start).count());
+    
+    start = std::chrono::high_resolution_clock::now();
+    for(int ii = 0; ii < passes; ii++) {
+        root->setPosition(ii,ii);
+        root->render(batch);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    batch->end();
+    CULog("Dirty renders: %lld us",
+          (long long)std::chrono::duration_cast<std::chrono::microseconds>(end-start).count());
+    
+    CULog("Node benchmarks complete (checksum %f).\n", sum.x+sum.y);
+}
+
 #pragma mark -
 #pragma mark Main
     
 void sceneUnitTest() {
     testNode();
+    benchNodeTransforms();
 }
     
 }
@@ -12,6 +12,8 @@
 namespace cugl {
     
 void testNode();
+
+void benchNodeTransforms();
     
 void sceneUnitTest();
     
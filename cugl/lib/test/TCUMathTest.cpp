@@ -73,7 +73,7 @@ void testVec2() {
     CUAssertAlwaysLog(Vec2::ONE.x == 1 && Vec2::ONE.y == 1,         "Ones vector failed");
     CUAssertAlwaysLog(Vec2::UNIT_X.x == 1 && Vec2::UNIT_X.y == 0,   "X-axis vector failed");
     CUAssertAlwaysLog(Vec2::UNIT_Y.x == 0 && Vec2::UNIT_Y.y == 1,   "Y-axis vector failed");
-    CUAssertAlwaysLog(Vec2::ANCHOR_MIDDLE.x == 0.5 && Vec2::ANCHOR_MIDDLE.y == 0.5,
+    CUAssertAlwaysLog(Vec2::ANCHOR_CENTER.x == 0.5 && Vec2::ANCHOR_CENTER.y == 0.5,
                       "Central anchor failed");
     CUAssertAlwaysLog(Vec2::ANCHOR_BOTTOM_LEFT.x == 0.0 && Vec2::ANCHOR_BOTTOM_LEFT.y == 0.0,
                       "Bottom left anchor failed");
@@ -87,9 +87,9 @@ void testVec2() {
                       "Middle right anchor failed");
     CUAssertAlwaysLog(Vec2::ANCHOR_MIDDLE_LEFT.x == 0.0 && Vec2::ANCHOR_MIDDLE_LEFT.y == 0.5,
                       "Middle left anchor failed");
-    CUAssertAlwaysLog(Vec2::ANCHOR_MIDDLE_TOP.x == 0.5 && Vec2::ANCHOR_MIDDLE_TOP.y == 1.0,
+    CUAssertAlwaysLog(Vec2::ANCHOR_TOP_CENTER.x == 0.5 && Vec2::ANCHOR_TOP_CENTER.y == 1.0,
                       "Middle top anchor failed");
-    CUAssertAlwaysLog(Vec2::ANCHOR_MIDDLE_BOTTOM.x == 0.5 && Vec2::ANCHOR_MIDDLE_BOTTOM.y == 0.0,
+    CUAssertAlwaysLog(Vec2::ANCHOR_BOTTOM_CENTER.x == 0.5 && Vec2::ANCHOR_BOTTOM_CENTER.y == 0.0,
                       "Middle bottom anchor failed");
     
     
@@ -2806,11 +2806,7 @@ void testColor4f() {
     CUAssertAlwaysLog(test4.r == 0.5f && test4.g == 0.6f && test4.b == 0.25f && test4.a == 0.75f,
                       "Copy constructor failed");
 
-#if CU_MEMORY_ORDER == CU_ORDER_REVERSED
-    Color4f test5(128 << 24 | 32 << 16 | 64 << 8 | 192);
-#else
     Color4f test5(192 << 24 | 64 << 16 | 32 << 8 | 128);
-#endif
 	CUAssertAlwaysLog(CU_MATH_APPROX(test5.r,0.75f,0.005f) && CU_MATH_APPROX(test5.g,0.25f,0.005f) &&
                       CU_MATH_APPROX(test5.b,0.125f,0.005f) && CU_MATH_APPROX(test5.a,0.5f,0.005f),
                       "Packed integer constructor failed");
@@ -2850,11 +2846,7 @@ void testColor4f() {
     CUAssertAlwaysLog(test1.r == 0.25f && test1.g == 0.1f && test1.b == 0.9f && test1.a == 0.5f,
                       "Float assignment failed");
     
-#if CU_MEMORY_ORDER == CU_ORDER_REVERSED
-	test1 = (128 << 24 | 32 << 16 | 64 << 8 | 192);
-#else
     test1 = (192 << 24 | 64 << 16 | 32 << 8 | 128);
-#endif
     CUAssertAlwaysLog(CU_MATH_APPROX(test1.r,0.75f,0.005f)  && CU_MATH_APPROX(test1.g,0.25f,0.005f) &&
                       CU_MATH_APPROX(test1.b,0.125f,0.005f) && CU_MATH_APPROX(test1.a,0.5f,0.005f),
                       "Packed integer assignment failed");
@@ -2871,11 +2863,7 @@ void testColor4f() {
     CUAssertAlwaysLog(test1.r == 0.25f && test1.g == 0.1f && test1.b == 0.9f && test1.a == 0.5f,
                       "Alternate float assignment failed");
     
-#if CU_MEMORY_ORDER == CU_ORDER_REVERSED
-	test1.set(128 << 24 | 32 << 16 | 64 << 8 | 192);
-#else
     test1.set(192 << 24 | 64 << 16 | 32 << 8 | 128);
-#endif
     CUAssertAlwaysLog(CU_MATH_APPROX(test1.r,0.75f,0.005f)  && CU_MATH_APPROX(test1.g,0.25f,0.005f) &&
                       CU_MATH_APPROX(test1.b,0.125f,0.005f) && CU_MATH_APPROX(test1.a,0.5f,0.005f),
                       "Alternate packed integer assignment failed");
@@ -3502,11 +3490,7 @@ void testColor4() {
     CUAssertAlwaysLog(test4.r == 128 && test4.g == 64 && test4.b == 32 && test4.a == 192,
                       "Copy constructor failed");
     
-#if CU_MEMORY_ORDER == CU_ORDER_REVERSED
-	Color4 test5(128 << 24 | 32 << 16 | 64 << 8 | 192);
-#else
     Color4 test5(192 << 24 | 64 << 16 | 32 << 8 | 128);
-#endif
     CUAssertAlwaysLog(test5.r == 192 && test5.g == 64 && test5.b == 32 && test5.a == 128,
                       "Packed integer constructor failed");
     
@@ -8493,11 +8477,11 @@ void testPlane() {
     std::string str1;
     
     std::string str2 = "[";
-    str2 += cugl::to_string(1/sqrt(3));
+    str2 += cugl::to_string(1/sqrtf(3.0f));
     str2 +=  "x+";
-    str2 += cugl::to_string(1/sqrt(3));
+    str2 += cugl::to_string(1/sqrtf(3.0f));
     str2 +=  "y+";
-    str2 += cugl::to_string(1/sqrt(3));
+    str2 += cugl::to_string(1/sqrtf(3.0f));
     str2 +=  "z = ";
     str2 += cugl::to_string(1.0f);
     str2 += "]";
@@ -8593,6 +8577,112 @@ void testFrustum() {
 }
 
 
+#pragma mark -
+#pragma mark Bulk Transforms
+
+/**
+ * Unit test and benchmark for the bulk point transforms
+ *
+ * This compares the vectorized kernels against the single point transforms,
+ * for both packed and vertex-strided arrays.  It then times both approaches.
+ */
+void testTransformPoints() {
+    CULog("Running tests for bulk transforms.\n");
+    
+    Mat4 mat;
+    Mat4::createRotationZ(0.7f,&mat);
+    mat.scale(1.5f,-2.0f,1.0f);
+    mat.translate(3.0f,4.0f,0.0f);
+    Affine2 aff(1.2f,0.3f,-0.5f,0.9f,7.0f,-2.0f);
+    
+    // Odd sizes exercise the scalar tail after the vector loops
+    for(int size = 0; size < 19; size++) {
+        std::vector<Vec2> points;
+        std::vector<Vertex2> verts;
+        for(int ii = 0; ii < size; ii++) {
+            Vec2 p(ii*3.5f-20.0f,ii*ii*0.25f);
+            Vertex2 v;
+            v.position = p;
+            v.color = Color4::RED;
+            v.texcoord.set(0.5f,0.25f);
+            points.push_back(p);
+            verts.push_back(v);
+        }
+        
+        std::vector<Vec2> test1 = points;
+        std::vector<Vertex2> test2 = verts;
+        Mat4::transformPoints(mat,test1.data(),size);
+        Mat4::transformPoints(mat,(Vec2*)test2.data(),size,sizeof(Vertex2));
+        for(int ii = 0; ii < size; ii++) {
+            Vec2 expect = points[ii]*mat;
+            CUAssertAlwaysLog(test1[ii].equals(expect,CU_TEST_EPSILON*100),
+                              "Method Mat4::transformPoints() failed");
+            CUAssertAlwaysLog(test2[ii].position.equals(expect,CU_TEST_EPSILON*100),
+                              "Method Mat4::transformPoints() failed with stride");
+            CUAssertAlwaysLog(test2[ii].color == Color4::RED && test2[ii].texcoord == Vec2(0.5f,0.25f),
+                              "Method Mat4::transformPoints() overwrote vertex data");
+        }
+        
+        test1 = points;
+        test2 = verts;
+        Affine2::transformPoints(aff,test1.data(),size);
+        Affine2::transformPoints(aff,(Vec2*)test2.data(),size,sizeof(Vertex2));
+        for(int ii = 0; ii < size; ii++) {
+            Vec2 expect = points[ii]*aff;
+            CUAssertAlwaysLog(test1[ii].equals(expect,CU_TEST_EPSILON*100),
+                              "Method Affine2::transformPoints() failed");
+            CUAssertAlwaysLog(test2[ii].position.equals(expect,CU_TEST_EPSILON*100),
+                              "Method Affine2::transformPoints() failed with stride");
+            CUAssertAlwaysLog(test2[ii].color == Color4::RED && test2[ii].texcoord == Vec2(0.5f,0.25f),
+                              "Method Affine2::transformPoints() overwrote vertex data");
+        }
+    }
+    
+#pragma mark Benchmark
+    const int size   = 4096;
+    const int passes = 200;
+    std::vector<Vertex2> verts(size);
+    for(int ii = 0; ii < size; ii++) {
+        verts[ii].position.set(ii*0.5f,ii*0.25f);
+    }
+    Mat4 small;
+    Mat4::createRotationZ(0.001f,&small);
+    
+    timestamp_t start = cuclock_t::now();
+    for(int jj = 0; jj < passes; jj++) {
+        for(int ii = 0; ii < size; ii++) {
+            verts[ii].position *= small;
+        }
+    }
+    timestamp_t end = cuclock_t::now();
+    CULog("Scalar vertex transforms: %lld us",
+          (long long)std::chrono::duration_cast<std::chrono::microseconds>(end-start).count());
+    
+    start = cuclock_t::now();
+    for(int jj = 0; jj < passes; jj++) {
+        Mat4::transformPoints(small,(Vec2*)verts.data(),size,sizeof(Vertex2));
+    }
+    end = cuclock_t::now();
+    CULog("Bulk vertex transforms: %lld us",
+          (long long)std::chrono::duration_cast<std::chrono::microseconds>(end-start).count());
+    
+    std::vector<Vec2> points(size);
+    for(int ii = 0; ii < size; ii++) {
+        points[ii] = verts[ii].position;
+    }
+    start = cuclock_t::now();
+    for(int jj = 0; jj < passes; jj++) {
+        Mat4::transformPoints(small,points.data(),size);
+    }
+    end = cuclock_t::now();
+    CULog("Bulk packed transforms: %lld us",
+          (long long)std::chrono::duration_cast<std::chrono::microseconds>(end-start).count());
+
+#pragma mark Complete
+    CULog("Bulk transform tests complete (checksum %f).\n", points[size-1].x+verts[size-1].position.y);
+}
+
+
 #pragma mark -
 #pragma mark Main
 
@@ -8615,6 +8705,7 @@ void mathUnitTest() {
     testRay();
     testPlane();
     testFrustum();
+    testTransformPoints();
 }
     
 }
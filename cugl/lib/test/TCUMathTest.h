@@ -118,6 +118,13 @@ void testPlane();
  */
 void testFrustum();
 
+/**
+ * Unit test and benchmark for the bulk point transforms
+ *
+ * This class uses vector acceleration on select platforms.
+ */
+void testTransformPoints();
+
 /**
  * Master unit test that invokes all others in this module.
  */
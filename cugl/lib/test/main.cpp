@@ -10,6 +10,13 @@
 #include <stdio.h>
 #include <string>
 #include <sstream>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <SDL/SDL_image.h>
 #include <cugl/cugl.h>
 
 #include "TCUMathTest.h"
@@ -168,6 +175,874 @@ void testThread() {
     pool = nullptr;
 }
 
+/**
+ * Tests task groups, priorities and continuations of the thread pool.
+ */
+void testTaskGroup() {
+    CULog("Running tests for TaskGroup.");
+    std::shared_ptr<cugl::ThreadPool> pool = cugl::ThreadPool::alloc(4);
+    std::atomic<int> count(0);
+    std::shared_ptr<cugl::TaskGroup> outer = cugl::TaskGroup::alloc();
+    for(int ii = 0; ii < 50; ii++) {
+        pool->addTask([&] {
+            // Waiting inside a task runs the other tasks
+            std::shared_ptr<cugl::TaskGroup> inner = cugl::TaskGroup::alloc();
+            for(int jj = 0; jj < 100; jj++) {
+                pool->addTask([&] { count++; }, cugl::ThreadPool::Priority::HIGH, inner);
+            }
+            inner->wait();
+        }, cugl::ThreadPool::Priority::NORMAL, outer);
+    }
+    outer->wait();
+    CUAssertLog(count == 5000, "Nested tasks did not all run");
+    
+    std::shared_ptr<cugl::TaskGroup> first = cugl::TaskGroup::alloc();
+    std::shared_ptr<cugl::TaskGroup> second = cugl::TaskGroup::alloc();
+    for(int ii = 0; ii < 100; ii++) {
+        pool->addTask([&] { count++; }, cugl::ThreadPool::Priority::LOW, first);
+    }
+    int stage = 0;
+    pool->addContinuation(first, [&] { stage = count; }, cugl::ThreadPool::Priority::NORMAL, second);
+    second->wait();
+    CUAssertLog(stage == 5100, "Continuation ran before its group finished");
+    
+    // A waiting worker with nothing to run sleeps until the group is done
+    std::shared_ptr<cugl::TaskGroup> slow = cugl::TaskGroup::alloc();
+    std::atomic<bool> started(false);
+    pool->addTask([&] {
+        pool->addTask([&] { started = true; SDL_Delay(50); }, cugl::ThreadPool::Priority::HIGH, slow);
+        while (!started) {
+            SDL_Delay(1);
+        }
+        slow->wait();
+    }, cugl::ThreadPool::Priority::NORMAL, outer);
+    outer->wait();
+    CUAssertLog(slow->isDone(), "Waiting worker did not see its group finish");
+    
+    std::shared_ptr<cugl::TaskGroup> dropped = cugl::TaskGroup::alloc();
+    for(int ii = 0; ii < 1000; ii++) {
+        pool->addTask([] { SDL_Delay(1); }, cugl::ThreadPool::Priority::LOW, dropped);
+    }
+    pool->stop();
+    CUAssertLog(pool->isShutdown() && dropped->isDone(), "Stop did not discard the pending tasks");
+    CULog("TaskGroup tests complete.\n");
+}
+
+/**
+ * A copy of the original thread pool: one locked queue shared by every thread
+ */
+class LockedPool {
+private:
+    std::vector<std::thread> _workers;
+    std::queue<std::function<void()>> _taskQueue;
+    std::mutex _queueMutex;
+    std::condition_variable _taskCondition;
+    bool _stop = false;
+    
+public:
+    LockedPool(int threads) {
+        for(int ii = 0; ii < threads; ii++) {
+            _workers.emplace_back([this] {
+                while (true) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lk(_queueMutex);
+                        _taskCondition.wait(lk, [this] { return _stop || !_taskQueue.empty(); });
+                        if (_stop) {
+                            return;
+                        }
+                        task = std::move(_taskQueue.front());
+                        _taskQueue.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+    
+    ~LockedPool() {
+        {
+            std::unique_lock<std::mutex> lk(_queueMutex);
+            _stop = true;
+            _taskCondition.notify_all();
+        }
+        for(auto it = _workers.begin(); it != _workers.end(); ++it) {
+            it->join();
+        }
+    }
+    
+    void addTask(const std::function<void()>& task) {
+        std::unique_lock<std::mutex> lk(_queueMutex);
+        _taskQueue.emplace(task);
+        _taskCondition.notify_one();
+    }
+};
+
+/**
+ * Benchmarks the thread pool against the original locked queue.
+ *
+ * The first test adds many tiny tasks from the main thread.  The second has
+ * every task spawn more tasks, so the workers contend for the queue.  This
+ * reports the tasks run per second.
+ *
+ * @param threads   The number of worker threads
+ */
+void benchThreadPool(int threads) {
+    CULog("Running benchmarks for ThreadPool with %d threads.", threads);
+    const int tasks  = 200000;
+    const int fanout = 64;
+    const char* names[] = { "Locked queue", "Work stealing" };
+    for(int mode = 0; mode < 2; mode++) {
+        std::shared_ptr<LockedPool> locked;
+        std::shared_ptr<cugl::ThreadPool> pool;
+        std::function<void(const std::function<void()>&)> add;
+        if (mode == 0) {
+            locked = std::make_shared<LockedPool>(threads);
+            add = [&](const std::function<void()>& task) { locked->addTask(task); };
+        } else {
+            pool = cugl::ThreadPool::alloc(threads);
+            add = [&](const std::function<void()>& task) { pool->addTask(task); };
+        }
+        
+        std::atomic<int> count(0);
+        auto start = std::chrono::high_resolution_clock::now();
+        for(int ii = 0; ii < tasks; ii++) {
+            add([&] { count++; });
+        }
+        while (count < tasks) {
+            std::this_thread::yield();
+        }
+        auto middle = std::chrono::high_resolution_clock::now();
+        
+        count = 0;
+        for(int ii = 0; ii < tasks/fanout; ii++) {
+            add([&] {
+                for(int jj = 0; jj < fanout; jj++) {
+                    add([&] { count++; });
+                }
+            });
+        }
+        while (count < tasks/fanout*fanout) {
+            std::this_thread::yield();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        
+        double flat = std::chrono::duration_cast<std::chrono::microseconds>(middle-start).count()/1.0e6;
+        double nest = std::chrono::duration_cast<std::chrono::microseconds>(end-middle).count()/1.0e6;
+        CULog("%s: %.0f tasks/s from main, %.0f tasks/s spawned by workers",
+              names[mode], tasks/flat, tasks/fanout*fanout/nest);
+    }
+    CULog("ThreadPool benchmarks complete.\n");
+}
+
+/**
+ * Benchmarks texture decoding over the textures of an asset directory.
+ *
+ * This compares the old decode path (IMG_Load followed by a full copy in
+ * SDL_ConvertSurfaceFormat) with Texture::decode, with and without the
+ * premultiply pass.  It reports the throughput in decoded megabytes per
+ * second, and the peak pixel memory held for any one image.
+ *
+ * @param directory The asset directory (with a trailing separator)
+ */
+void benchTextureDecode(const std::string& directory) {
+    CULog("Running benchmarks for texture decoding.");
+    std::shared_ptr<cugl::JsonReader> reader = cugl::JsonReader::alloc(directory+"json/assets.json");
+    std::shared_ptr<cugl::JsonValue> json = (reader == nullptr ? nullptr : reader->readJson());
+    std::shared_ptr<cugl::JsonValue> textures = (json == nullptr ? nullptr : json->get("textures"));
+    if (textures == nullptr) {
+        CULogError("No textures in '%sjson/assets.json'",directory.c_str());
+        return;
+    }
+    
+    std::vector<std::string> files;
+    for(int ii = 0; ii < textures->size(); ii++) {
+        std::shared_ptr<cugl::JsonValue> entry = textures->get(ii);
+        if (entry->has("pack")) {
+            std::shared_ptr<cugl::JsonValue> pack = entry->get("pack");
+            for(int jj = 0; jj < pack->size(); jj++) {
+                files.push_back(directory+pack->get(jj)->asString());
+            }
+        } else if (entry->has("file")) {
+            files.push_back(directory+entry->getString("file"));
+        }
+    }
+    
+    // Images that are not RGBA must be converted into a second buffer
+    std::vector<size_t> expanded;
+    for(auto it = files.begin(); it != files.end(); ++it) {
+        SDL_Surface* surface = IMG_Load(it->c_str());
+        size_t size = 0;
+        if (surface != nullptr) {
+            if (surface->format->format != SDL_PIXELFORMAT_RGBA32) {
+                size = surface->pitch*surface->h;
+            }
+            SDL_FreeSurface(surface);
+        }
+        expanded.push_back(size);
+    }
+    
+    const int passes = 5;
+    for(int mode = 0; mode < 3; mode++) {
+        size_t bytes = 0;
+        size_t peak  = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for(int pass = 0; pass < passes; pass++) {
+            for(size_t ii = 0; ii < files.size(); ii++) {
+                SDL_Surface* result = nullptr;
+                size_t held = 0;
+                if (mode == 0) {
+                    SDL_Surface* surface = IMG_Load(files[ii].c_str());
+                    if (surface != nullptr) {
+                        result = SDL_ConvertSurfaceFormat(surface,SDL_PIXELFORMAT_RGBA32,0);
+                        held = surface->pitch*surface->h;
+                        SDL_FreeSurface(surface);
+                    }
+                } else {
+                    result = cugl::Texture::decode(files[ii],mode == 2);
+                    held = expanded[ii];
+                }
+                if (result != nullptr) {
+                    size_t size = result->pitch*result->h;
+                    bytes += size;
+                    peak = std::max(peak,held+size);
+                    SDL_FreeSurface(result);
+                }
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double secs = std::chrono::duration_cast<std::chrono::microseconds>(end-start).count()/1.0e6;
+        const char* names[] = { "IMG_Load + convert", "Texture::decode", "Texture::decode (premultiplied)" };
+        CULog("%s: %.1f MB/s, peak %.2f MB per image",names[mode],
+              bytes/(1024.0*1024.0)/secs,peak/(1024.0*1024.0));
+    }
+    CULog("Texture decoding benchmarks complete.\n");
+}
+
+/**
+ * Appends a 32-bit word to a KTX buffer in native byte order
+ *
+ * @param data  The buffer
+ * @param word  The word to append
+ */
+static void appendWord(std::vector<Uint8>& data, Uint32 word) {
+    Uint8* bytes = (Uint8*)&word;
+    data.insert(data.end(), bytes, bytes+sizeof(Uint32));
+}
+
+/**
+ * Returns a synthetic KTX file with a 64x32 ETC2 image and three mipmaps
+ *
+ * The image data is not meaningful; each level is filled with its index.
+ *
+ * @param swap  Whether to write the header in the opposite byte order
+ *
+ * @return a synthetic KTX file with a 64x32 ETC2 image and three mipmaps
+ */
+static std::vector<Uint8> makeContainer(bool swap) {
+    const Uint8 identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+    // GL_COMPRESSED_RGBA8_ETC2_EAC; each 4x4 block is 16 bytes
+    const Uint32 header[13] = { 0x04030201, 0, 1, 0, 0x9278, 0x1908, 64, 32, 0, 0, 1, 3, 8 };
+    const Uint32 sizes[3] = { 2048, 512, 128 };
+    
+    std::vector<Uint8> data(identifier, identifier+12);
+    for(int ii = 0; ii < 13; ii++) {
+        appendWord(data, swap ? SDL_Swap32(header[ii]) : header[ii]);
+    }
+    data.insert(data.end(), 8, 0);  // Key/value data
+    for(int ii = 0; ii < 3; ii++) {
+        appendWord(data, swap ? SDL_Swap32(sizes[ii]) : sizes[ii]);
+        data.insert(data.end(), sizes[ii], (Uint8)ii);
+    }
+    return data;
+}
+
+/**
+ * Tests the KTX parser and mipmap selection of TextureContainer.
+ *
+ * This test does not use OpenGL, so it does not need a GPU.
+ */
+void testTextureContainer() {
+    CULog("Running tests for TextureContainer.");
+    for(int swap = 0; swap < 2; swap++) {
+        std::vector<Uint8> data = makeContainer(swap);
+        std::shared_ptr<cugl::TextureContainer> container;
+        container = cugl::TextureContainer::allocWithData(data.data(), data.size());
+        CUAssertLog(container != nullptr, "Container failed to parse");
+        CUAssertLog(container->getFormat() == 0x9278, "Format is incorrect");
+        CUAssertLog(container->getWidth() == 64 && container->getHeight() == 32, "Size is incorrect");
+        CUAssertLog(container->getLevelCount() == 3, "Level count is incorrect");
+        
+        size_t offset = 64+8+4;
+        for(size_t ii = 0; ii < 3; ii++) {
+            const cugl::TextureContainer::Level& level = container->getLevel(ii);
+            CUAssertLog(level.width == (64u >> ii) && level.height == (32u >> ii),
+                        "Level %zu size is incorrect", ii);
+            CUAssertLog(level.offset == offset, "Level %zu offset is incorrect", ii);
+            CUAssertLog(container->getLevelData(ii)[0] == ii && container->getLevelData(ii)[level.size-1] == ii,
+                        "Level %zu data is incorrect", ii);
+            offset += level.size+4;
+        }
+        
+        CUAssertLog(container->selectLevel(0)  == 0, "Unlimited selection is incorrect");
+        CUAssertLog(container->selectLevel(64) == 0, "Selection for 64 is incorrect");
+        CUAssertLog(container->selectLevel(63) == 1, "Selection for 63 is incorrect");
+        CUAssertLog(container->selectLevel(16) == 2, "Selection for 16 is incorrect");
+        CUAssertLog(container->selectLevel(4)  == 2, "Selection for 4 is incorrect");
+    }
+    
+    std::vector<Uint8> data = makeContainer(false);
+    std::vector<Uint8> bad = data;
+    bad[1] = 'X';
+    CUAssertLog(cugl::TextureContainer::allocWithData(bad.data(), bad.size()) == nullptr,
+                "Bad identifier was accepted");
+    bad = data;
+    bad.resize(bad.size()-1);
+    CUAssertLog(cugl::TextureContainer::allocWithData(bad.data(), bad.size()) == nullptr,
+                "Truncated level was accepted");
+    bad = data;
+    bad[16] = 1;    // glType of an uncompressed image
+    CUAssertLog(cugl::TextureContainer::allocWithData(bad.data(), bad.size()) == nullptr,
+                "Uncompressed image was accepted");
+    CULog("TextureContainer tests complete.\n");
+}
+
+/**
+ * Tests the LZ4 blocks and binary JSON used by the asset cache.
+ */
+void testAssetCache() {
+    CULog("Running tests for AssetCache.");
+    std::vector<Uint8> data(100000);
+    for(size_t ii = 0; ii < data.size(); ii++) {
+        // A mix of runs, repeats and noise
+        data[ii] = (ii % 5000 < 2000 ? 0 : (ii % 5000 < 4000 ? (Uint8)(ii % 37) : (Uint8)rand()));
+    }
+    for(size_t size = 0; size <= data.size(); size = size*3+1) {
+        std::vector<Uint8> packed;
+        cugl::AssetCache::compress(data.data(), size, packed);
+        std::vector<Uint8> unpacked(size);
+        CUAssertLog(cugl::AssetCache::decompress(packed.data(), packed.size(), unpacked.data(), size),
+                    "Block of size %zu failed to decompress", size);
+        CUAssertLog(std::equal(unpacked.begin(), unpacked.end(), data.begin()),
+                    "Block of size %zu is incorrect", size);
+        if (size > 0) {
+            CUAssertLog(!cugl::AssetCache::decompress(packed.data(), packed.size()-1, unpacked.data(), size),
+                        "Truncated block of size %zu was accepted", size);
+        }
+    }
+    
+    std::string text = "{\"name\":\"level\",\"size\":[8,-3,2.5],\"flags\":{\"on\":true,\"off\":false},\"none\":null}";
+    std::shared_ptr<cugl::JsonValue> json = cugl::JsonValue::allocWithJson(text);
+    std::vector<Uint8> binary;
+    json->toBinary(binary);
+    std::shared_ptr<cugl::JsonValue> copy = cugl::JsonValue::allocWithBinary(binary.data(), binary.size());
+    CUAssertLog(copy != nullptr, "Binary JSON failed to decode");
+    CUAssertLog(copy->toString(false) == json->toString(false), "Binary JSON is incorrect");
+    CUAssertLog(cugl::JsonValue::allocWithBinary(binary.data(), binary.size()-1) == nullptr,
+                "Truncated binary JSON was accepted");
+    CULog("AssetCache tests complete.\n");
+}
+
+/**
+ * Benchmarks the game startup with a cold and a warm asset cache.
+ *
+ * This loads the asset directory and the realm directories synchronously,
+ * as the game does before the menu is interactive.  The first pass clears
+ * the cache, so every entry is a miss that is decoded and written.  The
+ * second pass reads every entry back.  Sounds are not cached, and so they
+ * are not loaded.  The application asset directory must be the one of
+ * the game, and there must be an OpenGL context.
+ */
+void benchStartup() {
+    CULog("Running benchmarks for the asset cache.");
+    const char* names[] = { "Cold", "Warm" };
+    for(int pass = 0; pass < 2; pass++) {
+        std::shared_ptr<cugl::AssetManager> assets = cugl::AssetManager::alloc();
+        assets->attach<cugl::Font>(cugl::FontLoader::alloc()->getHook());
+        assets->attach<cugl::Texture>(cugl::TextureLoader::alloc()->getHook());
+        assets->attach<cugl::Node>(cugl::SceneLoader::alloc()->getHook());
+        std::shared_ptr<cugl::AssetCache> cache = assets->getCache();
+        if (cache == nullptr) {
+            CULogError("The asset manager has no cache");
+            return;
+        }
+        if (pass == 0) {
+            cache->clear();
+        }
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        assets->loadDirectory("json/assets.json");
+        for(int realm = 0; realm < 3; realm++) {
+            assets->loadDirectory("json/realm"+cugl::to_string(realm)+".json");
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double millis = std::chrono::duration_cast<std::chrono::microseconds>(end-start).count()/1000.0;
+        CULog("%s start: %.1f ms (cache hits %u, misses %u)", names[pass], millis,
+              cache->getHits(), cache->getMisses());
+        assets->dispose();
+    }
+    CULog("Asset cache benchmarks complete.\n");
+}
+
+/**
+ * A loader of integers, where each integer is its own size in bytes
+ *
+ * Each asset also stores its half under the key with suffix "_half".  Like
+ * an atlas region, this half has no residency record of its own.
+ */
+class BudgetLoader : public cugl::Loader<int> {
+public:
+    /** The number of times an asset was read */
+    int reads = 0;
+    
+protected:
+    bool read(const std::string& key, const std::string& source,
+              cugl::LoaderCallback callback, bool async) override {
+        if (_assets.find(key) != _assets.end()) {
+            return false;
+        }
+        reads++;
+        _assets[key] = std::make_shared<int>(atoi(source.c_str()));
+        _assets[key+"_half"] = std::make_shared<int>(atoi(source.c_str())/2);
+        return true;
+    }
+    
+    bool read(const std::shared_ptr<cugl::JsonValue>& json,
+              cugl::LoaderCallback callback, bool async) override {
+        return read(json->key(), json->asString(), callback, async);
+    }
+    
+    size_t footprint(const std::shared_ptr<int>& asset) const override {
+        return (size_t)*asset;
+    }
+};
+
+/**
+ * Tests the memory budget and LRU eviction of the asset loaders.
+ */
+void testAssetBudget() {
+    CULog("Running tests for asset budgets.");
+    std::shared_ptr<BudgetLoader> loader = std::make_shared<BudgetLoader>();
+    loader->load("a", "100");
+    loader->load("b", "100");
+    loader->load("c", "100");
+    CUAssertLog(loader->getMemory() == 300, "Memory is incorrect");
+    
+    loader->get("a");
+    std::shared_ptr<int> held = loader->get("b");
+    loader->setBudget(200);
+    CUAssertLog(loader->getMemory() == 200 && !loader->contains("c"), "Least recent asset was not evicted");
+    CUAssertLog(loader->contains("a") && loader->contains("b"), "Recent asset was evicted");
+    
+    held = nullptr;
+    loader->load("d", "100");
+    CUAssertLog(!loader->contains("a") && loader->contains("b") && loader->contains("d"),
+                "Eviction order is incorrect");
+    int reads = loader->reads;
+    std::shared_ptr<int> c = loader->get("c");
+    CUAssertLog(c != nullptr && *c == 100 && loader->reads == reads+1, "Evicted asset was not reloaded");
+    CUAssertLog(!loader->contains("b") && loader->getMemory() == 200, "Reload did not respect the budget");
+    
+    CUAssertLog(loader->unload("b") && loader->get("b") == nullptr, "Evicted asset was not unloaded");
+    c = nullptr;
+    CUAssertLog(loader->unload("c") && loader->getMemory() == 100, "Unload did not release memory");
+    loader->unloadAll();
+    CUAssertLog(loader->getMemory() == 0, "Memory was not released");
+    CULog("Asset budget tests complete.\n");
+}
+
+/**
+ * Tests that asset handles follow their asset across unloads and reloads.
+ */
+void testAssetHandle() {
+    CULog("Running tests for asset handles.");
+    std::shared_ptr<BudgetLoader> loader = std::make_shared<BudgetLoader>();
+    cugl::AssetHandle<int> handle = loader->resolve("a");
+    CUAssertLog(handle.isValid() && handle.key() == "a", "Handle is invalid");
+    CUAssertLog(handle.get() == nullptr, "Handle to a missing asset is not null");
+    loader->load("a", "50");
+    CUAssertLog(handle.get() != nullptr && *handle.get() == 50, "Handle did not find the loaded asset");
+    CUAssertLog(loader->resolve("a") == handle, "Key resolved to a different handle");
+    
+    loader->setBudget(60);
+    loader->load("b", "50");
+    CUAssertLog(!loader->contains("a"), "Handle kept the asset from being evicted");
+    CUAssertLog(*handle.get() == 50 && !loader->contains("b"), "Handle did not reload an evicted asset");
+    
+    loader->unload("a");
+    CUAssertLog(handle.get() == nullptr, "Handle to an unloaded asset is not null");
+    loader->load("a", "70");
+    CUAssertLog(*handle.get() == 70, "Handle did not find the new asset");
+    cugl::AssetHandle<int> region = loader->resolve("a_half");
+    CUAssertLog(region.get() != nullptr && *region.get() == 35, "Handle did not find the region");
+    loader->unload("a_half");
+    CUAssertLog(region.get() == nullptr, "Handle to an unloaded region is not null");
+    for(int ii = 0; ii < 1000; ii++) {
+        loader->resolve("key"+cugl::to_string(ii));
+    }
+    CUAssertLog(loader->get("a") == handle.get(), "Handle is out of date");
+    loader = nullptr;
+    CUAssertLog(!handle.isValid() && handle.get() == nullptr, "Handle outlived its loader");
+    CULog("Asset handle tests complete.\n");
+}
+
+/**
+ * Tests that adding a child invalidates the cached bounds of its new parent.
+ *
+ * The group is first rendered off-screen, so that its cached bounds are
+ * culled.  A child added on-screen must then be drawn.  It must run with
+ * an OpenGL context.
+ */
+void testSubtreeBounds() {
+    CULog("Running tests for subtree bounds.");
+    std::shared_ptr<cugl::SpriteBatch> batch = cugl::SpriteBatch::alloc();
+    std::shared_ptr<cugl::Scene> scene = cugl::Scene::alloc(1024, 576);
+    std::shared_ptr<cugl::Node> group = cugl::Node::allocWithPosition(cugl::Vec2(5000, 5000));
+    group->setAnchor(cugl::Vec2::ZERO);
+    group->addChild(cugl::Node::allocWithBounds(0, 0, 10, 10));
+    scene->addChild(group);
+    scene->render(batch);
+    CUAssertLog(scene->getNodesDrawn() == 0, "Off-screen group was drawn");
+    
+    // This child is already dirty when it is added
+    group->addChild(cugl::Node::allocWithBounds(-4900, -4900, 10, 10));
+    scene->render(batch);
+    CUAssertLog(scene->getNodesDrawn() == 2, "On-screen child was culled");
+    CULog("Subtree bounds tests complete.\n");
+}
+
+/**
+ * Tests that a static subtree draws from its mesh until it changes.
+ *
+ * The layer mimics the PlayMode background: a full screen image with
+ * a framed panel on top.  It must run with an OpenGL context.
+ */
+void testStaticNode() {
+    CULog("Running tests for static nodes.");
+    std::vector<Uint32> pixels(16*16, 0xffffffff);
+    std::shared_ptr<cugl::Texture> texture = cugl::Texture::allocWithData(pixels.data(), 16, 16);
+    std::shared_ptr<cugl::SpriteBatch> batch = cugl::SpriteBatch::alloc();
+    std::shared_ptr<cugl::Scene> scene = cugl::Scene::alloc(1024, 576);
+    std::shared_ptr<cugl::PolygonNode> background = cugl::PolygonNode::allocWithTexture(texture);
+    background->setAnchor(cugl::Vec2::ZERO);
+    background->setContentSize(1024, 576);
+    std::shared_ptr<cugl::PolygonNode> frame = cugl::PolygonNode::allocWithTexture(texture);
+    frame->setContentSize(512, 128);
+    frame->setPosition(512, 500);
+    background->addChild(frame);
+    background->setStatic(true);
+    scene->addChild(background);
+    
+    scene->render(batch);
+    CUAssertLog(background->isStatic(), "Node is not static");
+    scene->render(batch);
+    CUAssertLog(scene->getNodesDrawn() == 1, "Static layer was not drawn from its mesh");
+    
+    frame->setPosition(512, 450);
+    scene->render(batch);
+    CUAssertLog(scene->getNodesDrawn() == 3, "Static layer was not baked again after a change");
+    scene->render(batch);
+    CUAssertLog(scene->getNodesDrawn() == 1, "Static layer was baked again without a change");
+    
+    background->setStatic(false);
+    scene->render(batch);
+    CUAssertLog(scene->getNodesDrawn() == 2, "Layer was drawn from its mesh after static was cleared");
+    CULog("Static node tests complete.\n");
+}
+
+/**
+ * Tests that a node drawn outside its scene uses the transform it is given.
+ *
+ * The node lies outside the scene viewport, so the scene culls it.  Drawn
+ * directly with a camera that sees it, it must not be culled, whatever
+ * the address of its transform.  It must run with an OpenGL context.
+ */
+void testRenderTransform() {
+    CULog("Running tests for explicit render transforms.");
+    std::vector<Uint32> pixels(16*16, 0xffffffff);
+    std::shared_ptr<cugl::Texture> texture = cugl::Texture::allocWithData(pixels.data(), 16, 16);
+    std::shared_ptr<cugl::SpriteBatch> batch = cugl::SpriteBatch::alloc();
+    std::shared_ptr<cugl::Scene> scene = cugl::Scene::alloc(1024, 576);
+    std::shared_ptr<cugl::PolygonNode> node = cugl::PolygonNode::allocWithTexture(texture);
+    node->setAnchor(cugl::Vec2::ZERO);
+    node->setContentSize(1024, 576);
+    node->setPosition(4096, 0);
+    scene->addChild(node);
+    scene->render(batch);
+    CUAssertLog(scene->getNodesDrawn() == 0, "Offscreen node was not culled");
+    
+    cugl::Mat4 view;
+    cugl::Mat4::multiply(cugl::Mat4::createTranslation(cugl::Vec3(-4096, 0, 0)),
+                         scene->getCamera()->getCombined(), &view);
+    batch->begin(view);
+    node->render(batch);
+    batch->end();
+    CUAssertLog(batch->getCallsMade() == 1, "Node drawn with the identity transform was culled");
+    
+    cugl::Mat4 identity = cugl::Mat4::IDENTITY;
+    batch->begin(view);
+    node->render(batch, identity, cugl::Color4::WHITE);
+    batch->end();
+    CUAssertLog(batch->getCallsMade() == 1, "Node drawn with a copy of the identity was culled");
+    CULog("Explicit render transform tests complete.\n");
+}
+
+/**
+ * Tests that instanced sprites leave no vertex array state for the next pass.
+ *
+ * Each pass ends with instanced sprites, and the next one starts by binding
+ * the shader.  A static layer is then drawn from its mesh after an instanced
+ * pass.  It must run with an OpenGL context.
+ */
+void testInstanceState() {
+    CULog("Running tests for sprite instance state.");
+    std::vector<Uint32> pixels(16*16, 0xff0000ff);
+    std::shared_ptr<cugl::Texture> texture = cugl::Texture::allocWithData(pixels.data(), 16, 16);
+    std::shared_ptr<cugl::SpriteBatch> batch = cugl::SpriteBatch::alloc();
+    batch->setInstancing(true);
+    std::shared_ptr<cugl::Scene> scene = cugl::Scene::alloc(1024, 576);
+    std::shared_ptr<cugl::PolygonNode> sprite = cugl::PolygonNode::allocWithTexture(texture);
+    sprite->setAnchor(cugl::Vec2::ZERO);
+    sprite->setContentSize(1024, 576);
+    scene->addChild(sprite);
+    
+    // Clear errors left by earlier tests so they are not blamed on this one
+    while (glGetError() != GL_NO_ERROR) {}
+    GLubyte color[4];
+    GLint array;
+    for(int ii = 0; ii < 3; ii++) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        scene->render(batch);
+        CUAssertLog(glGetError() == GL_NO_ERROR, "Instanced pass %d raised a GL error", ii);
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &array);
+        CUAssertLog(array == 0, "Instanced pass %d left a vertex array bound", ii);
+        glReadPixels(512, 288, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color);
+        CUAssertLog(color[0] == 255 && color[1] == 0, "Instanced pass %d did not draw the sprite", ii);
+    }
+    
+    std::shared_ptr<cugl::PolygonNode> layer = cugl::PolygonNode::allocWithTexture(texture);
+    layer->setAnchor(cugl::Vec2::ZERO);
+    layer->setContentSize(512, 576);
+    layer->addChild(cugl::PolygonNode::allocWithTexture(texture));
+    layer->setStatic(true);
+    scene->addChild(layer);
+    for(int ii = 0; ii < 3; ii++) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        scene->render(batch);
+        CUAssertLog(glGetError() == GL_NO_ERROR, "Static pass %d raised a GL error", ii);
+        glReadPixels(256, 288, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color);
+        CUAssertLog(color[0] == 255 && color[1] == 0, "Static pass %d did not draw the layer", ii);
+    }
+    CUAssertLog(scene->getNodesDrawn() == 2, "Static layer was not drawn from its mesh");
+    CULog("Sprite instance state tests complete.\n");
+}
+
+/**
+ * Benchmarks the draw calls of a game board with and without the board atlas.
+ *
+ * The board is 8x8 tiles, each from one of the 7 tile strips, with a pawn
+ * on every other cell.  Loose textures give each of the 22 board sheets a
+ * texture of its own, while the atlas places them in the 7 pages of the
+ * board atlas.  This reports the draw calls and time per frame, with and
+ * without texture slots.  It must run with an OpenGL context.
+ */
+void benchBoardBatch() {
+    CULog("Running benchmarks for the board atlas.");
+    const int sheets = 22;
+    const int pages  = 7;
+    const int frames = 200;
+    std::vector<Uint32> pixels(256*256, 0xffffffff);
+    std::vector<std::shared_ptr<cugl::Texture>> loose;
+    std::vector<std::shared_ptr<cugl::Texture>> atlas;
+    std::vector<std::shared_ptr<cugl::Texture>> paged;
+    for(int ii = 0; ii < pages; ii++) {
+        paged.push_back(cugl::Texture::allocWithData(pixels.data(), 256, 256));
+    }
+    for(int ii = 0; ii < sheets; ii++) {
+        float s = (ii/pages % 2)*0.5f;
+        float t = (ii/pages / 2)*0.5f;
+        loose.push_back(cugl::Texture::allocWithData(pixels.data(), 128, 128));
+        atlas.push_back(paged[ii % pages]->getSubTexture(s, s+0.5f, t, t+0.5f));
+    }
+    
+    std::shared_ptr<cugl::SpriteBatch> batch = cugl::SpriteBatch::alloc();
+    cugl::Mat4 camera = cugl::Mat4::createOrthographicOffCenter(0, 1024, 0, 576, -1, 1);
+    const char* names[] = { "Loose textures", "Board atlas" };
+    for(int slots = 0; slots < 2; slots++) {
+        batch->setMultiTexture(slots == 1);
+        for(int mode = 0; mode < 2; mode++) {
+            std::vector<std::shared_ptr<cugl::Texture>>& textures = (mode == 0 ? loose : atlas);
+            Uint32 seed = 1;
+            unsigned int calls = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for(int frame = 0; frame < frames; frame++) {
+                batch->begin(camera);
+                for(int cell = 0; cell < 64; cell++) {
+                    cugl::Rect bounds(64*(cell % 8), 64*(cell / 8), 64, 64);
+                    seed = seed*1664525+1013904223;
+                    batch->draw(textures[(seed >> 16) % 7], bounds);
+                    if (cell % 2 == 0) {
+                        batch->draw(textures[7+(seed >> 8) % (sheets-7)], bounds);
+                    }
+                }
+                batch->end();
+                calls += batch->getCallsMade();
+            }
+            glFinish();
+            auto end = std::chrono::high_resolution_clock::now();
+            double micros = std::chrono::duration_cast<std::chrono::microseconds>(end-start).count();
+            CULog("%s, %s: %.1f draw calls, %.3f ms per frame", names[mode],
+                  (slots ? "texture slots" : "no slots"), calls/(float)frames, micros/frames/1000);
+        }
+    }
+    CULog("Board atlas benchmarks complete.\n");
+}
+
+/**
+ * Compares the draw calls of a PlayMode frame with and without texture slots.
+ *
+ * The frame is drawn in scene order: the realm background, the board (7
+ * atlas pages) with its pawns, the touch indicator, and then the HUD, whose
+ * buttons, star icons and font labels are all separate textures.
+ * It must run with an OpenGL context.
+ */
+void benchTextureSlots() {
+    CULog("Running benchmarks for texture slots.");
+    const int frames = 200;
+    std::vector<Uint32> pixels(64*64, 0xffffffff);
+    auto make = [&] { return cugl::Texture::allocWithData(pixels.data(), 64, 64); };
+    std::vector<std::shared_ptr<cugl::Texture>> board;
+    std::vector<std::shared_ptr<cugl::Texture>> stars;
+    for(int ii = 0; ii < 7; ii++) {
+        board.push_back(make());
+    }
+    for(int ii = 0; ii < 3; ii++) {
+        stars.push_back(make());
+    }
+    std::shared_ptr<cugl::Texture> background = make();
+    std::shared_ptr<cugl::Texture> touch = make();
+    std::shared_ptr<cugl::Texture> button = make();
+    std::shared_ptr<cugl::Texture> sound  = make();
+    std::shared_ptr<cugl::Texture> glyphs = make();
+    
+    std::shared_ptr<cugl::SpriteBatch> batch = cugl::SpriteBatch::alloc();
+    cugl::Mat4 camera = cugl::Mat4::createOrthographicOffCenter(0, 1024, 0, 576, -1, 1);
+    unsigned int calls[2];
+    for(int slots = 0; slots < 2; slots++) {
+        batch->setMultiTexture(slots == 1);
+        Uint32 seed = 1;
+        calls[slots] = 0;
+        for(int frame = 0; frame < frames; frame++) {
+            batch->begin(camera);
+            batch->draw(background, cugl::Rect(0, 0, 1024, 576));
+            for(int cell = 0; cell < 64; cell++) {
+                cugl::Rect bounds(256+64*(cell % 8), 64*(cell / 8), 64, 64);
+                seed = seed*1664525+1013904223;
+                batch->draw(board[(seed >> 16) % 7], bounds);
+                if (cell % 2 == 0) {
+                    batch->draw(board[(seed >> 8) % 7], bounds);
+                }
+            }
+            batch->draw(touch, cugl::Rect(300, 300, 64, 64));
+            batch->draw(button, cugl::Rect(16, 500, 64, 64));
+            batch->draw(sound, cugl::Rect(96, 500, 64, 64));
+            for(int ii = 0; ii < 3; ii++) {
+                batch->draw(stars[ii], cugl::Rect(16, 400-64*ii, 32, 32));
+                for(int jj = 0; jj < 8; jj++) {
+                    batch->draw(glyphs, cugl::Rect(56+12*jj, 400-64*ii, 12, 24));
+                }
+            }
+            batch->end();
+            calls[slots] += batch->getCallsMade();
+        }
+    }
+    CULog("Draw calls per frame: %.1f without slots, %.1f with slots",
+          calls[0]/(float)frames, calls[1]/(float)frames);
+    CULog("Texture slot benchmarks complete.\n");
+}
+
+/**
+ * Benchmarks the packed vertex layout of SpriteBatch on 10k sprites.
+ *
+ * The sprites are rotated so that they are drawn as meshes, not instances.
+ * This reports the bytes uploaded and the time per frame for each vertex
+ * layout.  It must run with an OpenGL context.
+ */
+void benchPackedVertices() {
+    CULog("Running benchmarks for packed vertices.");
+    // The largest capacity whose ring of packed vertices has 16-bit indices
+    std::shared_ptr<cugl::SpriteBatch> check = cugl::SpriteBatch::alloc(13107);
+    CUAssertLog(check->usesShortIndices(), "Ring of 13107 vertices should use 16-bit indices");
+    check = cugl::SpriteBatch::alloc(16384);
+    CUAssertLog(!check->usesShortIndices(), "Ring of 16384 vertices should use 32-bit indices");
+    check = nullptr;
+    
+    const int sprites = 10000;
+    const int frames  = 100;
+    std::vector<Uint32> pixels(16*16, 0xffffffff);
+    std::shared_ptr<cugl::Texture> texture = cugl::Texture::allocWithData(pixels.data(), 16, 16);
+    std::shared_ptr<cugl::SpriteBatch> batch = cugl::SpriteBatch::alloc();
+    cugl::Mat4 camera = cugl::Mat4::createOrthographicOffCenter(0, 1024, 0, 576, -1, 1);
+    for(int packed = 0; packed < 2; packed++) {
+        batch->setPacked(packed == 1);
+        size_t bytes = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for(int frame = 0; frame < frames; frame++) {
+            batch->begin(camera);
+            for(int ii = 0; ii < sprites; ii++) {
+                cugl::Affine2 transform;
+                transform.rotate(ii*0.01f);
+                transform.translate((float)(ii % 100)*10, (float)(ii / 100)*5);
+                batch->draw(texture, cugl::Vec2(8, 8), transform);
+            }
+            batch->end();
+            bytes += batch->getBytesUploaded();
+        }
+        glFinish();
+        auto end = std::chrono::high_resolution_clock::now();
+        double micros = std::chrono::duration_cast<std::chrono::microseconds>(end-start).count();
+        CULog("%s vertices, %s indices: %.1f KB uploaded, %.3f ms per frame",
+              (packed ? "Packed" : "Full"), (batch->usesShortIndices() ? "16-bit" : "32-bit"),
+              bytes/1024.0/frames, micros/frames/1000);
+    }
+    CULog("Packed vertex benchmarks complete.\n");
+}
+
+/**
+ * Tests the scheduled callbacks of the application over several frames.
+ *
+ * @param app   The running application
+ */
+void testSchedule(cugl::Application& app) {
+    CULog("Running tests for Application::schedule.");
+    int once = 0;
+    int repeats = 0;
+    int cancelled = 0;
+    std::atomic<int> posted(0);
+    app.schedule([&] { once++; return false; });
+    app.schedule([&] { repeats++; return repeats < 3; }, 20);
+    Uint32 id = app.schedule([&] { cancelled++; return false; }, 50);
+    Uint32 far = app.schedule([&] { cancelled++; return false; }, 20000000);
+    app.unschedule(id);
+    std::thread thread([&] {
+        for(int ii = 0; ii < 1000; ii++) {
+            app.schedule([&] { posted++; return false; }, ii % 100);
+        }
+    });
+    thread.join();
+    
+    Uint32 start = SDL_GetTicks();
+    while (SDL_GetTicks()-start < 500) {
+        app.step();
+    }
+    app.unschedule(far);
+    app.step();
+    CUAssertLog(once == 1, "One-time callback ran %d times", once);
+    CUAssertLog(repeats == 3, "Periodic callback ran %d times", repeats);
+    CUAssertLog(cancelled == 0, "Unscheduled callback ran");
+    CUAssertLog(posted == 1000, "Only %d callbacks from another thread ran", posted.load());
+    CULog("Application::schedule tests complete.\n");
+}
 
 int main() {
     cugl::Application app;
@@ -183,6 +1058,22 @@ int main() {
     //cugl::sceneUnitTest();
     //testBinary();
     //testFree();
+    //benchTextureDecode("../../assets/");
+    //testTextureContainer();
+    //testAssetCache();
+    //benchStartup();
+    //testAssetBudget();
+    //testAssetHandle();
+    //testTaskGroup();
+    //benchThreadPool(4);
+    //testSchedule(app);
+    //testSubtreeBounds();
+    //testStaticNode();
+    //testInstanceState();
+    //testRenderTransform();
+    //benchBoardBatch();
+    //benchPackedVertices();
+    //benchTextureSlots();
     testThread();
     
 #if SDL_BYTEORDER == SDL_LIL_ENDIAN
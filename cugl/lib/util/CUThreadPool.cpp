@@ -1,14 +1,22 @@
 //
-//  CUThreadPool.h
+//  CUThreadPool.cpp
 //  Cornell University Game Library (CUGL)
 //
 //  Module for a pool of threads capable of executing asynchronous tasks.  Each
 //  task is specified by a void function.  There are no guarantees about thread
 //  safety; that is responsibility of the author of each task.
 //
-//  This code is largely inspired from the Cocos2d file AudioEngine.cpp, from
-//  the code for asynchronous asset loading. We generalized that class added
-//  some notable safety changes.
+//  The pool is a work-stealing scheduler.  Each worker has its own deques of
+//  tasks (one per priority), and tasks spawned by a worker go to the back of
+//  its own deque without any locking.  An idle worker steals from the front of
+//  the others' deques, and tasks from other threads go in a shared queue.
+//  Workers with nothing to do sleep until a task arrives.  Tasks may belong to
+//  a group, which can be waited on or followed by continuation tasks.
+//
+//  This code was originally inspired by the Cocos2d file AudioEngine.cpp, from
+//  the code for asynchronous asset loading.  The deques follow Chase and Lev,
+//  "Dynamic Circular Work-Stealing Deque", with the memory orders of Le et al.,
+//  "Correct and Efficient Work-Stealing for Weak Memory Models".
 //
 //  CUGL zlib License:
 //      This software is provided 'as-is', without any express or implied
@@ -33,22 +41,309 @@
 //  Version: 11/29/16
 //
 #include <cugl/util/CUThreadPool.h>
+#include <algorithm>
 
 using namespace cugl;
 
+/** The initial capacity of a worker deque (a power of two) */
+#define DEQUE_CAPACITY  64
+
+#pragma mark -
+#pragma mark Work-Stealing Deque
+
+namespace {
+
+/**
+ * A Chase-Lev work-stealing deque of task pointers.
+ *
+ * Only the owning worker may push or pop, at the bottom.  Any thread may
+ * steal, at the top.  The buffer grows as needed; old buffers are kept
+ * until the deque is deleted, as a thief may still be reading one.
+ */
+template <typename T>
+class WorkDeque {
+private:
+    /** A circular buffer of task pointers */
+    class Buffer {
+    public:
+        /** The capacity (a power of two) */
+        Sint64 capacity;
+        /** The slots */
+        std::unique_ptr<std::atomic<T*>[]> slots;
+
+        Buffer(Sint64 size) : capacity(size), slots(new std::atomic<T*>[size]) {}
+
+        T* get(Sint64 index) const {
+            return slots[index & (capacity-1)].load(std::memory_order_relaxed);
+        }
+
+        void put(Sint64 index, T* value) {
+            slots[index & (capacity-1)].store(value, std::memory_order_relaxed);
+        }
+    };
+
+    /** The index of the oldest task (where thieves steal) */
+    std::atomic<Sint64> _top;
+    /** The index after the newest task (where the owner pushes and pops) */
+    std::atomic<Sint64> _bottom;
+    /** The current buffer */
+    std::atomic<Buffer*> _buffer;
+    /** Every buffer allocated, including the current one */
+    std::vector<std::unique_ptr<Buffer>> _buffers;
+
+public:
+    WorkDeque() : _top(0), _bottom(0) {
+        _buffers.emplace_back(new Buffer(DEQUE_CAPACITY));
+        _buffer.store(_buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    /**
+     * Adds a task at the bottom of the deque (owner only)
+     *
+     * @param task  The task to add
+     */
+    void push(T* task) {
+        Sint64 b = _bottom.load(std::memory_order_relaxed);
+        Sint64 t = _top.load(std::memory_order_acquire);
+        Buffer* buffer = _buffer.load(std::memory_order_relaxed);
+        if (b-t > buffer->capacity-1) {
+            Buffer* bigger = new Buffer(buffer->capacity*2);
+            for(Sint64 ii = t; ii < b; ii++) {
+                bigger->put(ii, buffer->get(ii));
+            }
+            _buffers.emplace_back(bigger);
+            _buffer.store(bigger, std::memory_order_release);
+            buffer = bigger;
+        }
+        buffer->put(b, task);
+        _bottom.store(b+1, std::memory_order_release);
+    }
+
+    /**
+     * Returns the task at the bottom of the deque, or nullptr if empty (owner only)
+     *
+     * @return the task at the bottom of the deque
+     */
+    T* pop() {
+        Sint64 b = _bottom.load(std::memory_order_relaxed)-1;
+        Buffer* buffer = _buffer.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        Sint64 t = _top.load(std::memory_order_relaxed);
+
+        T* result = nullptr;
+        if (t <= b) {
+            result = buffer->get(b);
+            if (t == b) {
+                // The last task; race the thieves for it
+                if (!_top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed)) {
+                    result = nullptr;
+                }
+                _bottom.store(b+1, std::memory_order_relaxed);
+            }
+        } else {
+            _bottom.store(b+1, std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    /**
+     * Returns the task at the top of the deque, or nullptr if there is none
+     *
+     * A steal may fail because of another thread, in which case retry is
+     * set to true and the deque may still have tasks.
+     *
+     * @param retry Set to true if the steal lost a race
+     *
+     * @return the task at the top of the deque
+     */
+    T* steal(bool& retry) {
+        Sint64 t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        Sint64 b = _bottom.load(std::memory_order_acquire);
+        if (t < b) {
+            Buffer* buffer = _buffer.load(std::memory_order_acquire);
+            T* result = buffer->get(t);
+            if (!_top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                retry = true;
+                return nullptr;
+            }
+            return result;
+        }
+        return nullptr;
+    }
+};
+
+}
+
+#pragma mark -
+#pragma mark Tasks and Workers
+
+/**
+ * A task waiting to run
+ */
+class ThreadPool::Task {
+public:
+    /** The task function */
+    std::function<void()> function;
+    /** The group of the task (may be nullptr) */
+    std::shared_ptr<TaskGroup> group;
+};
+
+/**
+ * A worker thread and its deques
+ */
+class ThreadPool::Worker {
+public:
+    /** The pool of this worker */
+    ThreadPool* pool;
+    /** The tasks spawned by this worker, by priority */
+    WorkDeque<Task> deques[PRIORITIES];
+    /** The state of the random number generator for choosing a victim */
+    Uint32 seed;
+    /** The worker thread */
+#ifdef CU_SDL_THREADS
+    SDL_Thread* thread;
+#else
+    std::thread thread;
+#endif
+
+    /**
+     * Returns a random number for choosing a victim (xorshift)
+     *
+     * @return a random number for choosing a victim
+     */
+    Uint32 random() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+};
+
+/** The worker of the current thread */
+thread_local ThreadPool::Worker* ThreadPool::_current = nullptr;
+
+#pragma mark -
+#pragma mark Task Group
+/**
+ * Records that a task of this group has finished.
+ *
+ * If this was the last task, the waiting threads are woken up and the
+ * continuations are scheduled.
+ */
+void TaskGroup::finish() {
+    if (_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    std::vector<Continuation> ready;
+    std::vector<ThreadPool*> parked;
+    {
+        std::unique_lock<std::mutex> lk(_mutex);
+        ready.swap(_continuations);
+        parked = _parked;
+        _condition.notify_all();
+    }
+    
+    // Waiting workers sleep with the idle ones, so wake them all to check
+    std::sort(parked.begin(), parked.end());
+    parked.erase(std::unique(parked.begin(), parked.end()), parked.end());
+    for(auto it = parked.begin(); it != parked.end(); ++it) {
+        std::unique_lock<std::mutex> lk((*it)->_sleepMutex);
+        (*it)->_taskCondition.notify_all();
+    }
+    for(auto it = ready.begin(); it != ready.end(); ++it) {
+        ThreadPool::Task* task = new ThreadPool::Task();
+        task->function = std::move(it->task);
+        task->group = it->group;
+        it->pool->submit(task, it->priority);
+    }
+}
+
+/**
+ * Blocks until every task in this group has finished.
+ *
+ * If this is called by a worker thread, the worker runs other tasks of
+ * its pool while it waits, so that waiting inside a task cannot starve
+ * the pool.  When there are none, it sleeps with the idle workers until
+ * either a task arrives or the group is done.  Any other thread sleeps
+ * until the group is done.
+ */
+void TaskGroup::wait() {
+    ThreadPool::Worker* worker = ThreadPool::_current;
+    if (worker == nullptr) {
+        std::unique_lock<std::mutex> lk(_mutex);
+        _condition.wait(lk, [this] { return _pending.load() == 0; });
+        return;
+    }
+
+    // A stopping pool discards the remaining tasks, so do not wait for them
+    ThreadPool* pool = worker->pool;
+    while (_pending.load() > 0 && !pool->isStopped()) {
+        ThreadPool::Task* task = pool->next(worker);
+        if (task == nullptr) {
+            // Look once more after reading the signal, so no task is missed
+            Uint64 seen = pool->_signal.load();
+            task = pool->next(worker);
+            if (task == nullptr) {
+                // Register before checking the count, so finish cannot miss us
+                {
+                    std::unique_lock<std::mutex> lk(_mutex);
+                    _parked.push_back(pool);
+                }
+                {
+                    std::unique_lock<std::mutex> lk(pool->_sleepMutex);
+                    pool->_sleeping++;
+                    while (_pending.load() > 0 && pool->_signal.load() == seen && !pool->_stop.load()) {
+                        pool->_taskCondition.wait(lk);
+                    }
+                    pool->_sleeping--;
+                }
+                {
+                    std::unique_lock<std::mutex> lk(_mutex);
+                    _parked.erase(std::find(_parked.begin(), _parked.end(), pool));
+                }
+                continue;
+            }
+        }
+        pool->execute(task);
+    }
+}
+
+
 #pragma mark -
 #pragma mark Constructors
+/**
+ * Creates a thread pool with no active threads.
+ *
+ * You must initialize this thread pool before use.
+ *
+ * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate a thread pool
+ * on the heap, use one of the static constructors instead.
+ */
+ThreadPool::ThreadPool() : _signal(0), _sleeping(0), _searching(0), _stop(false), _active(0) {
+    for(int ii = 0; ii < PRIORITIES; ii++) {
+        _queued[ii].store(0);
+    }
+}
+
 /**
  * Disposes this thread pool, releasing all memory.
  *
- * A disposed thread pool can be safely reinitialized. However, it is a bad
- * idea to destroy the thread pool if the pool is not yet shut down. The
- * task queue is shared by the child threads, so we cannot delete it until
- * all the threads complete.  This destructor will block unti showndown.
+ * This method blocks until the workers have finished their current tasks.
+ * Tasks that have not started are discarded.  A disposed thread pool can
+ * be safely reinitialized.
  */
 void ThreadPool::dispose() {
     stop();
-    while (!isShutdown());
+    for(auto it = _workers.begin(); it != _workers.end(); ++it) {
+        delete *it;
+    }
+    _workers.clear();
+    _stop = false;
 }
 
 /**
@@ -63,11 +358,23 @@ void ThreadPool::dispose() {
  * @return true if the threed pool is initialized properly, false otherwise.
  */
 bool ThreadPool::init(int threads) {
+    if (!_workers.empty()) {
+        return false;
+    }
+
+    // Workers steal from each other, so they must all exist before any starts
     for (int index = 0; index < threads; ++index) {
+        Worker* worker = new Worker();
+        worker->pool = this;
+        worker->seed = 2463534242u+index*2654435761u;
+        _workers.push_back(worker);
+    }
+    _active = threads;
+    for (auto it = _workers.begin(); it != _workers.end(); ++it) {
 #ifdef CU_SDL_THREADS
-        _workers.emplace_back(SDL_CreateThread(ThreadPool::sdlThreadFunc,"Pool Dispatch",(void*)this));
+        (*it)->thread = SDL_CreateThread(ThreadPool::sdlThreadFunc,"Pool Dispatch",(void*)(*it));
 #else
-        _workers.emplace_back(std::thread(std::bind(&ThreadPool::threadFunc, this)));
+        (*it)->thread = std::thread(std::bind(&ThreadPool::threadFunc, this, *it));
 #endif
     }
     return true;
@@ -76,110 +383,313 @@ bool ThreadPool::init(int threads) {
 
 #pragma mark -
 #pragma mark Thread Execution
-
 /**
- * The body function of a single thread.
+ * The body function of a single worker.
  *
- * This function pulls tasks from the task queue.
+ * This function runs tasks until the pool stops, sleeping when there
+ * is nothing to do.
  *
- * This implementation is safe to use with std::thread.
+ * @param worker    The worker for this thread
  */
-void ThreadPool::threadFunc() {
-    while (!_stop) {
-        std::function<void()> task = nullptr;
-        {   // Lock for save queue access
-            std::unique_lock<std::mutex> lk(_queueMutex);
-            if (_stop) {
-                break;
+void ThreadPool::run(Worker* worker) {
+    _current = worker;
+    bool searching = true;
+    _searching++;
+    while (!_stop.load()) {
+        Task* task = next(worker);
+        if (task == nullptr) {
+            if (!searching) {
+                searching = true;
+                _searching++;
             }
-            // Pull the next task off the queue
-            if (!_taskQueue.empty()) {
-                task = std::move(_taskQueue.front());
-                _taskQueue.pop();
-            } else {
-                _taskCondition.wait(lk);
+            // Look once more after reading the signal, so no task is missed
+            Uint64 seen = _signal.load();
+            task = next(worker);
+            if (task == nullptr) {
+                searching = false;
+                _searching--;
+                std::unique_lock<std::mutex> lk(_sleepMutex);
+                _sleeping++;
+                while (_signal.load() == seen && !_stop.load()) {
+                    _taskCondition.wait(lk);
+                }
+                _sleeping--;
+                searching = true;
+                _searching++;
                 continue;
             }
         }
-        // Perform the current task
-        task();
+
+        // The last searcher to find work wakes another, in case there is more
+        if (searching) {
+            searching = false;
+            if (--_searching == 0) {
+                wake();
+            }
+        }
+        execute(task);
+    }
+    if (searching) {
+        _searching--;
     }
-    _complete++;
+    _current = nullptr;
+    _active--;
 }
 
 /**
  * The body function of a single thread.
  *
- * This function pulls tasks from the task queue.
+ * This implementation is safe to use with std::thread.
+ *
+ * @param worker    The worker for this thread
+ */
+void ThreadPool::threadFunc(Worker* worker) {
+    run(worker);
+}
+
+/**
+ * The body function of a single thread.
  *
  * This static implementation uses the SDL thread API.  It should be used
  * on Android and Windows, which have special thread requirements.
+ *
+ * @param ptr   The worker for this thread
+ *
+ * @return 0 when the thread completes
  */
 int ThreadPool::sdlThreadFunc(void* ptr) {
-    ThreadPool* self = (ThreadPool*)ptr;
-    while (!self->_stop) {
-        std::function<void()> task = nullptr;
-        {   // Lock for save queue access
-            std::unique_lock<std::mutex> lk(self->_queueMutex);
-            if (self->_stop) {
-                break;
+    Worker* worker = (Worker*)ptr;
+    worker->pool->run(worker);
+    return 0;
+}
+
+/**
+ * Returns the next task for the given worker, or nullptr if there is none.
+ *
+ * For each priority in turn, the worker takes the newest task of its own
+ * deque, then the oldest task of the shared queue, and then steals the
+ * oldest task of another worker.
+ *
+ * @param worker    The worker looking for a task
+ *
+ * @return the next task for the given worker, or nullptr if there is none.
+ */
+ThreadPool::Task* ThreadPool::next(Worker* worker) {
+    size_t count = _workers.size();
+    for(int priority = 0; priority < PRIORITIES; priority++) {
+        Task* task = worker->deques[priority].pop();
+        if (task != nullptr) {
+            return task;
+        }
+
+        if (_queued[priority].load(std::memory_order_acquire) > 0) {
+            std::unique_lock<std::mutex> lk(_queueMutex);
+            if (!_taskQueue[priority].empty()) {
+                task = _taskQueue[priority].front();
+                _taskQueue[priority].pop_front();
+                _queued[priority]--;
+                return task;
             }
-            // Pull the next task off the queue
-            if (!self->_taskQueue.empty()) {
-                task = std::move(self->_taskQueue.front());
-                self->_taskQueue.pop();
-            } else {
-                self->_taskCondition.wait(lk);
-                continue;
+        }
+
+        bool retry = true;
+        while (retry && count > 1) {
+            retry = false;
+            size_t start = worker->random() % count;
+            for(size_t ii = 0; ii < count; ii++) {
+                Worker* victim = _workers[(start+ii) % count];
+                if (victim != worker) {
+                    task = victim->deques[priority].steal(retry);
+                    if (task != nullptr) {
+                        return task;
+                    }
+                }
             }
         }
-        // Perform the current task
-        task();
     }
-    self->_complete++;
-    return 0;
+    return nullptr;
 }
 
+/**
+ * Runs the given task, and then deletes it.
+ *
+ * @param task  The task to run
+ */
+void ThreadPool::execute(Task* task) {
+    task->function();
+    if (task->group != nullptr) {
+        task->group->finish();
+    }
+    delete task;
+}
+
+/**
+ * Deletes a task without running it.
+ *
+ * The group of the task is still told that it is done.
+ *
+ * @param task  The task to discard
+ */
+void ThreadPool::discard(Task* task) {
+    if (task->group != nullptr) {
+        task->group->finish();
+    }
+    delete task;
+}
 
 
 #pragma mark -
 #pragma mark Task Management
 /**
- * Adds a task to the thread pool.
+ * Schedules the given task, which is already counted by its group.
+ *
+ * The task is discarded if the pool is stopped.
+ *
+ * @param task      The task to schedule
+ * @param priority  The task priority
+ */
+void ThreadPool::submit(Task* task, int priority) {
+    Worker* worker = _current;
+    if (worker != nullptr && worker->pool == this && !_stop.load()) {
+        // Spawned by a worker, so no lock (stop discards leftovers after joining)
+        worker->deques[priority].push(task);
+    } else {
+        std::unique_lock<std::mutex> lk(_queueMutex);
+        if (_stop.load()) {
+            lk.unlock();
+            discard(task);
+            return;
+        }
+        _taskQueue[priority].push_back(task);
+        _queued[priority]++;
+    }
+
+    // A searching worker is sure to see the signal change, so only wake if none
+    _signal++;
+    if (_searching.load() == 0) {
+        wake();
+    }
+}
+
+/**
+ * Wakes a sleeping worker, if there is one.
+ */
+void ThreadPool::wake() {
+    if (_sleeping.load() > 0) {
+        std::unique_lock<std::mutex> lk(_sleepMutex);
+        _taskCondition.notify_one();
+    }
+}
+
+/**
+ * Adds a task with the given priority to the thread pool.
+ *
+ * If a group is specified, the task is counted by that group until it
+ * finishes (or is discarded).  A task added by a worker of this pool
+ * goes in that worker's own deque, and is the next task it runs.
+ *
+ * @param  task     the task function to add to the thread pool
+ * @param  priority the task priority
+ * @param  group    the group of the task (may be nullptr)
+ */
+void ThreadPool::addTask(const std::function<void()> &task, Priority priority,
+                         const std::shared_ptr<TaskGroup>& group) {
+    Task* item = new Task();
+    item->function = task;
+    item->group = group;
+    if (group != nullptr) {
+        group->_pending++;
+    }
+    submit(item, (int)priority);
+}
+
+/**
+ * Adds a task to run once every task in the given group has finished.
  *
- * A task is a void returning function with no parameters.  If you need
- * state in the task, you should use a method call for the state.  The task
- * will not be executed immediately, but must wait for the first available
- * worker.
+ * The continuation is counted by its own group (if any) as soon as it is
+ * added, so waiting on that group also waits for the group before it.  If
+ * the first group is already done, the task is scheduled immediately.
  *
+ * @param  after    the group to wait for
  * @param  task     the task function to add to the thread pool
+ * @param  priority the task priority
+ * @param  group    the group of the continuation (may be nullptr)
  */
-void ThreadPool::addTask(const std::function<void()> &task){
-    std::unique_lock<std::mutex> lk(_queueMutex);
-    _taskQueue.emplace(task);
-    _taskCondition.notify_one();
+void ThreadPool::addContinuation(const std::shared_ptr<TaskGroup>& after,
+                                 const std::function<void()> &task, Priority priority,
+                                 const std::shared_ptr<TaskGroup>& group) {
+    if (group != nullptr) {
+        group->_pending++;
+    }
+    if (after != nullptr) {
+        std::unique_lock<std::mutex> lk(after->_mutex);
+        if (after->_pending.load() > 0) {
+            TaskGroup::Continuation continuation;
+            continuation.pool = this;
+            continuation.task = task;
+            continuation.priority = (int)priority;
+            continuation.group = group;
+            after->_continuations.push_back(continuation);
+            return;
+        }
+    }
+
+    Task* item = new Task();
+    item->function = task;
+    item->group = group;
+    submit(item, (int)priority);
 }
 
 /**
  * Stop the thread pool, marking it for shut down.
  *
- * A stopped thread pool is marked for shutdown, but it shutdown has not
- * necessarily completed.  Shutdown will be complete when the current child
- * threads have finished with their tasks.
+ * This method blocks until every worker has finished its current task.
+ * Tasks that have not started are discarded, and tasks added afterwards
+ * are ignored.
  */
 void ThreadPool::stop() {
     {
         std::unique_lock<std::mutex> lk(_queueMutex);
         _stop = true;
+    }
+    {
+        std::unique_lock<std::mutex> lk(_sleepMutex);
         _taskCondition.notify_all();
     }
-    
-    for (auto&& worker : _workers) {
+
+    for (auto it = _workers.begin(); it != _workers.end(); ++it) {
 #ifdef CU_SDL_THREADS
-        int status;
-        SDL_WaitThread(worker,&status);
+        if ((*it)->thread != nullptr) {
+            int status;
+            SDL_WaitThread((*it)->thread,&status);
+            (*it)->thread = nullptr;
+        }
 #else
-        worker.join();
+        if ((*it)->thread.joinable()) {
+            (*it)->thread.join();
+        }
 #endif
     }
+
+    // No worker is running, so the deques are safe to drain from here
+    std::vector<Task*> leftover;
+    {
+        std::unique_lock<std::mutex> lk(_queueMutex);
+        for(int priority = 0; priority < PRIORITIES; priority++) {
+            leftover.insert(leftover.end(), _taskQueue[priority].begin(), _taskQueue[priority].end());
+            _taskQueue[priority].clear();
+            _queued[priority] = 0;
+        }
+    }
+    for (auto it = _workers.begin(); it != _workers.end(); ++it) {
+        for(int priority = 0; priority < PRIORITIES; priority++) {
+            Task* task;
+            while ((task = (*it)->deques[priority].pop()) != nullptr) {
+                leftover.push_back(task);
+            }
+        }
+    }
+    for(auto it = leftover.begin(); it != leftover.end(); ++it) {
+        discard(*it);
+    }
 }
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+"""
+Builds an asset pack for the CUGL AssetPack class.
+
+The pack holds every file of the given asset directories in a single file,
+so that the game does not open each asset separately.  If a file appears in
+more than one directory, the later directory wins (e.g. a directory of
+generated files can add to the main asset directory).
+
+The layout (all values little-endian) is:
+
+    Header:  the magic "CUPK", the version, the number of entries and the
+             size of the name table (4 bytes each)
+    Index:   40 bytes per entry, sorted by name: the name offset and length
+             (4 bytes each), then the data offset, the stored size, the
+             original size and the BLAKE2b-64 hash of the original (8 bytes each)
+    Names:   the entry names, with '/' separators and no terminators
+    Data:    the entry contents, each starting at a multiple of 16
+
+An entry whose stored size is less than its original size is an LZ4 block.
+Files in formats that are already compressed (e.g. PNG, OGG) are stored as
+is, so that the game can read them in place from the mapped pack.
+
+Usage:  packassets.py [-o assets.pack] [--exclude PATTERN] [--no-compress] DIR...
+"""
+import argparse
+import fnmatch
+import hashlib
+import os
+import struct
+import sys
+
+MAGIC = 0x4B505543
+VERSION = 1
+HEADER = 16
+ENTRY = 40
+ALIGN = 16
+
+# Formats that LZ4 cannot shrink
+PRECOMPRESSED = {'.png', '.jpg', '.jpeg', '.ogg', '.mp3', '.m4a', '.aac', '.flac', '.ktx'}
+
+# Only keep a compressed entry if it saves at least this fraction
+MIN_SAVING = 0.1
+
+
+def digest(data):
+    """Returns the 64-bit BLAKE2b hash of the given bytes"""
+    return struct.unpack('<Q', hashlib.blake2b(data, digest_size=8).digest())[0]
+
+
+def lz4_compress(data):
+    """Returns the LZ4 block compression of the given bytes (greedy, 64K window)"""
+    size = len(data)
+    out = bytearray()
+    table = {}
+    anchor = 0
+    pos = 0
+    # The last match must start 12 bytes before the end, and the last 5 bytes are literals
+    limit = size - 12
+
+    def emit(literals, length):
+        litlen = len(literals)
+        token = (min(litlen, 15) << 4) | (min(length - 4, 15) if length else 0)
+        out.append(token)
+        if litlen >= 15:
+            rest = litlen - 15
+            while rest >= 255:
+                out.append(255)
+                rest -= 255
+            out.append(rest)
+        out.extend(literals)
+
+    def extend(value):
+        while value >= 255:
+            out.append(255)
+            value -= 255
+        out.append(value)
+
+    while pos < limit:
+        key = data[pos:pos + 4]
+        candidate = table.get(key)
+        table[key] = pos
+        if candidate is None or pos - candidate > 0xffff:
+            pos += 1
+            continue
+
+        # Extend the match, leaving the last 5 bytes as literals
+        end = size - 5
+        length = 4
+        while pos + length < end and data[candidate + length] == data[pos + length]:
+            length += 1
+
+        emit(data[anchor:pos], length)
+        out.extend(struct.pack('<H', pos - candidate))
+        if length - 4 >= 15:
+            extend(length - 4 - 15)
+        pos += length
+        anchor = pos
+
+    emit(data[anchor:], 0)
+    return bytes(out)
+
+
+def collect(directories, excludes, output):
+    """Returns a dictionary from entry name to file path"""
+    files = {}
+    for root in directories:
+        for parent, dirs, names in os.walk(root):
+            dirs.sort()
+            for name in sorted(names):
+                path = os.path.join(parent, name)
+                entry = os.path.relpath(path, root).replace(os.sep, '/')
+                if os.path.abspath(path) == os.path.abspath(output):
+                    continue
+                if name.startswith('.') or any(fnmatch.fnmatch(entry, p) for p in excludes):
+                    continue
+                files[entry] = path
+    return files
+
+
+def build(files, output, compress):
+    """Writes the pack for the given files, returning the (original, stored) sizes"""
+    names = sorted(files, key=lambda n: n.encode('utf-8'))
+    encoded = [n.encode('utf-8') for n in names]
+    table = b''.join(encoded)
+    offset = HEADER + ENTRY * len(names) + len(table)
+
+    index = bytearray()
+    blobs = []
+    nameoff = 0
+    total = [0, 0]
+    for name, raw in zip(names, encoded):
+        with open(files[name], 'rb') as f:
+            data = f.read()
+        stored = data
+        ext = os.path.splitext(name)[1].lower()
+        if compress and len(data) > 64 and ext not in PRECOMPRESSED:
+            packed = lz4_compress(data)
+            if len(packed) <= len(data) * (1 - MIN_SAVING):
+                stored = packed
+
+        offset = (offset + ALIGN - 1) // ALIGN * ALIGN
+        index.extend(struct.pack('<IIQQQQ', nameoff, len(raw), offset, len(stored), len(data), digest(data)))
+        blobs.append((offset, stored))
+        nameoff += len(raw)
+        offset += len(stored)
+        total[0] += len(data)
+        total[1] += len(stored)
+
+    with open(output, 'wb') as f:
+        f.write(struct.pack('<IIII', MAGIC, VERSION, len(names), len(table)))
+        f.write(index)
+        f.write(table)
+        for start, stored in blobs:
+            f.write(b'\0' * (start - f.tell()))
+            f.write(stored)
+    return total
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Builds a CUGL asset pack.')
+    parser.add_argument('directories', nargs='+', help='the asset directories (later ones win)')
+    parser.add_argument('-o', '--output', default='assets.pack', help='the pack file')
+    parser.add_argument('--exclude', action='append', default=[], help='a glob of entries to leave out')
+    parser.add_argument('--no-compress', action='store_true', help='store every entry as is')
+    args = parser.parse_args()
+
+    for root in args.directories:
+        if not os.path.isdir(root):
+            sys.exit('%s is not a directory' % root)
+    files = collect(args.directories, args.exclude, args.output)
+    parent = os.path.dirname(args.output)
+    if parent:
+        os.makedirs(parent, exist_ok=True)
+    original, stored = build(files, args.output, not args.no_compress)
+    print('Packed %d files (%d bytes) into %s (%d bytes of data)' % (len(files), original, args.output, stored))
+
+
+if __name__ == '__main__':
+    main()
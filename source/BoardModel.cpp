@@ -37,7 +37,8 @@ _tilePaddingX(0.0f),
 _tilePaddingY(0.0f),
 offsetRow(false),
 offsetCol(false),
-offset(0.0f) {
+offset(0.0f),
+_allDirty(true) {
 }
 
 /** Initializes the board */
@@ -113,6 +114,11 @@ void BoardModel::dispose() {
     _removedTiles.clear();
     _removedAllies.clear();
     _removedEnemies.clear();
+    _dirtyCells.clear();
+    _cellBounds.clear();
+    _drawnAllies.clear();
+    _drawnEnemies.clear();
+    _allDirty = true;
 }
 
 
@@ -142,6 +148,7 @@ bool BoardModel::setupBoardNode(int width, int height, int colors, Size dimen) {
     _cellSize = Size(cellLength, cellLength*0.85f);
     // Set tile padding
     _tilePaddingX = -cellLength*0.04f;
+    resetCellBounds();
     
     return true;
 }
@@ -487,6 +494,7 @@ size_t BoardModel::getEnemy(int x, int y) {
 // Set the value at the given (x, y) coordinate
 void BoardModel::setTile(int x, int y, std::shared_ptr<TileModel> t) {
 	_tiles[indexOfCoordinate(x, y)] = t;
+    markDirty(x, y);
 }
 
 // Place ally at index i of _allies on location (x, y)
@@ -509,6 +517,7 @@ void BoardModel::removeAlly(int i) {
     replaceTile(indexOfCoordinate(_allies[i]->getX(), _allies[i]->getY()));
     
     // Remove Ally
+    _drawnAllies.erase(_allies[i].get());
     _removedAllies.insert(_allies[i]);
     _allies.erase(_allies.begin() + i);
     _numAllies--;
@@ -517,6 +526,7 @@ void BoardModel::removeAlly(int i) {
 // Remove enemy at index i
 void BoardModel::removeEnemy(int i) {
 //    _node->removeChild(_enemies[i]->getSprite());
+    _drawnEnemies.erase(enemiesEntityIds[i]);
     _removedEnemies.insert(enemiesEntityIds[i]);
     enemiesEntityIds.erase(enemiesEntityIds.begin() + i);
     _numEnemies--;
@@ -601,6 +611,7 @@ void BoardModel::replaceTile(int tileLocation) {
     std::shared_ptr<TileModel> tile = TileModel::alloc(color, bounds, _assets);
     _tiles[tileLocation] = tile;
     _addedTiles.insert(tile);
+    markDirty(xOfIndex(tileLocation), yOfIndex(tileLocation));
 }
 
 // Slide pawns in row or column [k] by [offset]
@@ -696,18 +707,23 @@ void BoardModel::slide(bool row, int k, int offset) {
 
 //Offset view of row (not model)
 void BoardModel::setOffsetRow(float value) {
+    markDirtyOffset();
 	offsetRow = true;
 	offset = value;
+    markDirtyOffset();
 }
 
 //Offset view of col (not model)
 void BoardModel::setOffsetCol(float value) {
+    markDirtyOffset();
 	offsetCol = true;
 	offset = value;
+    markDirtyOffset();
 }
 
 //Offset reset
 void BoardModel::offsetReset() {
+    markDirtyOffset();
 	offsetRow = false;
 	offsetCol = false;
 	offset = 0.0f;
@@ -715,8 +731,11 @@ void BoardModel::offsetReset() {
 
 // Deselect _selectedTile
 void BoardModel::deselectTile() {
-    _selectedTile = -1;
     offsetReset();
+    if (_selectedTile != -1) {
+        markDirty(xOfIndex(_selectedTile), yOfIndex(_selectedTile));
+    }
+    _selectedTile = -1;
 }
 
 //Slide row [y] by [offset]
@@ -758,7 +777,11 @@ bool BoardModel::selectTileAtPosition(Vec2 position) {
     if (y < 0 || _height <= y) {
         return false;
     }
+    if (_selectedTile != -1) {
+        markDirty(xOfIndex(_selectedTile), yOfIndex(_selectedTile));
+    }
     _selectedTile = indexOfCoordinate(x, y);
+    markDirty(x, y);
     return true;
 }
 
@@ -771,19 +794,28 @@ void BoardModel::updateNodes(bool position, bool z) {
     // Tiles
     for (int x = 0; x < _width; x++) {
         for (int y = 0; y < _height; y++) {
+            int i = indexOfCoordinate(x, y);
+            if (!_allDirty && !_dirtyCells[i]) {
+                continue;
+            }
             if (position)
-                _tiles[indexOfCoordinate(x, y)]->setSpriteBounds(calculateDrawBounds(x, y));
+                _tiles[i]->setSpriteBounds(calculateDrawBounds(x, y));
             if (z) {
-                _tiles[indexOfCoordinate(x, y)]->getSprite()->setZOrder(calculateDrawZ(x, y, true));
-                if (_tiles[indexOfCoordinate(x, y)]->getDeathSprite()) {
-                    _tiles[indexOfCoordinate(x, y)]->getDeathSprite()->setZOrder(calculateDrawZ(x, y, false) + 1);
+                _tiles[i]->getSprite()->setZOrder(calculateDrawZ(x, y, true));
+                if (_tiles[i]->getDeathSprite()) {
+                    _tiles[i]->getDeathSprite()->setZOrder(calculateDrawZ(x, y, false) + 1);
                 }
             }
         }
     }
     
-    // Allies
+    // Allies (update if their cell is dirty or they changed cells)
     for (std::vector<std::shared_ptr<PlayerPawnModel>>::iterator it = _allies.begin(); it != _allies.end(); ++it) {
+        int cell = cellOfCoordinate((*it)->getX(), (*it)->getY());
+        auto drawn = _drawnAllies.find(it->get());
+        if (!_allDirty && drawn != _drawnAllies.end() && drawn->second == cell && (cell == -1 || !_dirtyCells[cell])) {
+            continue;
+        }
         if (position) {
             (*it)->setSpriteBounds(calculateDrawBounds((*it)->getX(), (*it)->getY()));
         }
@@ -791,11 +823,19 @@ void BoardModel::updateNodes(bool position, bool z) {
             (*it)->getSprite()->setZOrder(calculateDrawZ((*it)->getX(), (*it)->getY(), false));
             (*it)->getEndSprite()->setZOrder(calculateDrawZ((*it)->getX(), (*it)->getY(), false));
         }
+        if (position && z) {
+            _drawnAllies[it->get()] = cell;
+        }
     }
     
-    // Enemies
+    // Enemies (update if their cell is dirty or they changed cells)
     for (std::vector<size_t>::iterator it = enemiesEntityIds.begin(); it != enemiesEntityIds.end(); ++it) {
 		LocationComponent loc = _entityManager->getComponent<LocationComponent>((*it));
+        int cell = cellOfCoordinate(loc.x, loc.y);
+        auto drawn = _drawnEnemies.find(*it);
+        if (!_allDirty && drawn != _drawnEnemies.end() && drawn->second == cell && (cell == -1 || !_dirtyCells[cell])) {
+            continue;
+        }
 		IdleComponent idle = _entityManager->getComponent<IdleComponent>((*it));
 
 		if (position) {
@@ -809,6 +849,15 @@ void BoardModel::updateNodes(bool position, bool z) {
 		}
         if (z)
             idle.sprite->setZOrder(calculateDrawZ(loc.x, loc.y, false));
+        if (position && z) {
+            _drawnEnemies[*it] = cell;
+        }
+    }
+    
+    // Everything is now up to date
+    if (position && z) {
+        std::fill(_dirtyCells.begin(), _dirtyCells.end(), false);
+        _allDirty = false;
     }
     
     // Resort z order
@@ -816,6 +865,59 @@ void BoardModel::updateNodes(bool position, bool z) {
         _node->sortZOrder();
 }
 
+// Mark cell (x, y) so its sprites are updated by the next updateNodes
+void BoardModel::markDirty(int x, int y) {
+    int cell = cellOfCoordinate(x, y);
+    if (cell != -1) {
+        _dirtyCells[cell] = true;
+    }
+}
+
+// Mark every cell in row [y] (row=true) or column [x] (row=false) as dirty
+void BoardModel::markDirtyLine(bool row, int k) {
+    int size = row ? _width : _height;
+    for (int i = 0; i < size; i++) {
+        markDirty(row ? i : k, row ? k : i);
+    }
+}
+
+// Mark the row/col currently offset by the player as dirty
+void BoardModel::markDirtyOffset() {
+    if (_selectedTile == -1) {
+        return;
+    }
+    if (offsetRow) {
+        markDirtyLine(true, yOfIndex(_selectedTile));
+    }
+    if (offsetCol) {
+        markDirtyLine(false, xOfIndex(_selectedTile));
+    }
+}
+
+// Recompute the cached cell bounds (call on resize or padding change)
+void BoardModel::resetCellBounds() {
+    _cellBounds.resize(_width*_height);
+    _dirtyCells.assign(_width*_height, false);
+    for (int i = 0; i < _width*_height; i++) {
+        Rect bounds = gridToScreen(xOfIndex(i), yOfIndex(i));
+        float x = bounds.getMinX() + _tilePaddingX/2.0f;
+        float y = bounds.getMinY() + _tilePaddingY/2.0f;
+        float width = bounds.size.width - _tilePaddingX;
+        float height = bounds.size.height - _tilePaddingY;
+        float length = std::max(width, height);
+        _cellBounds[i].set(x, y, length, length);
+    }
+    _allDirty = true;
+}
+
+// Returns index of cell (x, y), or -1 if it is not on the board
+int BoardModel::cellOfCoordinate(int x, int y) const {
+    if (x < 0 || _width <= x || y < 0 || _height <= y) {
+        return -1;
+    }
+    return indexOfCoordinate(x, y);
+}
+
 float BoardModel::getCellLength() {
     float cellWidth = (gameWidth - 2.0f*_boardPadding) / _width;
     float cellHeight = (gameHeight - 2.0f*_boardPadding) / _height;
@@ -859,16 +961,23 @@ int BoardModel::lengthToCells(float length, bool row) {
 
 // Apply padding, offset, and wrap to return tile bounds
 Rect BoardModel::calculateDrawBounds(int gridX, int gridY) {
-    Rect bounds = gridToScreen(gridX, gridY);
-    
-    // Apply Padding to Bounds
+    // Apply Padding to Bounds (cached for cells on the board)
+    Rect bounds;
+    int cell = cellOfCoordinate(gridX, gridY);
+    if (cell != -1 && (size_t)cell < _cellBounds.size()) {
+        bounds = _cellBounds[cell];
+    } else {
+        bounds = gridToScreen(gridX, gridY);
 //    float x = bounds.getMinX() - _tilePaddingX/2.0f + _tilePaddingY/2.0f;
-    float x = bounds.getMinX() + _tilePaddingX/2.0f;
-    float y = bounds.getMinY() + _tilePaddingY/2.0f;
-    float width = bounds.size.width - _tilePaddingX;
-    float height = bounds.size.height - _tilePaddingY;
-    float length = std::max(width, height);
-    bounds.set(x, y, length, length);
+        float x = bounds.getMinX() + _tilePaddingX/2.0f;
+        float y = bounds.getMinY() + _tilePaddingY/2.0f;
+        float width = bounds.size.width - _tilePaddingX;
+        float height = bounds.size.height - _tilePaddingY;
+        float length = std::max(width, height);
+        bounds.set(x, y, length, length);
+    }
+    float x = bounds.getMinX();
+    float y = bounds.getMinY();
     
     // Calculate Offset
     float xOffset = (offsetRow && gridY == yOfIndex(_selectedTile)) ? offset : 0.0f;
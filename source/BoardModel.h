@@ -14,6 +14,7 @@
 #include "PlayerPawnModel.h"
 #include <set>
 #include <vector>
+#include <unordered_map>
 #include "EntityManager.h"
 
 #define ENEMY_FRAME_RIGHT  0
@@ -119,6 +120,38 @@ protected:
     
 	/** Set storing all attacking enemies attacking on the board (store for animation) */
 	std::set<size_t> _attackingEnemies;
+    
+#pragma mark -
+#pragma mark Node Update Tracking
+    /** Cells (by index) whose sprites must be updated by the next updateNodes */
+    std::vector<bool> _dirtyCells;
+    
+    /** Whether every sprite must be updated by the next updateNodes */
+    bool _allDirty;
+    
+    /** Padded bounds of each cell (before offset, wrap and selection) */
+    std::vector<cugl::Rect> _cellBounds;
+    
+    /** Cell index each ally was last drawn at (-1 if off the board) */
+    std::unordered_map<PlayerPawnModel*, int> _drawnAllies;
+    
+    /** Cell index each enemy was last drawn at (-1 if off the board) */
+    std::unordered_map<size_t, int> _drawnEnemies;
+    
+    /** Mark cell (x, y) so its sprites are updated by the next updateNodes */
+    void markDirty(int x, int y);
+    
+    /** Mark every cell in row [y] (row=true) or column [x] (row=false) as dirty */
+    void markDirtyLine(bool row, int k);
+    
+    /** Mark the row/col currently offset by the player as dirty */
+    void markDirtyOffset();
+    
+    /** Recompute the cached cell bounds (call on resize or padding change) */
+    void resetCellBounds();
+    
+    /** Returns index of cell (x, y), or -1 if it is not on the board */
+    int cellOfCoordinate(int x, int y) const;
 
     
 #pragma mark -
@@ -364,9 +397,17 @@ public:
     /** Get board node */
     std::shared_ptr<cugl::Node>& getNode() { return _node; }
     
-    /** Update nodes positions (can choose to only update position or z) */
+    /**
+     * Update nodes positions (can choose to only update position or z)
+     *
+     * Only sprites in cells marked dirty (by slides, replaced tiles, offsets
+     * and selection) or pawns that changed cells are updated.
+     */
     void updateNodes(bool position=true, bool z=true);
     
+    /** Force every sprite to be updated by the next updateNodes */
+    void markAllDirty() { _allDirty = true; }
+    
     /**
      * Select tile at screen position [position]
      *
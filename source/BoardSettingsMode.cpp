@@ -68,6 +68,13 @@ bool BoardSettingsMode::init(const std::shared_ptr<cugl::AssetManager>& assets)
 	_alliesLabel->setText(std::to_string(allies), true);
 	_enemiesLabel->setText(std::to_string(enemies), true);
 
+	// The values only change on a click, so draw them from cached textures
+	_heightLabel->setCacheAsBitmap(true);
+	_widthLabel->setCacheAsBitmap(true);
+	_colorsLabel->setCacheAsBitmap(true);
+	_alliesLabel->setCacheAsBitmap(true);
+	_enemiesLabel->setCacheAsBitmap(true);
+
 
 
 
@@ -10,6 +10,13 @@
 
 using namespace cugl;
 
+/** The memory budget for textures (unused ones are evicted past this) */
+#define TEXTURE_BUDGET (256*1024*1024)
+/** The memory budget for sound effects */
+#define SOUND_BUDGET   (8*1024*1024)
+/** The asset directory for each realm */
+#define REALM_ASSETS   "json/realm%d.json"
+
 #pragma mark -
 #pragma mark Application State
 
@@ -26,6 +33,8 @@ using namespace cugl;
 void BoxApp::onStartup() {
     _assets = AssetManager::alloc();
     _batch  = SpriteBatch::alloc();
+    _batch->setPacked(true);    // All our textures clamp, so 16-bit texcoords suffice
+    _batch->setMultiTexture(true);
     _input = std::make_shared<InputController>();
     
     // Start-up basic input
@@ -71,6 +80,7 @@ void BoxApp::onShutdown() {
     _menu.dispose();
     _gameplay.dispose();
     _assets = nullptr;
+    _realm = -1;
     _batch = nullptr;
     _input = nullptr;
     
@@ -99,6 +109,8 @@ void BoxApp::onShutdown() {
  */
 void BoxApp::onSuspend() {
     AudioEngine::get()->pauseAll();
+    // We may not come back, so do not leave progress in the write-behind queue
+    GameData::get()->flush();
 }
 
 /**
@@ -115,6 +127,34 @@ void BoxApp::onResume() {
     AudioEngine::get()->resumeAll();
 }
 
+/**
+ * Starts loading the assets of the given realm, unloading those of the previous one
+ *
+ * The realm backgrounds are only needed in gameplay, so each realm has its
+ * own asset directory that is swapped in as the player moves between realms.
+ * The assets load asynchronously, so the caller should wait until the asset
+ * manager is complete.  Calling this again for the same realm does nothing.
+ *
+ * @param realm The realm to load
+ */
+void BoxApp::loadRealm(int realm) {
+    if (realm == _realm) {
+        return;
+    }
+    char directory[32];
+    if (_realm >= 0) {
+        snprintf(directory, sizeof(directory), REALM_ASSETS, _realm);
+        _assets->unloadDirectory(directory);
+    }
+    snprintf(directory, sizeof(directory), REALM_ASSETS, realm);
+    _assets->loadDirectoryAsync(directory, [=](const std::string& key, bool success) {
+        if (!success) {
+            CULogError("Could not load '%s' for realm %d", key.c_str(), realm);
+        }
+    });
+    _realm = realm;
+}
+
 
 #pragma mark -
 #pragma mark Application Loop
@@ -137,6 +177,8 @@ void BoxApp::update(float timestep) {
     } else if (!_loadedMenu) {
         // Load Menu
         _loading.dispose();
+        _assets->setBudget<Texture>(TEXTURE_BUDGET);
+        _assets->setBudget<Sound>(SOUND_BUDGET);
         _menu.init(_assets, _input, 0);
         _loadedMenu = true;
         
@@ -160,21 +202,28 @@ void BoxApp::update(float timestep) {
         // Update Menu
         _menu.update(timestep);
     } else if (!_loadedGameplay) {
-        // Load Level
+        // Load Level, keeping the menu on screen until its realm is loaded
 //        std::string& levelJson = _menu.getSelectedLevelJson();
         int level = _menu.getSelectedLevel();
-        _menu.dispose();
-        CULog("Init Gameplay");
-        _gameplay.init(_assets, _input, level);
-        _loadedGameplay = true;
+        loadRealm(GameData::get()->getRealm(level));
+        if (_assets->complete()) {
+            _menu.dispose();
+            CULog("Init Gameplay");
+            _gameplay.init(_assets, _input, level);
+            _loadedGameplay = true;
+        }
 	} else if (!_gameplay.isComplete()) {
         // Update Gameplay
 		_gameplay.update(timestep);
     } else {
         int level = _gameplay.getLevel();
         if (_gameplay.restart) {
-            _gameplay.dispose();
-            _gameplay.init(_assets, _input, level);
+            // The finished level stays on screen until the next realm is loaded
+            loadRealm(GameData::get()->getRealm(level));
+            if (_assets->complete()) {
+                _gameplay.dispose();
+                _gameplay.init(_assets, _input, level);
+            }
         } else {
             // Go back to Menu
             _gameplay.dispose();
@@ -40,6 +40,20 @@ protected:
     /** Whether or not we have finished loading all assets */
     bool _loadedMenu;
     bool _loadedGameplay;
+    /** The realm whose assets are loaded (-1 for none) */
+    int _realm;
+    
+    /**
+     * Starts loading the assets of the given realm, unloading those of the previous one
+     *
+     * The realm backgrounds are only needed in gameplay, so each realm has its
+     * own asset directory that is swapped in as the player moves between realms.
+     * The assets load asynchronously, so the caller should wait until the asset
+     * manager is complete.  Calling this again for the same realm does nothing.
+     *
+     * @param realm The realm to load
+     */
+    void loadRealm(int realm);
     
 public:
 #pragma mark Constructors
@@ -52,7 +66,7 @@ public:
      * of initialization from the constructor allows main.cpp to perform
      * advanced configuration of the application before it starts.
      */
-    BoxApp() : cugl::Application(), _loadedMenu(false), _loadedGameplay(false) {}
+    BoxApp() : cugl::Application(), _loadedMenu(false), _loadedGameplay(false), _realm(-1) {}
     
     /**
      * Disposes of this application, releasing all resources.
@@ -21,11 +21,25 @@ GameData* GameData::_gData = nullptr;
 #pragma mark Constructors
 
 /** Constructor */
-GameData::GameData() {
+GameData::GameData() :
+_dirty(false),
+_saveStop(false) {
 }
 
 /** Dispose of all (non-static) resources */
 void GameData::dispose() {
+    // Stop the save thread, then write anything it had not got to
+    if (_saveThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _saveStop = true;
+        }
+        _saveCondition.notify_all();
+        _saveThread.join();
+    }
+    if (_settingsJson != nullptr) {
+        writeSettings();
+    }
     _settingsJson = nullptr;
     _levelsJson = nullptr;
     _levelListJson = nullptr;
@@ -58,6 +72,10 @@ bool GameData::init(std::string saveDir) {
     // LevelListJson
     _levelListJson = JsonReader::allocWithAsset(LEVEL_LIST_PATH)->readJson()->get("levels");
     
+    // Settings are written behind on this thread
+    _saveStop = false;
+    _saveThread = std::thread(&GameData::saveLoop, this);
+    
     return true;
 }
 
@@ -81,23 +99,80 @@ void GameData::initLevelData(int level) {
     levelData->appendChild(STARS_KEY, starsData);
     levelData->appendChild(MOVES_KEY, movesData);
     _levelsJson->appendChild(to_string(level), levelData);
-    saveSettings();
+    markDirty();
 }
 
 /** Returns reference to the level JsonValue */
 std::shared_ptr<JsonValue> GameData::getLevelJson(int level) {
     std::string levelKey = std::to_string(level);
     if (!_levelsJson->has(levelKey)) {
+        std::lock_guard<std::mutex> lock(_mutex);
         initLevelData(level);
     }
     return _levelsJson->get(levelKey);
 }
 
-/** Writes settings json */
-void GameData::saveSettings() {
-//    CULog("save json: \n%s", _settingsJson->toString().c_str());
-    std::shared_ptr<JsonWriter> writer = JsonWriter::alloc(_settingsPath);
-    writer->writeJson(_settingsJson);
+/** Marks settings as changed and wakes the save thread (_mutex must be held) */
+void GameData::markDirty() {
+    _dirty = true;
+    _lastChange = std::chrono::steady_clock::now();
+    _saveCondition.notify_one();
+}
+
+/** Writes settings json atomically (temp file + rename) if it is dirty; retries later on failure */
+void GameData::writeSettings() {
+    std::lock_guard<std::mutex> writeLock(_writeMutex);
+    
+    // Snapshot under the lock; the file I/O happens outside it
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_dirty) {
+            return;
+        }
+        data = _settingsJson->toString();
+        _dirty = false;
+    }
+    
+    // Never leave a half-written settings file behind
+    std::string tempPath = _settingsPath + SETTINGS_TEMP_SUFFIX;
+    std::shared_ptr<JsonWriter> writer = JsonWriter::alloc(tempPath);
+    if (writer == nullptr) {
+        CULogError("Could not open %s for writing", tempPath.c_str());
+        // The snapshot is not saved until the rename succeeds
+        std::lock_guard<std::mutex> lock(_mutex);
+        markDirty();
+        return;
+    }
+    writer->writeLine(data);
+    writer->close();
+    
+    // Sync before the rename, or a crash could leave an empty file in its place
+    Pathname temp(tempPath);
+    if (!temp.syncFile() || !temp.renameTo(_settingsPath)) {
+        CULogError("Could not replace %s", _settingsPath.c_str());
+        std::lock_guard<std::mutex> lock(_mutex);
+        markDirty();
+    }
+}
+
+/** Body of the save thread; coalesces changes and writes after a quiet period */
+void GameData::saveLoop() {
+    std::chrono::milliseconds debounce(SAVE_DEBOUNCE_MS);
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_saveStop) {
+        _saveCondition.wait(lock, [this] { return _dirty || _saveStop; });
+        // Wait until no change has arrived for the debounce period
+        while (!_saveStop && std::chrono::steady_clock::now() < _lastChange + debounce) {
+            _saveCondition.wait_until(lock, _lastChange + debounce);
+        }
+        if (_saveStop) {
+            break;  // dispose writes the final state
+        }
+        lock.unlock();
+        writeSettings();
+        lock.lock();
+    }
 }
 
 
@@ -132,6 +207,11 @@ void GameData::stop() {
     _gData = nullptr;
 }
 
+/** Writes any pending changes immediately, blocking until done */
+void GameData::flush() {
+    writeSettings();
+}
+
 
 #pragma mark -
 #pragma mark Static Accessors/Mutators
@@ -145,8 +225,11 @@ bool GameData::getMuteSetting() {
 /** Set the saved mute setting */
 void GameData::setMuteSetting(bool mute) {
     std::shared_ptr<JsonValue> muteJson = _settingsJson->get(MUTE_KEY);
-    muteJson->set(mute);
-    saveSettings();
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (muteJson->asBool() != mute) {
+        muteJson->set(mute);
+        markDirty();
+    }
 }
 
 /** Get the saved level number of stars */
@@ -158,8 +241,11 @@ int GameData::getLevelStars(int level) {
 /** Set the saved level number of stars */
 void GameData::setLevelStars(int level, int stars) {
     std::shared_ptr<JsonValue> starsJson = getLevelJson(level)->get(STARS_KEY);
-    starsJson->set((double)stars);
-    saveSettings();
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (starsJson->asInt() != stars) {
+        starsJson->set((double)stars);
+        markDirty();
+    }
 }
 
 /** Get the level saved number of moves */
@@ -171,8 +257,11 @@ int GameData::getLevelMoves(int level) {
 /** Set the level saved number of moves */
 void GameData::setLevelMoves(int level, int moves) {
     std::shared_ptr<JsonValue> movesJson = getLevelJson(level)->get(MOVES_KEY);
-    movesJson->set((double)moves);
-    saveSettings();
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (movesJson->asInt() != moves) {
+        movesJson->set((double)moves);
+        markDirty();
+    }
 }
 
 /** Return which of the 3 realms a level is in */
@@ -16,8 +16,16 @@
 #define LEVELS_KEY "levels"
 #define STARS_KEY "stars"
 #define MOVES_KEY "moves"
+/** Suffix of the temporary file a save is written to before being renamed into place */
+#define SETTINGS_TEMP_SUFFIX ".tmp"
+/** Quiet period (in milliseconds) after the last change before settings are written */
+#define SAVE_DEBOUNCE_MS 500
 
 #include <cugl/cugl.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 class GameData {
 private:
@@ -39,6 +47,27 @@ private:
     /** Reference to levelList Json */
     std::shared_ptr<cugl::JsonValue> _levelListJson;
     
+    /** Guards _settingsJson mutations and the dirty state below */
+    std::mutex _mutex;
+    
+    /** Serialises writers so an older snapshot never replaces a newer one */
+    std::mutex _writeMutex;
+    
+    /** Wakes the save thread when settings change or on stop */
+    std::condition_variable _saveCondition;
+    
+    /** Background thread that writes dirty settings */
+    std::thread _saveThread;
+    
+    /** Whether settings have changed since the last write */
+    bool _dirty;
+    
+    /** Whether the save thread should exit */
+    bool _saveStop;
+    
+    /** Time of the most recent change (for the debounce) */
+    std::chrono::steady_clock::time_point _lastChange;
+    
 #pragma mark -
 #pragma mark Constructors
     /** Constructor */
@@ -64,8 +93,14 @@ private:
     /** Returns reference to the level JsonValue */
     std::shared_ptr<cugl::JsonValue> getLevelJson(int level);
     
-    /** Writes settings json */
-    void saveSettings();
+    /** Marks settings as changed and wakes the save thread (_mutex must be held) */
+    void markDirty();
+    
+    /** Writes settings json atomically (temp file + rename) if it is dirty */
+    void writeSettings();
+    
+    /** Body of the save thread; coalesces changes and writes after a quiet period */
+    void saveLoop();
     
 public:
 #pragma mark -
@@ -92,6 +127,14 @@ public:
      */
     static void stop();
     
+    /**
+     * Writes any pending changes immediately, blocking until done.
+     *
+     * Changes are normally written behind on a background thread. Call this
+     * when the application may be terminated (e.g. on suspend).
+     */
+    void flush();
+    
 #pragma mark -
 #pragma mark Non-Static Accessors/Mutators
     /** Get the saved mute setting */
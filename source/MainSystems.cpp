@@ -106,7 +106,6 @@ bool MovementDumbSystem::updateEntity(EntityId entity, std::shared_ptr<BoardMode
 		if (isFree) {
             if (targetY < loc.y) {
                 idle.sprite->setZOrder(board->calculateDrawZ(targetX, targetY, false));
-                board->getNode()->sortZOrder();
             }
 			loc.x = targetX;
 			loc.y = targetY;
@@ -271,7 +270,6 @@ bool MovementSmartSystem::updateEntity(EntityId entity, std::shared_ptr<BoardMod
 		if (isFree) {
             if (targetY < loc.y) {
                 idle.sprite->setZOrder(board->calculateDrawZ(targetX, targetY, false));
-                board->getNode()->sortZOrder();
             }
 			loc.x = targetX;
 			loc.y = targetY;
@@ -47,11 +47,19 @@ bool MenuMode::init(const std::shared_ptr<AssetManager>& assets, std::shared_ptr
     } else if (!Scene::init(dimen)) {
         return false;
     }
+    setDeferred(true);  // Group the tiles, stars and labels by texture
     
     // Initialize
     _assets = assets;
     _dimen = dimen;
     _selectedLevel = selectedLevel;
+    _tileTextures[0] = _assets->resolve<Texture>(MENU_TILE_KEY_0);
+    _tileTextures[1] = _assets->resolve<Texture>(MENU_TILE_KEY_1);
+    _tileTextures[2] = _assets->resolve<Texture>(MENU_TILE_KEY_2);
+    _dotTexture = _assets->resolve<Texture>(MENU_DOT_KEY);
+    _starTexture = _assets->resolve<Texture>(MENU_STAR_KEY);
+    _starEmptyTexture = _assets->resolve<Texture>(MENU_STAR_EMPTY_KEY);
+    _levelFont = _assets->resolve<Font>("alwaysHereToo");
     
     // Initialize ActionManager
     _actions = ActionManager::alloc();
@@ -105,6 +113,7 @@ void MenuMode::dispose() {
     _active = false;
     _menuTiles.clear();
     _menuDots.clear();
+    _menuSlotLevels.clear();
     _menuCapHiTiles.clear();
     _menuCapLowTiles.clear();
     _softOffset = 0.0f;
@@ -124,8 +133,7 @@ void MenuMode::dispose() {
 /** Load levels from json */
 void MenuMode::loadLevelsFromJson(const std::string& filePath) {
     // Load json
-    std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(filePath);
-    std::shared_ptr<JsonValue> json = reader->readJson();
+    std::shared_ptr<JsonValue> json = _assets->readJson(filePath);
     if (json == nullptr) {
         CUAssertLog(false, "Failed to load level file");
         return;
@@ -146,11 +154,13 @@ void MenuMode::loadLevelsFromJson(const std::string& filePath) {
     std::shared_ptr<Node> bottomCap = createBottomCap(-1 - j);
     _worldNode->addChild(bottomCap, MENU_CAP_Z);
     _menuCapLowTiles.push_back(bottomCap);
-    // Create levels
-    for (auto i = 0; i < _levelsJson->size(); i++) {
+    // Create levels (only enough to cover the screen; they are rebound as we scroll)
+    int poolSize = std::min(menuTilePoolSize(), int(_levelsJson->size()));
+    for (auto i = 0; i < poolSize; i++) {
         std::shared_ptr<Node> menuTile = createLevelNode(i);
         _worldNode->addChild(menuTile, MENU_TILE_Z);
         _menuTiles.push_back(menuTile);
+        _menuSlotLevels.push_back(i);
     }
     // Create hi cap
     for (j = 0; j < _hiCapTiles; j++) {
@@ -171,17 +181,7 @@ std::shared_ptr<Node> MenuMode::createLevelNode(int levelIdx, bool cap) {
     ss << (levelIdx+1);
 
     // Initialize node
-    int realm = GameData::get()->getRealm(levelIdx);
-    std::string tileKey;
-    if (realm == 0) {
-        tileKey = MENU_TILE_KEY_0;
-    } else if (realm == 1) {
-        tileKey = MENU_TILE_KEY_1;
-    } else {
-        tileKey = MENU_TILE_KEY_2;
-    }
-    
-    std::shared_ptr<AnimationNode> menuTile = AnimationNode::alloc(_assets->get<Texture>(tileKey), MENU_TILE_ROWS, MENU_TILE_COLS, MENU_TILE_SIZE);
+    std::shared_ptr<AnimationNode> menuTile = AnimationNode::alloc(menuTileTexture(levelIdx), MENU_TILE_ROWS, MENU_TILE_COLS, MENU_TILE_SIZE);
     menuTile->setAnchor(Vec2::ANCHOR_BOTTOM_LEFT);
     menuTile->setContentSize(_menuTileSize);
     menuTile->setPosition(menuTilePosition(levelIdx));
@@ -190,14 +190,14 @@ std::shared_ptr<Node> MenuMode::createLevelNode(int levelIdx, bool cap) {
     
     if (!cap) {
         // Initialize Level Dot
-        std::shared_ptr<PolygonNode> levelDot = PolygonNode::allocWithTexture(_assets->get<Texture>(MENU_DOT_KEY));
+        std::shared_ptr<PolygonNode> levelDot = PolygonNode::allocWithTexture(_dotTexture.get());
         levelDot->setAnchor(Vec2::ANCHOR_CENTER);
         levelDot->setContentSize(_dotSize);
         levelDot->setPosition(_menuTileSize.width*levelFractionX(levelIdx), _menuTileSize.height*0.5f);
         menuTile->addChild(levelDot);
         
         // Initialize Level Number
-        std::shared_ptr<Font> font = _assets->get<Font>("alwaysHereToo");
+        std::shared_ptr<Font> font = _levelFont.get();
         std::shared_ptr<Label> levelLabel = Label::alloc(ss.str(), font);
         levelLabel->setAnchor(Vec2::ANCHOR_CENTER);
         levelLabel->setPosition(levelDot->getContentSize().width*0.55f, levelDot->getContentSize().height*0.5f);    // Font appears off-center
@@ -210,38 +210,77 @@ std::shared_ptr<Node> MenuMode::createLevelNode(int levelIdx, bool cap) {
         float starXRight = starXMid + _starSize.width + starOffset;
         float starY = levelDot->getContentSize().height*0.0f;
         float starYMid = levelDot->getContentSize().height*-0.13f;
-        int levelStars = GameData::get()->getLevelStars(levelIdx);
-        CULog("level %d stars: %d", levelIdx, levelStars);
         // 1
-        std::string star1Key = (levelStars >= 1) ? MENU_STAR_KEY : MENU_STAR_EMPTY_KEY;
-        std::shared_ptr<PolygonNode> star1 = PolygonNode::allocWithTexture(_assets->get<Texture>(star1Key));
+        std::shared_ptr<PolygonNode> star1 = PolygonNode::allocWithTexture(_starEmptyTexture.get());
         star1->setAnchor(Vec2::ANCHOR_CENTER);
         star1->setContentSize(_starSize);
         star1->setPosition(starXLeft, starY);
         levelDot->addChild(star1);
         // 2
-        std::string star2Key = (levelStars >= 2) ? MENU_STAR_KEY : MENU_STAR_EMPTY_KEY;
-        std::shared_ptr<PolygonNode> star2 = PolygonNode::allocWithTexture(_assets->get<Texture>(star2Key));
+        std::shared_ptr<PolygonNode> star2 = PolygonNode::allocWithTexture(_starEmptyTexture.get());
         star2->setAnchor(Vec2::ANCHOR_CENTER);
         star2->setContentSize(_starSize);
         star2->setPosition(starXMid, starYMid);
         levelDot->addChild(star2);
         // 3
-        std::string star3Key = (levelStars >= 3) ? MENU_STAR_KEY : MENU_STAR_EMPTY_KEY;
-        std::shared_ptr<PolygonNode> star3 = PolygonNode::allocWithTexture(_assets->get<Texture>(star3Key));
+        std::shared_ptr<PolygonNode> star3 = PolygonNode::allocWithTexture(_starEmptyTexture.get());
         star3->setAnchor(Vec2::ANCHOR_CENTER);
         star3->setContentSize(_starSize);
         star3->setPosition(starXRight, starY);
         levelDot->addChild(star3);
         // TODO: Initialize Level High Score
-        int levelMoves = GameData::get()->getLevelMoves(levelIdx);
         
-        CULog("level %d moves: %d", levelIdx, levelMoves);
+        // Stars depend on saved progress
+        bindLevelNode(menuTile, levelDot, levelIdx);
     }
     
     return menuTile;
 }
 
+/** Rebind recycled level tile [tile] and its dot [dot] to the level at [levelIdx] */
+void MenuMode::bindLevelNode(const std::shared_ptr<Node>& tile, const std::shared_ptr<Node>& dot, int levelIdx) {
+    std::stringstream ss;
+    ss << (levelIdx+1);
+    
+    // Tile
+    std::shared_ptr<AnimationNode> menuTile = std::dynamic_pointer_cast<AnimationNode>(tile);
+    menuTile->setTexture(menuTileTexture(levelIdx));
+    menuTile->setFrame(menuTileFrame(levelIdx));
+    menuTile->setName(ss.str());
+    menuTile->setPosition(menuTilePosition(levelIdx));
+    
+    // Dot (reset to unselected; update animates it from there)
+    dot->setScale(1.0f);
+    dot->setPosition(dotPosition(levelIdx));
+    std::shared_ptr<Label> levelLabel = std::dynamic_pointer_cast<Label>(dot->getChild(0));
+    levelLabel->setText(ss.str());
+    levelLabel->setScale(1.0f);
+    levelLabel->setPosition(dot->getContentSize().width*0.55f, dot->getContentSize().height*0.5f);
+    
+    // Stars
+    int levelStars = GameData::get()->getLevelStars(levelIdx);
+    for (int s = 0; s < 3; s++) {
+        std::shared_ptr<Texture> texture = (levelStars > s) ? _starTexture.get() : _starEmptyTexture.get();
+        std::shared_ptr<PolygonNode> star = std::dynamic_pointer_cast<PolygonNode>(dot->getChild(1+s));
+        if (star->getTexture() != texture) {
+            star->setTexture(texture);
+            star->setPolygon(Rect(Vec2::ZERO, texture->getSize()));
+            star->setContentSize(_starSize);
+        }
+    }
+}
+
+/** Return the texture of the menu tile for the level at [levelIdx] */
+std::shared_ptr<Texture> MenuMode::menuTileTexture(int levelIdx) {
+    int realm = GameData::get()->getRealm(levelIdx);
+    if (realm == 0) {
+        return _tileTextures[0].get();
+    } else if (realm == 1) {
+        return _tileTextures[1].get();
+    }
+    return _tileTextures[2].get();
+}
+
 /** Create top cap */
 std::shared_ptr<Node> MenuMode::createTopCap(int idx) {
     std::shared_ptr<Node> topCap = PolygonNode::allocWithTexture(_assets->get<Texture>(MENU_TOP_CAP_KEY));
@@ -344,19 +383,22 @@ bool MenuMode::touchSelectedLevel(cugl::Vec2 touchPosition) {
     Vec2 touchPositionMikaNodeCoords = _mikaNode->worldToNodeCoords(touchPosition);
     bool inMikaSprite = _mikaSprite->getBoundingBox().contains(touchPositionMikaNodeCoords);
     // Check Dot
-    std::shared_ptr<Node> menuTile = _menuTiles[_selectedLevel];
-    Vec2 touchPositionMenuNodeCoords = menuTile->worldToNodeCoords(touchPosition);
-    bool inDotSprite = _menuDots[_selectedLevel]->getBoundingBox().contains(touchPositionMenuNodeCoords);
+    bool inDotSprite = false;
+    int slot = levelSlot(_selectedLevel);
+    if (slot != -1) {
+        Vec2 touchPositionMenuNodeCoords = _menuTiles[slot]->worldToNodeCoords(touchPosition);
+        inDotSprite = _menuDots[slot]->getBoundingBox().contains(touchPositionMenuNodeCoords);
+    }
     return inNullTile || inMikaSprite || inDotSprite;
 }
 
 /** Returns tapped level and -1 if no level tapped */
 int MenuMode::tappedLevel(cugl::Vec2 touchPosition) {
-    for (int i = 0; i < _menuDots.size(); i++) {
-        std::shared_ptr<Node> menuTile = _menuTiles[i];
+    for (int slot = 0; slot < _menuDots.size(); slot++) {
+        std::shared_ptr<Node> menuTile = _menuTiles[slot];
         Vec2 touchPositionNodeCoords = menuTile->worldToNodeCoords(touchPosition);
-        if (_menuDots[i]->getBoundingBox().contains(touchPositionNodeCoords)) {
-            return i;
+        if (_menuDots[slot]->getBoundingBox().contains(touchPositionNodeCoords)) {
+            return _menuSlotLevels[slot];
         }
     }
     return -1;
@@ -404,12 +446,48 @@ bool MenuMode::menuTileOnScreen(int i) {
     return ((minY > 0.0f && minY < _dimen.height) || (maxY > 0.0f && maxY < _dimen.height));
 }
 
-/** Returns true if node is on the screen */
-bool MenuMode::nodeOnScreen(std::shared_ptr<cugl::Node> node) {
-    Rect nodeBounds = node->getBoundingBox();
-    float minY = nodeBounds.getMinY();
-    float maxY = nodeBounds.getMaxY();
-    return ((minY > 0.0f && minY < _dimen.height) || (maxY > 0.0f && maxY < _dimen.height));
+/** Returns the number of level tiles needed to cover the screen plus margin */
+int MenuMode::menuTilePoolSize() {
+    int onScreen = int(std::ceil(_dimen.height/_menuTileSize.height)) + 1;
+    return onScreen + 2*MENU_POOL_MARGIN;
+}
+
+/** Returns the recycled slot bound to the level at [levelIdx] and -1 if it is not materialised */
+int MenuMode::levelSlot(int levelIdx) {
+    if (levelIdx < 0 || _menuTiles.empty()) {
+        return -1;
+    }
+    int slot = levelIdx % int(_menuTiles.size());
+    return (_menuSlotLevels[slot] == levelIdx) ? slot : -1;
+}
+
+/** Rebinds recycled level tiles so they cover the visible window plus margin */
+void MenuMode::updateLevelWindow() {
+    int poolSize = int(_menuTiles.size());
+    if (poolSize == 0) {
+        return;
+    }
+    // Lowest level on screen, less the margin, clamped so the window stays in range
+    int first = int(std::floor((_softOffset - _originY)/_menuTileSize.height)) - MENU_POOL_MARGIN;
+    first = std::max(0, std::min(first, int(_levelsJson->size()) - poolSize));
+    for (int i = first; i < first + poolSize; i++) {
+        int slot = i % poolSize;
+        int old = _menuSlotLevels[slot];
+        if (old == i) {
+            continue;
+        }
+        // Drop animations still running for the level that left this slot
+        std::stringstream ss;
+        ss << old;
+        _actions->remove("select_" + ss.str());
+        _actions->remove("unselect_" + ss.str());
+        _actions->remove("select_label_" + ss.str());
+        _actions->remove("unselect_label_" + ss.str());
+        _actions->remove("select_label_scale_" + ss.str());
+        _actions->remove("unselect_label_scale_" + ss.str());
+        bindLevelNode(_menuTiles[slot], _menuDots[slot], i);
+        _menuSlotLevels[slot] = i;
+    }
 }
 
 
@@ -612,10 +690,12 @@ void MenuMode::update(float timestep) {
     }
     
     // Move Menu Tiles
-    for (auto i = 0; i < _menuTiles.size(); i++) {
+    updateLevelWindow();
+    for (auto slot = 0; slot < _menuTiles.size(); slot++) {
+        int i = _menuSlotLevels[slot];
         // Menu Tiles
-        _menuTiles[i]->setPosition(menuTilePosition(i));
-        _menuTiles[i]->setVisible(menuTileOnScreen(i));
+        _menuTiles[slot]->setPosition(menuTilePosition(i));
+        _menuTiles[slot]->setVisible(menuTileOnScreen(i));
         
         // Dots
         float time = 0.1f;
@@ -631,13 +711,13 @@ void MenuMode::update(float timestep) {
 //        Size size = (i == _selectedLevel) ? maxDotSize : _dotSize;
         Size size = _dotSize*scale;
         Vec2 position = (i == _selectedLevel) ? dotPosition(i)-Vec2(0.0f, _menuTileSize.height*0.1f) : dotPosition(i);
-//        _menuDots[i]->setContentSize(size);
+//        _menuDots[slot]->setContentSize(size);
         std::shared_ptr<ScaleTo> scaleAction = ScaleTo::alloc(Vec2(scale, scale), time);
         if (!_actions->isActive(ss.str())) {
-            _actions->activate(ss.str(), scaleAction, _menuDots[i]);
+            _actions->activate(ss.str(), scaleAction, _menuDots[slot]);
         }
-        _menuDots[i]->setAnchor(Vec2::ANCHOR_CENTER);
-        _menuDots[i]->setPosition(position);
+        _menuDots[slot]->setAnchor(Vec2::ANCHOR_CENTER);
+        _menuDots[slot]->setPosition(position);
         
         // Label
         std::stringstream ssLabel;
@@ -655,38 +735,30 @@ void MenuMode::update(float timestep) {
         Vec2 labelPos = (i == _selectedLevel) ? Vec2(size.width*0.29f, size.height*0.09f) : Vec2(size.width*0.55f, size.height*0.5f);
 //        Vec2 labelMoveBy = Vec2(0.0f, _dotSize.height*0.4f);
 //        labelMoveBy = (i == _selectedLevel) ? -labelMoveBy : labelMoveBy;
-//        _menuDots[i]->getChild(0)->setPosition(labelPos);
+//        _menuDots[slot]->getChild(0)->setPosition(labelPos);
         std::shared_ptr<MoveTo> moveAction = MoveTo::alloc(labelPos, time);
 //        std::shared_ptr<MoveBy> moveAction = MoveBy::alloc(labelMoveBy, time);
         float labelScale = (i == _selectedLevel) ? 0.60f : 1.0f;
         std::shared_ptr<ScaleTo> labelScaleAction = ScaleTo::alloc(Vec2(labelScale, labelScale), time);
         if (!_actions->isActive(ssLabel.str())) {
-            _actions->activate(ssLabel.str(), moveAction, _menuDots[i]->getChild(0));
+            _actions->activate(ssLabel.str(), moveAction, _menuDots[slot]->getChild(0));
         }
         if (!_actions->isActive(ssLabelScale.str())) {
-            _actions->activate(ssLabelScale.str(), labelScaleAction, _menuDots[i]->getChild(0));
+            _actions->activate(ssLabelScale.str(), labelScaleAction, _menuDots[slot]->getChild(0));
         }
-        _menuDots[i]->getChild(0)->setAnchor(Vec2::ANCHOR_CENTER);
+        _menuDots[slot]->getChild(0)->setAnchor(Vec2::ANCHOR_CENTER);
     }
     // Move upper cap
     for (auto i = 0; i < _menuCapHiTiles.size(); i++) {
         // Menu Tiles
         int lvlIdx = int(_levelsJson->size())+i;
         _menuCapHiTiles[i]->setPosition(menuTilePosition(lvlIdx));
-        if (i != _menuCapHiTiles.size()-1) {
-            // Never hide high cap
-            _menuCapHiTiles[i]->setVisible(nodeOnScreen(_menuCapHiTiles[i]));
-        }
     }
     // Move lower cap
     for (auto i = 0; i < _menuCapLowTiles.size(); i++) {
         // Menu Tiles
         int lvlIdx = -1 - i;
         _menuCapLowTiles[i]->setPosition(menuTilePosition(lvlIdx));
-        if (i != _menuCapLowTiles.size()-1) {
-            // Never hide low cap
-            _menuCapLowTiles[i]->setVisible(nodeOnScreen(_menuCapLowTiles[i]));
-        }
     }
     
     // Update Mika Animation
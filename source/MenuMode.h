@@ -33,6 +33,9 @@
 #define MENU_TILE_COLS 1
 #define MENU_TILE_SIZE 6
 
+/** Number of level tiles kept bound beyond each edge of the screen */
+#define MENU_POOL_MARGIN 2
+
 #define MENU_CAP_Z  10
 #define MENU_TILE_Z 1
 #define MIKA_Z      5
@@ -46,13 +49,22 @@ protected:
     // TODO: VIEW
     cugl::Size _dimen;
     std::shared_ptr<cugl::Node> _worldNode;
+    /** Recycled level tiles; only the visible window (plus margin) exists */
     std::vector<std::shared_ptr<cugl::Node>> _menuTiles;
     std::vector<std::shared_ptr<cugl::Node>> _menuDots;
+    /** Level currently bound to each recycled tile (level i lives in slot i % pool size) */
+    std::vector<int> _menuSlotLevels;
     std::vector<std::shared_ptr<cugl::Node>> _menuCapLowTiles;
     std::vector<std::shared_ptr<cugl::Node>> _menuCapHiTiles;
     cugl::Size _menuTileSize;
     cugl::Size _dotSize;
     cugl::Size _starSize;
+    /** Handles to the assets of every level node, so rebinding does not look up keys */
+    cugl::AssetHandle<cugl::Texture> _tileTextures[3];
+    cugl::AssetHandle<cugl::Texture> _dotTexture;
+    cugl::AssetHandle<cugl::Texture> _starTexture;
+    cugl::AssetHandle<cugl::Texture> _starEmptyTexture;
+    cugl::AssetHandle<cugl::Font> _levelFont;
     std::shared_ptr<cugl::Node> _mikaNode;
     std::shared_ptr<cugl::AnimationNode> _mikaSprite;
     /** The action manager for this game mode. */
@@ -128,6 +140,12 @@ public:
     /** Create level node */
     std::shared_ptr<cugl::Node> createLevelNode(int levelIdx, bool cap=false);
     
+    /** Rebind recycled level tile [tile] and its dot [dot] to the level at [levelIdx] */
+    void bindLevelNode(const std::shared_ptr<cugl::Node>& tile, const std::shared_ptr<cugl::Node>& dot, int levelIdx);
+    
+    /** Return the texture of the menu tile for the level at [levelIdx] */
+    std::shared_ptr<cugl::Texture> menuTileTexture(int levelIdx);
+    
     /** Create top cap */
     std::shared_ptr<cugl::Node> createTopCap(int idx);
     
@@ -175,8 +193,14 @@ public:
     /** Returns if menu tile at index [i] is on the screen (shouldn't or should hidden) */
     bool menuTileOnScreen(int i);
     
-    /** Returns true if node is on the screen */
-    bool nodeOnScreen(std::shared_ptr<cugl::Node> node);
+    /** Returns the number of level tiles needed to cover the screen plus margin */
+    int menuTilePoolSize();
+    
+    /** Returns the recycled slot bound to the level at [levelIdx] and -1 if it is not materialised */
+    int levelSlot(int levelIdx);
+    
+    /** Rebinds recycled level tiles so they cover the visible window plus margin */
+    void updateLevelWindow();
     
     
 #pragma mark -
@@ -55,6 +55,7 @@ bool PlayMode::init(const std::shared_ptr<AssetManager>& assets, std::shared_ptr
 	} else if (!Scene::init(dimen)) {
 		return false;
 	}
+    setDeferred(true);  // Group the board and HUD sprites by texture
     _dimen = dimen;
     _level = level;
 
@@ -84,6 +85,8 @@ bool PlayMode::init(const std::shared_ptr<AssetManager>& assets, std::shared_ptr
     }
     _background = PolygonNode::allocWithTexture(assets->get<Texture>(backgroundKey));
     _background->setContentSize(dimen);
+    // The background never changes, so draw it from a retained mesh
+    _background->setStatic(true);
     addChild(_background, 0);
     
 //    _worldNode = Node::allocWithBounds(dimen);
@@ -104,6 +107,8 @@ bool PlayMode::init(const std::shared_ptr<AssetManager>& assets, std::shared_ptr
     _touchNode->setVisible(false);
     addChild(_touchNode);
     sortZOrder();
+    // Board sprites change z as they move; resort (incrementally) at render
+    setZAutoSort(true);
     _touchAction = Animate::alloc(0, 31, 1.0f);
 
     // Setup state
@@ -298,12 +303,10 @@ void PlayMode::toggleSound() {
 /** Load level from json */
 void PlayMode::setupLevelFromJson(Size dimen) {
     // Get filepath
-    std::shared_ptr<JsonReader> levelsReader = JsonReader::allocWithAsset("json/levelList.json");
-    std::shared_ptr<JsonValue> levelsJson = levelsReader->readJson();
+    std::shared_ptr<JsonValue> levelsJson = _assets->readJson("json/levelList.json");
     std::string filePath = levelsJson->get("levels")->get(_level)->asString();
     // Load json
-    std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(filePath);
-    std::shared_ptr<JsonValue> json = reader->readJson();
+    std::shared_ptr<JsonValue> json = _assets->readJson(filePath);
     if (json == nullptr) {
         CUAssertLog(false, "Failed to load level file");
         return;
@@ -398,6 +401,8 @@ void PlayMode::initMenu() {
     float menuHeight = _menuNode->getContentSize().height/_menuNode->getContentSize().width * menuWidth;
     _menuNode->setContentSize(menuWidth, menuHeight);
     _menuNode->setPosition(_dimen.width*0.5f, menuY);
+    // The frame only changes on a move, so it is baked into a mesh
+    _menuNode->setStatic(true);
     _worldNode->addChild(_menuNode, 5);
     
     // Restart
@@ -489,8 +494,9 @@ void PlayMode::initMenu() {
     float allyWidth = unit*2.0f;
     float allyHeight = _menuAlly->getContentSize().height/_menuAlly->getContentSize().width * allyWidth;
     _menuAlly->setContentSize(allyWidth, allyHeight);
-    _menuAlly->setPosition(cornerOffset + allyWidth*0.04f, menuNodeMid);
-    _menuNode->addChild(_menuAlly);
+    // The ally animates every frame, so it sits above the static frame
+    _menuAlly->setPosition(_menuNode->nodeToParentCoords(Vec2(cornerOffset + allyWidth*0.04f, menuNodeMid)));
+    _worldNode->addChild(_menuAlly, 6);
     
     // Stars
     float starHeight = _menuNode->getContentSize().height*0.215f;
@@ -1430,8 +1436,7 @@ void PlayMode::nextLevel() {
     _level++;
     
     // Check if past last level
-    std::shared_ptr<JsonReader> levelsReader = JsonReader::allocWithAsset("json/levelList.json");
-    std::shared_ptr<JsonValue> levelsJson = levelsReader->readJson();
+    std::shared_ptr<JsonValue> levelsJson = _assets->readJson("json/levelList.json");
     if (_level >= levelsJson->get("levels")->size()) {
         _level--;
         restart = false;
@@ -1461,8 +1466,7 @@ void PlayMode::levelMenu() {
     restart = false;
     
     // Check if past last level
-    std::shared_ptr<JsonReader> levelsReader = JsonReader::allocWithAsset("json/levelList.json");
-    std::shared_ptr<JsonValue> levelsJson = levelsReader->readJson();
+    std::shared_ptr<JsonValue> levelsJson = _assets->readJson("json/levelList.json");
     if (_level >= levelsJson->get("levels")->size()) {
         _level--;
         exit();
@@ -41,6 +41,7 @@ bool PlayerController::init(std::shared_ptr<ActionManager>& actions, const std::
     _board = board;
     _input = input;
 	_entityManager = manager;
+    _rootTexture = board->getAssets()->resolve<Texture>("rooting");
     
     _debug = false;
     _complete = false;
@@ -156,7 +157,7 @@ void PlayerController::update(float timestep) {
 				}
 				bool onRootedX = false;
 				bool onRootedY = false;
-				std::shared_ptr<cugl::Texture> rootTexture = _board->getAssets()->get<Texture>("rooting");
+				std::shared_ptr<cugl::Texture> rootTexture = _rootTexture.get();
 
 				for (int xx = 0; xx < _board->getWidth(); xx++) {
 					if (_entityManager->hasComponent<RootingComponent>(_board->getEnemy(xx, y))) { onRootedX = true; }
@@ -32,6 +32,8 @@ protected:
     std::shared_ptr<BoardModel> _board;
 	/** Entity Manager */
 	std::shared_ptr<EntityManager> _entityManager;
+    /** The rooting texture (fetched on every input frame, so resolved once) */
+    cugl::AssetHandle<cugl::Texture> _rootTexture;
     /** NUmber of player moves */
     int _numberMoves = 0;
     
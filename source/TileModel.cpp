@@ -37,61 +37,66 @@ void TileModel::dispose() {
 #pragma mark -
 #pragma mark Accessors/Mutators
 
+/** The number of tile colors, including the null tile (-1) */
+#define TILE_COLORS 11
+
+/** The texture, death texture and death sound keys of each color, starting with the null tile */
+static const char* TILE_KEYS[TILE_COLORS][3] = {
+    { TILE_TEXTURE_KEY_NULL, nullptr, nullptr },
+    { TILE_TEXTURE_KEY_0, TILE_TEXTURE_KEY_DEATH_0, TILE_SOUND_KEY_DEATH_0 },
+    { TILE_TEXTURE_KEY_1, TILE_TEXTURE_KEY_DEATH_1, TILE_SOUND_KEY_DEATH_1 },
+    { TILE_TEXTURE_KEY_2, TILE_TEXTURE_KEY_DEATH_2, TILE_SOUND_KEY_DEATH_2 },
+    { TILE_TEXTURE_KEY_3, TILE_TEXTURE_KEY_DEATH_3, TILE_SOUND_KEY_DEATH_3 },
+    { TILE_TEXTURE_KEY_4, TILE_TEXTURE_KEY_DEATH_4, TILE_SOUND_KEY_DEATH_4 },
+    { TILE_TEXTURE_KEY_5, TILE_TEXTURE_KEY_DEATH_5, TILE_SOUND_KEY_DEATH_5 },
+    { TILE_TEXTURE_KEY_6, TILE_TEXTURE_KEY_DEATH_6, TILE_SOUND_KEY_DEATH_6 },
+    { TILE_TEXTURE_KEY_7, TILE_TEXTURE_KEY_DEATH_7, TILE_SOUND_KEY_DEATH_7 },
+    { TILE_TEXTURE_KEY_8, TILE_TEXTURE_KEY_DEATH_8, TILE_SOUND_KEY_DEATH_8 },
+    { TILE_TEXTURE_KEY_9, TILE_TEXTURE_KEY_DEATH_9, TILE_SOUND_KEY_DEATH_9 }
+};
+
+/** The asset handles of a tile color */
+typedef struct {
+    AssetHandle<Texture> texture;
+    AssetHandle<Texture> deathTexture;
+    AssetHandle<Sound> deathSound;
+} TileHandles;
+
+/** Returns the asset handles for [color], resolving them once per asset manager */
+static const TileHandles& tileHandles(int color, const std::shared_ptr<cugl::AssetManager>& assets) {
+    static TileHandles handles[TILE_COLORS];
+    static std::weak_ptr<AssetManager> resolved;
+    if (resolved.lock() != assets) {
+        for (int ii = 0; ii < TILE_COLORS; ii++) {
+            handles[ii].texture = assets->resolve<Texture>(TILE_KEYS[ii][0]);
+            handles[ii].deathTexture = TILE_KEYS[ii][1] ? assets->resolve<Texture>(TILE_KEYS[ii][1]) : AssetHandle<Texture>();
+            handles[ii].deathSound = TILE_KEYS[ii][2] ? assets->resolve<Sound>(TILE_KEYS[ii][2]) : AssetHandle<Sound>();
+        }
+        resolved = assets;
+    }
+    return handles[color+1];
+}
+
 /** Sets the film strip */
 void TileModel::setSprite(const Rect bounds, const std::shared_ptr<cugl::AssetManager>& assets) {
-    // Get Texture
+    // Get Texture (refills call this for every new tile, so use handles)
     std::shared_ptr<Texture> texture;
     std::shared_ptr<Texture> deathTexture;
+    if (_color >= -1 && _color < TILE_COLORS-1) {
+        const TileHandles& handles = tileHandles(_color, assets);
+        texture = handles.texture.get();
+        deathTexture = handles.deathTexture.get();
+        _deathSound = handles.deathSound.get();
+    }
+    
     Color4 color = Color4::WHITE;
-    if (_color == -1) {
-        texture = assets->get<Texture>(TILE_TEXTURE_KEY_NULL);
-    } else if (_color == 0) {
-        texture = assets->get<Texture>(TILE_TEXTURE_KEY_0);
-        deathTexture = assets->get<Texture>(TILE_TEXTURE_KEY_DEATH_0);
-        _deathSound = assets->get<Sound>(TILE_SOUND_KEY_DEATH_0);
-    } else if (_color == 1) {
-        texture = assets->get<Texture>(TILE_TEXTURE_KEY_1);
-        deathTexture = assets->get<Texture>(TILE_TEXTURE_KEY_DEATH_1);
-        _deathSound = assets->get<Sound>(TILE_SOUND_KEY_DEATH_1);
-    } else if (_color == 2) {
-        texture = assets->get<Texture>(TILE_TEXTURE_KEY_2);
-        deathTexture = assets->get<Texture>(TILE_TEXTURE_KEY_DEATH_2);
-        _deathSound = assets->get<Sound>(TILE_SOUND_KEY_DEATH_2);
-//        color = Color4::RED;
-    } else if (_color == 3) {
-        texture = assets->get<Texture>(TILE_TEXTURE_KEY_3);
-        deathTexture = assets->get<Texture>(TILE_TEXTURE_KEY_DEATH_3);
-        _deathSound = assets->get<Sound>(TILE_SOUND_KEY_DEATH_3);
-//        color = Color4::CYAN;
-    } else if (_color == 4) {
-        texture = assets->get<Texture>(TILE_TEXTURE_KEY_4);
-        deathTexture = assets->get<Texture>(TILE_TEXTURE_KEY_DEATH_4);
-        _deathSound = assets->get<Sound>(TILE_SOUND_KEY_DEATH_4);
-//        color = Color4::GREEN;
-    } else if (_color == 5) {
-        texture = assets->get<Texture>(TILE_TEXTURE_KEY_5);
-        deathTexture = assets->get<Texture>(TILE_TEXTURE_KEY_DEATH_5);
-        _deathSound = assets->get<Sound>(TILE_SOUND_KEY_DEATH_5);
-//        color = Color4::YELLOW;
-    } else if (_color == 6) {
-        texture = assets->get<Texture>(TILE_TEXTURE_KEY_6);
-        deathTexture = assets->get<Texture>(TILE_TEXTURE_KEY_DEATH_6);
-        _deathSound = assets->get<Sound>(TILE_SOUND_KEY_DEATH_6);
+    if (_color == 6) {
         color = Color4::BLUE;
     } else if (_color == 7) {
-        texture = assets->get<Texture>(TILE_TEXTURE_KEY_7);
-        deathTexture = assets->get<Texture>(TILE_TEXTURE_KEY_DEATH_7);
-        _deathSound = assets->get<Sound>(TILE_SOUND_KEY_DEATH_7);
         color = Color4::MAGENTA;
     } else if (_color == 8) {
-        texture = assets->get<Texture>(TILE_TEXTURE_KEY_8);
-        deathTexture = assets->get<Texture>(TILE_TEXTURE_KEY_DEATH_8);
-        _deathSound = assets->get<Sound>(TILE_SOUND_KEY_DEATH_8);
         color = Color4::CORNFLOWER;
     } else if (_color == 9) {
-        texture = assets->get<Texture>(TILE_TEXTURE_KEY_9);
-        deathTexture = assets->get<Texture>(TILE_TEXTURE_KEY_DEATH_9);
-        _deathSound = assets->get<Sound>(TILE_SOUND_KEY_DEATH_9);
         color = Color4::ORANGE;
     }
     